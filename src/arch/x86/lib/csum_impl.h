@@ -0,0 +1,60 @@
+/**
+ * @file
+ * @brief Internet checksum for x86
+ *
+ * @details 32-bit words are added with carry, so the loop does one load
+ *   and one addition per four bytes.
+ *
+ * @date 17.10.26
+ */
+
+#ifndef ARCH_X86_LIB_CSUM_IMPL_H_
+#define ARCH_X86_LIB_CSUM_IMPL_H_
+
+#ifndef __ASSEMBLER__
+
+#define __HAVE_ARCH_CSUM_PARTIAL
+
+static inline unsigned long partial_sum(const void *addr, int len) {
+	unsigned long sum, words;
+	const unsigned char *ptr;
+	unsigned short oddbyte;
+
+	sum = 0;
+	ptr = addr;
+
+	words = len >> 2;
+	if (words != 0) {
+		/* decl doesn't change carry flag */
+		__asm__ (
+				"clc\n"
+			"1:\n\t"
+				"adcl (%1), %0\n\t"
+				"leal 4(%1), %1\n\t"
+				"decl %2\n\t"
+				"jnz 1b\n\t"
+				"adcl $0, %0\n"
+				: "+r" (sum), "+r" (ptr), "+r" (words)
+				:
+				: "memory", "cc"
+		);
+		sum = (sum >> 16) + (sum & 0xffff);
+	}
+
+	if (len & 2) {
+		sum += *(const unsigned short *)ptr;
+		ptr += 2;
+	}
+
+	if (len & 1) {
+		oddbyte = 0;
+		*((unsigned char *)&oddbyte) = *ptr;
+		sum += oddbyte;
+	}
+
+	return (sum >> 16) + (sum & 0xffff);
+}
+
+#endif /* !__ASSEMBLER__ */
+
+#endif /* !ARCH_X86_LIB_CSUM_IMPL_H_ */
@@ -0,0 +1,57 @@
+/**
+ * @file
+ * @brief Prints statistics of buffer cache
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <fs/bcache.h>
+
+static void print_usage(void) {
+	printf("Usage: bcstat [-s]\n");
+}
+
+static unsigned long ratio(unsigned long part, unsigned long total) {
+	return total ? part * 100 / total : 0;
+}
+
+int main(int argc, char **argv) {
+	struct bcache_stats st;
+	int opt, res;
+
+	while (-1 != (opt = getopt(argc, argv, "sh"))) {
+		switch (opt) {
+		case 's':
+			res = bcache_flush_blkdev(NULL);
+			if (res != 0) {
+				printf("bcstat: write back failed: %d\n", res);
+				return res;
+			}
+			break;
+		case 'h':
+			print_usage();
+			return 0;
+		default:
+			print_usage();
+			return -EINVAL;
+		}
+	}
+
+	bcache_get_stats(&st);
+
+	printf("buffers:    %d (fifo %d, lru %d, dirty %d), ghosts %d\n",
+			st.capacity, st.fifo, st.lru, st.dirty, st.ghosts);
+	printf("hits:       %lu (%lu%%)\n", st.hits,
+			ratio(st.hits, st.hits + st.misses));
+	printf("misses:     %lu\n", st.misses);
+	printf("evictions:  %lu\n", st.evictions);
+	printf("writebacks: %lu\n", st.writebacks);
+	printf("readahead:  %lu, used %lu (%lu%%)\n", st.readahead,
+			st.readahead_hits, ratio(st.readahead_hits, st.readahead));
+
+	return 0;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file
+ * @brief Measures IOPS and throughput of block device
+ *
+ * @details Keeps up to iodepth requests in the queue of device, like
+ *   fio with an asynchronous engine does.
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <drivers/block_dev.h>
+#include <drivers/block_request.h>
+#include <hal/ipl.h>
+#include <kernel/sched/waitq.h>
+#include <kernel/thread/waitq.h>
+#include <kernel/time/ktime.h>
+
+#define BLKBENCH_DEFAULT_BS    4096
+#define BLKBENCH_DEFAULT_DEPTH 16
+#define BLKBENCH_DEFAULT_COUNT 10000
+
+struct blkbench {
+	struct block_bio *bios;
+	int *idle;          /* Indexes of bios which aren't submitted */
+	int nidle;
+	int errors;
+	struct waitq wq;
+};
+
+static struct blkbench bench;
+
+static void print_usage(void) {
+	printf("Usage: blkbench [-t read|write|randread|randwrite] [-b BS] "
+			"[-d IODEPTH] [-n COUNT] DEVICE\n");
+}
+
+static void blkbench_end_io(struct block_bio *bio, int err) {
+	ipl_t ipl;
+
+	ipl = ipl_save();
+	{
+		if (err) {
+			bench.errors++;
+		}
+		bench.idle[bench.nidle++] = bio - bench.bios;
+	}
+	ipl_restore(ipl);
+
+	waitq_wakeup_all(&bench.wq);
+}
+
+static int blkbench_get_idle(void) {
+	ipl_t ipl;
+	int i;
+
+	WAITQ_WAIT(&bench.wq, bench.nidle > 0);
+
+	ipl = ipl_save();
+	{
+		i = bench.idle[--bench.nidle];
+	}
+	ipl_restore(ipl);
+
+	return i;
+}
+
+int main(int argc, char **argv) {
+	struct block_dev *bdev;
+	struct block_bio *bio;
+	const char *type;
+	char *bufs;
+	size_t bs, nblocks, span;
+	blkno_t seq;
+	int depth, count, op, rnd, opt, i, n;
+	time64_t start, ns;
+
+	type = "randread";
+	bs = BLKBENCH_DEFAULT_BS;
+	depth = BLKBENCH_DEFAULT_DEPTH;
+	count = BLKBENCH_DEFAULT_COUNT;
+
+	while (-1 != (opt = getopt(argc, argv, "t:b:d:n:h"))) {
+		switch (opt) {
+		case 't':
+			type = optarg;
+			break;
+		case 'b':
+			bs = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			depth = strtol(optarg, NULL, 0);
+			break;
+		case 'n':
+			count = strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_usage();
+			return 0;
+		default:
+			print_usage();
+			return -EINVAL;
+		}
+	}
+
+	if (optind >= argc) {
+		print_usage();
+		return -EINVAL;
+	}
+
+	if (!strcmp(type, "read") || !strcmp(type, "randread")) {
+		op = BLOCK_REQ_READ;
+	} else if (!strcmp(type, "write") || !strcmp(type, "randwrite")) {
+		op = BLOCK_REQ_WRITE;
+	} else {
+		print_usage();
+		return -EINVAL;
+	}
+	rnd = !strncmp(type, "rand", 4);
+
+	bdev = block_dev_find(argv[optind]);
+	if (bdev == NULL) {
+		printf("blkbench: %s: no such device\n", argv[optind]);
+		return -ENODEV;
+	}
+
+	if ((depth <= 0) || (count <= 0) || (bs == 0) || (bs % bdev->block_size)
+			|| (bs / bdev->block_size > bdev->queue->max_blocks)) {
+		printf("blkbench: wrong parameters, block size of device is %zu, "
+				"maximum request is %zu blocks\n", bdev->block_size,
+				bdev->queue->max_blocks);
+		return -EINVAL;
+	}
+
+	nblocks = bs / bdev->block_size;
+	span = bdev->size / bs;
+	if (span == 0) {
+		printf("blkbench: device is smaller than %zu bytes\n", bs);
+		return -EINVAL;
+	}
+
+	bench.bios = malloc(depth * sizeof(struct block_bio));
+	bench.idle = malloc(depth * sizeof(int));
+	bufs = malloc(depth * bs);
+	if (!bench.bios || !bench.idle || !bufs) {
+		free(bench.bios);
+		free(bench.idle);
+		free(bufs);
+		return -ENOMEM;
+	}
+	memset(bufs, 0x5a, depth * bs);
+
+	waitq_init(&bench.wq);
+	bench.errors = 0;
+	for (i = 0; i < depth; i++) {
+		bench.idle[i] = i;
+	}
+	bench.nidle = depth;
+
+	seq = 0;
+	start = ktime_get_ns();
+	for (n = 0; n < count; n++) {
+		i = blkbench_get_idle();
+		bio = &bench.bios[i];
+
+		bio->op = op;
+		bio->nblocks = nblocks;
+		bio->buf = bufs + i * bs;
+		bio->end_io = blkbench_end_io;
+		if (rnd) {
+			bio->blkno = (rand() % span) * nblocks;
+		} else {
+			bio->blkno = seq * nblocks;
+			seq = (seq + 1) % span;
+		}
+
+		block_bio_submit(bdev, bio);
+	}
+	WAITQ_WAIT(&bench.wq, bench.nidle == depth);
+	ns = ktime_get_ns() - start;
+
+	if (ns == 0) {
+		ns = 1;
+	}
+	printf("%s: %d x %zu bytes, iodepth %d, %lld us\n", type, count, bs, depth,
+			(long long) (ns / 1000));
+	printf("  %lld IOPS, %lld KiB/s, %d errors\n",
+			(long long) ((int64_t) count * 1000000000LL / ns),
+			(long long) ((int64_t) count * bs * (1000000000LL / 1024) / ns),
+			bench.errors);
+
+	free(bufs);
+	free(bench.idle);
+	free(bench.bios);
+
+	return bench.errors ? -EIO : 0;
+}
@@ -0,0 +1,421 @@
+/**
+ * @file
+ * @brief Measures latency of malloc() and free() and heap fragmentation
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <kernel/time/ktime.h>
+#include <mem/heap.h>
+#include <mem/page.h>
+
+#define HEAPBENCH_DEFAULT_COUNT 10000
+#define HEAPBENCH_DEFAULT_SIZE  1024
+#define HEAPBENCH_SLOTS         256
+#define HEAPBENCH_RING          64
+#define HEAPBENCH_SEG_SMALL     1000
+
+struct latency {
+	time64_t *ns;
+	int cnt;
+	int max_cnt;
+};
+
+struct ring {
+	void *obj[HEAPBENCH_RING];
+	int head;
+	int tail;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+static int count;
+static size_t max_size;
+
+static void print_usage(void) {
+	printf("Usage: heapbench [-t random|prodcons|frag|segments|all] [-n COUNT] "
+			"[-s MAXSIZE]\n");
+}
+
+static int latency_init(struct latency *lat, int max_cnt) {
+	/* Samples are allocated before measuring */
+	lat->ns = malloc(max_cnt * sizeof(time64_t));
+	lat->cnt = 0;
+	lat->max_cnt = max_cnt;
+
+	return lat->ns ? 0 : -ENOMEM;
+}
+
+static void latency_fini(struct latency *lat) {
+	free(lat->ns);
+}
+
+static inline void latency_add(struct latency *lat, time64_t ns) {
+	if (lat->cnt < lat->max_cnt) {
+		lat->ns[lat->cnt++] = ns;
+	}
+}
+
+static int time_cmp(const void *a, const void *b) {
+	time64_t x = *(const time64_t *) a, y = *(const time64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void latency_print(const char *name, struct latency *lat) {
+	time64_t *ns;
+	int n;
+
+	ns = lat->ns;
+	n = lat->cnt;
+	if (n == 0) {
+		printf("  %-7s no samples\n", name);
+		return;
+	}
+
+	qsort(ns, n, sizeof(time64_t), time_cmp);
+	printf("  %-7s %6d ops, ns: p50 %lld, p90 %lld, p99 %lld, p99.9 %lld, "
+			"max %lld\n", name, n,
+			(long long) ns[n / 2], (long long) ns[n * 9 / 10],
+			(long long) ns[n * 99 / 100], (long long) ns[n * 999 / 1000],
+			(long long) ns[n - 1]);
+}
+
+static void fragmentation_print(void) {
+	struct heap_stat st;
+
+	heap_get_stat(&st);
+	printf("  heap: %zu bytes in %d segments, free %zu, largest free %zu, "
+			"fragmentation %d%%\n", st.total, st.segments, st.free,
+			st.largest_free,
+			st.free ? (int) (100 - st.largest_free * 100 / st.free) : 0);
+}
+
+static size_t random_size(void) {
+	/* Small blocks are more frequent */
+	return 1 + rand() % (1 + rand() % max_size);
+}
+
+static void *timed_malloc(struct latency *lat, size_t size) {
+	time64_t start;
+	void *p;
+
+	start = ktime_get_ns();
+	p = malloc(size);
+	latency_add(lat, ktime_get_ns() - start);
+
+	return p;
+}
+
+static void timed_free(struct latency *lat, void *p) {
+	time64_t start;
+
+	start = ktime_get_ns();
+	free(p);
+	latency_add(lat, ktime_get_ns() - start);
+}
+
+static int bench_random(void) {
+	struct latency lat_malloc, lat_free;
+	void *slot[HEAPBENCH_SLOTS];
+	int i, j, res;
+
+	if (0 != (res = latency_init(&lat_malloc, count))) {
+		return res;
+	}
+	if (0 != (res = latency_init(&lat_free, count))) {
+		latency_fini(&lat_malloc);
+		return res;
+	}
+	memset(slot, 0, sizeof(slot));
+
+	for (i = 0; i < count; i++) {
+		j = rand() % HEAPBENCH_SLOTS;
+		if (slot[j]) {
+			timed_free(&lat_free, slot[j]);
+			slot[j] = NULL;
+		} else {
+			slot[j] = timed_malloc(&lat_malloc, random_size());
+		}
+	}
+
+	printf("random sizes up to %zu bytes, %d live blocks at most:\n",
+			max_size, HEAPBENCH_SLOTS);
+	latency_print("malloc", &lat_malloc);
+	latency_print("free", &lat_free);
+	fragmentation_print();
+
+	for (j = 0; j < HEAPBENCH_SLOTS; j++) {
+		free(slot[j]);
+	}
+	latency_fini(&lat_free);
+	latency_fini(&lat_malloc);
+
+	return 0;
+}
+
+static struct ring ring;
+static struct latency lat_consumer;
+
+static void *consumer(void *arg) {
+	void *p;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		pthread_mutex_lock(&ring.mutex);
+		while (ring.head == ring.tail) {
+			pthread_cond_wait(&ring.cond, &ring.mutex);
+		}
+		p = ring.obj[ring.tail++ % HEAPBENCH_RING];
+		pthread_cond_signal(&ring.cond);
+		pthread_mutex_unlock(&ring.mutex);
+
+		if (p) {
+			timed_free(&lat_consumer, p);
+		}
+	}
+
+	return NULL;
+}
+
+static int bench_prodcons(void) {
+	struct latency lat_producer;
+	pthread_t thread;
+	void *p;
+	int i, res;
+
+	if (0 != (res = latency_init(&lat_producer, count))) {
+		return res;
+	}
+	if (0 != (res = latency_init(&lat_consumer, count))) {
+		latency_fini(&lat_producer);
+		return res;
+	}
+
+	ring.head = ring.tail = 0;
+	pthread_mutex_init(&ring.mutex, NULL);
+	pthread_cond_init(&ring.cond, NULL);
+
+	res = pthread_create(&thread, NULL, consumer, NULL);
+	if (res != 0) {
+		latency_fini(&lat_consumer);
+		latency_fini(&lat_producer);
+		return -res;
+	}
+
+	/* Blocks are freed by another thread */
+	for (i = 0; i < count; i++) {
+		p = timed_malloc(&lat_producer, random_size());
+
+		pthread_mutex_lock(&ring.mutex);
+		while (ring.head - ring.tail == HEAPBENCH_RING) {
+			pthread_cond_wait(&ring.cond, &ring.mutex);
+		}
+		ring.obj[ring.head++ % HEAPBENCH_RING] = p;
+		pthread_cond_signal(&ring.cond);
+		pthread_mutex_unlock(&ring.mutex);
+	}
+	pthread_join(thread, NULL);
+
+	printf("producer/consumer, sizes up to %zu bytes:\n", max_size);
+	latency_print("malloc", &lat_producer);
+	latency_print("free", &lat_consumer);
+	fragmentation_print();
+
+	pthread_cond_destroy(&ring.cond);
+	pthread_mutex_destroy(&ring.mutex);
+	latency_fini(&lat_consumer);
+	latency_fini(&lat_producer);
+
+	return 0;
+}
+
+static int bench_frag(void) {
+	struct latency lat_malloc;
+	void **small;
+	void *big;
+	int i, n, res, failed;
+
+	n = count;
+	small = malloc(n * sizeof(void *));
+	if (small == NULL) {
+		return -ENOMEM;
+	}
+	if (0 != (res = latency_init(&lat_malloc, n))) {
+		free(small);
+		return res;
+	}
+
+	/* Every other of small blocks is freed, so there are many holes which
+	 * can't hold a bigger block */
+	for (i = 0; i < n; i++) {
+		small[i] = malloc(16 + rand() % 64);
+	}
+	for (i = 0; i < n; i += 2) {
+		free(small[i]);
+		small[i] = NULL;
+	}
+
+	printf("fragmentation stress, %d small blocks with holes:\n", n);
+	fragmentation_print();
+
+	failed = 0;
+	for (i = 0; i < n; i += 2) {
+		small[i] = timed_malloc(&lat_malloc, max_size);
+		if (small[i] == NULL) {
+			failed++;
+		}
+	}
+	big = malloc(max_size * 64);
+
+	latency_print("malloc", &lat_malloc);
+	printf("  %d of %d blocks of %zu bytes failed, block of %zu bytes %s\n",
+			failed, (n + 1) / 2, max_size, max_size * 64,
+			big ? "allocated" : "failed");
+	fragmentation_print();
+
+	free(big);
+	for (i = 0; i < n; i++) {
+		free(small[i]);
+	}
+	latency_fini(&lat_malloc);
+	free(small);
+
+	return 0;
+}
+
+/* Latency of free() of blocks from the first segment while there are
+ * @a seg_cnt other segments in the heap */
+static int bench_segments_one(int seg_cnt, void **small, void **big) {
+	struct latency lat_free;
+	int i, n, res;
+
+	if (0 != (res = latency_init(&lat_free, HEAPBENCH_SEG_SMALL))) {
+		return res;
+	}
+
+	/* Small blocks are placed in the oldest segments which are the last
+	 * ones in the list of segments */
+	for (i = 0; i < HEAPBENCH_SEG_SMALL; i++) {
+		small[i] = malloc(16);
+	}
+	for (n = 0; n < seg_cnt; n++) {
+		/* Block larger than a page doesn't fit into existing segments */
+		big[n] = malloc(2 * PAGE_SIZE());
+		if (big[n] == NULL) {
+			break;
+		}
+	}
+
+	printf("  %5d segments requested, %5d allocated:\n", seg_cnt, n);
+	for (i = 0; i < HEAPBENCH_SEG_SMALL; i++) {
+		if (small[i]) {
+			timed_free(&lat_free, small[i]);
+		}
+	}
+	latency_print("free", &lat_free);
+
+	for (i = 0; i < n; i++) {
+		free(big[i]);
+	}
+	latency_fini(&lat_free);
+
+	return n < seg_cnt ? -ENOMEM : 0;
+}
+
+static int bench_segments(void) {
+	void **small, **big;
+	int seg_cnt, res;
+
+	small = malloc(HEAPBENCH_SEG_SMALL * sizeof(void *));
+	big = malloc(count * sizeof(void *));
+	if ((small == NULL) || (big == NULL)) {
+		free(big);
+		free(small);
+		return -ENOMEM;
+	}
+
+	printf("free() latency depending on number of heap segments:\n");
+	for (seg_cnt = 1; seg_cnt <= count; seg_cnt *= 10) {
+		res = bench_segments_one(seg_cnt, small, big);
+		if (res != 0) {
+			break; /* heap is exhausted */
+		}
+	}
+	fragmentation_print();
+
+	free(big);
+	free(small);
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	const char *type;
+	int opt, res;
+
+	type = "all";
+	count = HEAPBENCH_DEFAULT_COUNT;
+	max_size = HEAPBENCH_DEFAULT_SIZE;
+
+	while (-1 != (opt = getopt(argc, argv, "t:n:s:h"))) {
+		switch (opt) {
+		case 't':
+			type = optarg;
+			break;
+		case 'n':
+			count = strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			max_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_usage();
+			return 0;
+		default:
+			print_usage();
+			return -EINVAL;
+		}
+	}
+
+	if ((count <= 0) || (max_size == 0)) {
+		print_usage();
+		return -EINVAL;
+	}
+
+	res = -EINVAL;
+	if (!strcmp(type, "random") || !strcmp(type, "all")) {
+		if (0 != (res = bench_random())) {
+			return res;
+		}
+	}
+	if (!strcmp(type, "prodcons") || !strcmp(type, "all")) {
+		if (0 != (res = bench_prodcons())) {
+			return res;
+		}
+	}
+	if (!strcmp(type, "frag") || !strcmp(type, "all")) {
+		if (0 != (res = bench_frag())) {
+			return res;
+		}
+	}
+	if (!strcmp(type, "segments") || !strcmp(type, "all")) {
+		if (0 != (res = bench_segments())) {
+			return res;
+		}
+	}
+
+	if (res == -EINVAL) {
+		print_usage();
+	}
+
+	return res;
+}
@@ -8,6 +8,7 @@
 
 #include <stdio.h>
 #include <unistd.h>
+#include <mem/page.h>
 #include <mem/phymem.h>
 #include <mem/vmem/vmem_alloc.h>
 #include <mem/vmem.h>
@@ -36,6 +37,23 @@ static void print_vmem(struct page_allocator *pgd_allocator,
 	printf("-----------------------------------------\n");
 }
 
+static void print_fragmentation(struct page_allocator *allocator) {
+	struct page_stat stat;
+	int order;
+
+	page_get_stat(allocator, &stat);
+
+	printf("cached by CPUs - %zu, largest free block - %zu\n",
+			stat.cached_pages, stat.largest_free);
+	printf("free blocks by order:");
+	for (order = 0; order < PAGE_MAX_ORDER; order++) {
+		if (stat.blocks[order]) {
+			printf(" %d:%u", order, stat.blocks[order]);
+		}
+	}
+	printf("\n");
+}
+
 static void print_phymem(struct page_allocator *allocator) {
 	char *const phymem_alloc_start = phymem_allocated_start();
 	char *const phymem_alloc_end = phymem_allocated_end();
@@ -48,6 +66,7 @@ static void print_phymem(struct page_allocator *allocator) {
 	printf("first usable phy_page adr - %p\n", allocator->pages_start);
 	printf("pages count / free - %zu / %zu\n", allocator->pages_n,
 				allocator->free / allocator->page_size);
+	print_fragmentation(allocator);
 	printf("-----------------------------------------\n");
 }
 
@@ -0,0 +1,71 @@
+/**
+ * @file
+ * @brief Print statistics of slab caches
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <mem/misc/slab.h>
+#include <mem/shrinker.h>
+
+#define SLABINFO_MAX_CACHES 64
+
+static struct cache_stats slabinfo_stats[SLABINFO_MAX_CACHES];
+
+static void print_usage(void) {
+	printf("Usage: slabinfo [-r] [-h]\n");
+}
+
+static unsigned int percent(unsigned long part, unsigned long total) {
+	return total ? (unsigned int) (part * 100 / total) : 0;
+}
+
+static void print_stats(const struct cache_stats *st) {
+	printf("%-16s %6zu  %6u %6u  %5u %5u  %5u %3u  %10lu %3u%%  %10lu %3u%%"
+			"  %6u\n",
+			st->name, st->obj_size,
+			st->inuse - st->cached, st->slabs * st->num,
+			st->slabs, st->slabs_free,
+			1U << st->slab_order, st->colour,
+			st->allocs, percent(st->alloc_hits, st->allocs),
+			st->frees, percent(st->free_hits, st->frees),
+			st->cached);
+}
+
+int main(int argc, char **argv) {
+	int opt, i, n;
+
+	while (-1 != (opt = getopt(argc, argv, "rh"))) {
+		switch (opt) {
+		case 'r':
+			printf("Reclaimed %zu objects\n", shrink_caches(SHRINK_SLAB,
+					shrink_count(SHRINK_SLAB)));
+			break;
+		case 'h':
+			print_usage();
+			return 0;
+		default:
+			print_usage();
+			return -EINVAL;
+		}
+	}
+
+	n = cache_get_stats(slabinfo_stats, SLABINFO_MAX_CACHES);
+
+	printf("name             objsize  active  total  slabs  free  pages col"
+			"      allocs  hit       frees  hit  cached\n");
+	for (i = 0; i < n && i < SLABINFO_MAX_CACHES; i++) {
+		print_stats(&slabinfo_stats[i]);
+	}
+	if (n > SLABINFO_MAX_CACHES) {
+		printf("... %d caches more\n", n - SLABINFO_MAX_CACHES);
+	}
+
+	printf("Reclaimable objects: %zu\n", shrink_count(SHRINK_SLAB));
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file
+ * @brief Print statistics of per-thread heap caches
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <kernel/sched/sched_lock.h>
+#include <kernel/task.h>
+#include <kernel/thread.h>
+#include <mem/tcache.h>
+
+static void print_usage(void) {
+	printf("Usage: tcstat [-a] [-h]\n");
+}
+
+static unsigned int percent(unsigned long part, unsigned long total) {
+	return total ? (unsigned int) (part * 100 / total) : 0;
+}
+
+static void print_stats(const char *tid, const char *task,
+		const struct tcache_stats *st) {
+	printf("%4s  %4s  %10lu  %3u%%  %10lu  %3u%%  %8lu  %8lu  %6u\n",
+			tid, task,
+			st->allocs, percent(st->alloc_hits, st->allocs),
+			st->frees, percent(st->free_hits, st->frees),
+			st->refills, st->flushes, st->cached);
+}
+
+static void stats_add(struct tcache_stats *to,
+		const struct tcache_stats *st) {
+	to->allocs += st->allocs;
+	to->alloc_hits += st->alloc_hits;
+	to->frees += st->frees;
+	to->free_hits += st->free_hits;
+	to->refills += st->refills;
+	to->flushes += st->flushes;
+	to->cached += st->cached;
+}
+
+int main(int argc, char **argv) {
+	struct tcache_stats st, all;
+	struct task *task;
+	struct thread *t;
+	char thread_str[12], task_str[12];
+	int opt, show_idle;
+
+	show_idle = 0;
+	while (-1 != (opt = getopt(argc, argv, "ah"))) {
+		switch (opt) {
+		case 'a':
+			show_idle = 1;
+			break;
+		case 'h':
+			print_usage();
+			return 0;
+		default:
+			print_usage();
+			return -EINVAL;
+		}
+	}
+
+	memset(&all, 0, sizeof all);
+
+	printf(" tid  task      allocs   hit       frees   hit   refills   "
+			"flushes  cached\n");
+
+	sched_lock();
+	{
+		task_foreach(task) {
+			task_foreach_thread(t, task) {
+				tcache_get_stats(t, &st);
+				stats_add(&all, &st);
+				if (!show_idle && !st.allocs && !st.frees) {
+					continue;
+				}
+
+				snprintf(thread_str, sizeof thread_str, "%d", t->id);
+				snprintf(task_str, sizeof task_str, "%d", task_get_id(task));
+				print_stats(thread_str, task_str, &st);
+			}
+		}
+	}
+	sched_unlock();
+
+	print_stats("ALL", "", &all);
+
+	return 0;
+}
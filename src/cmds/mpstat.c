@@ -23,6 +23,8 @@ int main(int argc, char **argv) {
 	int opt;
 	clock_t atotal = 0;
 	clock_t aidle = 0;
+	unsigned int amigr = 0;
+	unsigned int asteal = 0;
 
 	if (argc <= 1) {
 		print_usage();
@@ -40,24 +42,30 @@ int main(int argc, char **argv) {
 			print_usage();
 			return ENOERR;
 		case 'P':
-			printf("CPU  time  %%idle\n");
+			printf("CPU  time  %%idle      migr     steal\n");
 
 			for (int i = 0; i < NCPU; i++) {
 				clock_t idle = cpu_get_idle_time(i);
 				clock_t total = cpu_get_total_time(i);
+				unsigned int migr = cpu_get_migrations(i);
+				unsigned int steal = cpu_get_steals(i);
 
-				printf("%3d  %3ds    %2d%%\n",
+				printf("%3d  %3ds    %2d%%  %8u  %8u\n",
 						i,
 						(int) (total / CLOCKS_PER_SEC),
-						(int) (idle * 100 / total));
+						(int) (idle * 100 / total),
+						migr, steal);
 
 				atotal += total;
 				aidle  += idle;
+				amigr  += migr;
+				asteal += steal;
 			}
 
-			printf("ALL  %3ds    %2d%%\n",
+			printf("ALL  %3ds    %2d%%  %8u  %8u\n",
 					(int) (atotal / CLOCKS_PER_SEC),
-					(int) (aidle * 100 / atotal));
+					(int) (aidle * 100 / atotal),
+					amigr, asteal);
 
 			return ENOERR;
 		default:
@@ -7,8 +7,11 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
 #include "httpd.h"
 
 #define PAGE_INDEX  "index.html"
@@ -17,9 +20,10 @@ int httpd_try_respond_file(const struct client_info *cinfo, const struct http_re
 		char *buf, size_t buf_sz) {
 	char path[HTTPD_MAX_PATH];
 	char *uri_path;
-	size_t read_bytes;
-	FILE *file;
-	int path_len, retcode, cbyte;
+	struct stat st;
+	ssize_t sent_bytes;
+	off_t remain_bytes;
+	int file, path_len, retcode, cbyte;
 
 	if (0 == strcmp(hreq->uri.target, "/")) {
 		uri_path = PAGE_INDEX;
@@ -34,45 +38,46 @@ int httpd_try_respond_file(const struct client_info *cinfo, const struct http_re
 
 	httpd_debug("requested: %s, on fs: %s", hreq->uri.target, path);
 
-	file = fopen(path, "r");
-	if (!file) {
+	file = open(path, O_RDONLY);
+	if (file < 0) {
 		httpd_debug("file couldn't be opened (%d)", errno);
 		return 0;
 	}
 
+	if (0 > fstat(file, &st)) {
+		retcode = -errno;
+		goto out;
+	}
+
 	cbyte = snprintf(buf, buf_sz,
 			"HTTP/1.1 %d %s\r\n"
 			"Content-Type: %s\r\n"
+			"Content-Length: %ld\r\n"
 			"Connection: close\r\n"
 			"\r\n",
-			200, "", httpd_filename2content_type(path));
+			200, "", httpd_filename2content_type(path),
+			(long) st.st_size);
 
 	if (0 > write(cinfo->ci_sock, buf, cbyte)) {
 		retcode = -errno;
 		goto out;
 	}
 
+	/* File is sent without copying it through the user buffer */
 	retcode = 1;
-	while (0 != (read_bytes = fread(buf, 1, buf_sz, file))) {
-		const char *pb;
-		int remain_send_bytes;
-
-		pb = buf;
-		remain_send_bytes = read_bytes;
-		while (remain_send_bytes) {
-			int sent_bytes;
-
-			if (0 > (sent_bytes = write(cinfo->ci_sock, pb, read_bytes))) {
-				retcode = sent_bytes;
-				break;
+	remain_bytes = st.st_size;
+	while (remain_bytes > 0) {
+		sent_bytes = sendfile(cinfo->ci_sock, file, NULL, remain_bytes);
+		if (0 >= sent_bytes) {
+			if (0 > sent_bytes) {
+				retcode = -errno;
 			}
-
-			pb += sent_bytes;
-			remain_send_bytes -= sent_bytes;
+			break;
 		}
+
+		remain_bytes -= sent_bytes;
 	}
 out:
-	fclose(file);
+	close(file);
 	return retcode;
 }
-
@@ -210,6 +210,9 @@ static int ifconfig_print_long_info(struct in_device *iface) {
 	printf("\n\tcollisions:%ld",
 			stat->collisions);
 
+	printf("\n\tRX polls:%ld squeezed:%ld",
+			stat->rx_polls, stat->rx_poll_squeezed);
+
 	printf("\n\tRX bytes:%ld (%ld MiB)  TX bytes:%ld (%ld MiB)",
 			stat->rx_bytes, stat->rx_bytes / 1048576,
 			stat->tx_bytes, stat->tx_bytes / 1048576);
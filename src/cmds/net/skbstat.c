@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @brief Print statistics of per-CPU socket buffer caches
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <hal/cpu.h>
+#include <net/skbuff.h>
+
+static void print_usage(void) {
+	printf("Usage: skbstat [-h]\n");
+}
+
+static unsigned int percent(unsigned long part, unsigned long total) {
+	return total ? (unsigned int) (part * 100 / total) : 0;
+}
+
+static void print_stats(const char *cpu, const char *name,
+		const struct skb_cache_stats *st) {
+	printf("%3s  %-4s  %10lu  %3u%%  %10lu  %3u%%  %8lu  %8lu  %8lu  %6u\n",
+			cpu, name,
+			st->allocs, percent(st->alloc_hits, st->allocs),
+			st->frees, percent(st->free_hits, st->frees),
+			st->refills, st->flushes, st->depleted, st->cached);
+}
+
+static void stats_add(struct skb_cache_stats *to,
+		const struct skb_cache_stats *st) {
+	to->allocs += st->allocs;
+	to->alloc_hits += st->alloc_hits;
+	to->frees += st->frees;
+	to->free_hits += st->free_hits;
+	to->refills += st->refills;
+	to->flushes += st->flushes;
+	to->depleted += st->depleted;
+	to->cached += st->cached;
+}
+
+int main(int argc, char **argv) {
+	struct skb_cache_stats st, skb_all, data_all;
+	char cpu[4];
+	int opt;
+	unsigned int i;
+
+	while (-1 != (opt = getopt(argc, argv, "h"))) {
+		switch (opt) {
+		case 'h':
+			print_usage();
+			return 0;
+		default:
+			print_usage();
+			return -EINVAL;
+		}
+	}
+
+	memset(&skb_all, 0, sizeof skb_all);
+	memset(&data_all, 0, sizeof data_all);
+
+	printf("CPU  type      allocs   hit       frees   hit   refills   "
+			"flushes  depleted  cached\n");
+	for (i = 0; i < NCPU; i++) {
+		snprintf(cpu, sizeof cpu, "%u", i);
+
+		skb_get_cache_stats(i, &st);
+		print_stats(cpu, "skb", &st);
+		stats_add(&skb_all, &st);
+
+		skb_data_get_cache_stats(i, &st);
+		print_stats(cpu, "data", &st);
+		stats_add(&data_all, &st);
+	}
+
+	if (NCPU > 1) {
+		print_stats("ALL", "skb", &skb_all);
+		print_stats("ALL", "data", &data_all);
+	}
+
+	return 0;
+}
@@ -5,8 +5,26 @@
  * @author: Anton Bondarev
  */
 
+#include <errno.h>
+#include <stddef.h>
 #include <unistd.h>
 
+#include <fs/idesc.h>
+#include <fs/index_descriptor.h>
+#include <kernel/task/resource/idesc_table.h>
+
 int fsync(int fd) {
+	int ret;
+
+	if (!idesc_index_valid(fd)
+			|| (NULL == index_descriptor_get(fd))) {
+		return SET_ERRNO(EBADF);
+	}
+
+	ret = index_descriptor_fsync(fd);
+	if (ret != 0) {
+		return SET_ERRNO(-ret);
+	}
+
 	return 0;
 }
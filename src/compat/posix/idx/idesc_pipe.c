@@ -67,7 +67,7 @@ static int idesc_pipe_close(struct idesc_pipe *cur, struct idesc_pipe *other) {
 	cur->idesc.idesc_amode = 0;
 
 	if (other->idesc.idesc_amode) {
-		idesc_notify(&other->idesc, POLLERR);
+		idesc_notify(&other->idesc, POLLERR | POLLHUP);
 	} else {
 		return 1;
 	}
@@ -211,6 +211,7 @@ static int pipe_fcntl(struct idesc *data, int cmd, void * args) {
 }
 
 static int idesc_pipe_status(struct idesc *idesc, int mask) {
+	struct idesc_pipe *other;
 	struct pipe *pipe;
 	int res;
 
@@ -237,6 +238,12 @@ static int idesc_pipe_status(struct idesc *idesc, int mask) {
 		/* is there any exeptions */
 		res = 0; //TODO Where is errors counter
 		goto out;
+	case POLLHUP:
+		/* the other end is closed */
+		other = (idesc == &pipe->read_desc.idesc) ?
+				&pipe->write_desc : &pipe->read_desc;
+		res = idesc_pipe_isclosed(other);
+		goto out;
 	default:
 		res = 0;
 		break;
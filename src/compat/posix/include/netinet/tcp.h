@@ -12,6 +12,9 @@
 #define NETINET_TCP_H_
 
 /* Options specific for tcp socket */
-#define TCP_NODELAY 0
+#define TCP_NODELAY    0
+#define TCP_MAXSEG     2  /* Maximum segment size */
+#define TCP_CORK       3  /* Send only full segments */
+#define TCP_CONGESTION 13 /* Congestion control algorithm name */
 
 #endif /* NETINET_TCP_H_ */
@@ -0,0 +1,55 @@
+/**
+ * @file
+ * @brief I/O event notification for large number of descriptors.
+ *
+ * @date 17.10.26
+ */
+
+#ifndef SYS_EPOLL_H_
+#define SYS_EPOLL_H_
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include <sys/cdefs.h>
+
+#define EPOLL_CLOEXEC O_CLOEXEC
+
+#define EPOLLIN      POLLIN
+#define EPOLLOUT     POLLOUT
+#define EPOLLPRI     POLLPRI
+#define EPOLLERR     POLLERR
+#define EPOLLHUP     POLLHUP
+#define EPOLLRDNORM  POLLRDNORM
+#define EPOLLWRNORM  POLLWRNORM
+#define EPOLLONESHOT (1U << 30) /* Disable descriptor after event is reported */
+#define EPOLLET      (1U << 31) /* Report event only on state change */
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+typedef union epoll_data {
+	void *ptr;
+	int fd;
+	uint32_t u32;
+	uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event {
+	uint32_t events;
+	epoll_data_t data;
+};
+
+__BEGIN_DECLS
+
+extern int epoll_create(int size);
+extern int epoll_create1(int flags);
+extern int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
+extern int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+		int timeout);
+
+__END_DECLS
+
+#endif /* SYS_EPOLL_H_ */
@@ -0,0 +1,30 @@
+/**
+ * @file
+ * @brief Event counter accessed via file descriptor.
+ *
+ * @date 17.10.26
+ */
+
+#ifndef SYS_EVENTFD_H_
+#define SYS_EVENTFD_H_
+
+#include <stdint.h>
+#include <fcntl.h>
+
+#include <sys/cdefs.h>
+
+#define EFD_SEMAPHORE 0x1
+#define EFD_CLOEXEC   O_CLOEXEC
+#define EFD_NONBLOCK  O_NONBLOCK
+
+typedef uint64_t eventfd_t;
+
+__BEGIN_DECLS
+
+extern int eventfd(unsigned int initval, int flags);
+extern int eventfd_read(int fd, eventfd_t *value);
+extern int eventfd_write(int fd, eventfd_t value);
+
+__END_DECLS
+
+#endif /* SYS_EVENTFD_H_ */
@@ -0,0 +1,15 @@
+/**
+ * @file
+ * @brief Transfer data between file descriptors.
+ *
+ * @date 17.10.26
+ */
+
+#ifndef SYS_SENDFILE_H
+#define SYS_SENDFILE_H
+
+#include <sys/types.h>
+
+extern ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+
+#endif /* SYS_SENDFILE_H */
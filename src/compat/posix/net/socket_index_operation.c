@@ -115,6 +115,11 @@ static int socket_status(struct idesc *desc, int status_nr) {
 	if (status_nr & POLLERR) {
 		res += sk->opt.so_error;
 	}
+	if (status_nr & POLLHUP) {
+		/* Both directions are shut down */
+		res += (sk->shutdown_flag & (SHUT_RD + 1))
+				&& (sk->shutdown_flag & (SHUT_WR + 1));
+	}
 
 	return res;
 }
@@ -18,6 +18,8 @@
 extern size_t mspace_deep_copy_size(struct dlist_head *mspace);
 extern void mspace_deep_store(struct dlist_head *mspace, struct dlist_head *store_space, void *buf);
 extern void mspace_deep_restore(struct dlist_head *mspace, struct dlist_head *store_space, void *buf);
+extern void mspace_deep_hold(void);
+extern void mspace_deep_unhold(void);
 
 static inline struct dlist_head *task_mspace(struct task *tk) {
 	struct task_heap *task_heap;
@@ -40,6 +42,9 @@ void fork_heap_store(struct heap_space *hpspc, struct task *tk) {
 	if (hpspc->heap_sz != size) {
 		if (hpspc->heap) {
 			phymem_free(hpspc->heap, hpspc->heap_sz / PAGE_SIZE());
+		} else {
+			/* Segments are kept until the image is dropped */
+			mspace_deep_hold();
 		}
 
 		hpspc->heap = phymem_alloc(size / PAGE_SIZE());
@@ -66,5 +71,6 @@ void fork_heap_cleanup(struct heap_space *hpspc) {
 
 	phymem_free(hpspc->heap, hpspc->heap_sz / PAGE_SIZE());
 	hpspc->heap = NULL;
+	mspace_deep_unhold();
 }
 
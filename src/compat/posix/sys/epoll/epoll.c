@@ -0,0 +1,547 @@
+/**
+ * @file
+ * @brief I/O event notification for large number of descriptors.
+ *
+ * @details Unlike poll(), descriptors of interest are registered once.
+ *   Each of them has a hook which is called on idesc_notify() and puts the
+ *   descriptor into the ready list. So epoll_wait() checks status only of
+ *   descriptors which have been notified, not all of them.
+ *
+ *   In level-triggered mode the descriptor which has reported events stays
+ *   in the ready list and is checked again by the next epoll_wait(). In
+ *   edge-triggered mode (EPOLLET) it's removed until the next notification.
+ *
+ *   Lock order is idesc_event_lock(), epoll mutex, ready list spinlock.
+ *   Epoll descriptor is notified under its ready list spinlock, so
+ *   epoll_close() takes the spinlock once more before freeing it.
+ *
+ * @date 17.10.26
+ */
+
+#include <sys/epoll.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <fs/idesc.h>
+#include <fs/idesc_event.h>
+#include <hal/clock.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+#include <kernel/task.h>
+#include <kernel/task/resource/idesc_table.h>
+#include <kernel/thread/sync/mutex.h>
+#include <kernel/thread/thread_sched_wait.h>
+#include <kernel/time/time.h>
+#include <mem/sysmalloc.h>
+#include <util/array.h>
+#include <util/dlist.h>
+#include <util/member.h>
+
+struct epoll {
+	struct idesc idesc;
+	struct mutex mutex;      /* Protects interest list and items */
+	struct dlist_head items; /* Interest list */
+	struct dlist_head ready; /* Ready list, protected by lock */
+	spinlock_t lock;
+};
+
+struct epitem {
+	struct idesc_event_hook hook;
+	struct epoll *ep;
+	struct idesc *idesc;
+	int fd;
+	uint32_t events;
+	epoll_data_t data;
+	int disabled;            /* EPOLLONESHOT event has been reported */
+	struct dlist_head lnk;   /* Link in interest list */
+	struct dlist_head rdlnk; /* Link in ready list */
+};
+
+static const struct idesc_ops idesc_epoll_ops;
+
+static const int epoll_poll_masks[] = {
+	POLLIN, POLLOUT, POLLPRI, POLLERR, POLLHUP
+};
+
+/* Reported even if they aren't requested */
+#define EPOLL_ALWAYS (POLLERR | POLLHUP)
+
+static void epitem_notify(struct idesc_event_hook *hook, struct idesc *idesc,
+		int mask);
+
+static struct idesc *epoll_idesc_get(int fd) {
+	struct idesc_table *it;
+
+	if (!idesc_index_valid(fd)) {
+		return NULL;
+	}
+
+	it = task_resource_idesc_table(task_self());
+	assert(it);
+
+	return idesc_table_get(it, fd);
+}
+
+/* Returns errno if @a epfd isn't an epoll descriptor */
+static int epoll_get(int epfd, struct epoll **ep) {
+	struct idesc *idesc;
+
+	idesc = epoll_idesc_get(epfd);
+	if (idesc == NULL) {
+		return EBADF;
+	}
+	if (idesc->idesc_ops != &idesc_epoll_ops) {
+		return EINVAL;
+	}
+
+	*ep = (struct epoll *) idesc;
+	return 0;
+}
+
+/* Puts item into ready list, it may be called from interrupt */
+static void epoll_ready(struct epitem *epi) {
+	struct epoll *ep;
+	ipl_t ipl;
+
+	ep = epi->ep;
+
+	ipl = spin_lock_ipl(&ep->lock);
+	{
+		if (!epi->disabled && dlist_empty(&epi->rdlnk)) {
+			dlist_add_prev(&epi->rdlnk, &ep->ready);
+			idesc_notify(&ep->idesc, POLLIN);
+		}
+	}
+	spin_unlock_ipl(&ep->lock, ipl);
+}
+
+static void epoll_unready(struct epitem *epi) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&epi->ep->lock);
+	{
+		dlist_del_init(&epi->rdlnk);
+	}
+	spin_unlock_ipl(&epi->ep->lock, ipl);
+}
+
+/* Hook is found on the descriptor itself, it's watched by a few epolls */
+static struct epitem *epoll_find(struct epoll *ep, struct idesc *idesc,
+		int fd) {
+	struct idesc_event_hook *hook;
+	struct epitem *epi;
+
+	dlist_foreach_entry(hook, &idesc->idesc_hooks, lnk) {
+		if (hook->notify != epitem_notify) {
+			continue;
+		}
+		epi = member_cast_out(hook, struct epitem, hook);
+		if ((epi->ep == ep) && (epi->fd == fd)) {
+			return epi;
+		}
+	}
+
+	return NULL;
+}
+
+static void epitem_free(struct epitem *epi) {
+	epoll_unready(epi);
+	dlist_del(&epi->lnk);
+	sysfree(epi);
+}
+
+static void epitem_notify(struct idesc_event_hook *hook, struct idesc *idesc,
+		int mask) {
+	struct epitem *epi;
+	struct epoll *ep;
+
+	epi = member_cast_out(hook, struct epitem, hook);
+
+	if (mask & POLLNVAL) {
+		/* Descriptor is closed, hook is already removed from it */
+		ep = epi->ep;
+		mutex_lock(&ep->mutex);
+		epitem_free(epi);
+		mutex_unlock(&ep->mutex);
+		return;
+	}
+
+	if (mask && !(mask & (epi->events | EPOLL_ALWAYS))) {
+		return;
+	}
+
+	epoll_ready(epi);
+}
+
+static uint32_t epitem_revents(struct epitem *epi) {
+	struct idesc *idesc;
+	uint32_t revents;
+	int i;
+
+	idesc = epi->idesc;
+	assert(idesc->idesc_ops);
+	assert(idesc->idesc_ops->status);
+
+	revents = 0;
+	for (i = 0; i < ARRAY_SIZE(epoll_poll_masks); i++) {
+		if (((epi->events | EPOLL_ALWAYS) & epoll_poll_masks[i])
+				&& idesc->idesc_ops->status(idesc, epoll_poll_masks[i])) {
+			revents |= epoll_poll_masks[i];
+		}
+	}
+
+	return revents;
+}
+
+/* Checks descriptors of the ready list, called under epoll mutex */
+static int epoll_collect(struct epoll *ep, struct epoll_event *events,
+		int maxevents) {
+	struct dlist_head check;
+	struct epitem *epi;
+	uint32_t revents;
+	int cnt;
+	ipl_t ipl;
+
+	dlist_init(&check);
+
+	ipl = spin_lock_ipl(&ep->lock);
+	{
+		dlist_foreach_entry(epi, &ep->ready, rdlnk) {
+			dlist_move(&epi->rdlnk, &check);
+		}
+	}
+	spin_unlock_ipl(&ep->lock, ipl);
+
+	cnt = 0;
+	while (cnt < maxevents) {
+		/* Item is taken from the list before the check, so notification
+		 * which comes during the check puts it to the ready list again */
+		ipl = spin_lock_ipl(&ep->lock);
+		{
+			epi = dlist_first_entry_or_null(&check, struct epitem, rdlnk);
+			if (epi != NULL) {
+				dlist_del_init(&epi->rdlnk);
+			}
+		}
+		spin_unlock_ipl(&ep->lock, ipl);
+
+		if (epi == NULL) {
+			break;
+		}
+
+		revents = epitem_revents(epi);
+		if (!revents) {
+			continue;
+		}
+
+		events[cnt].events = revents;
+		events[cnt].data = epi->data;
+		cnt++;
+
+		if (epi->events & EPOLLONESHOT) {
+			epi->disabled = 1;
+		}
+		else if (!(epi->events & EPOLLET)) {
+			epoll_ready(epi);
+		}
+	}
+
+	/* Not checked ones are returned to the ready list */
+	ipl = spin_lock_ipl(&ep->lock);
+	{
+		dlist_foreach_entry(epi, &check, rdlnk) {
+			dlist_move(&epi->rdlnk, &ep->ready);
+		}
+	}
+	spin_unlock_ipl(&ep->lock, ipl);
+
+	return cnt;
+}
+
+static int epoll_sleep(struct epoll *ep, int timeout) {
+	struct idesc_wait_link wl;
+	int ret;
+
+	threadsig_lock();
+	{
+		idesc_wait_init(&wl, POLLIN);
+		/* O_NONBLOCK of epoll descriptor doesn't matter here */
+		idesc_wait_prepare(&ep->idesc, &wl);
+
+		ret = SCHED_WAIT_TIMEOUT(!dlist_empty(&ep->ready),
+				timeout < 0 ? SCHED_TIMEOUT_INFINITE : timeout);
+
+		idesc_wait_cleanup(&ep->idesc, &wl);
+	}
+	threadsig_unlock();
+
+	return ret;
+}
+
+static void epoll_close(struct idesc *idesc) {
+	struct epoll *ep;
+	struct epitem *epi;
+	ipl_t ipl;
+
+	assert(idesc);
+	assert(idesc->idesc_ops == &idesc_epoll_ops);
+
+	ep = (struct epoll *) idesc;
+
+	idesc_event_lock();
+	mutex_lock(&ep->mutex);
+	{
+		dlist_foreach_entry(epi, &ep->items, lnk) {
+			idesc_event_hook_del(epi->idesc, &epi->hook);
+			epitem_free(epi);
+		}
+	}
+	mutex_unlock(&ep->mutex);
+	idesc_event_unlock();
+
+	/* Hooks are removed, but the last of them can be notifying the
+	 * epoll descriptor yet */
+	ipl = spin_lock_ipl(&ep->lock);
+	spin_unlock_ipl(&ep->lock, ipl);
+
+	sysfree(ep);
+}
+
+static int epoll_status(struct idesc *idesc, int mask) {
+	struct epoll *ep;
+
+	assert(idesc);
+	assert(idesc->idesc_ops == &idesc_epoll_ops);
+
+	ep = (struct epoll *) idesc;
+
+	return (mask == POLLIN) && !dlist_empty(&ep->ready);
+}
+
+static const struct idesc_ops idesc_epoll_ops = {
+	.close = epoll_close,
+	.status = epoll_status,
+};
+
+int epoll_create1(int flags) {
+	struct idesc_table *it;
+	struct epoll *ep;
+	int fd;
+
+	if (flags & ~EPOLL_CLOEXEC) {
+		return SET_ERRNO(EINVAL);
+	}
+
+	it = task_resource_idesc_table(task_self());
+	assert(it);
+
+	ep = sysmalloc(sizeof *ep);
+	if (ep == NULL) {
+		return SET_ERRNO(ENOMEM);
+	}
+
+	idesc_init(&ep->idesc, &idesc_epoll_ops, S_IROTH);
+	mutex_init(&ep->mutex);
+	dlist_init(&ep->items);
+	dlist_init(&ep->ready);
+	ep->lock = SPIN_UNLOCKED;
+
+	fd = idesc_table_add(it, &ep->idesc, flags & EPOLL_CLOEXEC);
+	if (fd < 0) {
+		sysfree(ep);
+		return SET_ERRNO(-fd);
+	}
+
+	return fd;
+}
+
+int epoll_create(int size) {
+	if (size <= 0) {
+		return SET_ERRNO(EINVAL);
+	}
+
+	return epoll_create1(0);
+}
+
+/* Maximum depth of epoll descriptors nested into each other, as in Linux */
+#define EPOLL_MAX_NESTS 4
+
+/* Checks epoll descriptors reachable from @idesc don't lead back to @ep.
+ * Interest lists of all epoll instances are changed under idesc event lock,
+ * so it must be held by the caller. */
+static int epoll_loop_check(struct epoll *ep, struct idesc *idesc, int depth) {
+	struct epitem *epi;
+	int ret;
+
+	if (idesc->idesc_ops != &idesc_epoll_ops) {
+		return 0;
+	}
+	if ((idesc == &ep->idesc) || (depth >= EPOLL_MAX_NESTS)) {
+		return -ELOOP;
+	}
+
+	dlist_foreach_entry(epi, &((struct epoll *) idesc)->items, lnk) {
+		ret = epoll_loop_check(ep, epi->idesc, depth + 1);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int epoll_do_ctl(struct epoll *ep, int op, int fd, struct idesc *idesc,
+		struct epoll_event *event) {
+	struct epitem *epi;
+	int ret;
+
+	epi = epoll_find(ep, idesc, fd);
+
+	switch (op) {
+	case EPOLL_CTL_ADD:
+		if (epi != NULL) {
+			return -EEXIST;
+		}
+
+		ret = epoll_loop_check(ep, idesc, 0);
+		if (ret != 0) {
+			return ret;
+		}
+
+		epi = sysmalloc(sizeof *epi);
+		if (epi == NULL) {
+			return -ENOMEM;
+		}
+
+		epi->hook.notify = epitem_notify;
+		epi->ep = ep;
+		epi->idesc = idesc;
+		epi->fd = fd;
+		epi->events = event->events;
+		epi->data = event->data;
+		epi->disabled = 0;
+		dlist_head_init(&epi->rdlnk);
+		dlist_head_init(&epi->lnk);
+		dlist_add_prev(&epi->lnk, &ep->items);
+
+		idesc_event_hook_add(idesc, &epi->hook);
+		break;
+	case EPOLL_CTL_MOD:
+		if (epi == NULL) {
+			return -ENOENT;
+		}
+
+		epoll_unready(epi);
+		epi->events = event->events;
+		epi->data = event->data;
+		epi->disabled = 0;
+		break;
+	case EPOLL_CTL_DEL:
+		if (epi == NULL) {
+			return -ENOENT;
+		}
+
+		idesc_event_hook_del(idesc, &epi->hook);
+		epitem_free(epi);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+
+	/* Descriptor can be ready already, it's checked by epoll_wait() */
+	epoll_ready(epi);
+
+	return 0;
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+	struct epoll *ep;
+	struct idesc *idesc;
+	int ret;
+
+	ret = epoll_get(epfd, &ep);
+	if (ret != 0) {
+		return SET_ERRNO(ret);
+	}
+
+	idesc = epoll_idesc_get(fd);
+	if (idesc == NULL) {
+		return SET_ERRNO(EBADF);
+	}
+
+	if (idesc == &ep->idesc) {
+		return SET_ERRNO(EINVAL);
+	}
+	if (idesc->idesc_ops->status == NULL) {
+		return SET_ERRNO(EPERM);
+	}
+
+	if ((op != EPOLL_CTL_DEL) && (event == NULL)) {
+		return SET_ERRNO(EFAULT);
+	}
+
+	idesc_event_lock();
+	mutex_lock(&ep->mutex);
+	{
+		ret = epoll_do_ctl(ep, op, fd, idesc, event);
+	}
+	mutex_unlock(&ep->mutex);
+	idesc_event_unlock();
+
+	if (ret != 0) {
+		return SET_ERRNO(-ret);
+	}
+
+	return 0;
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+		int timeout) {
+	struct epoll *ep;
+	clock_t deadline, now;
+	int cnt, ret;
+
+	ret = epoll_get(epfd, &ep);
+	if (ret != 0) {
+		return SET_ERRNO(ret);
+	}
+
+	if ((events == NULL) || (maxevents <= 0)) {
+		return SET_ERRNO(EINVAL);
+	}
+
+	deadline = clock_sys_ticks() + ms2jiffies(timeout);
+
+	while (1) {
+		mutex_lock(&ep->mutex);
+		{
+			cnt = epoll_collect(ep, events, maxevents);
+		}
+		mutex_unlock(&ep->mutex);
+
+		if ((cnt != 0) || (timeout == 0)) {
+			return cnt;
+		}
+
+		ret = epoll_sleep(ep, timeout);
+		if (ret == -ETIMEDOUT) {
+			return 0;
+		}
+		if (ret != 0) {
+			return SET_ERRNO(-ret);
+		}
+
+		/* Notified descriptor could become not ready before the check */
+		if (timeout > 0) {
+			now = clock_sys_ticks();
+			if ((long) (deadline - now) <= 0) {
+				return 0;
+			}
+			timeout = jiffies2ms(deadline - now);
+		}
+	}
+}
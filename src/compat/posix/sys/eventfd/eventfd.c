@@ -0,0 +1,202 @@
+/**
+ * @file
+ * @brief Event counter accessed via file descriptor.
+ *
+ * @details Reading returns the counter and resets it (or decrements by one
+ *   with EFD_SEMAPHORE), writing adds to it. Read blocks while counter is
+ *   zero and write blocks while counter would overflow.
+ *
+ * @date 17.10.26
+ */
+
+#include <sys/eventfd.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <fs/idesc.h>
+#include <fs/idesc_event.h>
+#include <kernel/task.h>
+#include <kernel/task/resource/idesc_table.h>
+#include <kernel/thread/sync/mutex.h>
+#include <kernel/thread/thread_sched_wait.h>
+#include <mem/sysmalloc.h>
+
+#define EVENTFD_MAX (UINT64_MAX - 1)
+
+struct eventfd {
+	struct idesc idesc;
+	uint64_t count;
+	int semaphore;
+	struct mutex mutex;
+};
+
+static const struct idesc_ops idesc_eventfd_ops;
+
+static int eventfd_wait(struct eventfd *efd, int flags) {
+	struct idesc_wait_link wl;
+
+	return IDESC_WAIT_LOCKED(
+		mutex_unlock(&efd->mutex),
+		&efd->idesc, &wl, flags, SCHED_TIMEOUT_INFINITE,
+		mutex_lock(&efd->mutex));
+}
+
+static ssize_t eventfd_readv(struct idesc *idesc, const struct iovec *iov,
+		int cnt) {
+	struct eventfd *efd;
+	uint64_t value;
+	int res;
+
+	assert(idesc);
+	assert(idesc->idesc_ops == &idesc_eventfd_ops);
+	assert(iov);
+
+	if ((cnt != 1) || (iov->iov_len < sizeof value)) {
+		return -EINVAL;
+	}
+
+	efd = (struct eventfd *) idesc;
+
+	mutex_lock(&efd->mutex);
+	while (efd->count == 0) {
+		res = eventfd_wait(efd, POLLIN);
+		if (res != 0) {
+			mutex_unlock(&efd->mutex);
+			return res;
+		}
+	}
+	value = efd->semaphore ? 1 : efd->count;
+	efd->count -= value;
+	mutex_unlock(&efd->mutex);
+
+	idesc_notify(idesc, POLLOUT);
+
+	memcpy(iov->iov_base, &value, sizeof value);
+	return sizeof value;
+}
+
+static ssize_t eventfd_writev(struct idesc *idesc, const struct iovec *iov,
+		int cnt) {
+	struct eventfd *efd;
+	uint64_t value;
+	int res;
+
+	assert(idesc);
+	assert(idesc->idesc_ops == &idesc_eventfd_ops);
+	assert(iov);
+
+	if ((cnt != 1) || (iov->iov_len < sizeof value)) {
+		return -EINVAL;
+	}
+
+	memcpy(&value, iov->iov_base, sizeof value);
+	if (value > EVENTFD_MAX) {
+		return -EINVAL;
+	}
+
+	efd = (struct eventfd *) idesc;
+
+	mutex_lock(&efd->mutex);
+	while (EVENTFD_MAX - efd->count < value) {
+		res = eventfd_wait(efd, POLLOUT);
+		if (res != 0) {
+			mutex_unlock(&efd->mutex);
+			return res;
+		}
+	}
+	efd->count += value;
+	mutex_unlock(&efd->mutex);
+
+	if (value != 0) {
+		idesc_notify(idesc, POLLIN);
+	}
+
+	return sizeof value;
+}
+
+static int eventfd_status(struct idesc *idesc, int mask) {
+	struct eventfd *efd;
+	int res;
+
+	assert(idesc);
+	assert(idesc->idesc_ops == &idesc_eventfd_ops);
+
+	efd = (struct eventfd *) idesc;
+
+	res = 0;
+	mutex_lock(&efd->mutex);
+	switch (mask) {
+	case POLLIN:
+		res = efd->count != 0;
+		break;
+	case POLLOUT:
+		res = efd->count != EVENTFD_MAX;
+		break;
+	default:
+		break;
+	}
+	mutex_unlock(&efd->mutex);
+
+	return res;
+}
+
+static void eventfd_close(struct idesc *idesc) {
+	assert(idesc);
+	assert(idesc->idesc_ops == &idesc_eventfd_ops);
+
+	sysfree(idesc);
+}
+
+static const struct idesc_ops idesc_eventfd_ops = {
+	.id_readv = eventfd_readv,
+	.id_writev = eventfd_writev,
+	.close = eventfd_close,
+	.status = eventfd_status,
+};
+
+int eventfd(unsigned int initval, int flags) {
+	struct idesc_table *it;
+	struct eventfd *efd;
+	int fd;
+
+	if (flags & ~(EFD_SEMAPHORE | EFD_CLOEXEC | EFD_NONBLOCK)) {
+		return SET_ERRNO(EINVAL);
+	}
+
+	it = task_resource_idesc_table(task_self());
+	assert(it);
+
+	efd = sysmalloc(sizeof *efd);
+	if (efd == NULL) {
+		return SET_ERRNO(ENOMEM);
+	}
+
+	idesc_init(&efd->idesc, &idesc_eventfd_ops, S_IROTH | S_IWOTH);
+	efd->idesc.idesc_flags = flags & EFD_NONBLOCK;
+	efd->count = initval;
+	efd->semaphore = flags & EFD_SEMAPHORE;
+	mutex_init(&efd->mutex);
+
+	fd = idesc_table_add(it, &efd->idesc, flags & EFD_CLOEXEC);
+	if (fd < 0) {
+		sysfree(efd);
+		return SET_ERRNO(-fd);
+	}
+
+	return fd;
+}
+
+int eventfd_read(int fd, eventfd_t *value) {
+	return read(fd, value, sizeof *value) == sizeof *value ? 0 : -1;
+}
+
+int eventfd_write(int fd, eventfd_t value) {
+	return write(fd, &value, sizeof value) == sizeof value ? 0 : -1;
+}
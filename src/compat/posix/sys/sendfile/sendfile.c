@@ -0,0 +1,159 @@
+/**
+ * @file
+ * @brief Transfer data between file descriptors.
+ *
+ * @details If @c out_fd is a stream socket which protocol is able to read
+ *   data on its own, file data is read directly into network packets.
+ *   Otherwise data is copied through an intermediate buffer.
+ *
+ * @date 17.10.26
+ */
+
+#include <sys/sendfile.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <fs/file_desc.h>
+#include <fs/idesc.h>
+#include <fs/index_descriptor.h>
+#include <fs/kfile.h>
+#include <kernel/task/resource/idesc_table.h>
+#include <net/sock.h>
+#include <net/socket/ksocket.h>
+#include <net/socket/socket_desc.h>
+#include <util/math.h>
+
+#include <framework/mod/options.h>
+
+#define SENDFILE_BUF_SIZE OPTION_GET(NUMBER, buf_size)
+
+static ssize_t sendfile_copy(struct idesc *out, struct file_desc *in,
+		size_t count) {
+	char buf[SENDFILE_BUF_SIZE];
+	struct iovec iov;
+	size_t sent;
+	ssize_t ret;
+
+	assert(out->idesc_ops->id_writev);
+
+	sent = 0;
+	while (sent < count) {
+		iov.iov_base = buf;
+		iov.iov_len = min(count - sent, sizeof(buf));
+		ret = in->idesc.idesc_ops->id_readv(&in->idesc, &iov, 1);
+		if (ret <= 0) {
+			return sent ? sent : ret;
+		}
+
+		iov.iov_len = ret;
+		ret = out->idesc_ops->id_writev(out, &iov, 1);
+		if (ret <= 0) {
+			return sent ? sent : ret;
+		}
+		sent += ret;
+
+		if ((size_t) ret < iov.iov_len) {
+			/* Tail was read but not written, give it back */
+			kseek(in, (long) ret - (long) iov.iov_len, SEEK_CUR);
+			break;
+		}
+	}
+
+	return sent;
+}
+
+static ssize_t sendfile_sock(struct sock *sk, struct idesc *in,
+		size_t count) {
+	size_t sent;
+	int ret;
+
+	sent = 0;
+	while (sent < count) {
+		ret = ksendfile(sk, in, count - sent);
+		if (ret <= 0) {
+			return sent ? sent : ret;
+		}
+		sent += ret;
+	}
+
+	return sent;
+}
+
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+	struct idesc *in, *out;
+	struct file_desc *in_file;
+	struct sock *sk;
+	struct stat st;
+	off_t pos, start;
+	ssize_t ret;
+
+	if (!idesc_index_valid(in_fd)
+			|| (NULL == (in = index_descriptor_get(in_fd)))
+			|| (!(in->idesc_amode & S_IROTH))) {
+		return SET_ERRNO(EBADF);
+	}
+	if (!idesc_index_valid(out_fd)
+			|| (NULL == (out = index_descriptor_get(out_fd)))
+			|| (!(out->idesc_amode & S_IWOTH))) {
+		return SET_ERRNO(EBADF);
+	}
+
+	/* Only regular files are seekable sources */
+	in_file = file_desc_get(in_fd);
+	if (in_file == NULL) {
+		return SET_ERRNO(EINVAL);
+	}
+
+	pos = kseek(in_file, 0, SEEK_CUR);
+	if (pos < 0) {
+		return SET_ERRNO(-pos);
+	}
+
+	start = pos;
+	if (offset != NULL) {
+		start = kseek(in_file, *offset, SEEK_SET);
+		if (start < 0) {
+			return SET_ERRNO(-start);
+		}
+	}
+
+	ret = index_descriptor_fstat(in_fd, &st);
+	if (ret != 0) {
+		goto out;
+	}
+	if (start >= st.st_size) {
+		ret = 0;
+		goto out;
+	}
+	/* Protocols reading the file directly expect no short reads */
+	count = min(count, (size_t)(st.st_size - start));
+
+	sk = idesc_sock_get(out_fd);
+	if ((sk != NULL) && (sk->p_ops != NULL) && (sk->p_ops->sendfile != NULL)) {
+		if (sk->shutdown_flag & (SHUT_WR + 1)) {
+			ret = -EPIPE;
+			goto out;
+		}
+		ret = sendfile_sock(sk, in, count);
+	} else {
+		ret = sendfile_copy(out, in_file, count);
+	}
+
+out:
+	if (offset != NULL) {
+		if (ret > 0) {
+			*offset = start + ret;
+		}
+		kseek(in_file, pos, SEEK_SET);
+	}
+
+	if (ret < 0) {
+		return SET_ERRNO(-ret);
+	}
+	return ret;
+}
@@ -54,11 +54,16 @@ static size_t bdev_write(struct file_desc *desc, void *buf, size_t size) {
 	return n_write;
 }
 
+static int bdev_fsync(struct file_desc *desc) {
+	return block_dev_sync((struct block_dev *) desc->node->nas->fi->privdata);
+}
+
 static struct kfile_operations blockdev_fop = {
 	.open = bdev_open,
 	.close = bdev_close,
 	.read = bdev_read,
 	.write = bdev_write,
+	.fsync = bdev_fsync,
 };
 
 static struct filesystem *blockdev_fs;
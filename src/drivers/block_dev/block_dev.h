@@ -24,6 +24,8 @@
 #define DEV_TYPE_PACKET         3
 
 struct file_operations;
+struct block_queue;
+struct block_req;
 typedef struct block_dev {
 	struct file_operations *dev_ops;
 	dev_t id;
@@ -36,6 +38,11 @@ typedef struct block_dev {
 	size_t size;
 	size_t block_size;
 	struct block_dev_cache *cache;
+	struct block_queue *queue;
+
+	/* Sequential read detection */
+	blkno_t ra_next;
+	size_t ra_window;
 
 	struct dev_module *dev_module;
 
@@ -52,6 +59,9 @@ typedef struct block_dev_driver {
 	int (*write)(struct block_dev *bdev, char *buffer, size_t count, blkno_t blkno);
 
 	int (*probe)(void *args);
+
+	/* Starts request (optional), it's completed with block_req_complete() */
+	int (*submit)(struct block_dev *bdev, struct block_req *req);
 } block_dev_driver_t;
 
 typedef struct block_dev_module {
@@ -84,6 +94,8 @@ extern int block_dev_read(void *bdev, char *buffer, size_t count, blkno_t blkno)
 extern int block_dev_read_buffered(struct block_dev *bdev, char *buffer, size_t count, size_t offset);
 extern int block_dev_write_buffered(struct block_dev *bdev, const char *buffer, size_t count, size_t offset);
 extern int block_dev_write(void *bdev, const char *buffer, size_t count, blkno_t blkno);
+/* Writes back cached blocks and flushes cache of device */
+extern int block_dev_sync(struct block_dev *bdev);
 extern int block_dev_ioctl(void *bdev, int cmd, void *args, size_t size);
 extern int block_dev_close(void *bdev);
 extern int block_dev_destroy(void *bdev);
@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include <drivers/block_dev.h>
+#include <drivers/block_request.h>
 #include <framework/mod/options.h>
 #include <fs/bcache.h>
 #include <mem/misc/pool.h>
@@ -21,6 +22,9 @@
 
 #define DEFAULT_BDEV_BLOCK_SIZE OPTION_GET(NUMBER, default_block_size)
 #define MAX_DEV_QUANTITY OPTION_GET(NUMBER, dev_quantity)
+#define BATCH_BLOCKS OPTION_GET(NUMBER, batch_blocks)
+#define READAHEAD_MAX OPTION_GET(NUMBER, readahead_max)
+#define WRITE_BACK OPTION_GET(BOOLEAN, write_back)
 
 ARRAY_SPREAD_DEF(const struct block_dev_module, __block_dev_registry);
 POOL_DEF(cache_pool, struct block_dev_cache, MAX_DEV_QUANTITY);
@@ -78,6 +82,12 @@ struct block_dev *block_dev_create_common(const char *path, void *driver, void *
 		.block_size = DEFAULT_BDEV_BLOCK_SIZE,
 	};
 
+	bdev->queue = block_queue_create(bdev);
+	if (NULL == bdev->queue) {
+		block_dev_free(bdev);
+		return NULL;
+	}
+
 	strncpy (bdev->name, strrchr(path, '/') ? strrchr(path, '/') + 1 : path, NAME_MAX);
 
 	return bdev;
@@ -86,6 +96,11 @@ struct block_dev *block_dev_create_common(const char *path, void *driver, void *
 void block_dev_free(struct block_dev *dev) {
 	assert(dev);
 
+	if (dev->queue) {
+		bcache_invalidate_blkdev(dev);
+		block_queue_destroy(dev->queue);
+	}
+
 	devtab[dev->id] = NULL;
 	index_free(&block_dev_idx, dev->id);
 	pool_free(&blockdev_pool, dev);
@@ -136,15 +151,100 @@ struct block_dev *block_dev(void *dev) {
 	return (struct block_dev *)dev;
 }
 
+/* Whether the block @a i of batch is not covered by data completely */
+static inline int block_dev_partial(int i, size_t offset, size_t count,
+		int blksize) {
+	return (offset > i * blksize) || (offset + count < (i + 1) * blksize);
+}
+
+static int block_dev_batch_len(size_t offset, size_t count, int blksize) {
+	return min((offset + count + blksize - 1) / blksize, BATCH_BLOCKS);
+}
+
+static void block_dev_bh_submit(struct block_dev *bdev,
+		struct block_bio_batch *batch, struct block_bio *bio,
+		struct buffer_head *bh, int op) {
+	bio->op = op;
+	bio->blkno = bh->block;
+	bio->nblocks = 1;
+	bio->buf = bh->data;
+	block_bio_batch_submit(bdev, batch, bio);
+}
+
+/**
+ * Reads blocks of locked buffers which aren't in the cache yet, all of them
+ * or only ones which are covered by data partially.
+ */
+static int block_dev_bh_fill(struct block_dev *bdev, struct buffer_head **bh,
+		int n, size_t offset, size_t count, int partial_only) {
+	struct block_bio bio[BATCH_BLOCKS + READAHEAD_MAX];
+	struct block_bio_batch batch;
+	int res, i, blksize;
+
+	blksize = bdev->block_size;
+
+	/* Buffers are locked before plugging, as owner of a buffer can wait
+	 * for its own requests in the queue */
+	block_bio_batch_init(&batch);
+	block_queue_plug(bdev);
+	for (i = 0; i < n; i++) {
+		if (buffer_new(bh[i]) && (!partial_only
+					|| block_dev_partial(i, offset, count, blksize))) {
+			block_dev_bh_submit(bdev, &batch, &bio[i], bh[i], BLOCK_REQ_READ);
+		}
+	}
+	block_queue_unplug(bdev);
+
+	res = block_bio_batch_wait(&batch);
+	if (res != 0) {
+		return res;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (buffer_new(bh[i]) && (!partial_only
+					|| block_dev_partial(i, offset, count, blksize))) {
+			if (0 != (res = buffer_decrypt(bh[i]))) {
+				return res;
+			}
+			buffer_clear_flag(bh[i], BH_NEW);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Appends to @a bh new buffers of blocks following sequential reading,
+ * window of read-ahead is doubled while reading stays sequential.
+ * @return Number of the buffers
+ */
+static int block_dev_readahead(struct block_dev *bdev, struct buffer_head **bh,
+		blkno_t blkno, int blksize) {
+	blkno_t last;
+	int i, n;
+
+	last = bdev->size / blksize;
+	n = 0;
+	for (i = 0; (i < (int) bdev->ra_window) && (blkno + i < last); i++) {
+		/* Blocks which are already cached are skipped */
+		bh[n] = bcache_getblk_new(bdev, blkno + i, blksize);
+		if (bh[n] != NULL) {
+			n++;
+		}
+	}
+
+	return n;
+}
+
 int block_dev_read_buffered(struct block_dev *bdev, char *buffer, size_t count, size_t offset) {
+	struct buffer_head *bh[BATCH_BLOCKS + READAHEAD_MAX];
 	int blksize, blkno, cplen, cursor;
-	int res, i;
-	struct buffer_head *bh;
+	int res, i, n, ra;
 
 	assert(bdev);
 	assert(bdev->driver);
 
-	if (NULL == bdev->driver->read) {
+	if (NULL == bdev->driver->read && NULL == bdev->driver->submit) {
 		return -ENOSYS;
 	}
 	if (offset + count > bdev->size) {
@@ -155,36 +255,61 @@ int block_dev_read_buffered(struct block_dev *bdev, char *buffer, size_t count,
 		return blksize;
 	}
 	blkno = offset / blksize;
-	cplen = min(count, blksize - offset % blksize);
-
-	for (cursor = 0, i = 0; count != 0;
-			i++, count -= cplen, cursor += cplen, cplen = min(count, blksize)) {
-		bh = bcache_getblk_locked(bdev, blkno + i, blksize);
-		{
-			if (buffer_new(bh)) {
-				if (blksize != (res = bdev->driver->read(bdev, bh->data, blksize, blkno + i))
-						|| 0 != (res = buffer_decrypt(bh))) {
-					bcache_buffer_unlock(bh);
-					return res;
-				}
-				buffer_clear_flag(bh, BH_NEW);
+	offset %= blksize;
+
+	if (blkno == bdev->ra_next) {
+		bdev->ra_window = bdev->ra_window ? min(2 * bdev->ra_window,
+				(size_t) READAHEAD_MAX) : min(2, READAHEAD_MAX);
+	} else {
+		bdev->ra_window = 0;
+	}
+	bdev->ra_next = blkno + (offset + count + blksize - 1) / blksize;
+
+	for (cursor = 0; count != 0; blkno += n, offset = 0) {
+		n = block_dev_batch_len(offset, count, blksize);
+		for (i = 0; i < n; i++) {
+			bh[i] = bcache_getblk_locked(bdev, blkno + i, blksize);
+		}
+
+		/* Blocks following the last batch are read with it */
+		ra = 0;
+		if (offset + count <= n * blksize) {
+			ra = block_dev_readahead(bdev, bh + n, blkno + n, blksize);
+		}
+
+		res = block_dev_bh_fill(bdev, bh, n + ra, offset, count, 0);
+
+		for (i = 0; i < n; i++) {
+			if (res == 0) {
+				cplen = min(count, blksize - (i == 0 ? offset : 0));
+				memcpy(buffer + cursor, bh[i]->data + (i == 0 ? offset : 0), cplen);
+				cursor += cplen;
+				count -= cplen;
 			}
-			memcpy(buffer + cursor, bh->data + (i == 0 ? offset % blksize : 0), cplen);
+			bcache_buffer_unlock(bh[i]);
+		}
+		for (i = n; i < n + ra; i++) {
+			bcache_buffer_unlock(bh[i]);
+		}
+
+		if (res != 0) {
+			return res;
 		}
-		bcache_buffer_unlock(bh);
 	}
 
 	return cursor;
 }
 
 int block_dev_write_buffered(struct block_dev *bdev, const char *buffer, size_t count, size_t offset) {
+	struct buffer_head *bh[BATCH_BLOCKS];
+	struct block_bio bio[BATCH_BLOCKS];
+	struct block_bio_batch batch;
 	int blksize, blkno, cplen, cursor;
-	int res, i;
-	struct buffer_head *bh;
+	int res, i, n;
 
 	assert(bdev);
 
-	if (NULL == bdev->driver->write) {
+	if (NULL == bdev->driver->write && NULL == bdev->driver->submit) {
 		return -ENOSYS;
 	}
 	if (offset + count > bdev->size) {
@@ -197,42 +322,82 @@ int block_dev_write_buffered(struct block_dev *bdev, const char *buffer, size_t
 	}
 
 	blkno = offset / blksize;
-	cplen = min(count, blksize - offset % blksize);
-
-	for (cursor = 0, i = 0; count != 0;
-			i++, count -= cplen, cursor += cplen, cplen = min(count, blksize)) {
-		bh = bcache_getblk_locked(bdev, blkno + i, blksize);
-		{
-			if (buffer_new(bh)) {
-				if (cplen < blksize) {
-					if (blksize != (res = bdev->driver->read(bdev, bh->data, blksize, blkno + i))
-							|| 0 != (res = buffer_decrypt(bh))) {
-						bcache_buffer_unlock(bh);
-						return res;
-					}
-				}
-				buffer_clear_flag(bh, BH_NEW);
-			}
-			memcpy(bh->data + (i == 0 ? offset % blksize : 0), buffer + cursor, cplen);
-			/**
-			 * Blocks are stored in the buffer cache in a decrypted state.
-			 * Therefore first we encrypt block, then write it onto disk and then decrypt block.
-			 */
-			buffer_encrypt(bh);
-			if (blksize != (res = bdev->driver->write(bdev, bh->data,
-					blksize, blkno + i))) {
-				buffer_decrypt(bh);
-				bcache_buffer_unlock(bh);
-				return res;
+	offset %= blksize;
+
+	for (cursor = 0; count != 0; blkno += n, offset = 0) {
+		n = block_dev_batch_len(offset, count, blksize);
+		for (i = 0; i < n; i++) {
+			bh[i] = bcache_getblk_locked(bdev, blkno + i, blksize);
+		}
+
+		/* Partially written blocks are read before */
+		res = block_dev_bh_fill(bdev, bh, n, offset, count, 1);
+		if (res != 0) {
+			goto out_unlock;
+		}
+
+		for (i = 0; i < n; i++) {
+			cplen = min(count, blksize - (i == 0 ? offset : 0));
+			memcpy(bh[i]->data + (i == 0 ? offset : 0), buffer + cursor, cplen);
+			cursor += cplen;
+			count -= cplen;
+			buffer_clear_flag(bh[i], BH_NEW);
+		}
+
+		if (WRITE_BACK) {
+			for (i = 0; i < n; i++) {
+				bcache_mark_dirty(bh[i]);
 			}
-			buffer_decrypt(bh);
+			goto out_unlock;
+		}
+
+		/**
+		 * Blocks are stored in the buffer cache in a decrypted state.
+		 * Therefore first we encrypt blocks, then write them onto disk and
+		 * then decrypt blocks.
+		 */
+		block_bio_batch_init(&batch);
+		block_queue_plug(bdev);
+		for (i = 0; i < n; i++) {
+			buffer_encrypt(bh[i]);
+			block_dev_bh_submit(bdev, &batch, &bio[i], bh[i], BLOCK_REQ_WRITE);
+		}
+		block_queue_unplug(bdev);
+
+		res = block_bio_batch_wait(&batch);
+		for (i = 0; i < n; i++) {
+			buffer_decrypt(bh[i]);
+		}
+
+out_unlock:
+		for (i = 0; i < n; i++) {
+			bcache_buffer_unlock(bh[i]);
+		}
+		if (res != 0) {
+			return res;
 		}
-		bcache_buffer_unlock(bh);
+	}
+
+	if (WRITE_BACK) {
+		bcache_balance_dirty();
 	}
 
 	return cursor;
 }
 
+int block_dev_sync(struct block_dev *bdev) {
+	int res;
+
+	assert(bdev);
+
+	res = bcache_flush_blkdev(bdev);
+	if (res != 0) {
+		return res;
+	}
+
+	return block_dev_flush(bdev);
+}
+
 int block_dev_read(void *dev, char *buffer, size_t count, blkno_t blkno) {
 	struct block_dev *bdev;
 	int blksize;
@@ -0,0 +1,534 @@
+/**
+ * @file
+ * @brief Asynchronous block request queue.
+ *
+ * @details Queue is run in the context of submitter. If driver completes
+ *   requests asynchronously, the rest of the queue is dispatched by the
+ *   light thread of the queue, so driver's @c submit must not sleep.
+ *
+ * @date 17.10.26
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include <drivers/block_dev.h>
+#include <drivers/block_request.h>
+#include <framework/mod/options.h>
+#include <hal/clock.h>
+#include <hal/ipl.h>
+#include <kernel/lthread/lthread.h>
+#include <kernel/sched/waitq.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread/waitq.h>
+#include <mem/misc/pool.h>
+#include <util/array.h>
+#include <util/dlist.h>
+#include <util/math.h>
+#include <util/member.h>
+
+#define MAX_DEV_QUANTITY OPTION_GET(NUMBER, dev_quantity)
+#define REQ_QUANTITY     OPTION_GET(NUMBER, req_quantity)
+#define MAX_REQ_BLOCKS   OPTION_GET(NUMBER, max_req_blocks)
+#define DEFAULT_SCHED    OPTION_STRING_GET(scheduler)
+
+/* Bios which block_dev_rw_blocks() submits at once */
+#define RW_BLOCKS_BIOS   4
+
+ARRAY_SPREAD_DEF(const struct block_sched_ops, __block_sched_registry);
+
+POOL_DEF(block_queue_pool, struct block_queue, MAX_DEV_QUANTITY);
+POOL_DEF(block_req_pool, struct block_req, REQ_QUANTITY);
+
+/* Requests are freed on completion, perhaps from interrupt */
+static spinlock_t block_req_pool_lock = SPIN_STATIC_UNLOCKED;
+static struct waitq block_req_pool_wq = WAITQ_INIT(block_req_pool_wq);
+
+static struct block_req *block_req_alloc(void) {
+	struct block_req *req;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&block_req_pool_lock);
+	{
+		req = pool_alloc(&block_req_pool);
+	}
+	spin_unlock_ipl(&block_req_pool_lock, ipl);
+
+	return req;
+}
+
+static void block_req_free(struct block_req *req) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&block_req_pool_lock);
+	{
+		pool_free(&block_req_pool, req);
+	}
+	spin_unlock_ipl(&block_req_pool_lock, ipl);
+
+	waitq_wakeup_all(&block_req_pool_wq);
+}
+
+static int block_queue_lthread_run(struct lthread *self) {
+	block_queue_run(member_cast_out(self, struct block_queue, lt));
+
+	return 0;
+}
+
+struct block_queue *block_queue_create(struct block_dev *bdev) {
+	struct block_queue *q;
+
+	q = pool_alloc(&block_queue_pool);
+	if (q == NULL) {
+		return NULL;
+	}
+
+	memset(q, 0, sizeof *q);
+	q->bdev = bdev;
+	q->lock = SPIN_UNLOCKED;
+	dlist_init(&q->sorted);
+	dlist_init(&q->fifo[BLOCK_REQ_READ]);
+	dlist_init(&q->fifo[BLOCK_REQ_WRITE]);
+	q->depth = 1;
+	q->max_blocks = MAX_REQ_BLOCKS;
+	lthread_init(&q->lt, block_queue_lthread_run);
+
+	if (0 != block_queue_set_sched(q, DEFAULT_SCHED)) {
+		q->sched = NULL;
+		block_sched_foreach(q->sched) {
+			break;
+		}
+		assert(q->sched);
+	}
+
+	return q;
+}
+
+void block_queue_destroy(struct block_queue *q) {
+	assert(q);
+	assert(q->queued == 0 && q->inflight == 0);
+
+	lthread_join(&q->lt);
+	pool_free(&block_queue_pool, q);
+}
+
+void block_queue_set_limits(struct block_queue *q, int depth,
+		size_t max_blocks) {
+	assert(q);
+	assert(depth > 0);
+
+	q->depth = depth;
+	if (max_blocks != 0) {
+		q->max_blocks = max_blocks;
+	}
+}
+
+int block_queue_set_sched(struct block_queue *q, const char *name) {
+	const struct block_sched_ops *ops;
+	ipl_t ipl;
+
+	block_sched_foreach(ops) {
+		if (0 == strcmp(ops->name, name)) {
+			ipl = spin_lock_ipl(&q->lock);
+			{
+				q->sched = ops;
+			}
+			spin_unlock_ipl(&q->lock, ipl);
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+/* Tries to add bio to an adjacent queued request, called under queue lock */
+static int block_queue_merge(struct block_queue *q, struct block_bio *bio) {
+	struct block_req *req;
+
+	dlist_foreach_entry(req, &q->sorted, sort_lnk) {
+		if (req->blkno > bio->blkno + bio->nblocks) {
+			break;
+		}
+		if ((req->op != bio->op) || (req->op == BLOCK_REQ_FLUSH)
+				|| (req->nblocks + bio->nblocks > q->max_blocks)) {
+			continue;
+		}
+
+		if (req->blkno + req->nblocks == bio->blkno) {
+			dlist_add_prev(&bio->lnk, &req->bios);
+		} else if (bio->blkno + bio->nblocks == req->blkno) {
+			dlist_add_next(&bio->lnk, &req->bios);
+			req->blkno = bio->blkno;
+		} else {
+			continue;
+		}
+
+		req->nblocks += bio->nblocks;
+		q->nr_merges++;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Called under queue lock */
+static void block_queue_insert(struct block_queue *q, struct block_req *req) {
+	struct block_req *next;
+
+	dlist_foreach_entry(next, &q->sorted, sort_lnk) {
+		if (next->blkno > req->blkno) {
+			dlist_add_prev(&req->sort_lnk, &next->sort_lnk);
+			goto out;
+		}
+	}
+	dlist_add_prev(&req->sort_lnk, &q->sorted);
+out:
+	dlist_add_prev(&req->fifo_lnk, &q->fifo[block_req_dir(req->op)]);
+	q->queued++;
+}
+
+/* Called under queue lock */
+static void block_queue_remove(struct block_queue *q, struct block_req *req) {
+	dlist_del_init(&req->sort_lnk);
+	dlist_del_init(&req->fifo_lnk);
+	q->queued--;
+	q->last_pos = req->blkno + req->nblocks;
+}
+
+static int block_dev_do_rw(struct block_dev *bdev, int op, char *buf,
+		size_t nblocks, blkno_t blkno) {
+	size_t len;
+	int res;
+
+	len = nblocks * bdev->block_size;
+	if (op == BLOCK_REQ_READ) {
+		res = bdev->driver->read(bdev, buf, len, blkno);
+	} else {
+		res = bdev->driver->write(bdev, buf, len, blkno);
+	}
+
+	if (res == len) {
+		return 0;
+	}
+	return res < 0 ? res : -EIO;
+}
+
+/* Calls read()/write() of driver once for each run of adjacent buffers */
+static int block_req_do_rw(struct block_dev *bdev, struct block_req *req) {
+	struct block_bio *bio, *first;
+	size_t nblocks;
+	int res;
+
+	first = NULL;
+	nblocks = 0;
+	block_req_foreach_bio(bio, req) {
+		if ((first != NULL)
+				&& (bio->buf == first->buf + nblocks * bdev->block_size)) {
+			nblocks += bio->nblocks;
+			continue;
+		}
+
+		if (first != NULL) {
+			res = block_dev_do_rw(bdev, req->op, first->buf, nblocks,
+					first->blkno);
+			if (res != 0) {
+				return res;
+			}
+		}
+
+		first = bio;
+		nblocks = bio->nblocks;
+	}
+
+	if (first == NULL) {
+		return 0;
+	}
+
+	return block_dev_do_rw(bdev, req->op, first->buf, nblocks, first->blkno);
+}
+
+static void block_req_dispatch(struct block_queue *q, struct block_req *req) {
+	struct block_dev *bdev;
+	int res;
+
+	bdev = q->bdev;
+
+	if (bdev->driver->submit != NULL) {
+		res = bdev->driver->submit(bdev, req);
+		if (res != 0) {
+			block_req_complete(req, res);
+		}
+		return;
+	}
+
+	switch (req->op) {
+	case BLOCK_REQ_FLUSH:
+		/* Driver without submit() doesn't cache writes */
+		block_req_complete(req, 0);
+		return;
+	case BLOCK_REQ_DISCARD:
+		block_req_complete(req, -EOPNOTSUPP);
+		return;
+	default:
+		break;
+	}
+
+	if (((req->op == BLOCK_REQ_READ) && (bdev->driver->read == NULL))
+			|| ((req->op == BLOCK_REQ_WRITE) && (bdev->driver->write == NULL))) {
+		block_req_complete(req, -ENOSYS);
+		return;
+	}
+
+	block_req_complete(req, block_req_do_rw(bdev, req));
+}
+
+void block_queue_run(struct block_queue *q) {
+	struct block_req *req;
+	ipl_t ipl;
+
+	assert(q);
+
+	ipl = spin_lock_ipl(&q->lock);
+	if (q->dispatching) {
+		/* Another dispatcher will process all queued requests */
+		spin_unlock_ipl(&q->lock, ipl);
+		return;
+	}
+	q->dispatching = 1;
+
+	while ((q->kick || !q->plugged) && (q->inflight < q->depth)
+			&& (q->queued != 0)) {
+		req = q->sched->next(q);
+		assert(req);
+		block_queue_remove(q, req);
+		q->inflight++;
+		q->nr_dispatched++;
+		spin_unlock_ipl(&q->lock, ipl);
+
+		block_req_dispatch(q, req);
+
+		ipl = spin_lock_ipl(&q->lock);
+	}
+
+	if (q->queued == 0) {
+		q->kick = 0;
+	}
+	q->dispatching = 0;
+	spin_unlock_ipl(&q->lock, ipl);
+}
+
+/* Dispatches requests even if queue is plugged until it's empty */
+static void block_queue_kick(struct block_queue *q) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&q->lock);
+	{
+		q->kick = 1;
+	}
+	spin_unlock_ipl(&q->lock, ipl);
+
+	block_queue_run(q);
+}
+
+void block_req_complete(struct block_req *req, int err) {
+	struct block_queue *q;
+	struct block_bio *bio;
+	int run;
+	ipl_t ipl;
+
+	assert(req);
+
+	q = req->q;
+
+	block_req_foreach_bio(bio, req) {
+		dlist_del_init(&bio->lnk);
+		bio->end_io(bio, err);
+	}
+	block_req_free(req);
+
+	ipl = spin_lock_ipl(&q->lock);
+	{
+		q->inflight--;
+		run = !q->dispatching && (q->kick || !q->plugged)
+				&& (q->queued != 0);
+	}
+	spin_unlock_ipl(&q->lock, ipl);
+
+	if (run) {
+		lthread_launch(&q->lt);
+	}
+}
+
+void block_bio_submit(struct block_dev *bdev, struct block_bio *bio) {
+	struct block_queue *q;
+	struct block_req *req;
+	int merged;
+	ipl_t ipl;
+
+	assert(bdev);
+	assert(bio);
+	assert(bio->end_io);
+
+	q = bdev->queue;
+	assert(q);
+
+	if ((bio->nblocks == 0) && (bio->op != BLOCK_REQ_FLUSH)) {
+		bio->end_io(bio, 0);
+		return;
+	}
+	assert(bio->nblocks <= q->max_blocks);
+
+	dlist_head_init(&bio->lnk);
+
+	/* Request is allocated in advance as it can't be done under lock */
+	if (NULL == (req = block_req_alloc())) {
+		/* Pool is freed on completion of the queued requests */
+		block_queue_kick(q);
+		WAITQ_WAIT(&block_req_pool_wq, NULL != (req = block_req_alloc()));
+	}
+
+	ipl = spin_lock_ipl(&q->lock);
+	{
+		q->nr_bios++;
+		merged = block_queue_merge(q, bio);
+		if (!merged) {
+			dlist_head_init(&req->sort_lnk);
+			dlist_head_init(&req->fifo_lnk);
+			dlist_init(&req->bios);
+			req->q = q;
+			req->op = bio->op;
+			req->blkno = bio->blkno;
+			req->nblocks = bio->nblocks;
+			req->start = clock_sys_ticks();
+			req->err = 0;
+			req->driver_priv = NULL;
+			dlist_add_prev(&bio->lnk, &req->bios);
+			block_queue_insert(q, req);
+		}
+	}
+	spin_unlock_ipl(&q->lock, ipl);
+
+	if (merged) {
+		block_req_free(req);
+	}
+
+	block_queue_run(q);
+}
+
+void block_queue_plug(struct block_dev *bdev) {
+	ipl_t ipl;
+
+	assert(bdev && bdev->queue);
+
+	ipl = spin_lock_ipl(&bdev->queue->lock);
+	{
+		bdev->queue->plugged++;
+	}
+	spin_unlock_ipl(&bdev->queue->lock, ipl);
+}
+
+void block_queue_unplug(struct block_dev *bdev) {
+	ipl_t ipl;
+
+	assert(bdev && bdev->queue);
+
+	ipl = spin_lock_ipl(&bdev->queue->lock);
+	{
+		assert(bdev->queue->plugged > 0);
+		bdev->queue->plugged--;
+	}
+	spin_unlock_ipl(&bdev->queue->lock, ipl);
+
+	block_queue_run(bdev->queue);
+}
+
+static void block_bio_batch_end(struct block_bio *bio, int err) {
+	struct block_bio_batch *batch;
+	ipl_t ipl;
+
+	batch = bio->priv;
+
+	/* Waiter can leave as soon as pending is zero, so it's woken up
+	 * before it can run */
+	ipl = ipl_save();
+	{
+		if ((err != 0) && (batch->err == 0)) {
+			batch->err = err;
+		}
+		if (--batch->pending == 0) {
+			waitq_wakeup_all(&batch->wq);
+		}
+	}
+	ipl_restore(ipl);
+}
+
+void block_bio_batch_init(struct block_bio_batch *batch) {
+	batch->pending = 0;
+	batch->err = 0;
+	waitq_init(&batch->wq);
+}
+
+void block_bio_batch_submit(struct block_dev *bdev,
+		struct block_bio_batch *batch, struct block_bio *bio) {
+	ipl_t ipl;
+
+	bio->end_io = block_bio_batch_end;
+	bio->priv = batch;
+
+	ipl = ipl_save();
+	{
+		batch->pending++;
+	}
+	ipl_restore(ipl);
+
+	block_bio_submit(bdev, bio);
+}
+
+int block_bio_batch_wait(struct block_bio_batch *batch) {
+	WAITQ_WAIT(&batch->wq, batch->pending == 0);
+
+	return batch->err;
+}
+
+int block_dev_rw_blocks(struct block_dev *bdev, int op, char *buf,
+		size_t nblocks, blkno_t blkno) {
+	struct block_bio_batch batch;
+	struct block_bio bio[RW_BLOCKS_BIOS];
+	size_t max_blocks;
+	int i, res;
+
+	assert(bdev && bdev->queue);
+
+	max_blocks = bdev->queue->max_blocks;
+
+	/* Blocks are split to bios of the maximum request size, a few of them
+	 * are processed at once */
+	do {
+		block_bio_batch_init(&batch);
+		block_queue_plug(bdev);
+		for (i = 0; i < RW_BLOCKS_BIOS; i++) {
+			bio[i].op = op;
+			bio[i].blkno = blkno;
+			bio[i].nblocks = min(nblocks, max_blocks);
+			bio[i].buf = buf;
+			block_bio_batch_submit(bdev, &batch, &bio[i]);
+
+			blkno += bio[i].nblocks;
+			nblocks -= bio[i].nblocks;
+			if (buf != NULL) {
+				buf += bio[i].nblocks * bdev->block_size;
+			}
+			if (nblocks == 0) {
+				break;
+			}
+		}
+		block_queue_unplug(bdev);
+
+		if (0 != (res = block_bio_batch_wait(&batch))) {
+			return res;
+		}
+	} while (nblocks != 0);
+
+	return 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file
+ * @brief Asynchronous block request queue.
+ *
+ * @details Input/output is described by block_bio: a range of blocks and a
+ *   buffer for them. Submitted bios are merged into block requests if they
+ *   are adjacent on the disk, so a request is a contiguous range of blocks
+ *   which consists of a few buffers. I/O scheduler decides the order in
+ *   which requests are passed to the driver.
+ *
+ *   Driver with @c submit operation receives whole requests and completes
+ *   them with block_req_complete(), perhaps from an interrupt. It can
+ *   accept up to @c depth requests at a time (e.g. number of command slots
+ *   or hardware queues). Driver without @c submit is called with
+ *   read()/write() for every bio of the request in the submitter context.
+ *
+ * @date 17.10.26
+ */
+
+#ifndef DRIVERS_BLOCK_REQUEST_H_
+#define DRIVERS_BLOCK_REQUEST_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <kernel/lthread/lthread.h>
+#include <kernel/sched/waitq.h>
+#include <kernel/spinlock.h>
+#include <util/dlist.h>
+
+#define BLOCK_REQ_READ    0
+#define BLOCK_REQ_WRITE   1
+#define BLOCK_REQ_FLUSH   2 /* Write volatile cache of device, no blocks */
+#define BLOCK_REQ_DISCARD 3 /* Blocks are not used anymore, no buffer */
+
+/* Flush and discard are queued with writes */
+#define block_req_dir(op) \
+	((op) == BLOCK_REQ_READ ? BLOCK_REQ_READ : BLOCK_REQ_WRITE)
+
+struct block_dev;
+struct block_bio;
+struct block_queue;
+
+typedef void (*block_bio_end_t)(struct block_bio *bio, int err);
+
+struct block_bio {
+	struct dlist_head lnk;   /* Link in list of request bios */
+	int op;                  /* One of BLOCK_REQ_* */
+	blkno_t blkno;
+	size_t nblocks;
+	char *buf;
+	block_bio_end_t end_io;  /* Called on completion, perhaps from interrupt */
+	void *priv;              /* Owner data for end_io */
+};
+
+struct block_req {
+	struct dlist_head sort_lnk; /* Link in queue sorted by block number */
+	struct dlist_head fifo_lnk; /* Link in queue in order of arrival */
+	struct block_queue *q;
+	int op;
+	blkno_t blkno;
+	size_t nblocks;
+	clock_t start;              /* Time of arrival */
+	struct dlist_head bios;
+	int err;
+	void *driver_priv;          /* For driver while request is dispatched */
+};
+
+struct block_sched_ops {
+	const char *name;
+	/* Returns request to dispatch, it's removed from the queue by caller */
+	struct block_req *(*next)(struct block_queue *q);
+};
+
+struct block_queue {
+	struct block_dev *bdev;
+	const struct block_sched_ops *sched;
+	spinlock_t lock;
+
+	struct dlist_head sorted;   /* Queued requests sorted by block number */
+	struct dlist_head fifo[2];  /* Queued requests of each direction */
+	blkno_t last_pos;           /* Block after the last dispatched request */
+	int queued;
+
+	int depth;                  /* Requests which driver can accept at once */
+	int inflight;
+	size_t max_blocks;          /* Maximum size of request */
+	int plugged;
+	int kick;                   /* Dispatch despite plug until it's empty */
+	int dispatching;
+	struct lthread lt;          /* Runs queue after asynchronous completion */
+
+	/* Statistics */
+	unsigned long nr_bios;
+	unsigned long nr_merges;
+	unsigned long nr_dispatched;
+};
+
+extern struct block_queue *block_queue_create(struct block_dev *bdev);
+extern void block_queue_destroy(struct block_queue *q);
+
+/**
+ * Sets number of requests which driver can process simultaneously and
+ * maximum request size in blocks (0 keeps the current one).
+ */
+extern void block_queue_set_limits(struct block_queue *q, int depth,
+		size_t max_blocks);
+
+extern int block_queue_set_sched(struct block_queue *q, const char *name);
+
+/**
+ * Submits @a bio to the queue of device. @c end_io is called exactly once,
+ * also in case of error. Bio must not be bigger than @c max_blocks of the
+ * queue.
+ */
+extern void block_bio_submit(struct block_dev *bdev, struct block_bio *bio);
+
+/**
+ * Bios submitted between plug and unplug are only queued, so they can be
+ * merged into bigger requests. Queue is run on the last unplug.
+ */
+extern void block_queue_plug(struct block_dev *bdev);
+extern void block_queue_unplug(struct block_dev *bdev);
+
+/**
+ * Dispatches queued requests while driver accepts them.
+ */
+extern void block_queue_run(struct block_queue *q);
+
+/**
+ * Called by driver when request is done, @a err is 0 or negative errno.
+ */
+extern void block_req_complete(struct block_req *req, int err);
+
+/**
+ * Reads or writes @a nblocks blocks and waits for completion.
+ * @return Zero or negative errno
+ */
+extern int block_dev_rw_blocks(struct block_dev *bdev, int op, char *buf,
+		size_t nblocks, blkno_t blkno);
+
+/**
+ * Flushes volatile write cache of device. Only writes which are completed
+ * before are guaranteed to be on the media.
+ */
+static inline int block_dev_flush(struct block_dev *bdev) {
+	return block_dev_rw_blocks(bdev, BLOCK_REQ_FLUSH, NULL, 0, 0);
+}
+
+static inline int block_dev_discard(struct block_dev *bdev, blkno_t blkno,
+		size_t nblocks) {
+	return block_dev_rw_blocks(bdev, BLOCK_REQ_DISCARD, NULL, nblocks, blkno);
+}
+
+/**
+ * Group of bios which submitter waits for.
+ */
+struct block_bio_batch {
+	int pending;
+	int err;          /* The first error of bios */
+	struct waitq wq;
+};
+
+extern void block_bio_batch_init(struct block_bio_batch *batch);
+
+/**
+ * Submits @a bio as a part of @a batch, its @c end_io and @c priv are used
+ * by the batch.
+ */
+extern void block_bio_batch_submit(struct block_dev *bdev,
+		struct block_bio_batch *batch, struct block_bio *bio);
+
+/**
+ * Waits for all bios of @a batch.
+ * @return Zero or the first error of bios
+ */
+extern int block_bio_batch_wait(struct block_bio_batch *batch);
+
+#define block_req_foreach_bio(bio, req) \
+	dlist_foreach_entry(bio, &(req)->bios, lnk)
+
+#include <util/array.h>
+
+ARRAY_SPREAD_DECLARE(const struct block_sched_ops, __block_sched_registry);
+
+#define block_sched_foreach(ops_ptr) \
+	array_spread_foreach_ptr(ops_ptr, __block_sched_registry)
+
+#define BLOCK_SCHED_DEF(_name, _next)                                        \
+	ARRAY_SPREAD_DECLARE(const struct block_sched_ops,                       \
+			__block_sched_registry);                                         \
+	ARRAY_SPREAD_ADD_NAMED(__block_sched_registry, __block_sched_##_next, { \
+				.name = _name,                                               \
+				.next = _next                                                \
+			})
+
+#endif /* DRIVERS_BLOCK_REQUEST_H_ */
@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @brief Deadline I/O scheduler.
+ *
+ * @details Requests are dispatched in one direction of block numbers
+ *   (C-SCAN elevator) to reduce seeking. Request which waits longer than
+ *   its expiration time (read_expire or write_expire) is dispatched first,
+ *   reads are preferred as somebody usually waits for them.
+ *
+ * @date 17.10.26
+ */
+
+#include <stddef.h>
+
+#include <drivers/block_request.h>
+#include <framework/mod/options.h>
+#include <hal/clock.h>
+#include <kernel/time/time.h>
+#include <util/dlist.h>
+
+#define READ_EXPIRE  OPTION_GET(NUMBER, read_expire)
+#define WRITE_EXPIRE OPTION_GET(NUMBER, write_expire)
+
+static struct block_req *deadline_expired(struct block_queue *q, int op,
+		clock_t now) {
+	struct block_req *req;
+	clock_t expire;
+
+	req = dlist_first_entry_or_null(&q->fifo[op], struct block_req, fifo_lnk);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	expire = ms2jiffies(op == BLOCK_REQ_READ ? READ_EXPIRE : WRITE_EXPIRE);
+	if ((long) (now - req->start) < (long) expire) {
+		return NULL;
+	}
+
+	return req;
+}
+
+static struct block_req *deadline_next(struct block_queue *q) {
+	struct block_req *req;
+	clock_t now;
+
+	now = clock_sys_ticks();
+	if ((NULL != (req = deadline_expired(q, BLOCK_REQ_READ, now)))
+			|| (NULL != (req = deadline_expired(q, BLOCK_REQ_WRITE, now)))) {
+		return req;
+	}
+
+	/* Continue from the end of the last dispatched request */
+	dlist_foreach_entry(req, &q->sorted, sort_lnk) {
+		if (req->blkno >= q->last_pos) {
+			return req;
+		}
+	}
+
+	return dlist_first_entry_or_null(&q->sorted, struct block_req, sort_lnk);
+}
+
+BLOCK_SCHED_DEF("deadline", deadline_next);
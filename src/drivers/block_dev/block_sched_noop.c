@@ -0,0 +1,30 @@
+/**
+ * @file
+ * @brief I/O scheduler which dispatches requests in order of arrival.
+ *
+ * @details Adjacent requests are still merged by the queue. It's suitable
+ *   for devices without seek time like RAM and flash.
+ *
+ * @date 17.10.26
+ */
+
+#include <stddef.h>
+
+#include <drivers/block_request.h>
+#include <util/dlist.h>
+
+static struct block_req *noop_next(struct block_queue *q) {
+	struct block_req *rd, *wr;
+
+	rd = dlist_first_entry_or_null(&q->fifo[BLOCK_REQ_READ],
+			struct block_req, fifo_lnk);
+	wr = dlist_first_entry_or_null(&q->fifo[BLOCK_REQ_WRITE],
+			struct block_req, fifo_lnk);
+
+	if ((rd == NULL) || ((wr != NULL) && ((long) (wr->start - rd->start) < 0))) {
+		return wr;
+	}
+	return rd;
+}
+
+BLOCK_SCHED_DEF("noop", noop_next);
@@ -15,6 +15,7 @@
 
 #include <drivers/ide.h>
 #include <drivers/block_dev.h>
+#include <drivers/block_request.h>
 #include <drivers/block_dev/partition.h>
 #include <mem/phymem.h>
 
@@ -22,28 +23,39 @@
 extern int hd_ioctl(struct block_dev *bdev, int cmd, void *args, size_t size);
 static block_dev_driver_t idedisk_udma_driver;
 
-static void setup_dma(hdc_t *hdc, char *buffer, int count, int cmd) {
-	int i;
-	int len;
+/* Requests are limited so that their buffers always fit to PRD table */
+#define HD_DMA_MAX_SECTS 128
+
+/* Adds buffer to PRD table starting from entry @a i, returns the next free
+ * entry or -1 if table is full */
+static int prd_add(hdc_t *hdc, int i, char *buffer, int count) {
 	char *next;
+	int len;
 
-	i = 0;
 	next = (char *) ((unsigned long) buffer & ~(PAGESIZE - 1)) + PAGESIZE;
-	while (1) {
-		hdc->prds[i].addr = (unsigned long) buffer;
+	while (count > 0) {
+		if (i >= MAX_PRDS) {
+			return -1;
+		}
 		len = next - buffer;
-		if (count > len) {
-			hdc->prds[i].len = len;
-			count -= len;
-			buffer = next;
-			next += PAGESIZE;
-			i++;
-		} else {
-			hdc->prds[i].len = count | 0x80000000;
-			break;
+		if (len > count) {
+			len = count;
 		}
+		hdc->prds[i].addr = (unsigned long) buffer;
+		hdc->prds[i].len = len;
+		count -= len;
+		buffer = next;
+		next += PAGESIZE;
+		i++;
 	}
 
+	return i;
+}
+
+static void setup_dma_prds(hdc_t *hdc, int nprds, int cmd) {
+	/* Mark the end of PRD table */
+	hdc->prds[nprds - 1].len |= 0x80000000;
+
 	/* Setup PRD table */
 	outl(hdc->prds_phys, hdc->bmregbase + BM_PRD_ADDR);
 
@@ -55,6 +67,10 @@ static void setup_dma(hdc_t *hdc, char *buffer, int count, int cmd) {
 		 hdc->bmregbase + BM_STATUS_REG);
 }
 
+static void setup_dma(hdc_t *hdc, char *buffer, int count, int cmd) {
+	setup_dma_prds(hdc, prd_add(hdc, 0, buffer, count), cmd);
+}
+
 static void start_dma(hdc_t *hdc) {
 	/* Start DMA operation */
 	outb(inb(hdc->bmregbase + BM_COMMAND_REG) | BM_CR_START,
@@ -236,6 +252,74 @@ static int hd_write_udma(struct block_dev *bdev, char *buffer, size_t count, blk
 	return result == 0 ? count : result;
 }
 
+/* Whole request is transferred by one command, buffers of its bios are
+ * gathered by PRD table */
+static int hd_submit_udma(struct block_dev *bdev, struct block_req *req) {
+	hd_t *hd;
+	hdc_t *hdc;
+	struct block_bio *bio;
+	int nprds;
+	int result;
+
+	hd = (hd_t *) bdev->privdata;
+	hdc = hd->hdc;
+
+	switch (req->op) {
+	case BLOCK_REQ_FLUSH:
+		/* Driver doesn't enable write cache of the drive */
+		block_req_complete(req, 0);
+		return 0;
+	case BLOCK_REQ_DISCARD:
+		return -EOPNOTSUPP;
+	default:
+		break;
+	}
+
+	nprds = 0;
+	block_req_foreach_bio(bio, req) {
+		nprds = prd_add(hdc, nprds, bio->buf, bio->nblocks * bdev->block_size);
+		if (nprds < 0) {
+			return -EIO;
+		}
+	}
+
+	/* Select drive */
+	ide_select_drive(hd);
+
+	/* Wait for controller ready */
+	if (0 != ide_wait(hdc, HDCS_DRDY, HDTIMEOUT_DRDY)) {
+		return -EIO;
+	}
+
+	/* Prepare transfer */
+	hdc->dir = HD_XFER_DMA;
+	hdc->active = hd;
+
+	hd_setup_transfer(hd, req->blkno, req->nblocks);
+
+	if (req->op == BLOCK_REQ_READ) {
+		setup_dma_prds(hdc, nprds, BM_CR_WRITE);
+		outb(HDCMD_READDMA, hdc->iobase + HDC_COMMAND);
+	} else {
+		setup_dma_prds(hdc, nprds, BM_CR_READ);
+		outb(HDCMD_WRITEDMA, hdc->iobase + HDC_COMMAND);
+	}
+	start_dma(hdc);
+
+	/* Stop DMA channel and check DMA status */
+	result = stop_dma(hdc);
+	if ((result == 0) && (hdc->status & HDCS_ERR)) {
+		result = -EIO;
+	}
+
+	/* Cleanup */
+	hdc->dir = HD_XFER_IDLE;
+	hdc->active = NULL;
+
+	block_req_complete(req, result);
+	return 0;
+}
+
 static int idedisk_udma_init (void *args) {
 	hd_t *drive;
 	double size;
@@ -257,6 +341,8 @@ static int idedisk_udma_init (void *args) {
 				   (double) drive->param.unfbytes *
 				   (double) (drive->param.sectors + 1);
 			block_dev(drive->bdev)->size = (size_t) size;
+			block_queue_set_limits(block_dev(drive->bdev)->queue, 1,
+					HD_DMA_MAX_SECTS);
 		} else {
 			return -1;
 		}
@@ -271,6 +357,7 @@ static block_dev_driver_t idedisk_udma_driver = {
 	hd_read_udma,
 	hd_write_udma,
 	idedisk_udma_init,
+	hd_submit_udma,
 };
 
 BLOCK_DEV_DEF("idedisk_udma", &idedisk_udma_driver);
@@ -22,6 +22,7 @@
 #include <util/binalign.h>
 
 #include <drivers/block_dev.h>
+#include <drivers/block_request.h>
 
 #include <drivers/block_dev/ramdisk/ramdisk.h>
 
@@ -35,12 +36,15 @@ INDEX_DEF(ramdisk_idx,0,MAX_DEV_QUANTITY);
 static int read_sectors(struct block_dev *bdev, char *buffer, size_t count, blkno_t blkno);
 static int write_sectors(struct block_dev *bdev, char *buffer, size_t count, blkno_t blkno);
 static int ram_ioctl(struct block_dev *bdev, int cmd, void *args, size_t size);
+static int ramdisk_submit(struct block_dev *bdev, struct block_req *req);
 
 block_dev_driver_t ramdisk_pio_driver = {
 	"ramdisk_drv",
 	ram_ioctl,
 	read_sectors,
-	write_sectors
+	write_sectors,
+	NULL,
+	ramdisk_submit
 };
 
 static int ramdisk_get_index(char *path) {
@@ -96,6 +100,8 @@ struct ramdisk *ramdisk_create(char *path, size_t size) {
 
 	ramdisk->bdev->size = ramdisk_size;
 	ramdisk->bdev->block_size = RAMDISK_BLOCK_SIZE;
+	/* There is no seek time */
+	block_queue_set_sched(ramdisk->bdev->queue, "noop");
 	return ramdisk;
 
 err_free_bdev_idx:
@@ -179,6 +185,38 @@ static int write_sectors(struct block_dev *bdev,
 	return count;
 }
 
+/* Whole request is copied at once, so it's completed immediately */
+static int ramdisk_submit(struct block_dev *bdev, struct block_req *req) {
+	ramdisk_t *ramdisk;
+	struct block_bio *bio;
+	char *addr;
+	size_t len;
+
+	ramdisk = (ramdisk_t *) bdev->privdata;
+	if ((req->blkno + req->nblocks) * bdev->block_size > bdev->size) {
+		return -EIO;
+	}
+
+	if ((req->op == BLOCK_REQ_FLUSH) || (req->op == BLOCK_REQ_DISCARD)) {
+		/* Memory has no cache and nothing to release */
+		block_req_complete(req, 0);
+		return 0;
+	}
+
+	block_req_foreach_bio(bio, req) {
+		addr = ramdisk->p_start_addr + (bio->blkno * bdev->block_size);
+		len = bio->nblocks * bdev->block_size;
+		if (req->op == BLOCK_REQ_READ) {
+			memcpy(bio->buf, addr, len);
+		} else {
+			memcpy(addr, bio->buf, len);
+		}
+	}
+
+	block_req_complete(req, 0);
+	return 0;
+}
+
 static int ram_ioctl(struct block_dev *bdev, int cmd, void *args, size_t size) {
 	ramdisk_t *ramd = (ramdisk_t *) bdev->privdata;
 
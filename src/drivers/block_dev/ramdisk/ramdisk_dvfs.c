@@ -24,6 +24,7 @@
 #include <util/binalign.h>
 
 #include <drivers/block_dev.h>
+#include <drivers/block_request.h>
 #include <drivers/device.h>
 #include <drivers/block_dev/ramdisk/ramdisk.h>
 
@@ -36,11 +37,13 @@ INDEX_DEF(ramdisk_idx, 0, MAX_DEV_QUANTITY);
 
 static int read_sectors(struct block_dev *bdev, char *buffer, size_t count, blkno_t blkno);
 static int write_sectors(struct block_dev *bdev, char *buffer, size_t count, blkno_t blkno);
+static int ramdisk_submit(struct block_dev *bdev, struct block_req *req);
 
 struct block_dev_driver ramdisk_pio_driver = {
-	.name  = "ramdisk_drv",
-	.read  = read_sectors,
-	.write = write_sectors
+	.name   = "ramdisk_drv",
+	.read   = read_sectors,
+	.write  = write_sectors,
+	.submit = ramdisk_submit,
 };
 
 struct ramdisk *ramdisk_create(char *path, size_t size) {
@@ -72,6 +75,8 @@ struct ramdisk *ramdisk_create(char *path, size_t size) {
 	bdev->privdata = ram;
 	bdev->block_size = RAMDISK_BLOCK_SIZE;
 	bdev->size = ramdisk_size;
+	/* There is no seek time */
+	block_queue_set_sched(bdev->queue, "noop");
 
 	return ram;
 err_free_mem:
@@ -139,3 +144,35 @@ static int write_sectors(struct block_dev *bdev,
 	memcpy(write_addr, buffer, count);
 	return count;
 }
+
+/* Whole request is copied at once, so it's completed immediately */
+static int ramdisk_submit(struct block_dev *bdev, struct block_req *req) {
+	ramdisk_t *ramdisk;
+	struct block_bio *bio;
+	char *addr;
+	size_t len;
+
+	ramdisk = (ramdisk_t *) bdev->privdata;
+	if ((req->blkno + req->nblocks) * bdev->block_size > bdev->size) {
+		return -EIO;
+	}
+
+	if ((req->op == BLOCK_REQ_FLUSH) || (req->op == BLOCK_REQ_DISCARD)) {
+		/* Memory has no cache and nothing to release */
+		block_req_complete(req, 0);
+		return 0;
+	}
+
+	block_req_foreach_bio(bio, req) {
+		addr = ramdisk->p_start_addr + (bio->blkno * bdev->block_size);
+		len = bio->nblocks * bdev->block_size;
+		if (req->op == BLOCK_REQ_READ) {
+			memcpy(bio->buf, addr, len);
+		} else {
+			memcpy(addr, bio->buf, len);
+		}
+	}
+
+	block_req_complete(req, 0);
+	return 0;
+}
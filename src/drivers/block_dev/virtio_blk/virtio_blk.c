@@ -0,0 +1,610 @@
+/**
+ * @file
+ * @brief VirtIO block device driver
+ *
+ * @details Every request queue of device has a fixed number of slots: a
+ *   request header, status and a table of descriptors. With negotiated
+ *   INDIRECT_DESC the table is passed to the device by one descriptor of the
+ *   ring, otherwise it's copied to a chain of ring descriptors. Requests go
+ *   to the least loaded queue of device. With EVENT_IDX notifications and
+ *   interrupts are sent only when the other side waits for them.
+ *
+ * @date 17.10.26
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <drivers/block_dev.h>
+#include <drivers/block_dev/partition.h>
+#include <drivers/block_request.h>
+#include <drivers/pci/pci.h>
+#include <drivers/pci/pci_driver.h>
+#include <drivers/pci/pci_id.h>
+#include <drivers/virtio/virtio.h>
+#include <drivers/virtio/virtio_ring.h>
+#include <drivers/virtio/virtio_queue.h>
+#include <framework/mod/options.h>
+#include <kernel/irq.h>
+#include <kernel/spinlock.h>
+#include <mem/misc/pool.h>
+#include <util/indexator.h>
+#include <util/log.h>
+#include <util/math.h>
+#include <util/member.h>
+
+#include "virtio_blk.h"
+
+#define VIRTIO_BLK_DEV_QUANTITY OPTION_GET(NUMBER, dev_quantity)
+#define VIRTIO_BLK_QUEUES_MAX   OPTION_GET(NUMBER, queues_max)
+#define VIRTIO_BLK_QUEUE_DEPTH  OPTION_GET(NUMBER, queue_depth)
+#define VIRTIO_BLK_SEG_MAX      OPTION_GET(NUMBER, seg_max)
+
+/* Header and status descriptors */
+#define VIRTIO_BLK_DESC_EXTRA   2
+
+#define VIRTIO_BLK_FEATURES \
+	(VIRTIO_BLK_F_SIZE_MAX | VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_RO \
+		| VIRTIO_BLK_F_BLK_SIZE | VIRTIO_BLK_F_FLUSH | VIRTIO_BLK_F_MQ \
+		| VIRTIO_BLK_F_DISCARD | VIRTIO_RING_F_INDIRECT_DESC \
+		| VIRTIO_RING_F_EVENT_IDX)
+
+struct virtio_blk_slot {
+	struct vring_desc table[VIRTIO_BLK_SEG_MAX + VIRTIO_BLK_DESC_EXTRA];
+	struct virtio_blk_outhdr hdr;
+	struct virtio_blk_discard discard;
+	uint8_t status;
+	struct block_req *req;
+};
+
+struct virtio_blk_queue {
+	struct virtqueue vq;
+	struct virtio_blk_slot slots[VIRTIO_BLK_QUEUE_DEPTH];
+	struct virtio_blk_slot *free_slots[VIRTIO_BLK_QUEUE_DEPTH];
+	int num_free_slots;
+	int inflight;
+};
+
+struct virtio_blk_dev {
+	unsigned long base_addr;
+	unsigned int irq;
+	uint32_t features;
+	spinlock_t lock;
+	int nqueues;
+	struct virtio_blk_queue queues[VIRTIO_BLK_QUEUES_MAX];
+	unsigned int seg_max;      /* Descriptors of data in one request */
+	unsigned int sect_per_blk; /* VirtIO sectors in block of device */
+	struct block_dev *bdev;
+	int idx;
+};
+
+POOL_DEF(virtio_blk_pool, struct virtio_blk_dev, VIRTIO_BLK_DEV_QUANTITY);
+INDEX_DEF(virtio_blk_idx, 0, VIRTIO_BLK_DEV_QUANTITY);
+
+static int virtio_blk_read(struct block_dev *bdev, char *buffer,
+		size_t count, blkno_t blkno);
+static int virtio_blk_write(struct block_dev *bdev, char *buffer,
+		size_t count, blkno_t blkno);
+static int virtio_blk_ioctl(struct block_dev *bdev, int cmd, void *args,
+		size_t size);
+static int virtio_blk_submit(struct block_dev *bdev, struct block_req *req);
+
+static block_dev_driver_t virtio_blk_driver = {
+	.name   = "virtio_blk_drv",
+	.ioctl  = virtio_blk_ioctl,
+	.read   = virtio_blk_read,
+	.write  = virtio_blk_write,
+	.probe  = NULL,
+	.submit = virtio_blk_submit,
+};
+
+BLOCK_DEV_DEF("virtio_blk", &virtio_blk_driver);
+
+PCI_DRIVER("virtio_blk", virtio_blk_init, PCI_VENDOR_ID_VIRTIO,
+		PCI_DEV_ID_VIRTIO_BLK);
+
+static inline int virtio_blk_has(struct virtio_blk_dev *vbd,
+		uint32_t feature) {
+	return vbd->features & feature;
+}
+
+static int virtio_blk_rw(struct block_dev *bdev, int op, char *buffer,
+		size_t count, blkno_t blkno) {
+	int res;
+
+	res = block_dev_rw_blocks(bdev, op, buffer, count / bdev->block_size,
+			blkno);
+	return res < 0 ? res : count;
+}
+
+static int virtio_blk_read(struct block_dev *bdev, char *buffer,
+		size_t count, blkno_t blkno) {
+	return virtio_blk_rw(bdev, BLOCK_REQ_READ, buffer, count, blkno);
+}
+
+static int virtio_blk_write(struct block_dev *bdev, char *buffer,
+		size_t count, blkno_t blkno) {
+	return virtio_blk_rw(bdev, BLOCK_REQ_WRITE, buffer, count, blkno);
+}
+
+static int virtio_blk_ioctl(struct block_dev *bdev, int cmd, void *args,
+		size_t size) {
+	switch (cmd) {
+	case IOCTL_GETDEVSIZE:
+		return bdev->size;
+	case IOCTL_GETBLKSIZE:
+		return bdev->block_size;
+	}
+	return -ENOSYS;
+}
+
+static inline void virtio_blk_desc(struct vring_desc *table, int *n,
+		void *addr, uint32_t len, uint16_t flags) {
+	vring_desc_init(&table[*n], addr, len, flags | VRING_DESC_F_NEXT);
+	table[*n].next = *n + 1;
+	++*n;
+}
+
+/* Fills descriptors table of @a slot, returns number of descriptors */
+static int virtio_blk_fill_slot(struct virtio_blk_dev *vbd,
+		struct virtio_blk_slot *slot, struct block_req *req) {
+	struct block_dev *bdev;
+	struct block_bio *bio, *first;
+	uint16_t data_flags;
+	size_t len;
+	int n;
+
+	bdev = vbd->bdev;
+	n = 0;
+
+	slot->hdr.ioprio = 0;
+	slot->hdr.sector = (uint64_t)req->blkno * vbd->sect_per_blk;
+	virtio_blk_desc(slot->table, &n, &slot->hdr, sizeof slot->hdr, 0);
+
+	switch (req->op) {
+	case BLOCK_REQ_FLUSH:
+		slot->hdr.type = VIRTIO_BLK_T_FLUSH;
+		slot->hdr.sector = 0;
+		break;
+	case BLOCK_REQ_DISCARD:
+		slot->hdr.type = VIRTIO_BLK_T_DISCARD;
+		slot->hdr.sector = 0;
+		slot->discard.sector = (uint64_t)req->blkno * vbd->sect_per_blk;
+		slot->discard.num_sectors = req->nblocks * vbd->sect_per_blk;
+		slot->discard.flags = 0;
+		virtio_blk_desc(slot->table, &n, &slot->discard,
+				sizeof slot->discard, 0);
+		break;
+	default:
+		slot->hdr.type = (req->op == BLOCK_REQ_READ)
+				? VIRTIO_BLK_T_IN : VIRTIO_BLK_T_OUT;
+		data_flags = (req->op == BLOCK_REQ_READ) ? VRING_DESC_F_WRITE : 0;
+
+		/* Adjacent buffers are passed as one segment */
+		first = NULL;
+		len = 0;
+		block_req_foreach_bio(bio, req) {
+			if ((first != NULL) && (bio->buf == first->buf + len)) {
+				len += bio->nblocks * bdev->block_size;
+				continue;
+			}
+			if (first != NULL) {
+				virtio_blk_desc(slot->table, &n, first->buf, len, data_flags);
+			}
+			first = bio;
+			len = bio->nblocks * bdev->block_size;
+		}
+		assert(first != NULL);
+		virtio_blk_desc(slot->table, &n, first->buf, len, data_flags);
+		break;
+	}
+
+	slot->status = VIRTIO_BLK_S_IOERR;
+	vring_desc_init(&slot->table[n], &slot->status, sizeof slot->status,
+			VRING_DESC_F_WRITE);
+	++n;
+
+	assert(n <= vbd->seg_max + VIRTIO_BLK_DESC_EXTRA);
+
+	return n;
+}
+
+/* Places descriptors of @a slot to the ring, returns id of the head */
+static int virtio_blk_add_slot(struct virtio_blk_dev *vbd,
+		struct virtqueue *vq, struct virtio_blk_slot *slot, int n) {
+	struct vring_desc *desc;
+	int head, id, i;
+
+	if (virtio_blk_has(vbd, VIRTIO_RING_F_INDIRECT_DESC)) {
+		head = virtqueue_get_chain(vq, 1);
+		if (head < 0) {
+			return -EBUSY;
+		}
+		vring_desc_init(&vq->ring.desc[head], slot->table,
+				n * sizeof(struct vring_desc), VRING_DESC_F_INDIRECT);
+		return head;
+	}
+
+	head = virtqueue_get_chain(vq, n);
+	if (head < 0) {
+		return -EBUSY;
+	}
+
+	/* Chain is already linked by next fields */
+	id = head;
+	for (i = 0; i < n; i++) {
+		desc = &vq->ring.desc[id];
+		desc->addr = slot->table[i].addr;
+		desc->len = slot->table[i].len;
+		desc->flags = slot->table[i].flags;
+		id = desc->next;
+	}
+
+	return head;
+}
+
+static struct virtio_blk_slot *virtio_blk_desc_slot(struct vring_desc *desc) {
+	if (desc->flags & VRING_DESC_F_INDIRECT) {
+		return mcast_out((struct vring_desc *)(uintptr_t)desc->addr,
+				struct virtio_blk_slot, table);
+	}
+	return mcast_out((struct virtio_blk_outhdr *)(uintptr_t)desc->addr,
+			struct virtio_blk_slot, hdr);
+}
+
+static void virtio_blk_kick(struct virtio_blk_dev *vbd, struct virtqueue *vq,
+		uint16_t old) {
+	uint16_t new_idx;
+	int notify;
+
+	/* Index is published before the check of device flags */
+	__sync_synchronize();
+
+	new_idx = vq->ring.avail->idx;
+	if (virtio_blk_has(vbd, VIRTIO_RING_F_EVENT_IDX)) {
+		notify = vring_need_event(vring_get_avail_event(&vq->ring),
+				new_idx, old);
+	} else {
+		notify = !(vq->ring.used->flags & VRING_USED_F_NO_NOTIFY);
+	}
+
+	if (notify) {
+		virtio_notify_queue(vq->id, vbd->base_addr);
+	}
+}
+
+static struct virtio_blk_queue *virtio_blk_pick_queue(
+		struct virtio_blk_dev *vbd) {
+	struct virtio_blk_queue *bq, *best;
+	int i;
+
+	best = NULL;
+	for (i = 0; i < vbd->nqueues; i++) {
+		bq = &vbd->queues[i];
+		if ((bq->num_free_slots != 0)
+				&& ((best == NULL) || (bq->inflight < best->inflight))) {
+			best = bq;
+		}
+	}
+	return best;
+}
+
+static int virtio_blk_submit(struct block_dev *bdev, struct block_req *req) {
+	struct virtio_blk_dev *vbd;
+	struct virtio_blk_queue *bq;
+	struct virtio_blk_slot *slot;
+	uint16_t old;
+	int n, head;
+	ipl_t ipl;
+
+	vbd = bdev->privdata;
+
+	switch (req->op) {
+	case BLOCK_REQ_FLUSH:
+		if (!virtio_blk_has(vbd, VIRTIO_BLK_F_FLUSH)) {
+			/* Device without FLUSH has no volatile cache */
+			block_req_complete(req, 0);
+			return 0;
+		}
+		break;
+	case BLOCK_REQ_DISCARD:
+		if (!virtio_blk_has(vbd, VIRTIO_BLK_F_DISCARD)) {
+			return -EOPNOTSUPP;
+		}
+		/* fallthrough */
+	case BLOCK_REQ_WRITE:
+		if (virtio_blk_has(vbd, VIRTIO_BLK_F_RO)) {
+			return -EROFS;
+		}
+		/* fallthrough */
+	default:
+		if ((uint64_t)(req->blkno + req->nblocks) * bdev->block_size
+				> bdev->size) {
+			return -EIO;
+		}
+		break;
+	}
+
+	ipl = spin_lock_ipl(&vbd->lock);
+	{
+		/* Block queue doesn't dispatch more than all slots */
+		bq = virtio_blk_pick_queue(vbd);
+		assert(bq != NULL);
+		slot = bq->free_slots[--bq->num_free_slots];
+
+		n = virtio_blk_fill_slot(vbd, slot, req);
+		head = virtio_blk_add_slot(vbd, &bq->vq, slot, n);
+		assert(head >= 0);
+
+		slot->req = req;
+		bq->inflight++;
+
+		old = bq->vq.ring.avail->idx;
+		vring_push_desc(head, &bq->vq.ring);
+		virtio_blk_kick(vbd, &bq->vq, old);
+	}
+	spin_unlock_ipl(&vbd->lock, ipl);
+
+	return 0;
+}
+
+/* Collects completed requests of @a bq to @a done, returns their number */
+static int virtio_blk_reap(struct virtio_blk_dev *vbd,
+		struct virtio_blk_queue *bq, struct block_req **done) {
+	struct virtqueue *vq;
+	struct vring_used_elem *used_elem;
+	struct virtio_blk_slot *slot;
+	struct block_req *req;
+	int n;
+
+	vq = &bq->vq;
+	n = 0;
+
+	do {
+		while (vq->last_seen_used != vq->ring.used->idx) {
+			/* Used element is read after its index */
+			__sync_synchronize();
+
+			used_elem = &vq->ring.used->ring[vq->last_seen_used % vq->ring.num];
+			slot = virtio_blk_desc_slot(&vq->ring.desc[used_elem->id]);
+			virtqueue_put_chain(vq, used_elem->id);
+
+			req = slot->req;
+			switch (slot->status) {
+			case VIRTIO_BLK_S_OK:
+				req->err = 0;
+				break;
+			case VIRTIO_BLK_S_UNSUPP:
+				req->err = -EOPNOTSUPP;
+				break;
+			default:
+				req->err = -EIO;
+				break;
+			}
+			done[n++] = req;
+
+			slot->req = NULL;
+			bq->free_slots[bq->num_free_slots++] = slot;
+			bq->inflight--;
+			++vq->last_seen_used;
+		}
+
+		if (!virtio_blk_has(vbd, VIRTIO_RING_F_EVENT_IDX)) {
+			break;
+		}
+
+		/* Interrupt on the next completion, but it could happen before
+		 * the event index was written */
+		vring_set_used_event(&vq->ring, vq->last_seen_used);
+		__sync_synchronize();
+	} while (vq->last_seen_used != vq->ring.used->idx);
+
+	return n;
+}
+
+static irq_return_t virtio_blk_irq_handler(unsigned int irq_num,
+		void *dev_id) {
+	struct virtio_blk_dev *vbd;
+	struct block_req *done[VIRTIO_BLK_QUEUE_DEPTH];
+	int i, j, n;
+	ipl_t ipl;
+
+	vbd = dev_id;
+
+	if (~virtio_get_isr_status(vbd->base_addr) & 1) {
+		return IRQ_NONE;
+	}
+
+	for (i = 0; i < vbd->nqueues; i++) {
+		ipl = spin_lock_ipl(&vbd->lock);
+		{
+			n = virtio_blk_reap(vbd, &vbd->queues[i], done);
+		}
+		spin_unlock_ipl(&vbd->lock, ipl);
+
+		/* Completion can dispatch new requests */
+		for (j = 0; j < n; j++) {
+			block_req_complete(done[j], done[j]->err);
+		}
+	}
+
+	return IRQ_HANDLED;
+}
+
+static void virtio_blk_config(struct virtio_blk_dev *vbd) {
+	uint32_t features;
+
+	/* reset device */
+	virtio_reset(vbd->base_addr);
+
+	/* it's known device */
+	virtio_add_status(VIRTIO_CONFIG_S_ACKNOWLEDGE | VIRTIO_CONFIG_S_DRIVER,
+			vbd->base_addr);
+
+	features = virtio_load32(VIRTIO_REG_DEVICE_F, vbd->base_addr)
+			& VIRTIO_BLK_FEATURES;
+	if (VIRTIO_BLK_QUEUES_MAX == 1) {
+		features &= ~VIRTIO_BLK_F_MQ;
+	}
+	virtio_set_feature(features, vbd->base_addr);
+	vbd->features = features;
+
+	vbd->nqueues = 1;
+	if (virtio_blk_has(vbd, VIRTIO_BLK_F_MQ)) {
+		vbd->nqueues = min(virtio_load16(VIRTIO_REG_BLK_NUM_QUEUES,
+					vbd->base_addr), VIRTIO_BLK_QUEUES_MAX);
+		vbd->nqueues = max(vbd->nqueues, 1);
+	}
+
+	vbd->sect_per_blk = 1;
+	if (virtio_blk_has(vbd, VIRTIO_BLK_F_BLK_SIZE)) {
+		vbd->sect_per_blk = virtio_load32(VIRTIO_REG_BLK_BLK_SIZE,
+				vbd->base_addr) / VIRTIO_BLK_SECTOR_SIZE;
+		vbd->sect_per_blk = max(vbd->sect_per_blk, 1);
+	}
+
+	vbd->seg_max = VIRTIO_BLK_SEG_MAX;
+	if (virtio_blk_has(vbd, VIRTIO_BLK_F_SEG_MAX)) {
+		vbd->seg_max = min(vbd->seg_max,
+				virtio_load32(VIRTIO_REG_BLK_SEG_MAX, vbd->base_addr));
+		vbd->seg_max = max(vbd->seg_max, 1);
+	}
+}
+
+static void virtio_blk_queues_fini(struct virtio_blk_dev *vbd, int n) {
+	while (n-- > 0) {
+		virtqueue_destroy(&vbd->queues[n].vq, vbd->base_addr);
+	}
+}
+
+static int virtio_blk_queues_init(struct virtio_blk_dev *vbd) {
+	struct virtio_blk_queue *bq;
+	unsigned int seg_max;
+	int ret, i, j;
+
+	for (i = 0; i < vbd->nqueues; i++) {
+		bq = &vbd->queues[i];
+
+		ret = virtqueue_create(&bq->vq, i, vbd->base_addr);
+		if (ret != 0) {
+			virtio_blk_queues_fini(vbd, i);
+			return ret;
+		}
+		virtqueue_init_free_list(&bq->vq);
+
+		/* Every slot takes a whole chain of the ring without indirect
+		 * descriptors */
+		if (!virtio_blk_has(vbd, VIRTIO_RING_F_INDIRECT_DESC)) {
+			seg_max = bq->vq.ring.num / VIRTIO_BLK_QUEUE_DEPTH;
+			if (seg_max <= VIRTIO_BLK_DESC_EXTRA) {
+				virtio_blk_queues_fini(vbd, i + 1);
+				return -EINVAL;
+			}
+			vbd->seg_max = min(vbd->seg_max, seg_max - VIRTIO_BLK_DESC_EXTRA);
+		}
+
+		for (j = 0; j < VIRTIO_BLK_QUEUE_DEPTH; j++) {
+			bq->slots[j].req = NULL;
+			bq->free_slots[j] = &bq->slots[j];
+		}
+		bq->num_free_slots = VIRTIO_BLK_QUEUE_DEPTH;
+		bq->inflight = 0;
+	}
+
+	return 0;
+}
+
+static int virtio_blk_create(struct virtio_blk_dev *vbd) {
+	struct block_dev *bdev;
+	char path[PATH_MAX];
+	size_t max_blocks;
+	uint64_t capacity;
+
+	strcpy(path, "/dev/vd*");
+	if (0 > (vbd->idx = block_dev_named(path, &virtio_blk_idx))) {
+		return vbd->idx;
+	}
+
+	bdev = block_dev_create(path, &virtio_blk_driver, vbd);
+	if (bdev == NULL) {
+		index_free(&virtio_blk_idx, vbd->idx);
+		return -ENOMEM;
+	}
+	vbd->bdev = bdev;
+
+	capacity = virtio_load32(VIRTIO_REG_BLK_CAPACITY, vbd->base_addr)
+			| ((uint64_t)virtio_load32(VIRTIO_REG_BLK_CAPACITY + 4,
+					vbd->base_addr) << 32);
+	bdev->block_size = vbd->sect_per_blk * VIRTIO_BLK_SECTOR_SIZE;
+	bdev->size = capacity * VIRTIO_BLK_SECTOR_SIZE;
+
+	/* Each bio is one segment at most, and it's not bigger than segment */
+	max_blocks = vbd->seg_max;
+	if (virtio_blk_has(vbd, VIRTIO_BLK_F_SIZE_MAX)) {
+		max_blocks = min(max_blocks,
+				virtio_load32(VIRTIO_REG_BLK_SIZE_MAX, vbd->base_addr)
+					/ bdev->block_size);
+		max_blocks = max(max_blocks, 1);
+	}
+	block_queue_set_limits(bdev->queue,
+			vbd->nqueues * VIRTIO_BLK_QUEUE_DEPTH, max_blocks);
+
+	log_info("%s: %llu sectors, %d queues, indirect %d, event idx %d",
+			bdev->name, (unsigned long long) capacity, vbd->nqueues,
+			!!virtio_blk_has(vbd, VIRTIO_RING_F_INDIRECT_DESC),
+			!!virtio_blk_has(vbd, VIRTIO_RING_F_EVENT_IDX));
+
+	create_partitions(bdev);
+
+	return 0;
+}
+
+static int virtio_blk_init(struct pci_slot_dev *pci_dev) {
+	struct virtio_blk_dev *vbd;
+	int ret;
+
+	vbd = pool_alloc(&virtio_blk_pool);
+	if (vbd == NULL) {
+		return -ENOMEM;
+	}
+	memset(vbd, 0, sizeof *vbd);
+
+	vbd->base_addr = pci_dev->bar[0] & PCI_BASE_ADDR_IO_MASK;
+	vbd->irq = pci_dev->irq;
+	spin_init(&vbd->lock, __SPIN_UNLOCKED);
+
+	virtio_blk_config(vbd);
+
+	ret = virtio_blk_queues_init(vbd);
+	if (ret != 0) {
+		goto out_free;
+	}
+
+	ret = irq_attach(vbd->irq, virtio_blk_irq_handler, IF_SHARESUP, vbd,
+			"virtio_blk");
+	if (ret != 0) {
+		goto out_queues;
+	}
+
+	/* device is ready */
+	virtio_add_status(VIRTIO_CONFIG_S_DRIVER_OK, vbd->base_addr);
+
+	ret = virtio_blk_create(vbd);
+	if (ret != 0) {
+		goto out_irq;
+	}
+
+	return 0;
+
+out_irq:
+	irq_detach(vbd->irq, vbd);
+out_queues:
+	virtio_blk_queues_fini(vbd, vbd->nqueues);
+out_free:
+	virtio_add_status(VIRTIO_CONFIG_S_FAILED, vbd->base_addr);
+	pool_free(&virtio_blk_pool, vbd);
+	return ret;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file
+ * @brief VirtIO block device definitions
+ *
+ * @date 17.10.26
+ */
+
+#ifndef DRIVERS_BLOCK_DEV_VIRTIO_BLK_H_
+#define DRIVERS_BLOCK_DEV_VIRTIO_BLK_H_
+
+#include <stdint.h>
+
+/**
+ * VirtIO Block Device Registers (legacy layout without MSI-X)
+ */
+#define VIRTIO_REG_BLK_CAPACITY   0x14 /* Capacity in 512-byte sectors (8 bytes) */
+#define VIRTIO_REG_BLK_SIZE_MAX   0x1C /* Maximum size of segment */
+#define VIRTIO_REG_BLK_SEG_MAX    0x20 /* Maximum number of segments */
+#define VIRTIO_REG_BLK_BLK_SIZE   0x28 /* Logical block size */
+#define VIRTIO_REG_BLK_NUM_QUEUES 0x36 /* Number of request queues (2 bytes) */
+
+/**
+ * VirtIO Block Device Feature Bits
+ */
+#define VIRTIO_BLK_F_SIZE_MAX 0x00000002 /* Maximum size of segment is in
+											config */
+#define VIRTIO_BLK_F_SEG_MAX  0x00000004 /* Maximum number of segments is in
+											config */
+#define VIRTIO_BLK_F_RO       0x00000020 /* Device is read-only */
+#define VIRTIO_BLK_F_BLK_SIZE 0x00000040 /* Block size is in config */
+#define VIRTIO_BLK_F_FLUSH    0x00000200 /* Cache flush command support */
+#define VIRTIO_BLK_F_MQ       0x00001000 /* Device supports multiple
+											request queues */
+#define VIRTIO_BLK_F_DISCARD  0x00002000 /* Discard command support */
+
+/**
+ * VirtIO Block Request Types
+ */
+#define VIRTIO_BLK_T_IN      0
+#define VIRTIO_BLK_T_OUT     1
+#define VIRTIO_BLK_T_FLUSH   4
+#define VIRTIO_BLK_T_DISCARD 11
+
+/**
+ * VirtIO Block Request Status
+ */
+#define VIRTIO_BLK_S_OK     0
+#define VIRTIO_BLK_S_IOERR  1
+#define VIRTIO_BLK_S_UNSUPP 2
+
+/* Sectors of the requests are always 512 bytes */
+#define VIRTIO_BLK_SECTOR_SIZE 512
+
+/**
+ * VirtIO Block Request Header
+ */
+struct virtio_blk_outhdr {
+	uint32_t type;   /* Request type */
+	uint32_t ioprio; /* Priority */
+	uint64_t sector; /* Start sector */
+};
+
+/**
+ * VirtIO Block Discard Segment
+ */
+struct virtio_blk_discard {
+	uint64_t sector;      /* Start sector */
+	uint32_t num_sectors; /* Number of sectors */
+	uint32_t flags;       /* Flags */
+};
+
+#endif /* DRIVERS_BLOCK_DEV_VIRTIO_BLK_H_ */
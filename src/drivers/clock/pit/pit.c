@@ -9,6 +9,7 @@
 #include <embox/unit.h>
 #include <framework/mod/options.h>
 
+#include <assert.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -19,6 +20,7 @@
 #include <kernel/time/clock_source.h>
 #include <kernel/time/ktime.h>
 #include <util/array.h>
+#include <util/math.h>
 #include <drivers/clock/pit/regs.h>
 
 #define INPUT_CLOCK        1193182L /* clock tick rate, Hz */
@@ -29,7 +31,10 @@
 #define PIT_LOAD ((INPUT_CLOCK + PIT_HZ / 2) / PIT_HZ)
 static_assert(PIT_LOAD < 0x10000);
 
+#define PIT_ONESHOT_MAX (0xFFFF / PIT_LOAD)
+
 static int pit_clock_setup(struct time_dev_conf * conf);
+static clock_t pit_set_oneshot(struct time_event_device *dev, clock_t ticks);
 static int pit_clock_init(void);
 
 static struct clock_source pit_clock_source;
@@ -89,14 +94,21 @@ static struct time_counter_device pit_counter_device;
 #define PIT_16BIT       0x30    /* r/w counter 16 bits, LSB first */
 #define PIT_BCD         0x01    /* count in BCD */
 
-static cycle_t i8253_read(void) {
+/* Counter 0 load value of a programmed single event */
+static uint32_t pit_oneshot_load;
+
+static uint16_t pit_read_count(void) {
 	unsigned char lsb, msb;
 
 	pit_out8(PIT_SEL0 | PIT_LATCH, MODE_REG);
 	lsb = pit_in8(CHANNEL0);
 	msb = pit_in8(CHANNEL0);
 
-	return PIT_LOAD - ((msb << 8) | lsb);
+	return (msb << 8) | lsb;
+}
+
+static cycle_t i8253_read(void) {
+	return PIT_LOAD - pit_read_count();
 }
 
 static irq_return_t clock_handler(unsigned int irq_nr, void *dev_id) {
@@ -108,7 +120,9 @@ static struct time_event_device pit_event_device = {
 	.config = pit_clock_setup,
 	.event_hz = PIT_HZ,
 	.irq_nr = IRQ_NR,
-	.pending = irqctrl_pending
+	.pending = irqctrl_pending,
+	.set_oneshot = pit_set_oneshot,
+	.max_oneshot = PIT_ONESHOT_MAX,
 };
 
 static struct time_counter_device pit_counter_device = {
@@ -151,3 +165,28 @@ static int pit_clock_setup(struct time_dev_conf * conf) {
 
 	return ENOERR;
 }
+
+static clock_t pit_set_oneshot(struct time_event_device *dev, clock_t ticks) {
+	uint32_t elapsed;
+
+	if (ticks) {
+		assert(ticks <= PIT_ONESHOT_MAX);
+		pit_oneshot_load = ticks * PIT_LOAD;
+
+		/* Keep rate generator mode, switching to mode 0 and back makes
+		 * a spurious edge on OUT */
+		pit_out8(PIT_SEL0 | PIT_16BIT | PIT_RATEGEN, MODE_REG);
+		pit_out8(pit_oneshot_load & 0xFF, CHANNEL0);
+		pit_out8(pit_oneshot_load >> 8, CHANNEL0);
+
+		return 0;
+	}
+
+	/* Round to the nearest jiffy to not accumulate a lag on frequent
+	 * early wakeups, but never report not fired event as fired */
+	elapsed = pit_oneshot_load - pit_read_count();
+	pit_clock_setup(NULL);
+
+	return min((elapsed + PIT_LOAD / 2) / PIT_LOAD,
+			pit_oneshot_load / PIT_LOAD - 1);
+}
@@ -60,6 +60,9 @@ PCI_DRIVER_TABLE("e1000", e1000_init, e1000_id_table);
 
 #define E1000_MAX_RX_LEN (ETH_FRAME_LEN + E1000_RX_CHECKSUM_LEN)
 
+/** Receive interrupts, masked while the device is polled. */
+#define E1000_RX_INTR (E1000_REG_IMS_RXO | E1000_REG_IMS_RXT)
+
 static int e1000_stop(struct net_device *dev);
 
 struct e1000_rx_desc {
@@ -177,64 +180,89 @@ static void txed_skb_clean(struct net_device *dev) {
 	irq_unlock();
 }
 
-static void e1000_rx(struct net_device *dev) {
+static int e1000_rx_pending(struct net_device *dev) {
+	struct e1000_priv *nic_priv = e1000_get_priv(dev);
+	uint16_t cur;
+
+	cur = (1 + REG_LOAD(e1000_reg(dev, E1000_REG_RDT))) % E1000_RXDESC_NR;
+
+	return nic_priv->rx_descs[cur].status != 0;
+}
+
+/* Called only from the poll, receive interrupts are masked meanwhile */
+static int e1000_poll(struct net_device *dev, int budget) {
 	/*net_device_stats_t stat = get_eth_stat(dev);*/
 	struct e1000_priv *nic_priv = e1000_get_priv(dev);
 	struct sk_buff *skb, *new_skb;
 	uint16_t head;
 	uint16_t tail;
 	uint16_t cur;
+	struct sk_buff_head rx_list;
+	int work = 0;
 
-	/* nested irq locked to prevent already handled packets handled once more
-	 * as tail updated at exit
-	 */
-	irq_lock();
-	{
-		head = REG_LOAD(e1000_reg(dev, E1000_REG_RDH));
-		tail = REG_LOAD(e1000_reg(dev, E1000_REG_RDT));
-		cur = (1 + tail) % E1000_RXDESC_NR;
+	skb_queue_init(&rx_list);
+
+	head = REG_LOAD(e1000_reg(dev, E1000_REG_RDH));
+	tail = REG_LOAD(e1000_reg(dev, E1000_REG_RDT));
+	cur = (1 + tail) % E1000_RXDESC_NR;
+
+	while (cur != head && work < budget) {
+		int len;
+
+		if (!(nic_priv->rx_descs[cur].status)) {
+			break;
+		}
+
+		work++;
+		nic_priv->rx_descs[cur].status = 0;
 
-		while (cur != head) {
-			int len;
-
-			if (!(nic_priv->rx_descs[cur].status)) {
-				break;
-			}
-
-			len = nic_priv->rx_descs[cur].length - E1000_RX_CHECKSUM_LEN;
-
-			if (0 != nf_test_raw(NF_CHAIN_INPUT,
-						NF_TARGET_ACCEPT,
-						(char *) nic_priv->rx_descs[cur].buffer_address,
-						ETH_ALEN + (char *) nic_priv->rx_descs[cur].buffer_address,
-						ETH_ALEN)) {
-				goto drop_pack;
-			}
-
-			new_skb = skb_alloc(E1000_MAX_RX_LEN);
-			if (!new_skb) {
-				goto drop_pack;
-			}
-
-			skb = nic_priv->rx_skbs[cur];
-			nic_priv->rx_skbs[cur] = new_skb;
-			nic_priv->rx_descs[cur].buffer_address = (uint32_t) new_skb->mac.raw;
-			assert(skb);
-
-			skb = skb_realloc(len, skb);
-			if (!skb) {
-				goto drop_pack;
-			}
-			skb->dev = dev;
-			netif_rx(skb);
+		len = nic_priv->rx_descs[cur].length - E1000_RX_CHECKSUM_LEN;
+
+		if (0 != nf_test_raw(NF_CHAIN_INPUT,
+					NF_TARGET_ACCEPT,
+					(char *) nic_priv->rx_descs[cur].buffer_address,
+					ETH_ALEN + (char *) nic_priv->rx_descs[cur].buffer_address,
+					ETH_ALEN)) {
+			goto drop_pack;
+		}
+
+		new_skb = skb_alloc(E1000_MAX_RX_LEN);
+		if (!new_skb) {
+			goto drop_pack;
+		}
+
+		skb = nic_priv->rx_skbs[cur];
+		nic_priv->rx_skbs[cur] = new_skb;
+		nic_priv->rx_descs[cur].buffer_address = (uint32_t) new_skb->mac.raw;
+		assert(skb);
+
+		skb = skb_realloc(len, skb);
+		if (!skb) {
+			goto drop_pack;
+		}
+		skb->dev = dev;
+		__skb_queue_push(&rx_list, skb);
 drop_pack:
-			tail = cur;
+		tail = cur;
 
-			cur = (1 + tail) % E1000_RXDESC_NR;
+		cur = (1 + tail) % E1000_RXDESC_NR;
+	}
+	REG_STORE(e1000_reg(dev, E1000_REG_RDT), tail);
+
+	netif_receive_skb_list(&rx_list);
+
+	if (work < budget) {
+		netif_napi_complete(dev);
+		REG_STORE(e1000_reg(dev, E1000_REG_IMS), E1000_RX_INTR);
+
+		/* A packet could come before the interrupt was unmasked */
+		if (e1000_rx_pending(dev)) {
+			REG_STORE(e1000_reg(dev, E1000_REG_IMC), E1000_RX_INTR);
+			netif_napi_schedule(dev);
 		}
-		REG_STORE(e1000_reg(dev, E1000_REG_RDT), tail);
 	}
-	irq_unlock();
+
+	return work;
 }
 
 static irq_return_t e1000_interrupt(unsigned int irq_num, void *dev_id) {
@@ -243,7 +271,9 @@ static irq_return_t e1000_interrupt(unsigned int irq_num, void *dev_id) {
 	irq_return_t ret = IRQ_NONE;
 
 	if (cause & (E1000_REG_ICR_RXO | E1000_REG_ICR_RXT)) {
-		e1000_rx(dev_id);
+		/* Packets are received by the poll until the ring is drained */
+		REG_STORE(e1000_reg(dev_id, E1000_REG_IMC), E1000_RX_INTR);
+		netif_napi_schedule(dev_id);
 		ret = IRQ_HANDLED;
 	}
 
@@ -427,6 +457,7 @@ static int e1000_init(struct pci_slot_dev *pci_dev) {
 	memset(nic_priv, 0, sizeof(*nic_priv));
 	skb_queue_init(&nic_priv->txing_queue);
 	skb_queue_init(&nic_priv->tx_dev_queue);
+	netif_napi_add(nic, e1000_poll, 0);
 
 	res = irq_attach(pci_dev->irq, e1000_interrupt, IF_SHARESUP, nic, "e1000");
 	if (res < 0) {
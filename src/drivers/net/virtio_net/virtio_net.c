@@ -29,6 +29,7 @@
 PCI_DRIVER("virtio", virtio_init, PCI_VENDOR_ID_VIRTIO, PCI_DEV_ID_VIRTIO_NET);
 
 #define MODOPS_PREP_BUFF_CNT OPTION_GET(NUMBER, prep_buff_cnt)
+#define MODOPS_POLL_WEIGHT   OPTION_GET(NUMBER, poll_weight)
 
 struct virtio_priv {
 	struct virtqueue rq;
@@ -62,6 +63,11 @@ static int virtio_xmit(struct net_device *dev, struct sk_buff *skb) {
 	hdr = skb_extra_cast_in(skb_extra);
 	hdr->flags = 0;
 	hdr->gso_type = VIRTIO_NET_HDR_GSO_NONE;
+	if (skb->ip_summed == CHECKSUM_PARTIAL) {
+		hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		hdr->csum_start = skb->csum_start;
+		hdr->csum_offset = skb->csum_offset;
+	}
 
 	sched_lock();
 	{
@@ -84,43 +90,24 @@ static int virtio_xmit(struct net_device *dev, struct sk_buff *skb) {
 	return 0;
 }
 
-static irq_return_t virtio_interrupt(unsigned int irq_num,
-		void *dev_id) {
-	struct net_device *dev;
+static int virtio_poll(struct net_device *dev, int budget) {
 	struct virtqueue *vq;
 	struct vring_used_elem *used_elem;
 	struct sk_buff *skb;
 	struct sk_buff_data *new_data;
 	struct vring_desc *desc, *next;
+	struct virtio_net_hdr *hdr;
+	struct sk_buff_head rx_list;
+	int work;
 
-	dev = dev_id;
-
-	/* it is really? */
-	if (~virtio_net_get_isr_status(dev) & 1) {
-		return IRQ_NONE;
-	}
-
-	/* release outgoing packets */
-	vq = &netdev_priv(dev, struct virtio_priv)->tq;
-	while (vq->last_seen_used != vq->ring.used->idx) {
-		used_elem = &vq->ring.used->ring[vq->last_seen_used % vq->ring.num];
-
-		desc = &vq->ring.desc[used_elem->id];
-		skb_extra_free(skb_extra_cast_out((void *)(uintptr_t)desc->addr));
-		desc->addr = 0;
-		assert(desc->flags & VRING_DESC_F_NEXT);
-
-		next = &vq->ring.desc[desc->next];
-		skb_data_free(skb_data_cast_out((void *)(uintptr_t)next->addr));
-		next->addr = 0;
-		assert(~next->flags & VRING_DESC_F_NEXT);
+	vq = &netdev_priv(dev, struct virtio_priv)->rq;
+	skb_queue_init(&rx_list);
 
-		++vq->last_seen_used;
-	}
+	for (work = 0; work < budget; work++) {
+		if (vq->last_seen_used == vq->ring.used->idx) {
+			break;
+		}
 
-	/* receive incoming packets */
-	vq = &netdev_priv(dev, struct virtio_priv)->rq;
-	while (vq->last_seen_used != vq->ring.used->idx) {
 		used_elem = &vq->ring.used->ring[vq->last_seen_used % vq->ring.num];
 
 		desc = &vq->ring.desc[used_elem->id];
@@ -133,10 +120,28 @@ static irq_return_t virtio_interrupt(unsigned int irq_num,
 				skb_data_cast_out((void *)(uintptr_t)next->addr));
 		if (skb == NULL) {
 			log_error("skb_wrap return NULL");
-			break;
+			dev->stats.rx_dropped++;
+			/* The packet is dropped, its buffer is given back to
+			 * the device */
+			++vq->last_seen_used;
+			vring_push_desc(used_elem->id, &vq->ring);
+			continue;
 		}
 		skb->dev = dev;
-		netif_rx(skb);
+
+		/* Packets from the host or from other guests on the same host
+		 * can have partial checksum, it's valid as well */
+		hdr = (struct virtio_net_hdr *)(uintptr_t)desc->addr;
+		if (hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+			skb->ip_summed = CHECKSUM_PARTIAL;
+			skb->csum_start = hdr->csum_start;
+			skb->csum_offset = hdr->csum_offset;
+		}
+		else if (hdr->flags & VIRTIO_NET_HDR_F_DATA_VALID) {
+			skb->ip_summed = CHECKSUM_UNNECESSARY;
+		}
+
+		__skb_queue_push(&rx_list, skb);
 
 		++vq->last_seen_used;
 
@@ -145,6 +150,8 @@ static irq_return_t virtio_interrupt(unsigned int irq_num,
 			skb_extra_free(skb_extra_cast_out((void *)(uintptr_t)desc->addr));
 			desc->addr = next->addr = 0;
 			log_error("skb_data_alloc return NULL");
+			dev->stats.rx_dropped++;
+			work++;
 			break;
 		}
 
@@ -152,9 +159,69 @@ static irq_return_t virtio_interrupt(unsigned int irq_num,
 		next->addr = (uintptr_t)skb_data_cast_in(new_data);
 
 		vring_push_desc(used_elem->id, &vq->ring);
+	}
+
+	if (work != 0) {
 		virtio_net_notify_queue(VIRTIO_NET_QUEUE_RX, dev);
 	}
 
+	netif_receive_skb_list(&rx_list);
+
+	if (work < budget) {
+		netif_napi_complete(dev);
+
+		vq->ring.avail->flags &= ~VRING_AVAIL_F_NO_INTERRUPT;
+		__sync_synchronize();
+
+		/* A packet could come before the interrupt was enabled */
+		if (vq->last_seen_used != vq->ring.used->idx) {
+			vq->ring.avail->flags |= VRING_AVAIL_F_NO_INTERRUPT;
+			netif_napi_schedule(dev);
+		}
+	}
+
+	return work;
+}
+
+static irq_return_t virtio_interrupt(unsigned int irq_num,
+		void *dev_id) {
+	struct net_device *dev;
+	struct virtqueue *vq;
+	struct vring_used_elem *used_elem;
+	struct vring_desc *desc, *next;
+
+	dev = dev_id;
+
+	/* it is really? */
+	if (~virtio_net_get_isr_status(dev) & 1) {
+		return IRQ_NONE;
+	}
+
+	/* release outgoing packets */
+	vq = &netdev_priv(dev, struct virtio_priv)->tq;
+	while (vq->last_seen_used != vq->ring.used->idx) {
+		used_elem = &vq->ring.used->ring[vq->last_seen_used % vq->ring.num];
+
+		desc = &vq->ring.desc[used_elem->id];
+		skb_extra_free(skb_extra_cast_out((void *)(uintptr_t)desc->addr));
+		desc->addr = 0;
+		assert(desc->flags & VRING_DESC_F_NEXT);
+
+		next = &vq->ring.desc[desc->next];
+		skb_data_free(skb_data_cast_out((void *)(uintptr_t)next->addr));
+		next->addr = 0;
+		assert(~next->flags & VRING_DESC_F_NEXT);
+
+		++vq->last_seen_used;
+	}
+
+	/* receive incoming packets in the poll with the interrupt masked */
+	vq = &netdev_priv(dev, struct virtio_priv)->rq;
+	if (vq->last_seen_used != vq->ring.used->idx) {
+		vq->ring.avail->flags |= VRING_AVAIL_F_NO_INTERRUPT;
+		netif_napi_schedule(dev);
+	}
+
 	return IRQ_HANDLED;
 }
 
@@ -220,6 +287,16 @@ static void virtio_config(struct net_device *dev) {
 		guest_features |= VIRTIO_NET_F_STATUS;
 	}
 
+	/* negotiate checksum offloads */
+	if (virtio_net_has_feature(VIRTIO_NET_F_CSUM, dev)) {
+		dev->features |= NETIF_F_HW_CSUM;
+		guest_features |= VIRTIO_NET_F_CSUM;
+	}
+	if (virtio_net_has_feature(VIRTIO_NET_F_GUEST_CSUM, dev)) {
+		dev->features |= NETIF_F_RXCSUM;
+		guest_features |= VIRTIO_NET_F_GUEST_CSUM;
+	}
+
 	/* finalize guest features bits */
 	virtio_net_set_feature(guest_features, dev);
 }
@@ -340,6 +417,7 @@ static int virtio_init(struct pci_slot_dev *pci_dev) {
 	nic->irq = pci_dev->irq;
 	nic->base_addr = pci_dev->bar[0] & PCI_BASE_ADDR_IO_MASK;
 	nic_priv = netdev_priv(nic, struct virtio_priv);
+	netif_napi_add(nic, virtio_poll, MODOPS_POLL_WEIGHT);
 
 	virtio_config(nic);
 
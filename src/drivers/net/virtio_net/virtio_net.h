@@ -74,6 +74,7 @@
 struct virtio_net_hdr {
 	uint8_t flags;        /* Flags */
 #define VIRTIO_NET_HDR_F_NEEDS_CSUM 0x1
+#define VIRTIO_NET_HDR_F_DATA_VALID 0x2
 	uint8_t gso_type;     /* Type of Generic segmentation
 							 offload (GSO) */
 #define VIRTIO_NET_HDR_GSO_NONE 0x00
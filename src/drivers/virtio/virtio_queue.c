@@ -71,3 +71,52 @@ struct vring_desc * virtqueue_alloc_desc(struct virtqueue *vq) {
 
 	return vrd;
 }
+
+void virtqueue_init_free_list(struct virtqueue *vq) {
+	uint16_t i;
+
+	assert(vq != NULL);
+
+	for (i = 0; i < vq->ring.num - 1; ++i) {
+		vq->ring.desc[i].next = i + 1;
+	}
+	vq->free_head = 0;
+	vq->num_free = vq->ring.num;
+}
+
+int virtqueue_get_chain(struct virtqueue *vq, uint16_t n) {
+	uint16_t head, last, i;
+
+	assert(vq != NULL);
+	assert(n > 0);
+
+	if (vq->num_free < n) {
+		return -1;
+	}
+
+	head = last = vq->free_head;
+	for (i = 1; i < n; ++i) {
+		last = vq->ring.desc[last].next;
+	}
+	vq->free_head = vq->ring.desc[last].next;
+	vq->num_free -= n;
+
+	return head;
+}
+
+void virtqueue_put_chain(struct virtqueue *vq, uint16_t head) {
+	uint16_t last, n;
+
+	assert(vq != NULL);
+
+	last = head;
+	n = 1;
+	while (vq->ring.desc[last].flags & VRING_DESC_F_NEXT) {
+		last = vq->ring.desc[last].next;
+		++n;
+	}
+
+	vq->ring.desc[last].next = vq->free_head;
+	vq->free_head = head;
+	vq->num_free += n;
+}
@@ -25,6 +25,8 @@ struct virtqueue {
 	void *ring_mem;          /* Allocated data for ring storage */
 	uint16_t last_seen_used; /* Last seen used id */
 	uint16_t next_free_desc; /* Next free descriptor id */
+	uint16_t free_head;      /* Free descriptors list, linked by next */
+	uint16_t num_free;       /* Length of free descriptors list */
 };
 
 extern int virtqueue_create(struct virtqueue *vq, uint16_t q_id,
@@ -33,4 +35,21 @@ extern void virtqueue_destroy(struct virtqueue *vq,
 		unsigned long base_addr);
 extern struct vring_desc * virtqueue_alloc_desc(struct virtqueue *vq);
 
+/**
+ * Descriptors can be allocated from a free list instead of round-robin
+ * virtqueue_alloc_desc(), if device uses them out of order.
+ */
+extern void virtqueue_init_free_list(struct virtqueue *vq);
+
+/**
+ * Takes a chain of @a n descriptors linked by @c next fields.
+ * @return Id of the first descriptor or -1 if there is not enough of them
+ */
+extern int virtqueue_get_chain(struct virtqueue *vq, uint16_t n);
+
+/**
+ * Returns chain which starts at @a head and is linked by VRING_DESC_F_NEXT.
+ */
+extern void virtqueue_put_chain(struct virtqueue *vq, uint16_t head);
+
 #endif /* DRIVERS_VIRTIO_VIRTIO_QUEUE_H_ */
@@ -12,6 +12,14 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/**
+ * VirtIO Ring Feature Bits
+ */
+#define VIRTIO_RING_F_INDIRECT_DESC 0x10000000 /* Descriptor can point to a
+												  table of descriptors */
+#define VIRTIO_RING_F_EVENT_IDX     0x20000000 /* Interrupts and notifications
+												  are suppressed by indexes */
+
 /**
  * VirtIO Ring Descriptor Table
  */
@@ -73,6 +81,23 @@ struct vring {
 								  free-running index */
 };
 
+/**
+ * Whether the other side wants an event when index is moved from @a old to
+ * @a new_idx and it has asked for an event at @a event_idx
+ */
+static inline int vring_need_event(uint16_t event_idx, uint16_t new_idx,
+		uint16_t old) {
+	return (uint16_t)(new_idx - event_idx - 1) < (uint16_t)(new_idx - old);
+}
+
+static inline uint16_t vring_get_avail_event(struct vring *vr) {
+	return *(volatile uint16_t *)&vr->used->ring[vr->num];
+}
+
+static inline void vring_set_used_event(struct vring *vr, uint16_t idx) {
+	*(volatile uint16_t *)&vring_used_event(vr) = idx;
+}
+
 extern size_t vring_size(uint16_t num);
 extern void vring_init(struct vring *vr, uint16_t num, void *mem);
 extern void vring_push_desc(uint16_t id, struct vring *vr);
@@ -2,161 +2,818 @@
  * @file
  * @brief Buffer cache
  *
+ * @details Buffers are found by hash table, each bucket has its own lock.
+ *   Replacement queues, list of dirty buffers and statistics are protected
+ *   by bcache_lock, which is taken inside of a bucket lock. Lookup pins
+ *   buffer under bucket lock, so eviction checks under the same lock that
+ *   nobody else has found the buffer.
+ *
  * @author  Alexander Kalmuk
  * @date    22.07.2013
  */
 
+#include <assert.h>
+#include <errno.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
-#include <util/hashtable.h>
+#include <drivers/block_dev.h>
+#include <drivers/block_request.h>
+#include <hal/clock.h>
+#include <kernel/sched/waitq.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
+#include <kernel/thread/waitq.h>
+#include <kernel/time/time.h>
+#include <util/dlist.h>
+#include <util/err.h>
+#include <util/log.h>
 
 #include <mem/misc/pool.h>
+#include <mem/shrinker.h>
 #include <mem/sysmalloc.h>
 
 #include <fs/bcache.h>
 
+#include <framework/mod/options.h>
 
 #include <embox/unit.h>
 EMBOX_UNIT_INIT(bcache_init);
 
-#define BCACHE_SIZE OPTION_GET(NUMBER, bcache_size)
+#define BCACHE_SIZE           OPTION_GET(NUMBER, bcache_size)
+#define BCACHE_BUCKETS        OPTION_GET(NUMBER, hash_buckets)
+/* Buffers in the queue of the first access and recently evicted of them */
+#define BCACHE_FIFO_SIZE      (BCACHE_SIZE * OPTION_GET(NUMBER, a1in_percent) / 100)
+#define BCACHE_GHOSTS         (BCACHE_SIZE * OPTION_GET(NUMBER, a1out_percent) / 100 + 1)
+/* Flusher is woken up above the background limit, writers write back
+ * themselves above the hard one */
+#define BCACHE_DIRTY_BG       \
+	(BCACHE_SIZE * OPTION_GET(NUMBER, dirty_background_percent) / 100)
+#define BCACHE_DIRTY_MAX      (BCACHE_SIZE * OPTION_GET(NUMBER, dirty_percent) / 100)
+#define BCACHE_DIRTY_EXPIRE   OPTION_GET(NUMBER, dirty_expire)
+#define BCACHE_FLUSH_INTERVAL OPTION_GET(NUMBER, flush_interval)
+
+/* Buffers written back by one batch */
+#define BCACHE_FLUSH_BATCH    16
+/* Interval of retries when all buffers are in use */
+#define BCACHE_RETRY_MS       10
+
+struct bcache_bucket {
+	spinlock_t lock;
+	struct dlist_head buffers;
+};
+
+/* Block which was evicted from the fifo queue recently */
+struct bcache_ghost {
+	struct dlist_head hash_lnk;
+	struct dlist_head fifo_lnk;
+	struct block_dev *bdev;
+	int block;
+};
 
 POOL_DEF(buffer_head_pool, struct buffer_head, BCACHE_SIZE);
-static DLIST_DEFINE(bh_list);
-
+POOL_DEF(bcache_ghost_pool, struct bcache_ghost, BCACHE_GHOSTS);
+
+static struct bcache_bucket bcache_ht[BCACHE_BUCKETS];
+
+static spinlock_t bcache_lock = SPIN_STATIC_UNLOCKED;
+static DLIST_DEFINE(bcache_fifo);   /* First access, in order of arrival */
+static DLIST_DEFINE(bcache_lru);    /* Frequent access, from least recent */
+static DLIST_DEFINE(bcache_dirty);  /* In order of modification */
+static DLIST_DEFINE(bcache_ghost_fifo);
+static struct dlist_head bcache_ghost_ht[BCACHE_BUCKETS];
+static int bcache_nr_fifo;
+static int bcache_nr_lru;
+static int bcache_nr_ghosts;
+static int bcache_nr_dirty;
+static int bcache_nr_writeback;
+static struct bcache_stats bcache_stats;
+
+/* Waiters for free buffers and for completion of write back */
+static struct waitq bcache_wq;
+static struct waitq bcache_flusher_wq;
+
+static inline unsigned int bcache_hash(struct block_dev *bdev, int block) {
+	return ((uintptr_t)bdev / sizeof(void *) + block) % BCACHE_BUCKETS;
+}
 
-static size_t bh_hash(void *key);
-static int bh_cmp(void *key1, void *key2);
-HASHTABLE_DEF(bcache_ht, BCACHE_SIZE / 10, bh_hash, bh_cmp);
-POOL_DEF(bcach_ht_item_pool, struct hashtable_item, BCACHE_SIZE);
+static struct buffer_head *bcache_lookup(struct bcache_bucket *b,
+		struct block_dev *bdev, int block) {
+	struct buffer_head *bh;
 
-static struct hashtable *bcache = &bcache_ht;
-static struct mutex bcache_mutex;
-static int graw_buffers(struct block_dev *bdev, int block, size_t size);
-static void free_more_memory(size_t size);
+	dlist_foreach_entry(bh, &b->buffers, bh_next) {
+		if ((bh->bdev == bdev) && (bh->block == block)) {
+			return bh;
+		}
+	}
 
-struct buffer_head *bcache_getblk_locked(struct block_dev *bdev, int block, size_t size) {
-	struct buffer_head key = { .bdev = bdev, .block = block };
-	struct buffer_head *bh;
+	return NULL;
+}
 
-	assert(bdev);
+/* The following functions are called under bcache_lock */
 
-	mutex_lock(&bcache_mutex);
-	while (1) {
-		bh = (struct buffer_head *)hashtable_get(bcache, &key);
+static int bcache_ghost_take(struct block_dev *bdev, int block) {
+	struct bcache_ghost *g;
 
-		if (bh) {
-			assert(size == bh->blocksize);
-			bcache_buffer_lock(bh);
-			mutex_unlock(&bcache_mutex);
-			return bh;
+	dlist_foreach_entry(g, &bcache_ghost_ht[bcache_hash(bdev, block)],
+			hash_lnk) {
+		if ((g->bdev == bdev) && (g->block == block)) {
+			dlist_del(&g->hash_lnk);
+			dlist_del(&g->fifo_lnk);
+			pool_free(&bcache_ghost_pool, g);
+			bcache_nr_ghosts--;
+			return 1;
 		}
+	}
+
+	return 0;
+}
+
+static void bcache_ghost_add(struct block_dev *bdev, int block) {
+	struct bcache_ghost *g;
+
+	g = pool_alloc(&bcache_ghost_pool);
+	if (g == NULL) {
+		/* Forget the oldest one */
+		g = dlist_first_entry_or_null(&bcache_ghost_fifo, struct bcache_ghost,
+				fifo_lnk);
+		assert(g);
+		dlist_del(&g->hash_lnk);
+		dlist_del(&g->fifo_lnk);
+	} else {
+		bcache_nr_ghosts++;
+	}
+
+	dlist_head_init(&g->hash_lnk);
+	dlist_head_init(&g->fifo_lnk);
+	g->bdev = bdev;
+	g->block = block;
+	dlist_add_prev(&g->hash_lnk, &bcache_ghost_ht[bcache_hash(bdev, block)]);
+	dlist_add_prev(&g->fifo_lnk, &bcache_ghost_fifo);
+}
+
+static void bcache_queue_add(struct buffer_head *bh) {
+	if (bh->flags & BH_HOT) {
+		dlist_add_prev(&bh->lru_lnk, &bcache_lru);
+		bcache_nr_lru++;
+	} else {
+		dlist_add_prev(&bh->lru_lnk, &bcache_fifo);
+		bcache_nr_fifo++;
+	}
+}
+
+static void bcache_queue_del(struct buffer_head *bh) {
+	dlist_del_init(&bh->lru_lnk);
+	if (bh->flags & BH_HOT) {
+		bcache_nr_lru--;
+	} else {
+		bcache_nr_fifo--;
+	}
+}
+
+static struct buffer_head *bcache_queue_victim(struct dlist_head *queue,
+		int clean_only) {
+	struct buffer_head *bh;
 
-		while (-1 == graw_buffers(bdev, block, size)) {
-			free_more_memory(size);
+	dlist_foreach_entry(bh, queue, lru_lnk) {
+		if (buffer_locked(bh) || buffer_journal(bh)) {
+			continue;
+		}
+		if (clean_only && buffer_dirty(bh)) {
+			continue;
 		}
+		return bh;
 	}
-	mutex_unlock(&bcache_mutex);
 
-	assert(0); /* UNREACHABLE */
 	return NULL;
 }
 
-static void free_more_memory(size_t size) {
+/**
+ * Finds buffer to evict: the oldest one of the fifo if it's full, else the
+ * least recently used one. Buffer is removed from queues and pinned.
+ */
+static struct buffer_head *bcache_pick_victim(int clean_only) {
+	struct dlist_head *first, *second;
 	struct buffer_head *bh;
-	struct hashtable_item *ht_item;
 
-	/* Free everything that we can free */
-	dlist_foreach_entry(bh, &bh_list, bh_next) {
-		if (buffer_locked(bh)) {
+	if ((bcache_nr_fifo > BCACHE_FIFO_SIZE) || (bcache_nr_lru == 0)) {
+		first = &bcache_fifo;
+		second = &bcache_lru;
+	} else {
+		first = &bcache_lru;
+		second = &bcache_fifo;
+	}
+
+	bh = bcache_queue_victim(first, clean_only);
+	if (bh == NULL) {
+		bh = bcache_queue_victim(second, clean_only);
+	}
+	if (bh == NULL) {
+		return NULL;
+	}
+
+	bcache_queue_del(bh);
+	if (!dlist_empty(&bh->dirty_lnk)) {
+		/* It will be written back by evicting thread */
+		dlist_del_init(&bh->dirty_lnk);
+		bcache_nr_dirty--;
+	}
+	bcache_buffer_pin(bh, 1);
+
+	return bh;
+}
+
+/* Device blocks of buffer */
+static inline blkno_t bcache_bh_blkno(struct buffer_head *bh) {
+	return (blkno_t)bh->block * bh->blocksize / bh->bdev->block_size;
+}
+
+static inline size_t bcache_bh_nblocks(struct buffer_head *bh) {
+	return (bh->blocksize + bh->bdev->block_size - 1) / bh->bdev->block_size;
+}
+
+/**
+ * Writes locked buffers of one device and marks them clean, or dirty again
+ * if writing failed. Buffers are taken from the dirty list and pinned.
+ */
+static int bcache_write_buffers(struct buffer_head **bh, int n) {
+	struct block_bio bio[BCACHE_FLUSH_BATCH];
+	struct block_bio_batch batch;
+	struct block_dev *bdev;
+	int res, i;
+	ipl_t ipl;
+
+	assert(n <= BCACHE_FLUSH_BATCH);
+
+	bdev = bh[0]->bdev;
+
+	/**
+	 * Blocks are stored in the buffer cache in a decrypted state.
+	 * Therefore first we encrypt blocks, then write them onto disk and
+	 * then decrypt blocks.
+	 */
+	block_bio_batch_init(&batch);
+	block_queue_plug(bdev);
+	for (i = 0; i < n; i++) {
+		assert(bh[i]->bdev == bdev);
+		buffer_encrypt(bh[i]);
+
+		bio[i].op = BLOCK_REQ_WRITE;
+		bio[i].blkno = bcache_bh_blkno(bh[i]);
+		bio[i].nblocks = bcache_bh_nblocks(bh[i]);
+		bio[i].buf = bh[i]->data;
+		block_bio_batch_submit(bdev, &batch, &bio[i]);
+	}
+	block_queue_unplug(bdev);
+
+	res = block_bio_batch_wait(&batch);
+	for (i = 0; i < n; i++) {
+		buffer_decrypt(bh[i]);
+	}
+
+	ipl = spin_lock_ipl(&bcache_lock);
+	{
+		for (i = 0; i < n; i++) {
+			if (res == 0) {
+				buffer_clear_flag(bh[i], BH_DIRTY);
+			} else if (dlist_empty(&bh[i]->dirty_lnk)) {
+				dlist_add_prev(&bh[i]->dirty_lnk, &bcache_dirty);
+				bcache_nr_dirty++;
+			}
+		}
+		if (res == 0) {
+			bcache_stats.writebacks += n;
+		}
+	}
+	spin_unlock_ipl(&bcache_lock, ipl);
+
+	if (res != 0) {
+		log_error("write back of %d blocks from %d failed: %d", n,
+				bh[0]->block, res);
+	}
+
+	return res;
+}
+
+/**
+ * Writes back a batch of the oldest dirty buffers of @a bdev, or of any
+ * device if it's NULL.
+ * @return Number of written buffers
+ */
+static int bcache_writeback(struct block_dev *bdev, int expired_only,
+		int *err) {
+	struct buffer_head *bh[BCACHE_FLUSH_BATCH];
+	struct buffer_head *b;
+	clock_t now;
+	int res, i, k, n;
+	ipl_t ipl;
+
+	now = clock_sys_ticks();
+	n = 0;
+
+	ipl = spin_lock_ipl(&bcache_lock);
+	{
+		dlist_foreach_entry(b, &bcache_dirty, dirty_lnk) {
+			if (n == BCACHE_FLUSH_BATCH) {
+				break;
+			}
+			if (expired_only && (jiffies2ms(now - b->dirty_since)
+						< BCACHE_DIRTY_EXPIRE)) {
+				break;
+			}
+			if ((bdev != NULL) ? (b->bdev != bdev)
+					: ((n != 0) && (b->bdev != bh[0]->bdev))) {
+				continue;
+			}
+
+			/* Buffer stays dirty until it's written */
+			dlist_del_init(&b->dirty_lnk);
+			bcache_nr_dirty--;
+			bcache_buffer_pin(b, 1);
+			bh[n++] = b;
+		}
+		bcache_nr_writeback += n;
+	}
+	spin_unlock_ipl(&bcache_lock, ipl);
+
+	if (n == 0) {
+		return 0;
+	}
+
+	/* Buffers may be locked by writer in any order, so only the first one
+	 * is waited for, and the busy others are left for the next batch */
+	mutex_lock(&bh[0]->mutex);
+	for (i = 1, k = 1; i < n; i++) {
+		if (0 == mutex_trylock(&bh[i]->mutex)) {
+			bh[k++] = bh[i];
 			continue;
 		}
 
-		bcache_buffer_lock(bh);
+		ipl = spin_lock_ipl(&bcache_lock);
 		{
-			if (buffer_journal(bh)) {
-				bcache_buffer_unlock(bh);
+			dlist_add_next(&bh[i]->dirty_lnk, &bcache_dirty);
+			bcache_nr_dirty++;
+			bcache_nr_writeback--;
+		}
+		spin_unlock_ipl(&bcache_lock, ipl);
+		bcache_buffer_pin(bh[i], -1);
+	}
+	n = k;
+
+	res = bcache_write_buffers(bh, n);
+	if ((res != 0) && (err != NULL) && (*err == 0)) {
+		*err = res;
+	}
+
+	for (i = 0; i < n; i++) {
+		bcache_buffer_unlock(bh[i]);
+	}
+
+	ipl = spin_lock_ipl(&bcache_lock);
+	{
+		bcache_nr_writeback -= n;
+	}
+	spin_unlock_ipl(&bcache_lock, ipl);
+	waitq_wakeup_all(&bcache_wq);
+
+	return res == 0 ? n : 0;
+}
+
+/**
+ * Removes pinned @a bh from the cache, it's written back if it's dirty
+ * unless @a nowait is set. Mutex of dirty buffer isn't waited for, as its
+ * holder may wait for the caller, the buffer is requeued instead.
+ * @return Zero or error if buffer is used or can't be written
+ */
+static int bcache_evict(struct buffer_head *bh, int nowait) {
+	struct bcache_bucket *b;
+	int res;
+	ipl_t ipl;
+
+	if (buffer_dirty(bh) && !nowait && (0 == mutex_trylock(&bh->mutex))) {
+		bcache_write_buffers(&bh, 1);
+		mutex_unlock(&bh->mutex);
+	}
+
+	b = &bcache_ht[bcache_hash(bh->bdev, bh->block)];
+
+	ipl = spin_lock_ipl(&b->lock);
+	spin_lock(&bcache_lock);
+	{
+		if ((bh->lock_count != 1) || buffer_dirty(bh)) {
+			/* It was found or written again, or writing failed */
+			res = -EBUSY;
+			if (buffer_dirty(bh) && dlist_empty(&bh->dirty_lnk)) {
+				/* It was taken off the dirty list by
+				 * bcache_pick_victim() and isn't written */
+				dlist_add_next(&bh->dirty_lnk, &bcache_dirty);
+				bcache_nr_dirty++;
+			}
+			bcache_buffer_pin(bh, -1);
+			bcache_queue_add(bh);
+		} else {
+			res = 0;
+			dlist_del_init(&bh->bh_next);
+			if (!(bh->flags & BH_HOT) && (BCACHE_FIFO_SIZE != 0)) {
+				bcache_ghost_add(bh->bdev, bh->block);
+			}
+			bcache_stats.evictions++;
+		}
+	}
+	spin_unlock(&bcache_lock);
+	spin_unlock_ipl(&b->lock, ipl);
+
+	return res;
+}
+
+static void bcache_free(struct buffer_head *bh) {
+	ipl_t ipl;
+
+	sysfree(bh->data);
+
+	ipl = spin_lock_ipl(&bcache_lock);
+	{
+		pool_free(&buffer_head_pool, bh);
+	}
+	spin_unlock_ipl(&bcache_lock, ipl);
+}
+
+/**
+ * Allocates buffer with data of @a size, evicting another one if the cache
+ * is full. With @a nowait only clean buffer can be evicted.
+ */
+static struct buffer_head *bcache_alloc(size_t size, int nowait) {
+	struct buffer_head *bh;
+	int need_evict;
+	ipl_t ipl;
+
+	need_evict = 0;
+	while (1) {
+		ipl = spin_lock_ipl(&bcache_lock);
+		{
+			bh = need_evict ? NULL : pool_alloc(&buffer_head_pool);
+			if (bh != NULL) {
+				memset(bh, 0, sizeof(struct buffer_head));
+				mutex_init(&bh->mutex);
+				dlist_head_init(&bh->bh_next);
+				dlist_head_init(&bh->lru_lnk);
+				dlist_head_init(&bh->dirty_lnk);
+			} else {
+				bh = bcache_pick_victim(nowait);
+			}
+		}
+		spin_unlock_ipl(&bcache_lock, ipl);
+
+		if (bh == NULL) {
+			if (nowait) {
+				return NULL;
+			}
+			/* All buffers are in use, wait until some of them are
+			 * written back or unlocked */
+			waitq_wakeup_all(&bcache_flusher_wq);
+			WAITQ_WAIT_TIMEOUT(&bcache_wq, 0, BCACHE_RETRY_MS);
+			continue;
+		}
+
+		if (bh->data != NULL) {
+			if (0 != bcache_evict(bh, nowait)) {
+				if (nowait) {
+					return NULL;
+				}
 				continue;
 			}
+			if (bh->blocksize == size) {
+				return bh;
+			}
+			sysfree(bh->data);
+		}
+
+		bh->data = sysmalloc(size); /* TODO kmalloc */
+		if (bh->data != NULL) {
+			return bh;
+		}
+
+		/* Memory can be freed only by eviction of another buffer */
+		ipl = spin_lock_ipl(&bcache_lock);
+		{
+			pool_free(&buffer_head_pool, bh);
+		}
+		spin_unlock_ipl(&bcache_lock, ipl);
+		if (nowait) {
+			return NULL;
+		}
+		need_evict = 1;
+	}
+}
+
+static struct buffer_head *bcache_getblk(struct block_dev *bdev, int block,
+		size_t size, int readahead) {
+	struct bcache_bucket *b;
+	struct buffer_head *bh, *new;
+	int found;
+	ipl_t ipl;
+
+	assert(bdev);
 
-			if (buffer_dirty(bh)) {
-				assert(bh->bdev && bh->bdev->driver);
-				assert(bh->bdev->driver->write);
-				/* Write directly to disk */
-				bh->bdev->driver->write(bh->bdev, bh->data, bh->blocksize, bh->block);
+	b = &bcache_ht[bcache_hash(bdev, block)];
+	new = NULL;
+
+	while (1) {
+		ipl = spin_lock_ipl(&b->lock);
+		{
+			bh = bcache_lookup(b, bdev, block);
+			found = (bh != NULL);
+			if (found) {
+				bcache_buffer_pin(bh, 1);
+			} else if (new != NULL) {
+				bh = new;
+				new = NULL;
+
+				bh->bdev = bdev;
+				bh->block = block;
+				bh->blocksize = size;
+				bh->flags = BH_NEW;
+				bh->lock_count = 1;
+				bh->journal_block = NULL;
+				dlist_add_prev(&bh->bh_next, &b->buffers);
+
+				spin_lock(&bcache_lock);
+				{
+					/* Block which is accessed again after eviction from
+					 * the fifo is used frequently */
+					if ((BCACHE_FIFO_SIZE == 0)
+							|| bcache_ghost_take(bdev, block)) {
+						bh->flags |= BH_HOT;
+					}
+					bcache_queue_add(bh);
+					if (readahead) {
+						bh->flags |= BH_RA;
+						bcache_stats.readahead++;
+					} else {
+						bcache_stats.misses++;
+					}
+				}
+				spin_unlock(&bcache_lock);
 			}
+		}
+		spin_unlock_ipl(&b->lock, ipl);
 
-			dlist_del(&bh->bh_next);
-			ht_item = hashtable_del(bcache, bh);
+		if (bh != NULL) {
+			break;
 		}
-		bcache_buffer_unlock(bh);
 
-		sysfree(bh->data);
-		pool_free(&bcach_ht_item_pool, ht_item);
-		pool_free(&buffer_head_pool, bh);
+		new = bcache_alloc(size, readahead);
+		if (new == NULL) {
+			return NULL;
+		}
+		/* Buffer is locked before anyone can find it */
+		mutex_lock(&new->mutex);
+	}
+
+	if (new != NULL) {
+		/* Block was added while buffer was allocated */
+		mutex_unlock(&new->mutex);
+		bcache_free(new);
+	}
+
+	if (!found) {
+		return bh;
+	}
+
+	if (readahead) {
+		bcache_buffer_pin(bh, -1);
+		return NULL;
+	}
+
+	assert(size == bh->blocksize);
+
+	/* Buffer is pinned before it's waited for, so the cache isn't
+	 * locked while owner of the buffer may need it */
+	mutex_lock(&bh->mutex);
+
+	ipl = spin_lock_ipl(&bcache_lock);
+	{
+		bcache_stats.hits++;
+		if (bh->flags & BH_RA) {
+			buffer_clear_flag(bh, BH_RA);
+			bcache_stats.readahead_hits++;
+		}
+		if ((bh->flags & BH_HOT) && !dlist_empty(&bh->lru_lnk)) {
+			dlist_del_init(&bh->lru_lnk);
+			dlist_add_prev(&bh->lru_lnk, &bcache_lru);
+		}
 	}
+	spin_unlock_ipl(&bcache_lock, ipl);
+
+	return bh;
 }
 
-static int graw_buffers(struct block_dev *bdev, int block, size_t size) {
-	struct buffer_head *bh;
-	struct hashtable_item *ht_item;
+struct buffer_head *bcache_getblk_locked(struct block_dev *bdev, int block, size_t size) {
+	return bcache_getblk(bdev, block, size, 0);
+}
 
-	bh = pool_alloc(&buffer_head_pool);
+struct buffer_head *bcache_getblk_new(struct block_dev *bdev, int block, size_t size) {
+	return bcache_getblk(bdev, block, size, 1);
+}
 
-	if (!bh) {
-		return -1;
+void bcache_mark_dirty(struct buffer_head *bh) {
+	int wake;
+	ipl_t ipl;
+
+	assert(buffer_locked(bh));
+
+	ipl = spin_lock_ipl(&bcache_lock);
+	{
+		/* Buffer which is being written back is written with the
+		 * modification, as it's locked by writer */
+		if (!buffer_dirty(bh)) {
+			buffer_set_flag(bh, BH_DIRTY);
+			bh->dirty_since = clock_sys_ticks();
+			dlist_add_prev(&bh->dirty_lnk, &bcache_dirty);
+			bcache_nr_dirty++;
+		}
+		wake = (bcache_nr_dirty > BCACHE_DIRTY_BG);
 	}
+	spin_unlock_ipl(&bcache_lock, ipl);
 
-	memset(bh, 0, sizeof(struct buffer_head));
+	if (wake) {
+		waitq_wakeup_all(&bcache_flusher_wq);
+	}
+}
 
-	buffer_set_flag(bh, BH_NEW);
-	mutex_init(&bh->mutex);
-	dlist_head_init(&bh->bh_next);
-	bh->bdev = bdev;
-	bh->block = block;
-	bh->blocksize = size;
-	bh->data = sysmalloc(size); /* TODO kmalloc */
+void bcache_balance_dirty(void) {
+	while ((bcache_nr_dirty > BCACHE_DIRTY_MAX)
+			&& (0 != bcache_writeback(NULL, 0, NULL))) {
+	}
+}
 
-	if (!bh->data) {
-		pool_free(&buffer_head_pool, bh);
-		return -1;
+int bcache_flush_blkdev(struct block_dev *bdev) {
+	int err;
+
+	err = 0;
+	while (0 != bcache_writeback(bdev, 0, &err)) {
 	}
-	ht_item = pool_alloc(&bcach_ht_item_pool);
-	if (!ht_item) {
-		sysfree(bh->data);
-		pool_free(&buffer_head_pool, bh);
-		return -1;
+
+	/* Buffers which are being written back by others */
+	WAITQ_WAIT(&bcache_wq, bcache_nr_writeback == 0);
+
+	return err;
+}
+
+void bcache_invalidate_blkdev(struct block_dev *bdev) {
+	struct bcache_ghost *g;
+	struct buffer_head *bh;
+	int i;
+	ipl_t ipl;
+
+	bcache_flush_blkdev(bdev);
+
+	for (i = 0; i < BCACHE_BUCKETS; i++) {
+		ipl = spin_lock_ipl(&bcache_ht[i].lock);
+		spin_lock(&bcache_lock);
+		{
+			dlist_foreach_entry(bh, &bcache_ht[i].buffers, bh_next) {
+				if (bh->bdev != bdev) {
+					continue;
+				}
+				assert(!buffer_locked(bh));
+
+				dlist_del_init(&bh->bh_next);
+				bcache_queue_del(bh);
+				if (!dlist_empty(&bh->dirty_lnk)) {
+					/* Writing has failed, data is lost */
+					dlist_del_init(&bh->dirty_lnk);
+					bcache_nr_dirty--;
+				}
+				sysfree(bh->data);
+				pool_free(&buffer_head_pool, bh);
+			}
+
+			dlist_foreach_entry(g, &bcache_ghost_ht[i], hash_lnk) {
+				if (g->bdev == bdev) {
+					dlist_del(&g->hash_lnk);
+					dlist_del(&g->fifo_lnk);
+					pool_free(&bcache_ghost_pool, g);
+					bcache_nr_ghosts--;
+				}
+			}
+		}
+		spin_unlock(&bcache_lock);
+		spin_unlock_ipl(&bcache_ht[i].lock, ipl);
 	}
-	ht_item = hashtable_item_init(ht_item, bh, bh);
-	hashtable_put(bcache, ht_item);
+}
 
-	dlist_add_next(&bh->bh_next, &bh_list);
+/* Clean buffers which aren't in use are dropped on memory shortage */
+static inline int bcache_reclaimable(struct buffer_head *bh) {
+	return !buffer_locked(bh) && !buffer_journal(bh) && !buffer_dirty(bh);
+}
 
-	return 0;
+static size_t bcache_shrink_count(void) {
+	struct buffer_head *bh;
+	size_t cnt;
+	ipl_t ipl;
+
+	cnt = 0;
+	ipl = spin_lock_ipl(&bcache_lock);
+	{
+		dlist_foreach_entry(bh, &bcache_fifo, lru_lnk) {
+			cnt += bcache_reclaimable(bh);
+		}
+		dlist_foreach_entry(bh, &bcache_lru, lru_lnk) {
+			cnt += bcache_reclaimable(bh);
+		}
+	}
+	spin_unlock_ipl(&bcache_lock, ipl);
+
+	return cnt;
 }
 
-static size_t bh_hash(void *key) {
-	return ((struct buffer_head *)key)->block;
+static size_t bcache_shrink_scan(size_t nr) {
+	struct buffer_head *bh;
+	size_t freed;
+	ipl_t ipl;
+
+	for (freed = 0; freed < nr; freed++) {
+		ipl = spin_lock_ipl(&bcache_lock);
+		{
+			bh = bcache_pick_victim(1);
+		}
+		spin_unlock_ipl(&bcache_lock, ipl);
+
+		if (bh == NULL) {
+			break;
+		}
+		/* Buffer is pinned clean. If it was found and modified since, it's
+		 * requeued instead of writing */
+		if (0 != bcache_evict(bh, 1)) {
+			break;
+		}
+		bcache_free(bh);
+	}
+
+	if (freed != 0) {
+		waitq_wakeup_all(&bcache_wq);
+	}
+
+	return freed;
 }
 
-static int bh_cmp(void *key1, void *key2) {
-	struct buffer_head *bh1 = (struct buffer_head *)key1;
-	struct buffer_head *bh2 = (struct buffer_head *)key2;
-	int cmp_bdev;
+SHRINKER_DEF("bcache", SHRINK_HEAP, bcache_shrink_count, bcache_shrink_scan);
 
-	cmp_bdev = bh1->bdev < bh2->bdev ? -1 : bh1->bdev > bh2->bdev;
-	if (!cmp_bdev) {
-		return (bh1->block < bh2->block ? -1 : bh1->block > bh2->block);
+void bcache_get_stats(struct bcache_stats *stats) {
+	ipl_t ipl;
+
+	assert(stats);
+
+	ipl = spin_lock_ipl(&bcache_lock);
+	{
+		*stats = bcache_stats;
+		stats->capacity = BCACHE_SIZE;
+		stats->fifo = bcache_nr_fifo;
+		stats->lru = bcache_nr_lru;
+		stats->ghosts = bcache_nr_ghosts;
+		stats->dirty = bcache_nr_dirty;
 	}
+	spin_unlock_ipl(&bcache_lock, ipl);
+}
 
-	return cmp_bdev;
+static void *bcache_flusher(void *arg) {
+	while (1) {
+		WAITQ_WAIT_TIMEOUT(&bcache_flusher_wq,
+				bcache_nr_dirty > BCACHE_DIRTY_BG, BCACHE_FLUSH_INTERVAL);
+
+		/* Too many dirty buffers, the oldest ones are written at first */
+		while ((bcache_nr_dirty > BCACHE_DIRTY_BG / 2)
+				&& (0 != bcache_writeback(NULL, 0, NULL))) {
+		}
+
+		while (0 != bcache_writeback(NULL, 1, NULL)) {
+		}
+	}
+
+	return NULL;
 }
 
 static int bcache_init(void) {
+	struct thread *t;
+	int i;
+
+	for (i = 0; i < BCACHE_BUCKETS; i++) {
+		bcache_ht[i].lock = SPIN_UNLOCKED;
+		dlist_init(&bcache_ht[i].buffers);
+		dlist_init(&bcache_ghost_ht[i]);
+	}
+
+	waitq_init(&bcache_wq);
+	waitq_init(&bcache_flusher_wq);
 
-	mutex_init(&bcache_mutex);
+	t = thread_create(THREAD_FLAG_DETACHED, bcache_flusher, NULL);
+	if (err(t)) {
+		log_error("couldn't create flusher thread: %d", err(t));
+		return err(t);
+	}
 
 	return 0;
 }
@@ -232,12 +232,14 @@ static struct idesc *fatfs_open(struct node *node, struct file_desc *file_desc,
 static int    fatfs_close(struct file_desc *desc);
 static size_t fatfs_read(struct file_desc *desc, void *buf, size_t size);
 static size_t fatfs_write(struct file_desc *desc, void *buf, size_t size);
+static int    fatfs_fsync(struct file_desc *desc);
 
 static struct kfile_operations fatfs_fop = {
 	.open = fatfs_open,
 	.close = fatfs_close,
 	.read = fatfs_read,
 	.write = fatfs_write,
+	.fsync = fatfs_fsync,
 };
 
 /*
@@ -267,6 +269,10 @@ static int fatfs_close(struct file_desc *desc) {
 	return 0;
 }
 
+static int fatfs_fsync(struct file_desc *desc) {
+	return block_dev_sync(desc->node->nas->fs->bdev);
+}
+
 static size_t fatfs_read(struct file_desc *desc, void *buf, size_t size) {
 	size_t rezult;
 	uint32_t bytecount;
@@ -103,12 +103,14 @@ static struct idesc *tmpfs_open(struct node *node, struct file_desc *file_desc,
 static int    tmpfs_close(struct file_desc *desc);
 static size_t tmpfs_read(struct file_desc *desc, void *buf, size_t size);
 static size_t tmpfs_write(struct file_desc *desc, void *buf, size_t size);
+static int    tmpfs_fsync(struct file_desc *desc);
 
 static struct kfile_operations tmpfs_fop = {
 	.open = tmpfs_open,
 	.close = tmpfs_close,
 	.read = tmpfs_read,
 	.write = tmpfs_write,
+	.fsync = tmpfs_fsync,
 };
 
 /*
@@ -123,6 +125,10 @@ static int tmpfs_close(struct file_desc *desc) {
 	return 0;
 }
 
+static int tmpfs_fsync(struct file_desc *desc) {
+	return block_dev_sync(desc->node->nas->fs->bdev);
+}
+
 static int tmpfs_read_sector(struct nas *nas, char *buffer,
 		uint32_t count, uint32_t sector) {
 	struct tmpfs_fs_info *fsi;
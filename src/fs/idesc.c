@@ -25,6 +25,7 @@ int idesc_init(struct idesc *idesc, const struct idesc_ops *ops, mode_t amode) {
 	idesc->idesc_xattrops = NULL;
 
 	waitq_init(&idesc->idesc_waitq);
+	dlist_init(&idesc->idesc_hooks);
 
 	return 0;
 }
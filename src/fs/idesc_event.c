@@ -13,9 +13,13 @@
 #include <fs/idesc.h>
 #include <fcntl.h>
 #include <kernel/sched.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread/sync/mutex.h>
 
 #include <fs/idesc_event.h>
 
+static struct mutex idesc_hook_mutex = MUTEX_INIT(idesc_hook_mutex);
+
 int idesc_wait_prepare(struct idesc *i, struct idesc_wait_link *wl) {
 
 	waitq_wait_prepare(&i->idesc_waitq, &wl->link);
@@ -28,13 +32,74 @@ int idesc_wait_prepare(struct idesc *i, struct idesc_wait_link *wl) {
 }
 
 int idesc_notify(struct idesc *idesc, int mask) {
+	struct idesc_event_hook *hook;
+	ipl_t ipl;
 
 	//TODO MASK
 	waitq_wakeup(&idesc->idesc_waitq, 0);
 
+	/* Hooks list is protected by the lock of wait queue */
+	ipl = spin_lock_ipl(&idesc->idesc_waitq.lock);
+	{
+		dlist_foreach_entry(hook, &idesc->idesc_hooks, lnk) {
+			hook->notify(hook, idesc, mask);
+		}
+	}
+	spin_unlock_ipl(&idesc->idesc_waitq.lock, ipl);
+
 	return 0;
 }
 
 void idesc_wait_cleanup(struct idesc *i, struct idesc_wait_link *wl) {
 	waitq_wait_cleanup(&i->idesc_waitq, &wl->link);
 }
+
+void idesc_event_lock(void) {
+	mutex_lock(&idesc_hook_mutex);
+}
+
+void idesc_event_unlock(void) {
+	mutex_unlock(&idesc_hook_mutex);
+}
+
+void idesc_event_hook_add(struct idesc *idesc, struct idesc_event_hook *hook) {
+	ipl_t ipl;
+
+	dlist_head_init(&hook->lnk);
+
+	ipl = spin_lock_ipl(&idesc->idesc_waitq.lock);
+	{
+		dlist_add_prev(&hook->lnk, &idesc->idesc_hooks);
+	}
+	spin_unlock_ipl(&idesc->idesc_waitq.lock, ipl);
+}
+
+void idesc_event_hook_del(struct idesc *idesc, struct idesc_event_hook *hook) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&idesc->idesc_waitq.lock);
+	{
+		dlist_del_init(&hook->lnk);
+	}
+	spin_unlock_ipl(&idesc->idesc_waitq.lock, ipl);
+}
+
+void idesc_event_release(struct idesc *idesc) {
+	struct idesc_event_hook *hook;
+	ipl_t ipl;
+
+	idesc_event_lock();
+	while (!dlist_empty(&idesc->idesc_hooks)) {
+		ipl = spin_lock_ipl(&idesc->idesc_waitq.lock);
+		{
+			hook = dlist_first_entry(&idesc->idesc_hooks,
+					struct idesc_event_hook, lnk);
+			dlist_del_init(&hook->lnk);
+		}
+		spin_unlock_ipl(&idesc->idesc_waitq.lock, ipl);
+
+		/* Owner can free the hook now */
+		hook->notify(hook, idesc, POLLNVAL);
+	}
+	idesc_event_unlock();
+}
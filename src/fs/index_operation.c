@@ -63,6 +63,12 @@ static int idesc_file_ops_ioctl(struct idesc *idesc, int request, void *data) {
 	return kioctl((struct file_desc *)idesc, request, data);
 }
 
+static int idesc_file_ops_fsync(struct idesc *idesc) {
+	assert(idesc);
+
+	return kfsync((struct file_desc *)idesc);
+}
+
 static int idesc_file_ops_status(struct idesc *idesc, int mask) {
 	assert(idesc);
 
@@ -76,5 +82,6 @@ const struct idesc_ops idesc_file_ops = {
 	.ioctl = idesc_file_ops_ioctl,
 	.fstat = idesc_file_ops_stat,
 	.status = idesc_file_ops_status,
+	.fsync = idesc_file_ops_fsync,
 };
 
@@ -216,6 +216,18 @@ int kioctl(struct file_desc *desc, int request, void *data) {
 	return 0;
 }
 
+int kfsync(struct file_desc *desc) {
+	if (NULL == desc) {
+		return -EBADF;
+	}
+
+	if (NULL == desc->ops->fsync) {
+		return 0;
+	}
+
+	return desc->ops->fsync(desc);
+}
+
 int kftruncate(struct file_desc *desc, off_t length) {
 	int ret;
 
@@ -38,6 +38,10 @@ int kioctl(struct file_desc *fp, int request, void *data) {
 	return -ENOSYS;
 }
 
+int kfsync(struct file_desc *fp) {
+	return -ENOSYS;
+}
+
 struct node;
 
 int ktruncate(struct node *node, off_t length) {
@@ -2,6 +2,12 @@
  * @file
  * @brief Buffer cache
  *
+ * @details Buffers are replaced by 2Q policy: a buffer is placed to the
+ *   FIFO queue on the first access, and only if it's accessed again after
+ *   it was evicted from the FIFO, it's placed to the LRU queue of frequently
+ *   used buffers. So one pass over a big file doesn't evict the working set.
+ *   Dirty buffers are written back by the flusher thread.
+ *
  * @author  Alexander Kalmuk
  * @date    22.07.2013
  */
@@ -11,13 +17,19 @@
 
 #include <fs/buffer_head.h>
 
+/* Buffer is pinned by lock count before its mutex is taken. Pins are
+ * taken under different locks, so the count is changed atomically */
+static inline void bcache_buffer_pin(struct buffer_head *bh, int cnt) {
+	__atomic_fetch_add(&bh->lock_count, cnt, __ATOMIC_SEQ_CST);
+}
+
 static inline void bcache_buffer_lock(struct buffer_head *bh) {
+	bcache_buffer_pin(bh, 1);
 	mutex_lock(&bh->mutex);
-	bh->lock_count++;
 }
 
 static inline void bcache_buffer_unlock(struct buffer_head *bh) {
-	bh->lock_count--;
+	bcache_buffer_pin(bh, -1);
 	mutex_unlock(&bh->mutex);
 }
 
@@ -28,4 +40,50 @@ static inline void bcache_buffer_unlock(struct buffer_head *bh) {
  */
 extern struct buffer_head *bcache_getblk_locked(struct block_dev *bdev, int block, size_t size);
 
+/**
+ * Like bcache_getblk_locked(), but for read-ahead: never waits.
+ * @return
+ *   Locked new buffer or NULL if the block is already cached or there is
+ *   no buffer which can be reused at once.
+ */
+extern struct buffer_head *bcache_getblk_new(struct block_dev *bdev, int block, size_t size);
+
+/**
+ * Marks locked buffer as modified, it will be written back by the flusher.
+ */
+extern void bcache_mark_dirty(struct buffer_head *bh);
+
+/**
+ * Writes back dirty buffers in the context of caller if there are too many
+ * of them. Called by writers without locked buffers.
+ */
+extern void bcache_balance_dirty(void);
+
+/**
+ * Writes back all dirty buffers of @a bdev, or of all devices if it's NULL.
+ * @return Zero or the first error of write
+ */
+extern int bcache_flush_blkdev(struct block_dev *bdev);
+
+/**
+ * Writes back and drops all buffers of @a bdev, which is going to be freed.
+ */
+extern void bcache_invalidate_blkdev(struct block_dev *bdev);
+
+struct bcache_stats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	unsigned long writebacks;
+	unsigned long readahead;    /* Buffers read ahead */
+	unsigned long readahead_hits;
+	int capacity;
+	int fifo;                   /* Buffers in the queue of the first access */
+	int lru;                    /* Buffers in the queue of frequent access */
+	int ghosts;                 /* Blocks recently evicted from the fifo */
+	int dirty;
+};
+
+extern void bcache_get_stats(struct bcache_stats *stats);
+
 #endif /* FS_BCACHE_H_ */
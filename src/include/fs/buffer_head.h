@@ -9,6 +9,7 @@
 #ifndef FS_BUFFER_HEAD_H_
 #define FS_BUFFER_HEAD_H_
 
+#include <sys/types.h>
 #include <util/dlist.h>
 #include <kernel/thread/sync/mutex.h>
 #include <drivers/block_dev.h>
@@ -17,6 +18,8 @@
 #define BH_NEW     0x00000001
 #define BH_DIRTY   0x00000002
 #define BH_JOURNAL 0x00000004
+#define BH_HOT     0x00000008 /* In the queue of frequently used buffers */
+#define BH_RA      0x00000010 /* Read ahead and not used yet */
 
 #define buffer_new(bh) (bh->flags & BH_NEW)
 #define buffer_locked(bh) (bh->lock_count)
@@ -35,7 +38,10 @@ struct buffer_head {
 	size_t blocksize;               /* size of mapping */
 	int flags;                      /* buffer state bitmap */
 	struct mutex mutex;             /* synchronizes concurrent access to block */
-	struct dlist_head bh_next;      /* link to global list of buffer_heads */
+	struct dlist_head bh_next;      /* link in hash bucket of buffer cache */
+	struct dlist_head lru_lnk;      /* link in replacement queue */
+	struct dlist_head dirty_lnk;    /* link in list of dirty buffers */
+	clock_t dirty_since;            /* when buffer became dirty */
 	char *data;                     /* pointer to block's data */
 	int lock_count;			/* lock count to support multiplie locks */
 	/*
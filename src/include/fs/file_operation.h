@@ -20,6 +20,7 @@ struct kfile_operations {
 	size_t (*read)(struct file_desc *desc, void *buf, size_t size);
 	size_t (*write)(struct file_desc *desc, void *buf, size_t size);
 	int    (*ioctl)(struct file_desc *desc, int request, void *data);
+	int    (*fsync)(struct file_desc *desc);
 };
 
 #endif /* FS_FILE_OPERATION_H_ */
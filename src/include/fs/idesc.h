@@ -22,6 +22,7 @@ struct idesc {
 	const struct idesc_xattrops *idesc_xattrops;
 	unsigned int idesc_flags;
 	int idesc_count;
+	struct dlist_head idesc_hooks; /**< idesc_event_hook list, e.g. epoll */
 };
 
 struct iovec;
@@ -37,6 +38,7 @@ struct idesc_ops {
 	int (*status)(struct idesc *idesc, int mask);
 	void *(*idesc_mmap)(struct idesc *idesc, void *addr, size_t len, int prot,
 			int flags, int fd, off_t off);
+	int (*fsync)(struct idesc *idesc);
 };
 
 struct idesc_xattrops {
@@ -11,6 +11,7 @@
 
 #include <kernel/sched/waitq.h>
 #include <poll.h> /* for flags */
+#include <util/dlist.h>
 
 struct idesc;
 
@@ -56,6 +57,39 @@ extern void idesc_wait_cleanup(struct idesc *idesc, struct idesc_wait_link *wl);
  */
 extern int idesc_notify(struct idesc *idesc, int mask);
 
+/**
+ * Callback on every idesc_notify() of descriptor, so the one who watches
+ * a lot of descriptors (epoll) learns which of them are ready without
+ * waiting on each. It's called with interrupts disabled and must not sleep.
+ *
+ * Before descriptor is freed each hook is removed and called once more with
+ * POLLNVAL mask, under idesc_event_lock() and with interrupts enabled.
+ */
+struct idesc_event_hook {
+	struct dlist_head lnk;
+	void (*notify)(struct idesc_event_hook *hook, struct idesc *idesc,
+			int mask);
+};
+
+/**
+ * @brief Serializes adding and removing of hooks with descriptors releasing
+ */
+extern void idesc_event_lock(void);
+extern void idesc_event_unlock(void);
+
+/**
+ * @brief Add/remove hook of descriptor, called under idesc_event_lock()
+ */
+extern void idesc_event_hook_add(struct idesc *idesc,
+		struct idesc_event_hook *hook);
+extern void idesc_event_hook_del(struct idesc *idesc,
+		struct idesc_event_hook *hook);
+
+/**
+ * @brief Remove all hooks of descriptor which is going to be freed
+ */
+extern void idesc_event_release(struct idesc *idesc);
+
 /* TODO mask is unused, and not sure if sometime will. This is called from
  * object's operation which can't continue until some condition occur. Even
  * if this is successfuly worked, it is not unlikely that operation still can't
@@ -36,6 +36,8 @@ extern int index_descriptor_dupfd(int fd, int newfd);
 struct stat;
 extern int index_descriptor_fstat(int fd, struct stat *buff);
 
+extern int index_descriptor_fsync(int fd);
+
 __END_DECLS
 
 
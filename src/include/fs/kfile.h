@@ -30,6 +30,8 @@ extern int kioctl(struct file_desc *fp, int request, void *data);
 
 extern int kfstat(struct file_desc *fp, struct stat *buff);
 
+extern int kfsync(struct file_desc *fp);
+
 struct node;
 extern int ktruncate(struct node *node, off_t length);
 
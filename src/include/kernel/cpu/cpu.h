@@ -27,5 +27,7 @@ extern clock_t cpu_get_started(unsigned int cpu_id);
  */
 extern clock_t cpu_get_total_time(unsigned int cpu_id);
 extern clock_t cpu_get_idle_time(unsigned int cpu_id);
+extern unsigned int cpu_get_migrations(unsigned int cpu_id);
+extern unsigned int cpu_get_steals(unsigned int cpu_id);
 
 #endif /* !KERNEL_CPU_CPU_H_ */
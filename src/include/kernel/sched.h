@@ -67,6 +67,8 @@ struct schedee {
 	unsigned int ready;   /**< Managed by the scheduler. */
 	unsigned int waiting; /**< Waiting for an event. */
 
+	unsigned int cpu;     /**< CPU which runq holds (or held) the schedee. */
+
 	struct affinity         affinity;
 	struct sched_timing     sched_timing;
 	struct schedee_priority priority;
@@ -103,6 +105,11 @@ extern void sched_set_current(struct schedee *schedee);
 extern void sched_ticker_init(void);
 extern void sched_ticker_fini(void);
 extern void sched_ticker_switch(int prev_policy, int next_policy);
+/**
+ * Tells the ticker whether the current schedee shares the CPU with other
+ * ready ones, i.e. whether time slicing is needed.
+ */
+extern void sched_ticker_update(int shared);
 
 extern int sched_active(struct schedee *s);
 
@@ -127,6 +134,15 @@ extern int sched_active(struct schedee *s);
 extern int sched_change_priority(struct schedee *schedee, int prior,
 		int (*set_priority)(struct schedee_priority *, int));
 
+/**
+ * Number of schedees migrated to the CPU runq from other CPUs, including
+ * stolen ones.
+ */
+extern unsigned int sched_nr_migrations(unsigned int cpu_id);
+
+/** Number of schedees stolen by the CPU from runqs of other CPUs. */
+extern unsigned int sched_nr_steals(unsigned int cpu_id);
+
 extern void sched_wait_prepare(void);
 extern void sched_wait_cleanup(void);
 
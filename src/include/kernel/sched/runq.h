@@ -18,6 +18,12 @@ extern void runq_insert(runq_t *queue, struct schedee *schedee);
 extern void runq_remove(runq_t *queue, struct schedee *schedee);
 extern struct schedee *runq_extract(runq_t *queue);
 
+/**
+ * Removes the highest priority schedee which may run on CPUs of @a mask.
+ * @return The schedee or NULL if there is no such one
+ */
+extern struct schedee *runq_steal(runq_t *queue, unsigned int mask);
+
 extern void runq_item_init(runq_item_t *runq_link);
 
 #endif /* SCHED_RUNQ_H_ */
@@ -19,6 +19,10 @@
 struct runq {
 	runq_t queue;
 	spinlock_t lock;
+
+	unsigned int nr_queued;     /**< Schedees in the queue. */
+	unsigned int nr_migrations; /**< Schedees came from other CPUs. */
+	unsigned int nr_steals;     /**< Schedees stolen from other CPUs. */
 };
 
 #endif /* KERNEL_SCHED_SCHED_STRATEGY_H_ */
@@ -22,6 +22,7 @@
 #include <kernel/sched.h>
 #include <kernel/thread/thread_wait.h>
 #include <kernel/sched/waitq_protect_link.h>
+#include <mem/tcache.h>
 #include <util/dlist.h>
 
 struct task;
@@ -65,6 +66,8 @@ struct thread {
 	thread_local_t     local;
 	thread_cancel_t    cleanups;
 
+	tcache_t           tcache;       /**< Cache of small heap blocks */
+
 	struct waitq_protect_link waitq_list;
 
 	struct thread_wait thread_wait_list;
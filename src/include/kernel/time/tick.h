@@ -0,0 +1,26 @@
+/**
+ * @file
+ * @brief Stopping of the periodic tick while the CPU is idle
+ *
+ * @date 17.10.2026
+ */
+
+#ifndef KERNEL_TIME_TICK_H_
+#define KERNEL_TIME_TICK_H_
+
+/**
+ * Called by the idle thread before it halts the CPU. Programs the next
+ * clock event to the nearest timer expiration instead of the next tick.
+ */
+extern void tick_idle_enter(void);
+
+/**
+ * Called on each interrupt and by the idle thread after the CPU is woken
+ * up. If the tick was stopped, brings jiffies up to date and restores the
+ * periodic tick.
+ *
+ * @param irq_nr - number of the interrupt being handled, or -1
+ */
+extern void tick_irq_enter(int irq_nr);
+
+#endif /* KERNEL_TIME_TICK_H_ */
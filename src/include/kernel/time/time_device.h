@@ -43,6 +43,16 @@ struct time_event_device {
 	uint32_t irq_nr;
 	int (*pending) (unsigned int nr);
 	const char *name;
+
+	/**
+	 * Optional, used by tickless mode. Non-zero @a ticks programs the next
+	 * event after @a ticks jiffies (no more than @c max_oneshot) instead of
+	 * the next periodic one. Zero @a ticks restores periodic events and
+	 * returns the number of jiffies passed since the event was programmed,
+	 * provided it has not fired yet.
+	 */
+	clock_t (*set_oneshot)(struct time_event_device *dev, clock_t ticks);
+	clock_t max_oneshot;
 };
 
 /**
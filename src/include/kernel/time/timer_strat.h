@@ -9,6 +9,8 @@
 
 #ifndef TIMER_STRAT_H_
 #define TIMER_STRAT_H_
+#include <defines/clock_t.h>
+
 struct sys_timer;
 #include <module/embox/kernel/timer/strategy/api.h>
 
@@ -21,4 +23,29 @@ extern void timer_strat_stop(struct sys_timer *ptimer);
 
 extern void timer_strat_start(struct sys_timer *ptimer);
 
+/**
+ * Returns the number of timer_strat_sched() calls after which the nearest
+ * timer expires (at least 1), or (clock_t) -1 if there is no started timers.
+ * The value may be less than the real one, but never greater.
+ */
+extern clock_t timer_strat_next_event(void);
+
+/********
+ * timer_queue
+ *
+ * Instance of the strategy, timer_strat functions work with the system one.
+ * Other instances are driven only by explicit timer_queue_sched() calls.
+ */
+extern void timer_queue_init(struct timer_queue *queue);
+
+extern void timer_queue_sched(struct timer_queue *queue);
+
+extern void timer_queue_stop(struct timer_queue *queue,
+		struct sys_timer *ptimer);
+
+extern void timer_queue_start(struct timer_queue *queue,
+		struct sys_timer *ptimer);
+
+extern clock_t timer_queue_next_event(struct timer_queue *queue);
+
 #endif /* TIMER_STRAT_H_ */
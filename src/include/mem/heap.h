@@ -10,7 +10,22 @@
 #ifndef MEM_HEAP_H_
 #define MEM_HEAP_H_
 
+#include <stddef.h>
+
 #include <framework/mod/options.h>
 #include <module/embox/mem/heap_api.h>
 
+struct heap_stat {
+	size_t total;        /* Bytes in segments of heap */
+	size_t free;
+	size_t largest_free; /* The largest block which can be allocated */
+	int segments;
+};
+
+/**
+ * Gets statistics of heap of the current task, ratio of largest_free to
+ * free shows fragmentation.
+ */
+extern void heap_get_stat(struct heap_stat *stat);
+
 #endif /* MEM_HEAP_H_ */
@@ -14,5 +14,10 @@
 extern void bm_init(void *segment, size_t size);
 extern void *bm_memalign(void *segment, size_t boundary, size_t size);
 extern void bm_free(void *segment, void *ptr);
+/** @return Usable size of allocated block or zero if the block is free */
+extern size_t bm_block_size(void *ptr);
+extern void bm_get_stat(void *segment, size_t *free, size_t *largest_free);
+/** @return Non-zero if nothing is allocated in @a segment of @a size bytes */
+extern int bm_is_empty(void *segment, size_t size);
 
 #endif /* MEM_HEAP_BM_H_ */
@@ -0,0 +1,56 @@
+/**
+ * @file
+ * @brief Two-level segregated fit memory allocator
+ *
+ * @details Free blocks are kept in lists of size classes: the first level
+ *   is a power of two and the second one divides it linearly. Non-empty
+ *   lists are marked in bitmaps, so both allocation and free take constant
+ *   time regardless of the number of free blocks.
+ *
+ * @date 17.10.26
+ */
+
+#ifndef MEM_HEAP_TLSF_H_
+#define MEM_HEAP_TLSF_H_
+
+#include <sys/types.h>
+
+struct tlsf;
+
+/**
+ * Places control structure of allocator at the beginning of @a mem and
+ * makes the rest of it the first pool.
+ *
+ * @return Allocator or NULL if @a size is too small
+ */
+extern struct tlsf *tlsf_init(void *mem, size_t size);
+
+/**
+ * Adds memory to the allocator, it isn't merged with other pools.
+ * @return Zero or -EINVAL if @a size is too small
+ */
+extern int tlsf_add_pool(struct tlsf *tlsf, void *mem, size_t size);
+
+/**
+ * Removes pool added by tlsf_add_pool() if none of its blocks is allocated.
+ * @return Zero or -EBUSY if the pool is in use
+ */
+extern int tlsf_remove_pool(struct tlsf *tlsf, void *mem);
+
+extern void *tlsf_memalign(struct tlsf *tlsf, size_t boundary, size_t size);
+extern void tlsf_free(struct tlsf *tlsf, void *ptr);
+
+/** @return Usable size of allocated block or zero if the block is free */
+extern size_t tlsf_block_size(void *ptr);
+
+/** @return Size of control structure placed by tlsf_init() */
+extern size_t tlsf_control_size(void);
+
+/**
+ * Gets bytes in pools, free bytes and the largest size which can be
+ * allocated, it may be less than the largest free block.
+ */
+extern void tlsf_get_stat(struct tlsf *tlsf, size_t *total, size_t *free,
+		size_t *largest_free);
+
+#endif /* MEM_HEAP_TLSF_H_ */
@@ -74,13 +74,36 @@ extern void *cache_alloc(cache_t *cachep);
 extern void cache_free(cache_t *cachep, void* objp);
 
 /**
- * Remove all free slabs from cache
- * will be used in feature
+ * Return objects cached by the current CPU and remove all free slabs
  * @param cachep is pointer to cache which need to shrink
  * @return number of removed slabs
  */
 extern int cache_shrink(cache_t *cachep);
 
+struct cache_stats {
+	char name[__CACHE_NAMELEN];
+	size_t obj_size;
+	unsigned int num;         /* objects per slab */
+	unsigned int slab_order;
+	unsigned int colour;      /* different offsets of objects in slabs */
+	unsigned int slabs;
+	unsigned int slabs_free;
+	unsigned int inuse;       /* objects taken from slabs */
+	unsigned int cached;      /* of them kept in magazines of all CPUs */
+	unsigned long allocs;
+	unsigned long alloc_hits; /* served from magazine */
+	unsigned long frees;
+	unsigned long free_hits;  /* kept in magazine */
+};
+
+/**
+ * Get statistics of caches, the cache of cache descriptors is the first
+ * @param stats is array for statistics
+ * @param nr is size of @a stats
+ * @return number of caches, it can be greater than @a nr
+ */
+extern int cache_get_stats(struct cache_stats *stats, int nr);
+
 /**
  * Enable/disable cache growing. That means if growing is on, than
  * cache will allocate slabs when no memory. And allocation will be return NULL
@@ -14,9 +14,13 @@
 #include <stdint.h>
 
 #include <framework/mod/options.h>
+#include <kernel/spinlock.h>
 
 #include <module/embox/mem/page_api.h>
 
+struct page_area;
+struct page_pcp;
+
 struct page_allocator {
 	void *pages_start;
 	unsigned int pages_n;
@@ -24,8 +28,21 @@ struct page_allocator {
 
 	size_t free;
 
-	size_t bitmap_len;
-	unsigned long *bitmap;
+	spinlock_t lock;
+	unsigned int max_order;
+	struct page_area *areas;   /* free blocks of 2^order pages */
+	unsigned char *page_state; /* state of every page */
+	struct page_pcp *pcp;      /* per-CPU lists of single pages */
+	unsigned int pcp_high;
+};
+
+#define PAGE_MAX_ORDER 32
+
+struct page_stat {
+	size_t free_pages;    /* in free blocks */
+	size_t cached_pages;  /* in per-CPU lists */
+	size_t largest_free;  /* pages in the largest free block */
+	unsigned int blocks[PAGE_MAX_ORDER]; /* free blocks of 2^order pages */
 };
 
 extern struct page_allocator *page_allocator_init(char *start, size_t len, size_t page_size);
@@ -38,15 +55,6 @@ extern void page_free(struct page_allocator *allocator, void *page, size_t page_
 
 extern int page_belong(struct page_allocator *allocator, void *page);
 
-#define PAGE_ALLOCATOR_DEF(name, space, page_number, page_size) \
-	static unsigned long ctrl_space_##name[ page_number/32 ]; \
-	static struct page_allocator name = { \
-			space, \
-			page_number, \
-			page_size, \
-			page_size * page_number, \
-			(sizeof(unsigned long) * page_number/32), \
-			ctrl_space_##name \
-	}
+extern void page_get_stat(struct page_allocator *allocator, struct page_stat *stat);
 
 #endif /* MEM_PAGE_H_ */
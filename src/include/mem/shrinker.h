@@ -0,0 +1,63 @@
+/**
+ * @file
+ * @brief Reclaim of memory held by caches
+ *
+ * @details Caches of objects which can be dropped (clean buffers, per-CPU
+ *   magazines, free slabs) register a shrinker for the memory they return
+ *   freed objects to. When an allocator runs out of memory it calls
+ *   shrink_caches() for its own memory and retries, as freeing objects to
+ *   other memory (or to a static pool) doesn't help the failed allocation.
+ *
+ *   Shrinkers are called in context of a failed allocation with interrupts
+ *   enabled, they must not sleep and must not allocate memory.
+ *
+ * @date 17.10.26
+ */
+
+#ifndef MEM_SHRINKER_H_
+#define MEM_SHRINKER_H_
+
+#include <stddef.h>
+
+#include <framework/mod/options.h>
+#include <util/array.h>
+
+/** Objects asked to free by an allocator at once */
+#define SHRINK_BATCH OPTION_MODULE_GET(embox__mem__shrinker, NUMBER, batch)
+
+/* Memory which shrinkers return freed objects to */
+enum shrink_target {
+	SHRINK_HEAP, /* sysmalloc() and task heaps */
+	SHRINK_SLAB, /* pages of slab allocator */
+};
+
+struct shrinker {
+	const char *name;
+	enum shrink_target target;
+	/** @return Number of objects which could be freed now */
+	size_t (*count)(void);
+	/** Frees up to @a nr objects. @return Number of freed objects */
+	size_t (*scan)(size_t nr);
+};
+
+#define SHRINKER_DEF(name_, target_, count_, scan_) \
+	ARRAY_SPREAD_DECLARE(const struct shrinker, __shrinker_registry); \
+	ARRAY_SPREAD_ADD(__shrinker_registry, { \
+		.name = name_, \
+		.target = target_, \
+		.count = count_, \
+		.scan = scan_, \
+	})
+
+/**
+ * Asks shrinkers of @a target memory to free @a nr objects in total. It
+ * does nothing if another reclaim is in progress.
+ *
+ * @return Number of freed objects
+ */
+extern size_t shrink_caches(enum shrink_target target, size_t nr);
+
+/** Number of objects which could be freed by shrinkers of @a target */
+extern size_t shrink_count(enum shrink_target target);
+
+#endif /* MEM_SHRINKER_H_ */
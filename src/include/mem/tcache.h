@@ -0,0 +1,45 @@
+/**
+ * @file
+ * @brief Per-thread caches of small heap blocks
+ *
+ * @details Each thread keeps lists of free blocks of small size classes,
+ *   malloc() and free() of such blocks don't touch the task heap while
+ *   the lists are neither empty nor full.
+ *
+ * @date 17.10.26
+ */
+
+#ifndef MEM_TCACHE_H_
+#define MEM_TCACHE_H_
+
+#include <stddef.h>
+
+struct dlist_head;
+struct thread;
+
+struct tcache_stats {
+	unsigned long allocs;
+	unsigned long alloc_hits; /* served from the cache */
+	unsigned long frees;
+	unsigned long free_hits;  /* kept in the cache */
+	unsigned long refills;    /* batches taken from heap */
+	unsigned long flushes;    /* batches returned to heap */
+	unsigned int cached;      /* blocks in the cache now */
+};
+
+#include <module/embox/mem/tcache_api.h>
+
+typedef __tcache_t tcache_t;
+
+/** @return Block of at least @a size bytes or NULL if it isn't cached */
+extern void *tcache_alloc(size_t size, struct dlist_head *mspace);
+
+/** @return Zero if the block is kept in cache of the current thread */
+extern int tcache_free(void *ptr, struct dlist_head *mspace);
+
+/** Returns all blocks cached by the thread to heap of its task */
+extern void tcache_flush(struct thread *t);
+
+extern void tcache_get_stats(struct thread *t, struct tcache_stats *stats);
+
+#endif /* MEM_TCACHE_H_ */
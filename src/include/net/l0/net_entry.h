@@ -17,4 +17,38 @@
  */
 extern int netif_rx(void *pack);
 
+struct net_device;
+struct sk_buff;
+struct sk_buff_head;
+
+/**
+ * Switches the device to polling mode of receiving. @a poll is called from
+ * the rx lthread after netif_napi_schedule() and must pass at most @a budget
+ * packets to netif_receive_skb(). If it passed less than @a budget packets,
+ * the device has no more packets, so @a poll must call
+ * netif_napi_complete() and then unmask the receive interrupt.
+ *
+ * @param weight packets per poll, default if not positive
+ */
+extern void netif_napi_add(struct net_device *dev,
+		int (*poll)(struct net_device *dev, int budget), int weight);
+
+/**
+ * Requests polling of the device, called from interrupt handler after
+ * masking the receive interrupt.
+ */
+extern void netif_napi_schedule(struct net_device *dev);
+
+/** Stops polling of the device. */
+extern void netif_napi_complete(struct net_device *dev);
+
+/** Passes the packet to the stack, for use from poll callback. */
+extern int netif_receive_skb(struct sk_buff *skb);
+
+/**
+ * Passes packets collected by poll callback to the stack at once.
+ * The list is empty on return.
+ */
+extern void netif_receive_skb_list(struct sk_buff_head *list);
+
 #endif /* NET_L0_NET_ENTRY_ */
@@ -17,4 +17,12 @@
  */
 extern int net_rx(struct sk_buff *skb);
 
+/**
+ * Batched version of net_rx(). Packets are handled in order, consecutive
+ * packets of the same type from the same device are passed to L3 layer
+ * together.
+ * @param list - incoming packages, empty on return
+ */
+extern void net_rx_list(struct sk_buff_head *list);
+
 #endif /* NET_L0_NET_RX_ */
@@ -1,7 +1,6 @@
 /**
  * @file
  * @brief Definitions for the IP router.
- * @details no cache routing.
  *
  * @date 16.11.09
  * @author Nikolay Korotky
@@ -29,6 +28,18 @@ typedef struct rt_entry {
 	in_addr_t    rt_gateway;
 } rt_entry_t;
 
+/**
+ * Result of routing to a single destination cached by a socket. It stays
+ * valid while the FIB generation is the same.
+ */
+struct rt_dst_cache {
+	unsigned int gen;
+	in_addr_t dst;
+	struct net_device *wanna_dev;
+	struct net_device *dev;
+	in_addr_t src;
+};
+
 /**< Flags */
 #define RTF_UP          0x0001          /* route usable                 */
 #define RTF_GATEWAY     0x0002          /* destination is a gateway     */
@@ -99,6 +110,23 @@ extern int rt_fib_source_ip(in_addr_t dst, struct net_device *dev,
 extern int rt_fib_out_dev(in_addr_t dst, const struct sock *sk,
 		struct net_device **out_dev);
 
+/**
+ * Get output device and source IP address for the destination, like
+ * rt_fib_out_dev() and rt_fib_source_ip() do, reusing previous result
+ * if it is still valid.
+ * @param dc - cache of the result, may be NULL
+ * @return error code
+ */
+extern int rt_fib_dst_get(in_addr_t dst, const struct sock *sk,
+		struct rt_dst_cache *dc, struct net_device **out_dev,
+		in_addr_t *out_src);
+
+/**
+ * Get generation of the routing table. It changes with every change of
+ * the table, so cached routing results can be checked against it.
+ */
+extern unsigned int rt_fib_gen(void);
+
 /**
  * @param dst - ip address of destination
  * @param out_dev - device, from witch data will be send to dst.
@@ -17,6 +17,7 @@
 
 #include <linux/types.h>
 #include <linux/list.h>
+#include <kernel/time/timer.h>
 #include <net/socket/inet_sock.h>
 #include <net/socket/inet6_sock.h>
 
@@ -84,6 +85,29 @@ struct tcp_seq_state {
 	struct tcp_wind wind;
 };
 
+/* Deadlines multiplexed on the one per-socket timer */
+enum tcp_tmr {
+	TCP_TMR_REXMIT,   /* Retransmission timeout */
+	TCP_TMR_DELACK,   /* Delayed acknowledgment */
+	TCP_TMR_TIMEWAIT, /* End of TIME-WAIT state */
+	TCP_TMR_SYNC,     /* Synchronization timeout for incoming connection */
+	TCP_TMR_PUSH,     /* Limit of holding partial segment while corked */
+	TCP_TMR_MAX
+};
+
+struct tcp_cong_ops;
+
+#define TCP_CONG_PRIV_SIZE 6 /* Size of private data of congestion control */
+
+/* Range of sequence numbers [start, end) */
+struct tcp_sack_block {
+	uint32_t start;
+	uint32_t end;
+};
+
+#define TCP_SACK_BLOCKS_MAX 4 /* Maximum amount of blocks in SACK option */
+#define TCP_SACK_SCORE_MAX  8 /* Maximum amount of blocks in scoreboard */
+
 typedef struct tcp_sock {
 	struct proto_sock p_sk;     /* Base proto_sock class (MUST BE FIRST) */
 	enum tcp_sock_state state;  /* Socket state */
@@ -106,6 +130,37 @@ typedef struct tcp_sock {
 	struct timeval rcv_time;    /* The time when last message was received (ONLY FOR TCP_TIMEWAIT) */
 	unsigned int dup_ack;       /* Amount of duplicated packets */
 	unsigned int rexmit_mode;   /* Socket in rexmit mode */
+	struct sys_timer timer;     /* Armed to the nearest pending deadline */
+	unsigned int tmr_pending;   /* Bitmask of pending enum tcp_tmr */
+	clock_t tmr_deadline[TCP_TMR_MAX]; /* Deadlines in jiffies */
+	uint32_t srtt;              /* Smoothed round-trip time (ms) */
+	uint32_t rttvar;            /* Round-trip time variation (ms) */
+	uint32_t rto;               /* Retransmission timeout (ms) */
+	uint32_t rtt_seq;           /* Sequence whose ACK ends RTT measurement */
+	clock_t rtt_start;          /* When RTT measurement was started */
+	unsigned int rtt_active;    /* RTT measurement is in progress */
+	const struct tcp_cong_ops *cong; /* Congestion control algorithm */
+	uint32_t cwnd;              /* Congestion window (bytes) */
+	uint32_t ssthresh;          /* Slow start threshold (bytes) */
+	uint32_t smss;              /* Largest segment sent (bytes) */
+	uint32_t recover;           /* Highest sequence sent when loss detected */
+	unsigned int in_recovery;   /* Socket in fast recovery */
+	uint64_t cong_priv[TCP_CONG_PRIV_SIZE]; /* Congestion control data */
+	unsigned int ws_ok;         /* Window scale is used on the connection */
+	unsigned int sack_ok;       /* SACK is permitted on the connection */
+	struct sk_buff_head ooo_queue; /* Out-of-order segments sorted by seq */
+	unsigned int ooo_len;       /* Length of @a ooo_queue */
+	uint32_t ooo_last;          /* Sequence of the last queued segment */
+	struct tcp_sack_block sacked[TCP_SACK_SCORE_MAX]; /* SACK scoreboard */
+	unsigned int sacked_cnt;    /* Amount of blocks in @a sacked */
+	uint32_t rexmit_high;       /* End of the last retransmitted segment */
+	uint16_t rem_mss;           /* MSS announced by the remote side */
+	uint16_t mss;               /* Maximum segment size for the path */
+	uint32_t seg_max;           /* Maximum data of one skb, more than @a mss with TSO */
+	unsigned int nodelay;       /* TCP_NODELAY, Nagle algorithm is disabled */
+	unsigned int cork;          /* TCP_CORK, only full segments are sent */
+	struct sk_buff *tx_pend;    /* Partial segment coalescing small writes */
+	size_t tx_pend_len;         /* Data length of @a tx_pend */
 } tcp_sock_t;
 
 static inline struct tcp_sock * to_tcp_sock(
@@ -118,19 +173,30 @@ enum {
 	TCP_OPT_KIND_MSS  = 2, /* Maximum segment size */
 	TCP_OPT_KIND_WS   = 3, /* Window scale */
 	TCP_OPT_KIND_SACK = 4, /* SACK Permission */
+	TCP_OPT_KIND_SACK_BLK = 5, /* SACK blocks */
 	TCP_OPT_KIND_TS   = 8  /* Timestamp */
 };
 
 /* Delays in milliseconds */
-#define TCP_TIMER_FREQUENCY   1000  /* Frequency for tcp_tmr_default */
 #define TCP_TIMEWAIT_DELAY    2000  /* Delay for TIME-WAIT state */
-#define TCP_REXMIT_DELAY      2000  /* Delay between rexmitting */
 #define TCP_SYNC_TIMEOUT      5000  /* Synchronization timeout */
+#define TCP_DELACK_DELAY       200  /* Maximum delay of acknowledgment */
+#define TCP_CORK_DELAY         200  /* Maximum delay of corked partial segment */
+#define TCP_RTO_INITIAL       1000  /* RTO before first RTT sample (RFC 6298) */
+#define TCP_RTO_MIN           1000  /* Lower bound of RTO (RFC 6298) */
+#define TCP_RTO_MAX          60000  /* Upper bound of RTO (RFC 6298) */
 
-#define TCP_REXMIT_DUP_ACK       5  /* Rexmit after n duplicate ack */
+#define TCP_REXMIT_DUP_ACK       3  /* Rexmit after n duplicate ack */
+#define TCP_MSS_DEFAULT        536  /* Default sender MSS (RFC 1122) */
+#define TCP_TSO_MAX_SIZE    0xFC00  /* Data of TSO segment fits IP length field */
 
 #define TCP_WINDOW_VALUE_DEFAULT  16384 /* Default size of widnow */
 #define TCP_WINDOW_FACTOR_DEFAULT     7 /* Default factor of widnow */
+#define TCP_WINDOW_FACTOR_MAX        14 /* Maximum factor of window (RFC 7323) */
+#define TCP_WINDOW_VALUE_MAX     0xFFFF /* Maximum window without scaling */
+
+#define TCP_OPT_MAX_LEN              40 /* Maximum length of options */
+#define TCP_SYN_OPT_MAX_LEN          12 /* Maximum length of SYN options */
 
 /* Synchronization flags */
 #define TCP_SYNC_WRITE_QUEUE  0x01 /* Synchronization flag for socket sk_write_queue */
@@ -138,6 +204,13 @@ enum {
 #define TCP_SYNC_CONN_QUEUE   0x04 /* Synchronization flag for socket conn_wait */
 #define TCP_SYNC_SOCK_TABLE   0x08 /* Synchronization flag for tcp_table (set on tcp_sock_default) */
 
+/* Modes of tcp_pend_push() */
+enum {
+	TCP_PUSH_NAGLE, /* Hold partial segment while unacknowledged data or cork */
+	TCP_PUSH_MORE,  /* Hold partial segment, more data is expected */
+	TCP_PUSH_FORCE  /* Send partial segment at once */
+};
+
 /* Status of TCP connection */
 enum {
 	TCP_ST_NOTEXIST, /* Connection does not exist */
@@ -164,7 +237,10 @@ extern void tcp_sock_unlock(struct tcp_sock *sk, unsigned int obj);
 extern int alloc_prep_skb(struct tcp_sock *tcp_sk, size_t opt_len,
 		size_t *data_len, struct sk_buff **out_skb);
 extern void send_seq_from_sock(struct tcp_sock *tcp_sk, struct sk_buff *skb);
+extern size_t tcp_syn_opts_build(const struct tcp_sock *tcp_sk, uint8_t *opts);
+extern void tcp_pend_push(struct tcp_sock *tcp_sk, int mode);
 extern int tcp_sock_get_status(struct tcp_sock *tcp_sk);
+extern void tcp_sock_timer_init(struct tcp_sock *tcp_sk);
 extern void debug_print(__u8 code, const char *msg, ...);
 
 #endif /* NET_L4_TCP_H_ */
@@ -0,0 +1,84 @@
+/**
+ * @file
+ * @brief Pluggable TCP congestion control.
+ *
+ * @details Common part (slow start on RTO, fast retransmit and NewReno fast
+ *   recovery, RFC 5681 and RFC 6582) is done by TCP itself. Algorithm only
+ *   decides how the window grows on new acknowledgments and how much it is
+ *   reduced on a loss.
+ *
+ * @date 17.10.26
+ */
+
+#ifndef NET_L4_TCP_CONG_H_
+#define NET_L4_TCP_CONG_H_
+
+#include <stdint.h>
+
+#include <net/l4/tcp.h>
+
+#define TCP_CONG_NAME_MAX 16 /* Maximum length of algorithm name with '\0' */
+
+/* Initial window (RFC 6928) for MSS not greater than 1460 bytes */
+#define TCP_CONG_INIT_WND 14600
+
+/**
+ * Each congestion control algorithm implements this interface.
+ */
+struct tcp_cong_ops {
+	const char *name;
+	/* Initializes private data in @c cong_priv of socket */
+	void (*init)(struct tcp_sock *tcp_sk);
+	/* Returns new slow start threshold when loss is detected */
+	uint32_t (*ssthresh)(struct tcp_sock *tcp_sk);
+	/* Grows window when @a acked bytes are acknowledged, not in recovery */
+	void (*cong_avoid)(struct tcp_sock *tcp_sk, uint32_t acked);
+	/* Called on retransmission timeout after ssthresh (optional) */
+	void (*rto)(struct tcp_sock *tcp_sk);
+};
+
+extern const struct tcp_cong_ops * tcp_cong_lookup(const char *name);
+
+/**
+ * Sets algorithm of the socket, default one is used if @a ops is NULL.
+ * Congestion state is reset to initial if @a reset is not zero.
+ */
+extern void tcp_cong_init(struct tcp_sock *tcp_sk,
+		const struct tcp_cong_ops *ops, int reset);
+
+/**
+ * Slow start (RFC 5681, 3.1), returns part of @a acked which is left after
+ * window has reached the slow start threshold.
+ */
+extern uint32_t tcp_cong_slow_start(struct tcp_sock *tcp_sk, uint32_t acked);
+
+/**
+ * Amount of data sent but not acknowledged yet
+ */
+static inline uint32_t tcp_cong_flight(const struct tcp_sock *tcp_sk) {
+	return tcp_sk->self.seq - tcp_sk->last_ack;
+}
+
+static inline void * tcp_cong_priv(struct tcp_sock *tcp_sk) {
+	return &tcp_sk->cong_priv[0];
+}
+
+#include <util/array.h>
+
+ARRAY_SPREAD_DECLARE(const struct tcp_cong_ops, __tcp_cong_registry);
+
+#define tcp_cong_foreach(ops_ptr) \
+	array_spread_foreach_ptr(ops_ptr, __tcp_cong_registry)
+
+#define TCP_CONG_DEF(_name, _init, _ssthresh, _cong_avoid, _rto)         \
+	ARRAY_SPREAD_DECLARE(const struct tcp_cong_ops, __tcp_cong_registry); \
+	ARRAY_SPREAD_ADD_NAMED(__tcp_cong_registry,                           \
+			__tcp_cong_##_init, {                                         \
+				.name = _name,                                            \
+				.init = _init,                                            \
+				.ssthresh = _ssthresh,                                    \
+				.cong_avoid = _cong_avoid,                                \
+				.rto = _rto                                               \
+			})
+
+#endif /* NET_L4_TCP_CONG_H_ */
@@ -47,6 +47,12 @@ extern void tcp6_set_check_field(struct tcphdr *tcph,
 extern void tcp_set_check_field(struct tcphdr *tcph,
 		const void *nhhdr);
 
+/**
+ * Set TCP check field to pseudo header sum, the rest is summed by device
+ */
+extern void tcp_set_check_pseudo(struct tcphdr *tcph,
+		const void *nhhdr);
+
 /**
  * Calculate TCP data length
  */
@@ -35,6 +35,17 @@ extern void udp6_set_check_field(struct udphdr *udph,
 extern void udp_set_check_field(struct udphdr *udph,
 		const void *nhhdr);
 
+/**
+ * Set UDP check field to pseudo header sum, the rest is summed by device
+ */
+extern void udp_set_check_pseudo(struct udphdr *udph,
+		const void *nhhdr);
+
+/**
+ * Calculate partial sum of pseudo header
+ */
+extern unsigned long udp_pseudo_sum(const void *nhhdr);
+
 /**
  * Calculate UDP data length
  */
@@ -12,25 +12,38 @@
 #include <net/netdevice.h>
 #include <time.h>
 #include <util/dlist.h>
+#include <kernel/time/timer.h>
+
+/**
+ * Neighbour entity states (see RFC 4861 7.3.2)
+ */
+enum neighbour_state {
+	NEIGHBOUR_INCOMPLETE, /* resolution is in progress */
+	NEIGHBOUR_REACHABLE,  /* hw address is confirmed recently */
+	NEIGHBOUR_STALE,      /* hw address is not confirmed for a while */
+	NEIGHBOUR_DELAY,      /* stale entity was used, wait for confirmation */
+	NEIGHBOUR_PROBE       /* confirmation is requested */
+};
 
 /**
  * Neighbour entity
  */
 struct neighbour {
-	struct dlist_head lnk;             /* lnk */
+	struct dlist_head lnk;             /* in LRU list */
+	struct dlist_head hash_lnk;        /* in hash chain */
 	unsigned short ptype;              /* protocol */
 	unsigned char paddr[MAX_ADDR_LEN]; /* protocol address */
 	unsigned char plen;                /* protocol address len  */
 	struct net_device *dev;            /* net device */
-	int incomplete;                    /* is incomplete */
+	enum neighbour_state state;        /* state */
 	unsigned short htype;              /* hw space */
 	unsigned char haddr[MAX_ADDR_LEN]; /* hw address */
 	unsigned char hlen;                /* hw address len */
 	unsigned int flags;                /* flags */
 	struct sk_buff_head w_queue;       /* waiting queue */
-	unsigned long expire;              /* lifetime */
-	unsigned long resend;              /* resend timeout */
+	unsigned int w_queue_len;          /* length of waiting queue */
 	unsigned int sent_times;           /* how much times request was sent */
+	struct sys_timer tmr;              /* timer of current state */
 };
 
 /**
@@ -44,6 +44,8 @@ typedef struct net_device_stats {
 	unsigned long tx_dropped; /* no space available in pool */
 	unsigned long multicast;  /* multicast packets received */
 	unsigned long collisions; /* collision errors */
+	unsigned long rx_polls;   /* times polled for received packets */
+	unsigned long rx_poll_squeezed; /* polls which used up the whole weight */
 
 	/* detailed rx_errors: */
 	unsigned long rx_length_errors; /* recived packet with incorrect length */
@@ -106,6 +108,11 @@ typedef struct net_device_ops {
 	int (*check_mtu)(int mtu);
 } net_device_ops_t;
 
+/* Offloads supported by device (features field of net_device) */
+#define NETIF_F_TSO     0x1 /* Splits TCP segment into gso_size ones itself */
+#define NETIF_F_HW_CSUM 0x2 /* Completes CHECKSUM_PARTIAL checksum on TX */
+#define NETIF_F_RXCSUM  0x4 /* Verifies L4 checksum of received packets */
+
 /**
  * structure of net device
  */
@@ -120,12 +127,16 @@ typedef struct net_device {
 	unsigned char addr_len; /**< hardware address length      */
 	unsigned int flags; /**< interface flags (a la BSD)   */
 	unsigned int mtu; /**< interface MTU value          */
+	unsigned int features; /**< offloads, NETIF_F_XXX      */
 	unsigned long base_addr; /**< device I/O address           */
 	unsigned int irq; /**< device IRQ number            */
 	struct net_device_stats stats;
 	const struct net_device_ops *ops; /**< Hardware description  */
 	const struct net_driver *drv_ops; /**< Management operations        */
-	struct sk_buff_head dev_queue;
+	struct sk_buff_head dev_queue; /**< Backlog filled by netif_rx() */
+	unsigned int dev_queue_len;
+	int (*poll)(struct net_device *dev, int budget); /**< See netif_napi_add() */
+	int poll_weight; /**< Packets per poll, default if not positive */
 	struct net_node *pnet_node;
 	void *priv; /**< private data */
 } net_device_t;
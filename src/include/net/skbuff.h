@@ -29,6 +29,13 @@ struct arphdr;
 struct ethhdr;
 struct iovec;
 
+/* Checksum state of L4 packet (ip_summed field of sk_buff) */
+#define CHECKSUM_NONE        0 /* Not offloaded on TX, not verified on RX */
+#define CHECKSUM_PARTIAL     1 /* Checksum field holds pseudo header sum,
+								  the rest is summed by device */
+#define CHECKSUM_UNNECESSARY 2 /* Verified by device */
+#define CHECKSUM_COPY        3 /* Data is verified while copied to user */
+
 typedef struct sk_buff_head {
 	struct sk_buff *next;       /* Next buffer in list */
 	struct sk_buff *prev;       /* Previous buffer in list */
@@ -51,6 +58,20 @@ typedef struct sk_buff {        /* Socket buffer */
 		/* Length of actual data, from LL header till the end */
 	size_t len;
 
+		/* Segment size of TCP data if the packet is larger (TSO),
+		 * it is split by device with NETIF_F_TSO. Zero otherwise */
+	unsigned short gso_size;
+
+		/* Checksum state of L4 packet, one of CHECKSUM_* */
+	unsigned char ip_summed;
+		/* Start of data summed by device from LL header and offset of
+		 * checksum field from it, for CHECKSUM_PARTIAL */
+	unsigned short csum_start;
+	unsigned short csum_offset;
+		/* Partial sum of packet without data from p_data, for
+		 * CHECKSUM_COPY */
+	unsigned long csum;
+
 		/* Transport layer header */
 	union {
 		struct tcphdr *th;
@@ -108,6 +129,25 @@ extern int skb_data_cloned(const struct sk_buff_data *skb_data);
 extern void skb_data_free(struct sk_buff_data *skb_data);
 extern void *skb_get_data_pointner(struct sk_buff_data *skb_data);
 
+/**
+ * Statistics of per-CPU cache of sk_buff or sk_buff_data structures
+ */
+struct skb_cache_stats {
+	unsigned long allocs;
+	unsigned long alloc_hits; /* served from CPU cache */
+	unsigned long frees;
+	unsigned long free_hits;  /* returned to CPU cache */
+	unsigned long refills;
+	unsigned long flushes;
+	unsigned long depleted;   /* shared pool was exhausted */
+	unsigned int cached;      /* objects in CPU cache now */
+};
+
+extern void skb_get_cache_stats(unsigned int cpu,
+		struct skb_cache_stats *stats);
+extern void skb_data_get_cache_stats(unsigned int cpu,
+		struct skb_cache_stats *stats);
+
 extern struct sk_buff_extra * skb_extra_alloc(void);
 extern void skb_extra_free(struct sk_buff_extra *skb_extra);
 
@@ -159,6 +199,23 @@ extern struct sk_buff * skb_clone(const struct sk_buff *skb);
  */
 extern struct sk_buff * skb_declone(struct sk_buff *skb);
 
+/**
+ * Marks L4 checksum of @a skb to be completed by device, checksum field is
+ * at @a offset from the transport header and holds pseudo header sum.
+ */
+static inline void skb_csum_partial(struct sk_buff *skb,
+		unsigned short offset) {
+	skb->ip_summed = CHECKSUM_PARTIAL;
+	skb->csum_start = skb->h.raw - skb->mac.raw;
+	skb->csum_offset = offset;
+}
+
+/**
+ * Computes CHECKSUM_PARTIAL checksum in software, for devices without
+ * NETIF_F_HW_CSUM and for fragmentation
+ */
+extern int skb_csum_complete(struct sk_buff *skb);
+
 /**
  * Write buffer from iovec
  *
@@ -184,6 +241,13 @@ extern int skb_buf_iovec(void *buf, int buflen, struct iovec *iov, int iovlen);
 extern int skb_iovec_buf(const struct iovec *iov, int iovlen, const void *buf,
 		int buflen);
 
+/**
+ * The same as skb_iovec_buf(), but partial sum of copied data is added to
+ * @a sum
+ */
+extern int skb_iovec_buf_csum(const struct iovec *iov, int iovlen,
+		const void *buf, int buflen, unsigned long *sum);
+
 /**
  * Create copy of skb
  * In current implementation we don't have shared area for packets data,
@@ -217,6 +281,28 @@ extern struct sk_buff * skb_queue_pop(struct sk_buff_head *queue);
 
 extern int skb_queue_count(struct sk_buff_head *queue);
 
+/**
+ * Move up to @a max sk_buff from the head of @a queue to the tail of
+ * @a list at once
+ * @return number of moved sk_buff
+ */
+extern int skb_queue_pop_list(struct sk_buff_head *queue,
+		struct sk_buff_head *list, int max);
+
+/**
+ * Versions of skb_queue_push() and skb_queue_pop() for queues not shared
+ * with interrupts
+ */
+extern void __skb_queue_push(struct sk_buff_head *queue, struct sk_buff *skb);
+extern struct sk_buff * __skb_queue_pop(struct sk_buff_head *queue);
+
+/**
+ * Insert @a skb before @a pos (or to the tail if @a pos is NULL) of a queue
+ * not shared with interrupts, used to keep the queue ordered
+ */
+extern void __skb_queue_insert(struct sk_buff_head *queue,
+		struct sk_buff *pos, struct sk_buff *skb);
+
 static inline struct sk_buff * skb_queue_next(struct sk_buff *skb) {
 	return skb->lnk.next;
 }
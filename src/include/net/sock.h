@@ -74,6 +74,7 @@ struct sock {
 	struct idesc idesc;
 	struct sock_xattr sock_xattr;
 	struct dlist_head lnk;
+	struct dlist_head hash_lnk; /* connection or listener hash bucket */
 	enum sock_state state;
 	struct sock_opt opt;
 	struct sk_buff_head rx_queue;
@@ -136,6 +137,7 @@ struct sock_proto_ops {
 	int (*accept)(struct sock *sk, struct sockaddr *addr,
 			socklen_t *addrlen, int flags, struct sock **out_sk);
 	int (*sendmsg)(struct sock *sk, struct msghdr *msg, int flags);
+	int (*sendfile)(struct sock *sk, struct idesc *in, size_t count);
 	int (*recvmsg)(struct sock *sk, struct msghdr *msg, int flags);
 	int (*fillmsg)(struct sock *sk, struct msghdr *msg,
 			struct sk_buff *skb); //FIXME remove me
@@ -170,6 +172,12 @@ extern void sock_release(struct sock *sk);
 extern void sock_hash(struct sock *sk);
 extern void sock_unhash(struct sock *sk);
 
+/**
+ * Move socket to the hash bucket matching its current addresses. Must be
+ * called every time local or remote address of hashed socket is changed.
+ */
+extern void sock_rehash(struct sock *sk);
+
 
 extern void sock_rcv(struct sock *sk, struct sk_buff *skb,
 		unsigned char *p_data, size_t size);
@@ -201,6 +209,22 @@ extern struct sock * sock_lookup(const struct sock *sk,
 		sock_lookup_tester_ft tester,
 		const struct sk_buff *skb);
 
+/**
+ * Lookup connected socket (with non-zero remote port) by 4-tuple hash.
+ * Only sockets which lie in the bucket are checked with @a tester.
+ */
+extern struct sock * sock_lookup_conn(const struct sock_proto_ops *p_ops,
+		sock_lookup_tester_ft tester, const struct sk_buff *skb,
+		in_port_t local_port, in_port_t remote_port,
+		const void *remote_addr, size_t addr_len);
+
+/**
+ * Lookup listening or unconnected socket by local port hash.
+ */
+extern struct sock * sock_lookup_listen(const struct sock_proto_ops *p_ops,
+		sock_lookup_tester_ft tester, const struct sk_buff *skb,
+		in_port_t local_port);
+
 typedef int (*sock_addr_tester_ft)(const struct sockaddr *addr1,
 		const struct sockaddr *addr2);
 
@@ -11,6 +11,7 @@
 #define NET_SOCKET_INET_SOCK_H_
 
 #include <net/sock.h>
+#include <net/l3/route.h>
 #include <netinet/in.h>
 #include <arpa/inet.h> /* TODO remove this */
 #include <stdint.h>
@@ -37,6 +38,7 @@ struct inet_sock_opt {
  * @var id - ID counter for DF pkts
  * @var tos - TOS
  * @var mc_ttl - Multicasting TTL
+ * @var dst_cache - Route to the last destination
  */
 typedef struct inet_sock {
 	struct sock sk;            /* Base socket class (MUST BE FIRST) */
@@ -46,6 +48,7 @@ typedef struct inet_sock {
 	int16_t uc_ttl;
 	uint16_t id;
 	struct inet_sock_opt opt;
+	struct rt_dst_cache dst_cache;
 } inet_sock_t;
 
 static inline struct inet_sock * to_inet_sock(struct sock *sk) {
@@ -124,6 +124,18 @@ extern int kaccept(struct sock *sk, struct sockaddr *addr,
 extern int ksendmsg(struct sock *sk, struct msghdr *msg,
 		int flags);
 
+/**
+ * Send data read from a file descriptor on a stream socket.
+ * Call sendfile callback from proto_ops, so protocol can read data straight
+ * into its packets without intermediate buffer.
+ *
+ * @param sock - pointer to the socket structure
+ * @param in - descriptor to read data from at its current position
+ * @param count - maximum number of bytes to send
+ * @return number of sent bytes, minus posix errno on failure
+ */
+extern int ksendfile(struct sock *sk, struct idesc *in, size_t count);
+
 /**
  * Receive a message from a socket.
  * Call recvmsg callback from family_ops.
@@ -2,6 +2,11 @@
  * @file
  * @brief Checksumming functions for IP, TCP, UDP and so on.
  *
+ * @details partial_sum() returns one's complement sum of 16-bit words in
+ *   the byte order of the host, which is not greater than 0x1FFFF. So a few
+ *   partial sums can be added and folded with fold_short(). Architecture can
+ *   provide its own partial_sum() with __HAVE_ARCH_CSUM_PARTIAL defined.
+ *
  * @date 20.03.09
  * @author Anton Bondarev
  */
@@ -9,13 +14,49 @@
 #ifndef NET_UTIL_CHECKSUM_H_
 #define NET_UTIL_CHECKSUM_H_
 
+#include <stdint.h>
+#include <string.h>
+
+#include <module/embox/arch/libarch.h>
+
+/* Reduces 64-bit accumulator keeping its one's complement sum */
+static inline unsigned long csum_reduce(uint64_t sum) {
+	sum = (sum >> 32) + (sum & 0xffffffff);
+	sum = (sum >> 32) + (sum & 0xffffffff);
+	return (unsigned long) ((sum >> 16) + (sum & 0xffff));
+}
+
+#ifndef __HAVE_ARCH_CSUM_PARTIAL
+
 static inline unsigned long partial_sum(const void *addr, int len) {
-	unsigned long sum;
+	uint64_t sum;
+	const uint32_t *ptr32;
 	unsigned short oddbyte, *ptr;
 
 	sum = 0;
 	ptr = (unsigned short *)addr;
 
+	if (!((uintptr_t)ptr & 1)) {
+		if (((uintptr_t)ptr & 2) && (len > 1)) {
+			sum += *ptr++;
+			len -= 2;
+		}
+
+		/* 32-bit word is the sum of two 16-bit ones modulo 0xFFFF in any
+		 * byte order, so carries are only folded at the end */
+		ptr32 = (const uint32_t *)ptr;
+		while (len >= 16) {
+			sum += (uint64_t)ptr32[0] + ptr32[1] + ptr32[2] + ptr32[3];
+			ptr32 += 4;
+			len -= 16;
+		}
+		while (len >= 4) {
+			sum += *ptr32++;
+			len -= 4;
+		}
+		ptr = (unsigned short *)ptr32;
+	}
+
 	while (len > 1) {
 		sum += *ptr++;
 		len -= 2;
@@ -27,9 +68,11 @@ static inline unsigned long partial_sum(const void *addr, int len) {
 		sum += oddbyte;
 	}
 
-	return sum;
+	return csum_reduce(sum);
 }
 
+#endif /* __HAVE_ARCH_CSUM_PARTIAL */
+
 static inline unsigned short fold_short(unsigned long sum) {
 	sum = (sum >> 16) + (sum & 0xffff);
 	sum += (sum >> 16);
@@ -40,4 +83,52 @@ static inline unsigned short ptclbsum(const void *addr, int len) {
 	return ~fold_short(partial_sum(addr, len));
 }
 
+/**
+ * Adds partial sum @a sum2 of block which starts at @a offset of the packet
+ * to partial sum @a sum of the preceding data.
+ */
+static inline unsigned long csum_block_add(unsigned long sum,
+		unsigned long sum2, int offset) {
+	if (offset & 1) {
+		/* Bytes of the block are in other halves of 16-bit words */
+		sum2 = fold_short(sum2);
+		sum2 = ((sum2 & 0xff) << 8) | (sum2 >> 8);
+	}
+
+	return csum_reduce((uint64_t)sum + sum2);
+}
+
+/**
+ * Copies @a len bytes from @a src to @a dst and returns partial sum of them,
+ * data is read only once if both buffers are aligned to 32-bit words.
+ */
+static inline unsigned long csum_and_copy(void *dst, const void *src,
+		int len) {
+	uint64_t sum;
+	const uint32_t *from;
+	uint32_t *to, word;
+
+	if (((uintptr_t)dst | (uintptr_t)src) & 3) {
+		memcpy(dst, src, len);
+		return partial_sum(dst, len);
+	}
+
+	sum = 0;
+	from = src;
+	to = dst;
+	while (len >= 4) {
+		word = *from++;
+		*to++ = word;
+		sum += word;
+		len -= 4;
+	}
+
+	if (len != 0) {
+		memcpy(to, from, len);
+		sum += partial_sum(to, len);
+	}
+
+	return csum_reduce(sum);
+}
+
 #endif /* NET_UTIL_CHECKSUM_H_ */
@@ -7,6 +7,7 @@
  */
 
 #include <kernel/cpu/cpu.h>
+#include <kernel/sched.h>
 #include <kernel/thread.h>
 #include <time.h>
 
@@ -18,3 +19,11 @@ clock_t cpu_get_idle_time(unsigned int cpu_id) {
 	return thread_get_running_time(cpu_get_idle(cpu_id));
 }
 
+
+unsigned int cpu_get_migrations(unsigned int cpu_id) {
+	return sched_nr_migrations(cpu_id);
+}
+
+unsigned int cpu_get_steals(unsigned int cpu_id) {
+	return sched_nr_steals(cpu_id);
+}
@@ -27,6 +27,7 @@
 #include <kernel/irq_lock.h>
 #include <kernel/irq_stack.h>
 #include <kernel/critical.h>
+#include <kernel/time/tick.h>
 #include <drivers/irqctrl.h>
 #include <hal/ipl.h>
 #include <mem/objalloc.h>
@@ -163,6 +164,8 @@ void irq_dispatch(unsigned int irq_nr) {
 	assertf(irq_stack_protection() == 0,
 			"Stack overflow detected on irq dispatch");
 
+	tick_irq_enter(irq_nr);
+
 	if (irq_table[irq_nr]) {
 		ipl = ipl_save();
 		dlist_foreach_entry(entry, &(irq_table[irq_nr]->entry_list),
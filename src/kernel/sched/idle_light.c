@@ -8,11 +8,14 @@
 
 #include <hal/arch.h>
 #include <kernel/lthread/lthread.h>
+#include <kernel/time/tick.h>
 
 static struct lthread idle;
 
 static int idle_run(struct lthread *self) {
+	tick_idle_enter();
 	arch_idle();
+	tick_irq_enter(-1);
 	lthread_launch(self);
 	return 0;
 }
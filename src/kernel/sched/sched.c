@@ -30,6 +30,7 @@
 
 #include <kernel/critical.h>
 #include <kernel/spinlock.h>
+#include <kernel/cpu/cpudata.h>
 #include <kernel/sched/sched_strategy.h>
 #include <kernel/sched/current.h>
 
@@ -46,8 +47,13 @@
 static void sched_preempt(void);
 CRITICAL_DISPATCHER_DEF(sched_critical, sched_preempt, CRITICAL_SCHED_LOCK);
 
-//TODO these variable for scheduler (may be create object scheduler?)
-static struct runq rq;
+/* Each CPU has its own runq, a schedee is always enqueued to the runq of
+ * a CPU allowed by its affinity. */
+static struct runq rq __cpudata__;
+
+static inline struct runq *sched_cpu_rq(unsigned int cpu_id) {
+	return cpudata_cpu_ptr(cpu_id, &rq);
+}
 
 void sched_post_switch(void) {
 	critical_request_dispatch(&sched_critical);
@@ -58,15 +64,47 @@ static inline int sched_in_interrupt(void) {
 }
 
 int sched_init(struct schedee *current) {
+	struct runq *cpu_rq;
+	unsigned int cpu_id;
 
-	runq_init(&rq.queue);
-	rq.lock = SPIN_UNLOCKED;
+	for (cpu_id = 0; cpu_id < NCPU; cpu_id++) {
+		cpu_rq = sched_cpu_rq(cpu_id);
+
+		runq_init(&cpu_rq->queue);
+		cpu_rq->lock = SPIN_UNLOCKED;
+		cpu_rq->nr_queued = 0;
+		cpu_rq->nr_migrations = 0;
+		cpu_rq->nr_steals = 0;
+	}
 
 	sched_set_current(current);
 
 	return 0;
 }
 
+unsigned int sched_nr_migrations(unsigned int cpu_id) {
+	return sched_cpu_rq(cpu_id)->nr_migrations;
+}
+
+unsigned int sched_nr_steals(unsigned int cpu_id) {
+	return sched_cpu_rq(cpu_id)->nr_steals;
+}
+
+/** Locks: IPL. Returns locked runq where the schedee is or will be queued. */
+static struct runq *sched_lock_rq(struct schedee *s) {
+	struct runq *cpu_rq;
+
+	while (1) {
+		cpu_rq = sched_cpu_rq(s->cpu);
+		spin_lock(&cpu_rq->lock);
+		if (cpu_rq == sched_cpu_rq(s->cpu)) {
+			return cpu_rq;
+		}
+		/* The schedee has been stolen by another CPU meanwhile */
+		spin_unlock(&cpu_rq->lock);
+	}
+}
+
 int schedee_init(struct schedee *schedee, int priority,
 	struct schedee *(*process)(struct schedee *prev, struct schedee *next))
 {
@@ -80,6 +118,8 @@ int schedee_init(struct schedee *schedee, int priority,
 	schedee->active = false;
 	schedee->waiting = true;
 
+	schedee->cpu = cpu_get_id();
+
 	schedee_priority_init(schedee, priority);
 	sched_affinity_init(&schedee->affinity);
 	sched_timing_init(schedee);
@@ -94,75 +134,173 @@ void sched_set_current(struct schedee *schedee) {
 	schedee->ready = true;
 	schedee->active = true;
 	schedee->waiting = false;
+
+	schedee->cpu = cpu_get_id();
 }
 
 static void sched_check_preempt(struct schedee *t) {
+#ifdef SMP
+	if (t->cpu != cpu_get_id()) {
+		/* Let the target CPU compare priorities itself */
+		extern void smp_send_resched(int cpu_id);
+		smp_send_resched(t->cpu);
+		return;
+	}
+#endif /* SMP */
+
 	// TODO ask runq
 	if (schedee_priority_get(schedee_get_current()) <
 			schedee_priority_get(t))
-		sched_post_switch(); // TODO SMP
+		sched_post_switch();
 }
 
 /** Locks: IPL, thread, runq. */
-static void __sched_enqueue(struct schedee *s) {
-	runq_insert(&rq.queue, s);
+static void __sched_enqueue(struct runq *cpu_rq, struct schedee *s) {
+	runq_insert(&cpu_rq->queue, s);
+	cpu_rq->nr_queued++;
 }
 
 /** Locks: IPL, thread, runq. */
-static void __sched_dequeue(struct schedee *s) {
-	runq_remove(&rq.queue, s);
+static void __sched_dequeue(struct runq *cpu_rq, struct schedee *s) {
+	runq_remove(&cpu_rq->queue, s);
+	cpu_rq->nr_queued--;
 }
 
 /** Locks: IPL, thread, runq. */
-static void __sched_enqueue_set_ready(struct schedee *s) {
-	__sched_enqueue(s);
+static void __sched_enqueue_set_ready(struct runq *cpu_rq,
+		struct schedee *s) {
+	__sched_enqueue(cpu_rq, s);
 	s->ready = true;  /* let rq to see the previous state */
 }
 
 /** Locks: IPL, thread, runq. */
 static void __sched_wokenup_clear_waiting(struct schedee *s) {
+	sched_ticker_update(1);
 	sched_check_preempt(s);
 	s->waiting = false;
 }
 
+/**
+ * Locks: IPL, thread.
+ * Selects the least loaded CPU allowed by the affinity of the schedee,
+ * preferring the one it was running on to keep its cache warm. The load is
+ * read without locks, so it's just a hint.
+ */
+static unsigned int sched_select_cpu(struct schedee *s) {
+	unsigned int cpu_id, best;
+
+	best = s->cpu;
+	if (!sched_affinity_check(&s->affinity, 1 << best)) {
+		best = cpu_get_id();
+	}
+
+	for (cpu_id = 0; cpu_id < NCPU; cpu_id++) {
+		if (!sched_affinity_check(&s->affinity, 1 << cpu_id)) {
+			continue;
+		}
+		if (!sched_affinity_check(&s->affinity, 1 << best)
+				|| (sched_cpu_rq(cpu_id)->nr_queued
+					< sched_cpu_rq(best)->nr_queued)) {
+			best = cpu_id;
+		}
+	}
+
+	return best;
+}
+
+#ifdef SMP
+
+/**
+ * Locks: IPL, runq of the current CPU.
+ * Moves the highest priority schedee from the busiest CPU runq to the local
+ * one. Remote runq is only tried to lock to avoid deadlock with a CPU
+ * stealing in the opposite direction.
+ */
+static void sched_steal(struct runq *local_rq) {
+	struct runq *cpu_rq, *busiest;
+	struct schedee *s;
+	unsigned int cpu_id, self_id;
+
+	self_id = cpu_get_id();
+	busiest = NULL;
+
+	for (cpu_id = 0; cpu_id < NCPU; cpu_id++) {
+		cpu_rq = sched_cpu_rq(cpu_id);
+		/* Idle schedee of other CPU is never stolen, so there must be
+		 * something besides it */
+		if (cpu_id != self_id && cpu_rq->nr_queued > 1
+				&& (!busiest || cpu_rq->nr_queued > busiest->nr_queued)) {
+			busiest = cpu_rq;
+		}
+	}
+
+	if (!busiest || !spin_trylock(&busiest->lock)) {
+		return;
+	}
+
+	if (busiest->nr_queued > 1) {
+		/* Schedees bound to the remote CPU are skipped */
+		s = runq_steal(&busiest->queue, 1 << self_id);
+		if (s != NULL) {
+			busiest->nr_queued--;
+			s->cpu = self_id;
+			__sched_enqueue(local_rq, s);
+			local_rq->nr_steals++;
+			local_rq->nr_migrations++;
+		}
+	}
+
+	spin_unlock(&busiest->lock);
+}
+
+#else /* !SMP */
+
+static inline void sched_steal(struct runq *local_rq) { }
+
+#endif /* SMP */
+
 int sched_active(struct schedee *s) {
 	return s->active;
 }
 
 int sched_change_priority(struct schedee *s, int prior,
 		int (*set_priority)(struct schedee_priority *, int)) {
+	struct runq *cpu_rq;
 	ipl_t ipl;
 	int in_rq;
 
 	assert(s);
 
-	ipl = spin_lock_ipl(&rq.lock);
+	ipl = ipl_save();
+	cpu_rq = sched_lock_rq(s);
 	in_rq = s->ready && !sched_active(s);
 
 	if (in_rq)
-		__sched_dequeue(s);
+		__sched_dequeue(cpu_rq, s);
 	set_priority(&s->priority, prior);
 	if (in_rq)
-		__sched_enqueue(s);
+		__sched_enqueue(cpu_rq, s);
 
 	sched_check_preempt(s);
 
-	spin_unlock_ipl(&rq.lock, ipl);
+	spin_unlock(&cpu_rq->lock);
+	ipl_restore(ipl);
 
 	return 0;
 }
 
 static void __sched_freeze(struct schedee *s) {
+	struct runq *cpu_rq;
 	int in_rq;
 
 	assert(s);
 
-	spin_lock(&rq.lock);
+	cpu_rq = sched_lock_rq(s);
 	{
 		in_rq = s->ready && !sched_active(s);
 
 		if (in_rq)
-			__sched_dequeue(s);
+			__sched_dequeue(cpu_rq, s);
 
 		s->ready = false;
 
@@ -170,7 +308,7 @@ static void __sched_freeze(struct schedee *s) {
 		s->active = false;
 		s->waiting = false;
 	}
-	spin_unlock(&rq.lock);
+	spin_unlock(&cpu_rq->lock);
 }
 
 void sched_freeze(struct schedee *s) {
@@ -268,18 +406,20 @@ void sched_freeze(struct schedee *s) {
 
 /** Locks: IPL, thread. */
 static int __sched_wakeup_ready(struct schedee *s) {
+	struct runq *cpu_rq;
 	int ready;
 
-	/* This doesn't necessarily spin until the lock is acquired.
-	 * SMP 'schedule' could outrun us getting the lock, but it will
+	/* SMP 'schedule' could outrun us getting the lock, but it will
 	 * clear t->ready state as soon as possible thus letting us to go. */
-	spin_protected_if (&rq.lock, (ready = s->ready))
+	cpu_rq = sched_lock_rq(s);
+	if ((ready = s->ready))
 		/* Event has arrived before the thread reached 'schedule' and
 		 * went asleep (it could be even preempted after setting its
 		 * t->waiting state).
 		 * Just clear t->waiting state so that only a preemption check
 		 * is done by the thread when it finally invokes the scheduler. */
 		s->waiting = false;
+	spin_unlock(&cpu_rq->lock);
 
 	return ready;
 }
@@ -287,12 +427,22 @@ static int __sched_wakeup_ready(struct schedee *s) {
 
 /** Locks: IPL, thread. */
 static void __sched_wakeup_waiting(struct schedee *s) {
+	struct runq *cpu_rq;
+	unsigned int cpu_id;
+
 	assert(s && s->waiting);
 
-	spin_lock(&rq.lock);
-	__sched_enqueue_set_ready(s);
+	cpu_id = sched_select_cpu(s);
+	cpu_rq = sched_cpu_rq(cpu_id);
+
+	spin_lock(&cpu_rq->lock);
+	if (cpu_id != s->cpu) {
+		cpu_rq->nr_migrations++;
+		s->cpu = cpu_id;
+	}
+	__sched_enqueue_set_ready(cpu_rq, s);
 	__sched_wokenup_clear_waiting(s);
-	spin_unlock(&rq.lock);
+	spin_unlock(&cpu_rq->lock);
 }
 
 #ifdef SMP
@@ -368,13 +518,15 @@ void sched_start_switch(struct schedee *next) {
 /** locks: sched */
 static void __schedule(int preempt) {
 	ipl_t ipl;
+	struct runq *cpu_rq;
 	struct schedee *prev;
 	struct schedee *next;
 
 	prev = schedee_get_current();
 
 	assert(!sched_in_interrupt());
-	ipl = spin_lock_ipl(&rq.lock);
+	cpu_rq = sched_cpu_rq(cpu_get_id());
+	ipl = spin_lock_ipl(&cpu_rq->lock);
 
 	if (!preempt && prev->waiting)
 		prev->ready = false;
@@ -384,16 +536,22 @@ static void __schedule(int preempt) {
 		 * without really waking it up.
 		 * 'sched_finish_switch' will sort out what to do in such case. */
 	else
-		__sched_enqueue(prev);
+		__sched_enqueue(cpu_rq, prev);
 
 	sched_timing_stop(prev);
 
 	while (1) {
-		next = runq_extract(&rq.queue);
+		if (cpu_rq->nr_queued <= 1) {
+			/* Nothing but the idle schedee is left */
+			sched_steal(cpu_rq);
+		}
+
+		next = runq_extract(&cpu_rq->queue);
+		cpu_rq->nr_queued--;
 
 		/* Runq is unlocked as soon as possible, but interrupts remain disabled
 		 * during the 'sched_switch' (if any). */
-		spin_unlock(&rq.lock);
+		spin_unlock(&cpu_rq->lock);
 
 		schedee_set_current(next);
 		log_debug("prev: %#x, next: %#x", prev, next);
@@ -406,7 +564,12 @@ static void __schedule(int preempt) {
 		}
 
 		/* ipl is enabled, no need to save it. */
-		spin_lock_ipl_disable(&rq.lock);
+		spin_lock_ipl_disable(&cpu_rq->lock);
+	}
+
+	if (next == prev) {
+		/* Nobody else could take the CPU, no need to slice the time */
+		sched_ticker_update(0);
 	}
 
 	sched_timing_start(next);
@@ -10,6 +10,7 @@
 #include <hal/cpu.h>
 #include <kernel/sched.h>
 
+#include <kernel/time/time.h>
 #include <kernel/time/timer.h>
 #include <kernel/cpu/cpu.h>
 
@@ -23,8 +24,13 @@ EMBOX_UNIT_INIT(sched_ticker_module_init);
 
 #define SCHED_TICK_INTERVAL \
 	OPTION_GET(NUMBER, tick_interval)
+#define SCHED_TICK_ON_DEMAND \
+	OPTION_GET(BOOLEAN, on_demand)
 
-static struct sys_timer *sched_tick_timer;
+static struct sys_timer sched_tick_timer;
+
+static int sched_tick_enabled; /* current policy is time sliced */
+static int sched_tick_shared = 1; /* there are other ready schedees */
 
 static void sched_tick(sys_timer_t *timer, void *param) {
 	sched_post_switch();
@@ -37,15 +43,24 @@ static void sched_tick(sys_timer_t *timer, void *param) {
 #endif /* SMP */
 }
 
-void sched_ticker_init(void) {
-	if (timer_set(&sched_tick_timer, TIMER_PERIODIC, SCHED_TICK_INTERVAL,
-			sched_tick, NULL)) {
-		panic("Scheduler initialization failed!\n");
+static void sched_ticker_refresh(void) {
+	if (sched_tick_enabled && sched_tick_shared) {
+		if (!timer_is_started(&sched_tick_timer)) {
+			timer_start(&sched_tick_timer, ms2jiffies(SCHED_TICK_INTERVAL));
+		}
+	} else {
+		timer_stop(&sched_tick_timer);
 	}
 }
 
+void sched_ticker_init(void) {
+	sched_tick_enabled = 1;
+	sched_ticker_refresh();
+}
+
 void sched_ticker_fini(void) {
-	timer_close(sched_tick_timer);  // TODO err check?
+	sched_tick_enabled = 0;
+	sched_ticker_refresh();
 }
 
 void sched_ticker_switch(int prev_policy, int next_policy) {
@@ -60,8 +75,19 @@ void sched_ticker_switch(int prev_policy, int next_policy) {
 	}
 }
 
+void sched_ticker_update(int shared) {
+	/* Without the tick the CPU can stay idle for long in tickless mode */
+	if (SCHED_TICK_ON_DEMAND && (sched_tick_shared != shared)) {
+		sched_tick_shared = shared;
+		sched_ticker_refresh();
+	}
+}
+
 static int sched_ticker_module_init(void) {
+	if (timer_init(&sched_tick_timer, TIMER_PERIODIC, sched_tick, NULL)) {
+		panic("Scheduler initialization failed!\n");
+	}
+
 	sched_ticker_init();
 	return 0;
 }
-
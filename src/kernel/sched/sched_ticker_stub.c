@@ -11,3 +11,5 @@ void sched_ticker_init(void) { }
 void sched_ticker_fini(void) { }
 
 void sched_ticker_switch(int prev_policy, int next_policy) { }
+
+void sched_ticker_update(int shared) { }
@@ -0,0 +1,98 @@
+/**
+ * @file
+ * @brief O(1) run queue
+ *
+ * @details
+ *   Schedees of the same priority are kept in FIFO list, non-empty lists
+ *   are marked in the two-level bitmap. The highest priority is found with
+ *   two find-last-set operations regardless of the number of priorities.
+ *
+ * @date 17.10.2026
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stddef.h>
+
+#include <util/bit.h>
+#include <util/bitmap.h>
+#include <util/dlist.h>
+
+#include <kernel/sched.h>
+#include <kernel/sched/schedee_priority.h>
+#include <kernel/sched/sched_strategy.h>
+
+static_assert(RUNQ_BITMAP_WORDS <= LONG_BIT);
+
+void runq_item_init(runq_item_t *runq_link) {
+	dlist_head_init(runq_link);
+}
+
+void runq_init(runq_t *queue) {
+	int i;
+
+	queue->summary = 0;
+	bitmap_clear_all(queue->bitmap, SCHED_PRIORITY_TOTAL);
+
+	for (i = 0; i < SCHED_PRIORITY_TOTAL; i++) {
+		dlist_init(&queue->list[i]);
+	}
+}
+
+void runq_insert(runq_t *queue, struct schedee *s) {
+	int prio = schedee_priority_get(s) - SCHED_PRIORITY_MIN;
+
+	dlist_add_prev(&s->runq_link, &queue->list[prio]);
+
+	bitmap_set_bit(queue->bitmap, prio);
+	queue->summary |= 1ul << BITMAP_OFFSET(prio);
+}
+
+void runq_remove(runq_t *queue, struct schedee *s) {
+	int prio = schedee_priority_get(s) - SCHED_PRIORITY_MIN;
+
+	dlist_del(&s->runq_link);
+
+	if (dlist_empty(&queue->list[prio])) {
+		bitmap_clear_bit(queue->bitmap, prio);
+		if (!queue->bitmap[BITMAP_OFFSET(prio)]) {
+			queue->summary &= ~(1ul << BITMAP_OFFSET(prio));
+		}
+	}
+}
+
+struct schedee *runq_extract(runq_t *queue) {
+	struct schedee *s;
+	int word, prio;
+
+	if (!queue->summary) {
+		return NULL;
+	}
+
+	word = bit_fls(queue->summary) - 1;
+	prio = word * LONG_BIT + bit_fls(queue->bitmap[word]) - 1;
+
+	s = dlist_first_entry(&queue->list[prio], struct schedee, runq_link);
+	runq_remove(queue, s);
+
+	return s;
+}
+
+struct schedee *runq_steal(runq_t *queue, unsigned int mask) {
+	struct schedee *s;
+	int prio;
+
+	for (prio = SCHED_PRIORITY_TOTAL - 1; prio >= 0; prio--) {
+		if (!bitmap_test_bit(queue->bitmap, prio)) {
+			continue;
+		}
+		dlist_foreach_entry(s, &queue->list[prio], runq_link) {
+			if (sched_affinity_check(&s->affinity, mask)) {
+				runq_remove(queue, s);
+				return s;
+			}
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,30 @@
+/**
+ * @file
+ * @brief Run queue with a list per priority indexed by a priority bitmap
+ *
+ * @date 17.10.2026
+ */
+
+#ifndef KERNEL_SCHED_RUNQ_BITMAP_H_
+#define KERNEL_SCHED_RUNQ_BITMAP_H_
+
+#include <util/bitmap.h>
+#include <util/dlist.h>
+
+#include <kernel/sched/schedee_priority.h>
+
+#define RUNQ_BITMAP_WORDS BITMAP_SIZE(SCHED_PRIORITY_TOTAL)
+
+struct runq_queue {
+	/* Bit of a word is set if the priority list is not empty, bit of the
+	 * summary is set if the word is not zero. */
+	unsigned long summary;
+	unsigned long bitmap[RUNQ_BITMAP_WORDS];
+	struct dlist_head list[SCHED_PRIORITY_TOTAL];
+};
+
+typedef struct dlist_head runq_item_t;
+
+typedef struct runq_queue runq_t;
+
+#endif /* KERNEL_SCHED_RUNQ_BITMAP_H_ */
@@ -8,6 +8,7 @@
 
 #include <util/dlist.h>
 
+#include <kernel/sched.h>
 #include <kernel/sched/sched_strategy.h>
 
 struct schedee;
@@ -36,3 +37,16 @@ struct schedee *runq_extract(runq_t *queue) {
 
 	return schedee;
 }
+
+struct schedee *runq_steal(runq_t *queue, unsigned int mask) {
+	struct schedee *schedee;
+
+	dlist_foreach_entry(schedee, queue, runq_link) {
+		if (sched_affinity_check(&schedee->affinity, mask)) {
+			runq_remove(queue, schedee);
+			return schedee;
+		}
+	}
+
+	return NULL;
+}
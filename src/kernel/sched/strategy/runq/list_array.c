@@ -40,7 +40,10 @@ void runq_remove(runq_t *queue, struct schedee *schedee) {
 }
 
 struct schedee *runq_extract(runq_t *queue) {
-	const unsigned int mask = 1 << cpu_get_id();
+	return runq_steal(queue, 1 << cpu_get_id());
+}
+
+struct schedee *runq_steal(runq_t *queue, unsigned int mask) {
 	struct schedee *schedee = NULL;
 	int i;
 
@@ -38,3 +38,16 @@ struct schedee *runq_extract(runq_t *queue) {
 
 	return result;
 }
+
+struct schedee *runq_steal(runq_t *queue, unsigned int mask) {
+	struct schedee *s;
+
+	priolist_foreach_entry(s, queue, runq_link) {
+		if (sched_affinity_check(&s->affinity, mask)) {
+			runq_remove(queue, s);
+			return s;
+		}
+	}
+
+	return NULL;
+}
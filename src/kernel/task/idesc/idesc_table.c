@@ -13,6 +13,7 @@
 #include <string.h>
 
 #include <fs/idesc.h>
+#include <fs/idesc_event.h>
 #include <kernel/task.h>
 
 #include <kernel/task/resource/idesc_table.h>
@@ -82,6 +83,10 @@ void idesc_table_del(struct idesc_table *t, int idx) {
 	assert(idesc->idesc_ops && idesc->idesc_ops->close);
 
 	if (!(--idesc->idesc_count)) {
+		/* Descriptor is forgotten by everyone who watches it */
+		if (!dlist_empty(&idesc->idesc_hooks)) {
+			idesc_event_release(idesc);
+		}
 		idesc->idesc_ops->close(idesc);
 	}
 
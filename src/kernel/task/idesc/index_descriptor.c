@@ -170,3 +170,19 @@ int index_descriptor_fstat(int fd, struct stat *buff) {
 	}
 	return idesc->idesc_ops->fstat(idesc, buff);
 }
+
+int index_descriptor_fsync(int fd) {
+	struct idesc *idesc;
+
+	idesc = index_descriptor_get(fd);
+	if (!idesc) {
+		return -ENOENT;
+	}
+
+	assert(idesc->idesc_ops);
+	if (!idesc->idesc_ops->fsync) {
+		/* Nothing is cached */
+		return 0;
+	}
+	return idesc->idesc_ops->fsync(idesc);
+}
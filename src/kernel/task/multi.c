@@ -21,6 +21,7 @@
 #include <kernel/task/resource/errno.h>
 #include <kernel/task/task_table.h>
 #include <kernel/thread.h>
+#include <mem/tcache.h>
 
 #include <util/binalign.h>
 #include <util/err.h>
@@ -276,6 +277,13 @@ void task_do_exit(struct task *task, int status) {
 
 	task->status = status;
 
+	/* Threads are terminated after the heap is released, so their cached
+	 * blocks are returned now */
+	tcache_flush(main_thr);
+	dlist_foreach_entry(thr, &main_thr->thread_link, thread_link) {
+		tcache_flush(thr);
+	}
+
 	/* Deinitialize all resources */
 	task_resource_deinit(task);
 
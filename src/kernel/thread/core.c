@@ -22,6 +22,7 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 
 #include <embox/unit.h>
@@ -35,6 +36,7 @@
 #include <kernel/thread/thread_sched_wait.h>
 #include <kernel/sched/schedee_priority.h>
 #include <kernel/sched/current.h>
+#include <mem/tcache.h>
 #include <hal/cpu.h>
 #include <kernel/cpu/cpu.h>
 #include <kernel/cpu/cpudata.h>
@@ -206,6 +208,8 @@ void thread_init(struct thread *t, int priority,
 		panic("can't initialize thread_local");
 	}
 
+	memset(&t->tcache, 0, sizeof(t->tcache));
+
 	t->joining = NULL;
 
 	t->run = run;
@@ -282,6 +286,9 @@ void _NORETURN thread_exit(void *ret) {
 		/* NOTREACHED */
 	}
 
+	/* Heap blocks cached by the thread are returned to its task */
+	tcache_flush(current);
+
 	sched_lock();
 
 	// sched_finish(current);
@@ -391,6 +398,9 @@ int thread_terminate(struct thread *t) {
 
 		t->state |= TS_EXITED;
 
+		/* Heap blocks cached by the thread are returned to its task */
+		tcache_flush(t);
+
 		// XXX prevent scheduler to add thread in runq
 		if (t == thread_self()) {
 			t->schedee.waiting = true;
@@ -0,0 +1,14 @@
+/**
+ * @file
+ * @brief Periodic tick is never stopped
+ *
+ * @date 17.10.2026
+ */
+
+#include <kernel/time/tick.h>
+
+void tick_idle_enter(void) {
+}
+
+void tick_irq_enter(int irq_nr) {
+}
@@ -0,0 +1,83 @@
+/**
+ * @file
+ * @brief Tickless idle: the periodic tick is stopped while the CPU is idle
+ *
+ * @details
+ *   Before halting the CPU the idle thread asks the timer strategy for the
+ *   nearest timer expiration and programs the event device to fire then.
+ *   The first interrupt after that restores the periodic tick and advances
+ *   jiffies by the number of ticks passed in between, and the timer handler
+ *   processes all of them at once.
+ *
+ * @date 17.10.2026
+ */
+
+#include <assert.h>
+
+#include <framework/mod/options.h>
+#include <hal/ipl.h>
+#include <kernel/time/clock_source.h>
+#include <kernel/time/tick.h>
+#include <kernel/time/timer.h>
+#include <module/embox/kernel/time/slowdown.h>
+#include <util/math.h>
+
+#define SLOWDOWN_SHIFT OPTION_MODULE_GET(embox__kernel__time__slowdown, NUMBER, shift)
+
+extern struct clock_source *cs_jiffies;
+
+static int tick_stopped;
+static clock_t tick_stop_jiffies; /* jiffies when the tick was stopped */
+static clock_t tick_stop_ticks; /* ticks until the programmed event */
+
+void tick_idle_enter(void) {
+	struct time_event_device *ed;
+	clock_t ticks;
+	ipl_t ipl;
+
+	ed = cs_jiffies->event_device;
+	if (SLOWDOWN_SHIFT != 0 || !ed->set_oneshot) {
+		return;
+	}
+
+	ipl = ipl_save();
+	{
+		ticks = timer_strat_next_event();
+		if (!tick_stopped && ticks > 1) {
+			tick_stop_ticks = min(ticks, ed->max_oneshot);
+			tick_stop_jiffies = cs_jiffies->jiffies;
+			ed->set_oneshot(ed, tick_stop_ticks);
+			tick_stopped = 1;
+		}
+	}
+	ipl_restore(ipl);
+}
+
+void tick_irq_enter(int irq_nr) {
+	struct time_event_device *ed;
+	clock_t passed;
+	int fired;
+	ipl_t ipl;
+
+	if (!tick_stopped) {
+		return;
+	}
+
+	ed = cs_jiffies->event_device;
+
+	ipl = ipl_save();
+	if (tick_stopped) {
+		fired = (irq_nr == ed->irq_nr)
+				|| (ed->pending && ed->pending(ed->irq_nr));
+
+		passed = ed->set_oneshot(ed, 0);
+		if (fired) {
+			/* The event itself is counted by clock_tick_handler() */
+			passed = tick_stop_ticks - 1;
+		}
+
+		cs_jiffies->jiffies = tick_stop_jiffies + passed;
+		tick_stopped = 0;
+	}
+	ipl_restore(ipl);
+}
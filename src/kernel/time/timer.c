@@ -21,6 +21,9 @@ EMBOX_UNIT_INIT(init);
 
 static int inited = 0;
 
+/* Jiffies already passed to the timer strategy */
+static clock_t sched_jiffies;
+
 static struct lthread clock_handler_lt;
 extern struct clock_source *cs_jiffies;
 
@@ -45,7 +48,12 @@ void clock_tick_handler(int irq_num, void *dev_id) {
 }
 
 static int clock_handler(struct lthread *self) {
-	timer_strat_sched();
+	/* Several jiffies could pass before the handler has run, e.g. when
+	 * the tick was stopped in idle */
+	while (sched_jiffies != cs_jiffies->jiffies) {
+		sched_jiffies++;
+		timer_strat_sched();
+	}
 	return 0;
 }
 
@@ -53,6 +61,8 @@ static int init(void) {
 	lthread_init(&clock_handler_lt, &clock_handler);
 	schedee_priority_set(&clock_handler_lt.schedee, CLOCK_HND_PRIORITY);
 
+	sched_jiffies = cs_jiffies->jiffies;
+
 	inited = 1;
 
 	return 0;
@@ -10,9 +10,15 @@
 
 #include <kernel/time/timer.h>
 
-static DLIST_DEFINE(sys_timers_list); /* list head to timers */
+static struct timer_queue sys_timers = { /* list head to timers */
+	.timers = DLIST_INIT(sys_timers.timers),
+};
 
-void timer_strat_start(struct sys_timer *tmr) {
+void timer_queue_init(struct timer_queue *queue) {
+	dlist_init(&queue->timers);
+}
+
+void timer_queue_start(struct timer_queue *queue, struct sys_timer *tmr) {
 	struct sys_timer *it_tmr;
 
 	dlist_head_init(&tmr->lnk);
@@ -21,7 +27,7 @@ void timer_strat_start(struct sys_timer *tmr) {
 	tmr->cnt = tmr->load;
 
 	/* find first element that its time bigger than inserting @new_time */
-	dlist_foreach_entry(it_tmr, &sys_timers_list, lnk) {
+	dlist_foreach_entry(it_tmr, &queue->timers, lnk) {
 		if (it_tmr->cnt >= tmr->cnt) {
 			/* decrease value of next timer after inserting */
 			it_tmr->cnt -= tmr->cnt;
@@ -35,15 +41,15 @@ void timer_strat_start(struct sys_timer *tmr) {
 	}
 
 	/* add the latest timer to end of list */
-	dlist_add_prev(&tmr->lnk, &sys_timers_list);
+	dlist_add_prev(&tmr->lnk, &queue->timers);
 }
 
-void timer_strat_stop(struct sys_timer *ptimer) {
+void timer_queue_stop(struct timer_queue *queue, struct sys_timer *ptimer) {
 	struct sys_timer *next_tmr;
 
 	timer_set_stopped(ptimer);
 
-	if (ptimer->lnk.next != &sys_timers_list) {
+	if (ptimer->lnk.next != &queue->timers) {
 		next_tmr = (struct sys_timer *)ptimer->lnk.next;
 		next_tmr->cnt += ptimer->cnt;
 	}
@@ -51,29 +57,38 @@ void timer_strat_stop(struct sys_timer *ptimer) {
 	dlist_del(&ptimer->lnk);
 }
 
-static inline bool timers_need_schedule(void) {
-	if (dlist_empty(&sys_timers_list)) {
+clock_t timer_queue_next_event(struct timer_queue *queue) {
+	if (dlist_empty(&queue->timers)) {
+		return (clock_t) -1;
+	}
+
+	/* The first timer counts ticks until its expiration */
+	return ((sys_timer_t *) queue->timers.next)->cnt;
+}
+
+static inline bool timers_need_schedule(struct timer_queue *queue) {
+	if (dlist_empty(&queue->timers)) {
 		return false;
 	}
 
-	if (0 == --((sys_timer_t*)sys_timers_list.next)->cnt) {
+	if (0 == --((sys_timer_t*)queue->timers.next)->cnt) {
 		return true;
 	} else {
 		return false;
 	}
 }
 
-static inline void timers_schedule(void) {
+static inline void timers_schedule(struct timer_queue *queue) {
 	struct sys_timer *timer;
 
-	dlist_foreach_entry(timer, &sys_timers_list, lnk) {
+	dlist_foreach_entry(timer, &queue->timers, lnk) {
 		if (0 != timer->cnt) {
 			break;
 		}
 
-		timer_strat_stop(timer);
+		timer_queue_stop(queue, timer);
 		if (timer_is_periodic(timer)) {
-			timer_strat_start(timer);
+			timer_queue_start(queue, timer);
 		}
 
 		timer->handle(timer, timer->param);
@@ -85,8 +100,24 @@ static inline void timers_schedule(void) {
  * and the counter of this timer is the zero then its initial value is assigned
  * to the counter and the function is executed.
  */
-void timer_strat_sched(void) {
-	if (timers_need_schedule()) {
-		timers_schedule();
+void timer_queue_sched(struct timer_queue *queue) {
+	if (timers_need_schedule(queue)) {
+		timers_schedule(queue);
 	}
 }
+
+void timer_strat_start(struct sys_timer *tmr) {
+	timer_queue_start(&sys_timers, tmr);
+}
+
+void timer_strat_stop(struct sys_timer *ptimer) {
+	timer_queue_stop(&sys_timers, ptimer);
+}
+
+clock_t timer_strat_next_event(void) {
+	return timer_queue_next_event(&sys_timers);
+}
+
+void timer_strat_sched(void) {
+	timer_queue_sched(&sys_timers);
+}
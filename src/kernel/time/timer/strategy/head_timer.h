@@ -15,5 +15,9 @@
 
 typedef struct dlist_head sys_timer_queue_t;
 
+struct timer_queue {
+	struct dlist_head timers;
+};
+
 
 #endif /* HEAD_TIMER_H_ */
@@ -13,9 +13,15 @@
 
 #include <kernel/time/timer.h>
 
-static DLIST_DEFINE(sys_timers_list);
+static struct timer_queue sys_timers = {
+	.timers = DLIST_INIT(sys_timers.timers),
+};
 
-void timer_strat_start(struct sys_timer *tmr) {
+void timer_queue_init(struct timer_queue *queue) {
+	dlist_init(&queue->timers);
+}
+
+void timer_queue_start(struct timer_queue *queue, struct sys_timer *tmr) {
 	ipl_t ipl;
 
 	timer_set_started(tmr);
@@ -27,7 +33,7 @@ void timer_strat_start(struct sys_timer *tmr) {
  	 * be processed. Otherwise, if a new timer added while handling some
 	 * other one, it will be processed during same timer_strat_sched
 	 * request, not the next. */
-	dlist_add_next(&tmr->lnk, &sys_timers_list);
+	dlist_add_next(&tmr->lnk, &queue->timers);
 	ipl_restore(ipl);
 }
 
@@ -36,15 +42,15 @@ void timer_strat_start(struct sys_timer *tmr) {
  * and the counter of this timer is the zero then its initial value is assigned
  * to the counter and the function is executed.
  */
-void timer_strat_sched(void) {
+void timer_queue_sched(struct timer_queue *queue) {
 	sys_timer_t *tmr;
 
-	dlist_foreach_entry(tmr, &sys_timers_list, lnk) {
+	dlist_foreach_entry(tmr, &queue->timers, lnk) {
 		if (0 == tmr->cnt--) {
 			if (timer_is_periodic(tmr)) {
 				tmr->cnt = tmr->load;
 			} else {
-				timer_strat_stop(tmr);
+				timer_queue_stop(queue, tmr);
 			}
 
 			tmr->handle(tmr, tmr->param);
@@ -52,7 +58,26 @@ void timer_strat_sched(void) {
 	}
 }
 
-void timer_strat_stop(struct sys_timer *tmr) {
+clock_t timer_queue_next_event(struct timer_queue *queue) {
+	ipl_t ipl;
+	sys_timer_t *tmr;
+	clock_t next;
+
+	next = (clock_t) -1;
+
+	ipl = ipl_save();
+	dlist_foreach_entry(tmr, &queue->timers, lnk) {
+		/* Timer expires when its counter is zero before decrement */
+		if (tmr->cnt + 1 < next) {
+			next = tmr->cnt + 1;
+		}
+	}
+	ipl_restore(ipl);
+
+	return next;
+}
+
+void timer_queue_stop(struct timer_queue *queue, struct sys_timer *tmr) {
 	ipl_t ipl;
 
 	timer_set_stopped(tmr);
@@ -61,3 +86,19 @@ void timer_strat_stop(struct sys_timer *tmr) {
 	dlist_del(&tmr->lnk);
 	ipl_restore(ipl);
 }
+
+void timer_strat_start(struct sys_timer *tmr) {
+	timer_queue_start(&sys_timers, tmr);
+}
+
+void timer_strat_sched(void) {
+	timer_queue_sched(&sys_timers);
+}
+
+clock_t timer_strat_next_event(void) {
+	return timer_queue_next_event(&sys_timers);
+}
+
+void timer_strat_stop(struct sys_timer *tmr) {
+	timer_queue_stop(&sys_timers, tmr);
+}
@@ -14,4 +14,8 @@
 
 typedef struct dlist_head sys_timer_queue_t;
 
+struct timer_queue {
+	struct dlist_head timers;
+};
+
 #endif /* LIST_TIMER_H_ */
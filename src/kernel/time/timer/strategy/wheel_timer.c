@@ -0,0 +1,224 @@
+/**
+ * @file
+ * @brief Hierarchical timing wheel.
+ *
+ * @details
+ *   Timers expiring within the next ROOT_SIZE ticks are kept in the root
+ *   wheel, one slot per tick. Later timers are kept in one of the upper
+ *   wheels, each slot of which covers a whole turn of the wheel below. When
+ *   a lower wheel wraps around, the next slot of the upper wheel is
+ *   cascaded down. So start and stop are O(1) and each timer is moved at
+ *   most WHEEL_LVL_CNT times before it expires.
+ *
+ *   Timer expiry tick is stored in @c cnt field of the timer.
+ *
+ * @date 17.10.2026
+ */
+
+#include <stdint.h>
+
+#include <hal/ipl.h>
+#include <util/array.h>
+#include <util/dlist.h>
+
+#include <kernel/time/timer.h>
+
+#define ROOT_BITS TIMER_WHEEL_ROOT_BITS
+#define ROOT_SIZE (1 << ROOT_BITS)
+#define ROOT_MASK (ROOT_SIZE - 1)
+
+#define WHEEL_BITS TIMER_WHEEL_BITS
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+
+/* ROOT_BITS + WHEEL_LVL_CNT * WHEEL_BITS covers 32 bits, but ticks are
+ * compared modulo 2^32, so a timer can be set at most 2^31 - 1 ticks ahead.
+ * Longer delay is taken as already expired */
+#define WHEEL_LVL_CNT TIMER_WHEEL_LVL_CNT
+
+#define WHEEL_SHIFT(lvl) (ROOT_BITS + (lvl) * WHEEL_BITS)
+#define WHEEL_INDEX(tick, lvl) (((tick) >> WHEEL_SHIFT(lvl)) & WHEEL_MASK)
+
+static struct timer_queue sys_timers;
+
+void timer_queue_init(struct timer_queue *queue) {
+	struct dlist_head *slot;
+	int lvl;
+
+	array_foreach_ptr(slot, queue->root, ARRAY_SIZE(queue->root)) {
+		dlist_init(slot);
+	}
+
+	for (lvl = 0; lvl < WHEEL_LVL_CNT; lvl++) {
+		array_foreach_ptr(slot, queue->lvl[lvl], ARRAY_SIZE(queue->lvl[lvl])) {
+			dlist_init(slot);
+		}
+	}
+
+	queue->tick = 0;
+	queue->inited = 1;
+}
+
+/* Timers can be started before any unit is initialized, so the system
+ * wheels are initialized on the first use */
+static void wheel_check_init(struct timer_queue *queue) {
+	if (!queue->inited) {
+		timer_queue_init(queue);
+	}
+}
+
+static void wheel_add(struct timer_queue *queue, struct sys_timer *tmr) {
+	uint32_t expires, delta;
+	struct dlist_head *slot;
+	int lvl;
+
+	expires = tmr->cnt;
+	delta = expires - queue->tick;
+
+	if ((int32_t)delta < 0) {
+		/* Already expired, process it on the next tick */
+		slot = &queue->root[queue->tick & ROOT_MASK];
+	} else if (delta < ROOT_SIZE) {
+		slot = &queue->root[expires & ROOT_MASK];
+	} else {
+		for (lvl = 0; lvl < WHEEL_LVL_CNT - 1; lvl++) {
+			if (delta < (1UL << WHEEL_SHIFT(lvl + 1))) {
+				break;
+			}
+		}
+		slot = &queue->lvl[lvl][WHEEL_INDEX(expires, lvl)];
+	}
+
+	dlist_add_prev(&tmr->lnk, slot);
+}
+
+/* Moves all timers from the upper wheel slot to the lower wheels */
+static int wheel_cascade(struct timer_queue *queue, int lvl, int index) {
+	struct dlist_head *slot;
+	struct sys_timer *tmr;
+
+	slot = &queue->lvl[lvl][index];
+	while (!dlist_empty(slot)) {
+		tmr = dlist_first_entry(slot, struct sys_timer, lnk);
+		dlist_del_init(&tmr->lnk);
+		wheel_add(queue, tmr);
+	}
+
+	return index;
+}
+
+void timer_queue_start(struct timer_queue *queue, struct sys_timer *tmr) {
+	ipl_t ipl;
+
+	timer_set_started(tmr);
+
+	dlist_head_init(&tmr->lnk);
+
+	ipl = ipl_save();
+	{
+		wheel_check_init(queue);
+		/* Timer expires after @c load calls of timer_queue_sched() */
+		tmr->cnt = queue->tick + (tmr->load ? tmr->load : 1) - 1;
+		wheel_add(queue, tmr);
+	}
+	ipl_restore(ipl);
+}
+
+void timer_queue_stop(struct timer_queue *queue, struct sys_timer *tmr) {
+	ipl_t ipl;
+
+	timer_set_stopped(tmr);
+
+	ipl = ipl_save();
+	{
+		dlist_del_init(&tmr->lnk);
+	}
+	ipl_restore(ipl);
+}
+
+void timer_queue_sched(struct timer_queue *queue) {
+	ipl_t ipl;
+	struct dlist_head *slot;
+	struct sys_timer *tmr;
+	int index, lvl;
+
+	ipl = ipl_save();
+
+	wheel_check_init(queue);
+
+	index = queue->tick & ROOT_MASK;
+	for (lvl = 0; !index && lvl < WHEEL_LVL_CNT; lvl++) {
+		index = wheel_cascade(queue, lvl, WHEEL_INDEX(queue->tick, lvl));
+	}
+
+	slot = &queue->root[queue->tick & ROOT_MASK];
+	queue->tick++;
+
+	/* Timers started from handlers never land into the current slot, since
+	 * their expiry tick is not less than the current one */
+	while (!dlist_empty(slot)) {
+		tmr = dlist_first_entry(slot, struct sys_timer, lnk);
+
+		timer_set_stopped(tmr);
+		dlist_del_init(&tmr->lnk);
+		if (timer_is_periodic(tmr)) {
+			timer_set_started(tmr);
+			tmr->cnt = queue->tick + (tmr->load ? tmr->load : 1) - 1;
+			wheel_add(queue, tmr);
+		}
+
+		ipl_restore(ipl);
+		tmr->handle(tmr, tmr->param);
+		ipl = ipl_save();
+	}
+
+	ipl_restore(ipl);
+}
+
+clock_t timer_queue_next_event(struct timer_queue *queue) {
+	ipl_t ipl;
+	clock_t next;
+	uint32_t tick;
+	int lvl, index, upper;
+
+	next = (clock_t) -1;
+
+	ipl = ipl_save();
+	wheel_check_init(queue);
+
+	upper = 0;
+	for (lvl = 0; lvl < WHEEL_LVL_CNT && !upper; lvl++) {
+		for (index = 0; index < WHEEL_SIZE && !upper; index++) {
+			upper = !dlist_empty(&queue->lvl[lvl][index]);
+		}
+	}
+
+	/* Root wheel is exact, upper wheels timers are cascaded to the root
+	 * no earlier than the next tick which is multiple of ROOT_SIZE */
+	for (tick = queue->tick; tick != queue->tick + ROOT_SIZE; tick++) {
+		if ((upper && !(tick & ROOT_MASK))
+				|| !dlist_empty(&queue->root[tick & ROOT_MASK])) {
+			next = tick - queue->tick + 1;
+			break;
+		}
+	}
+	ipl_restore(ipl);
+
+	return next;
+}
+
+void timer_strat_start(struct sys_timer *tmr) {
+	timer_queue_start(&sys_timers, tmr);
+}
+
+void timer_strat_stop(struct sys_timer *tmr) {
+	timer_queue_stop(&sys_timers, tmr);
+}
+
+void timer_strat_sched(void) {
+	timer_queue_sched(&sys_timers);
+}
+
+clock_t timer_strat_next_event(void) {
+	return timer_queue_next_event(&sys_timers);
+}
@@ -0,0 +1,29 @@
+/**
+ * @file
+ *
+ * @brief Hierarchical timing wheel timer strategy
+ *
+ * @date 17.10.2026
+ */
+
+#ifndef WHEEL_TIMER_H_
+#define WHEEL_TIMER_H_
+
+#include <stdint.h>
+
+#include <util/dlist.h>
+
+#define TIMER_WHEEL_ROOT_BITS 8
+#define TIMER_WHEEL_BITS      6
+#define TIMER_WHEEL_LVL_CNT   4
+
+typedef struct dlist_head sys_timer_queue_t;
+
+struct timer_queue {
+	struct dlist_head root[1 << TIMER_WHEEL_ROOT_BITS];
+	struct dlist_head lvl[TIMER_WHEEL_LVL_CNT][1 << TIMER_WHEEL_BITS];
+	uint32_t tick; /* The tick which will be processed by the next sched */
+	int inited;
+};
+
+#endif /* WHEEL_TIMER_H_ */
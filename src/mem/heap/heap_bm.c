@@ -315,6 +315,55 @@ void bm_free(void *heap, void *ptr) {
 	sched_unlock();
 }
 
+size_t bm_block_size(void *ptr) {
+	struct free_block *block;
+
+	block = (struct free_block *) ((uint32_t *) ptr - 1);
+	if (!block_is_busy(block)) {
+		return 0;
+	}
+	return get_clear_size(block->size) - sizeof(block->size);
+}
+
+void bm_get_stat(void *heap, size_t *free, size_t *largest_free) {
+	struct free_block *block;
+	struct free_block_link *link;
+	struct free_block_link *free_blocks_list;
+	size_t size;
+
+	*free = 0;
+	*largest_free = 0;
+
+	sched_lock();
+
+	free_blocks_list = heap_get_free_blocks(heap);
+	for (link = free_blocks_list->next; link != free_blocks_list; link = link->next) {
+		block = (struct free_block *) ((uint32_t *) link - 1);
+		size = get_clear_size(block->size) - sizeof(block->size);
+
+		*free += size;
+		*largest_free = max(*largest_free, size);
+	}
+
+	sched_unlock();
+}
+
+int bm_is_empty(void *heap, size_t size) {
+	struct free_block_link *free_blocks_list;
+	struct free_block *block;
+
+	free_blocks_list = heap_get_free_blocks(heap);
+	if (free_blocks_list->next != free_blocks_list->prev) {
+		return 0;
+	}
+
+	/* The only free block is the initial one of the whole size */
+	block = heap + sizeof *free_blocks_list;
+	return (free_blocks_list->next == &block->link)
+		&& (get_clear_size(block->size) == get_clear_size(size
+				- (sizeof *free_blocks_list + sizeof block->size)));
+}
+
 void bm_init(void *heap, size_t size) {
 	struct free_block *block;
 	struct free_block_link *free_blocks_list;
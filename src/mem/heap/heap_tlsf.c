@@ -0,0 +1,478 @@
+/**
+ * @file
+ * @brief Two-level segregated fit memory allocator
+ *
+ * @details Block layout:
+ *   | prev_phys | size | *** data *** |
+ *   prev_phys is valid only if the previous block is free, two lower bits
+ *   of size mark whether the block and the previous one are free. Data of a
+ *   free block stores links of the list of its size class.
+ *
+ *   Size class of a block is found by the most significant bit of its size
+ *   (first level) and by the following TLSF_SL_LOG2 bits (second level).
+ *   Allocation rounds request up to the next class, so any block of the
+ *   first non-empty class which is found by bitmaps is good enough.
+ *
+ *   Allocator doesn't lock itself, callers do it.
+ *
+ * @date 17.10.26
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <kernel/printk.h>
+#include <mem/heap_afterfree.h>
+#include <mem/heap_tlsf.h>
+#include <util/binalign.h>
+#include <util/bit.h>
+#include <util/math.h>
+
+#define TLSF_ALIGN       8
+/* Number of second level lists is 1 << TLSF_SL_LOG2 */
+#define TLSF_SL_LOG2     4
+#define TLSF_SL_COUNT    (1 << TLSF_SL_LOG2)
+/* Blocks less than TLSF_SMALL_BLOCK are in the first list linearly */
+#define TLSF_FL_SHIFT    (TLSF_SL_LOG2 + 3)
+#define TLSF_SMALL_BLOCK (1 << TLSF_FL_SHIFT)
+#define TLSF_FL_MAX      (sizeof(size_t) == 8 ? 32 : 30)
+#define TLSF_FL_COUNT    (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+
+#define BLOCK_FREE       0x1
+#define BLOCK_PREV_FREE  0x2
+
+struct tlsf_block {
+	struct tlsf_block *prev_phys;
+	size_t size;
+	/* Following members are used only in free block */
+	struct tlsf_block *next_free;
+	struct tlsf_block *prev_free;
+};
+
+#define BLOCK_OVERHEAD   offsetof(struct tlsf_block, next_free)
+#define BLOCK_SIZE_MIN   (sizeof(struct tlsf_block) - BLOCK_OVERHEAD)
+#define BLOCK_SIZE_MAX   ((size_t) 1 << TLSF_FL_MAX)
+
+struct tlsf {
+	unsigned long fl_bitmap;
+	unsigned long sl_bitmap[TLSF_FL_COUNT];
+	struct tlsf_block *blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+	size_t total;
+	size_t used;
+};
+
+static inline size_t block_size(struct tlsf_block *block) {
+	return block->size & ~(BLOCK_FREE | BLOCK_PREV_FREE);
+}
+
+static inline void block_set_size(struct tlsf_block *block, size_t size) {
+	block->size = size | (block->size & (BLOCK_FREE | BLOCK_PREV_FREE));
+}
+
+static inline void *block_to_ptr(struct tlsf_block *block) {
+	return (char *) block + BLOCK_OVERHEAD;
+}
+
+static inline struct tlsf_block *ptr_to_block(void *ptr) {
+	return (struct tlsf_block *) ((char *) ptr - BLOCK_OVERHEAD);
+}
+
+static inline struct tlsf_block *block_next(struct tlsf_block *block) {
+	return (struct tlsf_block *) ((char *) block_to_ptr(block)
+			+ block_size(block));
+}
+
+static struct tlsf_block *block_link_next(struct tlsf_block *block) {
+	struct tlsf_block *next;
+
+	next = block_next(block);
+	next->prev_phys = block;
+
+	return next;
+}
+
+static void block_mark_free(struct tlsf_block *block) {
+	struct tlsf_block *next;
+
+	next = block_link_next(block);
+	next->size |= BLOCK_PREV_FREE;
+	block->size |= BLOCK_FREE;
+}
+
+static void block_mark_used(struct tlsf_block *block) {
+	block_next(block)->size &= ~BLOCK_PREV_FREE;
+	block->size &= ~BLOCK_FREE;
+}
+
+static void mapping_insert(size_t size, int *fl, int *sl) {
+	int msb;
+
+	if (size < TLSF_SMALL_BLOCK) {
+		*fl = 0;
+		*sl = size / (TLSF_SMALL_BLOCK / TLSF_SL_COUNT);
+	} else {
+		msb = bit_fls(size) - 1;
+		*sl = (size >> (msb - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+		*fl = msb - (TLSF_FL_SHIFT - 1);
+	}
+}
+
+/* Finds class which blocks are all not less than @a size */
+static void mapping_search(size_t size, int *fl, int *sl) {
+	if (size >= TLSF_SMALL_BLOCK) {
+		size += ((size_t) 1 << (bit_fls(size) - 1 - TLSF_SL_LOG2)) - 1;
+	}
+	mapping_insert(size, fl, sl);
+}
+
+static struct tlsf_block *search_suitable_block(struct tlsf *tlsf,
+		int *fl, int *sl) {
+	unsigned long fl_map, sl_map;
+
+	sl_map = tlsf->sl_bitmap[*fl] & (~0UL << *sl);
+	if (!sl_map) {
+		fl_map = tlsf->fl_bitmap & (~0UL << (*fl + 1));
+		if (!fl_map) {
+			return NULL;
+		}
+
+		*fl = bit_ctz(fl_map);
+		sl_map = tlsf->sl_bitmap[*fl];
+	}
+	*sl = bit_ctz(sl_map);
+
+	return tlsf->blocks[*fl][*sl];
+}
+
+static void remove_free_block(struct tlsf *tlsf, struct tlsf_block *block,
+		int fl, int sl) {
+	struct tlsf_block *prev, *next;
+
+	prev = block->prev_free;
+	next = block->next_free;
+	if (next) {
+		next->prev_free = prev;
+	}
+	if (prev) {
+		prev->next_free = next;
+	} else {
+		tlsf->blocks[fl][sl] = next;
+		if (!next) {
+			tlsf->sl_bitmap[fl] &= ~(1UL << sl);
+			if (!tlsf->sl_bitmap[fl]) {
+				tlsf->fl_bitmap &= ~(1UL << fl);
+			}
+		}
+	}
+}
+
+static void insert_free_block(struct tlsf *tlsf, struct tlsf_block *block) {
+	struct tlsf_block *head;
+	int fl, sl;
+
+	mapping_insert(block_size(block), &fl, &sl);
+
+	head = tlsf->blocks[fl][sl];
+	block->next_free = head;
+	block->prev_free = NULL;
+	if (head) {
+		head->prev_free = block;
+	}
+	tlsf->blocks[fl][sl] = block;
+
+	tlsf->fl_bitmap |= 1UL << fl;
+	tlsf->sl_bitmap[fl] |= 1UL << sl;
+}
+
+static void block_remove(struct tlsf *tlsf, struct tlsf_block *block) {
+	int fl, sl;
+
+	mapping_insert(block_size(block), &fl, &sl);
+	remove_free_block(tlsf, block, fl, sl);
+}
+
+static inline int block_can_split(struct tlsf_block *block, size_t size) {
+	return block_size(block) >= size + sizeof(struct tlsf_block);
+}
+
+/* Cuts free block after @a size bytes of data of @a block */
+static struct tlsf_block *block_split(struct tlsf_block *block, size_t size) {
+	struct tlsf_block *remaining;
+
+	remaining = (struct tlsf_block *) ((char *) block_to_ptr(block) + size);
+	remaining->size = block_size(block) - size - BLOCK_OVERHEAD;
+	block_set_size(block, size);
+
+	remaining->prev_phys = block;
+	block_mark_free(remaining);
+
+	return remaining;
+}
+
+/* Merges free block with the next one */
+static struct tlsf_block *block_absorb(struct tlsf_block *prev,
+		struct tlsf_block *block) {
+	prev->size += block_size(block) + BLOCK_OVERHEAD;
+	block_link_next(prev);
+
+	return prev;
+}
+
+static struct tlsf_block *block_merge_prev(struct tlsf *tlsf,
+		struct tlsf_block *block) {
+	struct tlsf_block *prev;
+
+	if (!(block->size & BLOCK_PREV_FREE)) {
+		return block;
+	}
+
+	prev = block->prev_phys;
+	block_remove(tlsf, prev);
+
+	return block_absorb(prev, block);
+}
+
+static struct tlsf_block *block_merge_next(struct tlsf *tlsf,
+		struct tlsf_block *block) {
+	struct tlsf_block *next;
+
+	next = block_next(block);
+	if (!(next->size & BLOCK_FREE)) {
+		return block;
+	}
+
+	block_remove(tlsf, next);
+
+	return block_absorb(block, next);
+}
+
+/* Returns leading @a gap bytes of removed free block to the lists */
+static struct tlsf_block *block_trim_free_leading(struct tlsf *tlsf,
+		struct tlsf_block *block, size_t gap) {
+	struct tlsf_block *remaining;
+
+	remaining = block_split(block, gap - BLOCK_OVERHEAD);
+	remaining->size |= BLOCK_PREV_FREE;
+	insert_free_block(tlsf, block);
+
+	return remaining;
+}
+
+static struct tlsf_block *block_locate_free(struct tlsf *tlsf, size_t size) {
+	struct tlsf_block *block;
+	int fl, sl;
+
+	mapping_search(size, &fl, &sl);
+	if (fl >= TLSF_FL_COUNT) {
+		return NULL;
+	}
+
+	block = search_suitable_block(tlsf, &fl, &sl);
+	if (block) {
+		assert(block_size(block) >= size);
+		remove_free_block(tlsf, block, fl, sl);
+	}
+
+	return block;
+}
+
+static void *block_prepare_used(struct tlsf *tlsf, struct tlsf_block *block,
+		size_t size) {
+	if (block_can_split(block, size)) {
+		insert_free_block(tlsf, block_split(block, size));
+	}
+	block_mark_used(block);
+
+	tlsf->used += block_size(block);
+
+	return block_to_ptr(block);
+}
+
+static size_t adjust_request_size(size_t size) {
+	if ((size == 0) || (size >= BLOCK_SIZE_MAX)) {
+		return 0;
+	}
+
+	return max(binalign_bound(size, TLSF_ALIGN), BLOCK_SIZE_MIN);
+}
+
+void *tlsf_memalign(struct tlsf *tlsf, size_t boundary, size_t size) {
+	struct tlsf_block *block;
+	uintptr_t ptr, aligned;
+	size_t adjust, gap;
+
+	assert(tlsf);
+
+	adjust = adjust_request_size(size);
+	if (adjust == 0) {
+		return NULL;
+	}
+
+	if (boundary <= TLSF_ALIGN) {
+		block = block_locate_free(tlsf, adjust);
+		return block ? block_prepare_used(tlsf, block, adjust) : NULL;
+	}
+
+	assert(binalign_check_bound(boundary, boundary));
+
+	/* Block is large enough to cut free block before aligned address */
+	size = adjust_request_size(adjust + boundary + sizeof(struct tlsf_block));
+	if (size == 0) {
+		return NULL;
+	}
+	block = block_locate_free(tlsf, size);
+	if (block == NULL) {
+		return NULL;
+	}
+
+	ptr = (uintptr_t) block_to_ptr(block);
+	aligned = binalign_bound(ptr, boundary);
+	gap = aligned - ptr;
+	if (gap && (gap < sizeof(struct tlsf_block))) {
+		aligned = binalign_bound(ptr + sizeof(struct tlsf_block), boundary);
+		gap = aligned - ptr;
+	}
+	if (gap) {
+		block = block_trim_free_leading(tlsf, block, gap);
+	}
+
+	return block_prepare_used(tlsf, block, adjust);
+}
+
+void tlsf_free(struct tlsf *tlsf, void *ptr) {
+	struct tlsf_block *block;
+
+	assert(tlsf);
+	assert(ptr);
+
+	block = ptr_to_block(ptr);
+	if (block->size & BLOCK_FREE) {
+		printk("***** free(): the block not busy\n");
+		return; /* if we try to free block more than once */
+	}
+
+	afterfree(ptr, block_size(block));
+	tlsf->used -= block_size(block);
+
+	block_mark_free(block);
+	block = block_merge_prev(tlsf, block);
+	block = block_merge_next(tlsf, block);
+	insert_free_block(tlsf, block);
+}
+
+size_t tlsf_block_size(void *ptr) {
+	struct tlsf_block *block;
+
+	block = ptr_to_block(ptr);
+	if (block->size & BLOCK_FREE) {
+		return 0;
+	}
+	return block_size(block);
+}
+
+int tlsf_add_pool(struct tlsf *tlsf, void *mem, size_t size) {
+	struct tlsf_block *block, *sentinel;
+	uintptr_t start;
+	size_t pool_size;
+
+	assert(tlsf);
+
+	start = binalign_bound((uintptr_t) mem, TLSF_ALIGN);
+	if (size < (start - (uintptr_t) mem) + 2 * BLOCK_OVERHEAD + BLOCK_SIZE_MIN) {
+		return -EINVAL;
+	}
+	size -= start - (uintptr_t) mem;
+
+	/* The first block and the sentinel which is always used */
+	pool_size = (size - 2 * BLOCK_OVERHEAD) & ~(TLSF_ALIGN - 1);
+	if (pool_size >= BLOCK_SIZE_MAX) {
+		pool_size = BLOCK_SIZE_MAX - TLSF_ALIGN;
+	}
+
+	block = (struct tlsf_block *) start;
+	block->prev_phys = NULL;
+	block->size = pool_size | BLOCK_FREE;
+	insert_free_block(tlsf, block);
+
+	sentinel = block_link_next(block);
+	sentinel->size = BLOCK_PREV_FREE;
+
+	tlsf->total += pool_size;
+
+	return 0;
+}
+
+int tlsf_remove_pool(struct tlsf *tlsf, void *mem) {
+	struct tlsf_block *block;
+
+	assert(tlsf);
+
+	block = (struct tlsf_block *) binalign_bound((uintptr_t) mem, TLSF_ALIGN);
+	/* Pool is free if it's merged into the single block before sentinel */
+	if (!(block->size & BLOCK_FREE) || (block_size(block_next(block)) != 0)) {
+		return -EBUSY;
+	}
+
+	block_remove(tlsf, block);
+	tlsf->total -= block_size(block);
+
+	return 0;
+}
+
+size_t tlsf_control_size(void) {
+	return binalign_bound(sizeof(struct tlsf), TLSF_ALIGN);
+}
+
+struct tlsf *tlsf_init(void *mem, size_t size) {
+	struct tlsf *tlsf;
+
+	assert(binalign_check_bound((uintptr_t) mem, sizeof(void *)));
+
+	if (size < tlsf_control_size()) {
+		return NULL;
+	}
+
+	tlsf = mem;
+	memset(tlsf, 0, sizeof(*tlsf));
+
+	if (0 != tlsf_add_pool(tlsf, (char *) mem + tlsf_control_size(),
+				size - tlsf_control_size())) {
+		return NULL;
+	}
+
+	return tlsf;
+}
+
+void tlsf_get_stat(struct tlsf *tlsf, size_t *total, size_t *free,
+		size_t *largest_free) {
+	struct tlsf_block *block;
+	int fl, sl;
+
+	assert(tlsf);
+
+	*total = tlsf->total;
+	*free = tlsf->total - tlsf->used;
+	*largest_free = 0;
+
+	if (!tlsf->fl_bitmap) {
+		return;
+	}
+
+	/* The largest block is in the last non-empty list */
+	fl = bit_fls(tlsf->fl_bitmap) - 1;
+	sl = bit_fls(tlsf->sl_bitmap[fl]) - 1;
+	for (block = tlsf->blocks[fl][sl]; block; block = block->next_free) {
+		*largest_free = max(*largest_free, block_size(block));
+	}
+
+	/* Larger requests are rounded up to the next class which is empty, so
+	 * only the lower bound of the class can be allocated */
+	if (*largest_free >= TLSF_SMALL_BLOCK) {
+		*largest_free &= ~(((size_t) 1 <<
+				(bit_fls(*largest_free) - 1 - TLSF_SL_LOG2)) - 1);
+	}
+}
@@ -7,6 +7,8 @@
  */
 
 #include <errno.h>
+#include <stdint.h>
+#include <string.h>
 #include <util/err.h>
 #include <unistd.h>
 #include <util/dlist.h>
@@ -15,6 +17,9 @@
 #include <kernel/task/kernel_task.h>
 #include <kernel/task/resource/task_heap.h>
 #include <kernel/printk.h>
+#include <mem/heap.h>
+#include <mem/shrinker.h>
+#include <mem/tcache.h>
 
 #include "mspace_malloc.h"
 
@@ -33,7 +38,14 @@ static struct dlist_head *kernel_task_mspace(void) {
 }
 
 void *memalign(size_t boundary, size_t size) {
-	return mspace_memalign(boundary, size, task_self_mspace());
+	void *ptr;
+
+	ptr = mspace_memalign(boundary, size, task_self_mspace());
+	if ((ptr == NULL) && (0 != shrink_caches(SHRINK_HEAP, SHRINK_BATCH))) {
+		ptr = mspace_memalign(boundary, size, task_self_mspace());
+	}
+
+	return ptr;
 }
 
 void *malloc(size_t size) {
@@ -43,7 +55,15 @@ void *malloc(size_t size) {
 		return NULL;
 	}
 
+	ptr = tcache_alloc(size, task_self_mspace());
+	if (ptr != NULL) {
+		return ptr;
+	}
+
 	ptr = mspace_malloc(size, task_self_mspace());
+	if ((ptr == NULL) && (0 != shrink_caches(SHRINK_HEAP, SHRINK_BATCH))) {
+		ptr = mspace_malloc(size, task_self_mspace());
+	}
 
 	if (ptr == NULL) {
 		SET_ERRNO(ENOMEM);
@@ -55,6 +75,9 @@ void *malloc(size_t size) {
 void free(void *ptr) {
 	if (ptr == NULL)
 		return;
+	if (0 == tcache_free(ptr, task_self_mspace())) {
+		return;
+	}
 	/* XXX this workaround for such situation:
 	 * module ConstructionGlobal invokes constructors inside kernel task for all applications,
 	 * and call malloc. After a while Qt application call realloc() on some memory previously
@@ -71,7 +94,7 @@ void *realloc(void *ptr, size_t size) {
 	void *ret;
 
 	if (size == 0 && ptr != NULL) {
-		mspace_free(ptr, task_self_mspace());
+		free(ptr);
 		return NULL; /* ok */
 	}
 	if (ptr == NULL) {
@@ -89,7 +112,24 @@ void *realloc(void *ptr, size_t size) {
 }
 
 void *calloc(size_t nmemb, size_t size) {
+	void *ptr;
+
 	if (nmemb == 0 || size == 0)
 		return NULL; /* ok */
-	return mspace_calloc(nmemb, size, task_self_mspace());
+	if (nmemb > SIZE_MAX / size) {
+		SET_ERRNO(ENOMEM);
+		return NULL;
+	}
+
+	/* Small blocks are taken from the thread cache like in malloc() */
+	ptr = malloc(nmemb * size);
+	if (ptr != NULL) {
+		memset(ptr, 0, nmemb * size);
+	}
+
+	return ptr;
+}
+
+void heap_get_stat(struct heap_stat *stat) {
+	mspace_get_stat(task_self_mspace(), stat);
 }
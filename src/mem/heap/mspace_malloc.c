@@ -4,6 +4,8 @@
  * @details
  *    Segment structure:
  *    |struct mm_segment| *** space for bm ***|
+ *    Segments which become empty are returned to page allocator, except
+ *    the first one.
  *
  *    TODO:
  *    Should be improved by usage of page_alloc when size is divisible by PAGE_SIZE()
@@ -18,82 +20,22 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <mem/heap.h>
 #include <mem/heap_bm.h>
 #include <mem/page.h>
 
 #include <util/dlist.h>
-#include <util/array.h>
+#include <util/math.h>
 
 #include <kernel/printk.h>
 #include <kernel/panic.h>
+#include <kernel/sched/sched_lock.h>
 
-/* TODO make it per task field */
-//static DLIST_DEFINE(task_mem_segments);
+#include "mspace_malloc.h"
+#include "mspace_segment.h"
 
 //#define DEBUG
 
-extern struct page_allocator *__heap_pgallocator;
-extern struct page_allocator *__heap_pgallocator2 __attribute__((weak));
-static struct page_allocator ** const mm_page_allocs[] = {
-	&__heap_pgallocator,
-	&__heap_pgallocator2,
-};
-
-static void *mm_segment_alloc(int page_cnt) {
-	void *ret;
-	int i;
-	for (i = 0; i < ARRAY_SIZE(mm_page_allocs); i++) {
-		if (mm_page_allocs[i]) {
-			ret = page_alloc(*mm_page_allocs[i], page_cnt);
-			if (ret) {
-				break;
-			}
-		}
-	}
-	return ret;
-}
-
-static void mm_segment_free(void *segment, int page_cnt) {
-	int i;
-	for (i = 0; i < ARRAY_SIZE(mm_page_allocs); i++) {
-		if (mm_page_allocs[i] && page_belong(*mm_page_allocs[i], segment)) {
-			page_free(*mm_page_allocs[i], segment, page_cnt);
-			break;
-		}
-	}
-}
-
-struct mm_segment {
-	struct dlist_head link;
-	size_t size;
-};
-
-static inline int pointer_inside_segment(void *segment, size_t size, void *pointer) {
-	return (pointer > segment && pointer < (segment + size));
-}
-
-static inline void *mm_to_segment(struct mm_segment *mm) {
-	assert(mm);
-	return ((char *) mm + sizeof *mm);
-}
-
-static void *pointer_to_segment(void *ptr, struct dlist_head *mspace) {
-	struct mm_segment *mm;
-	void *segment;
-
-	assert(ptr);
-	assert(mspace);
-
-	dlist_foreach_entry(mm, mspace, link) {
-		segment = mm_to_segment(mm);
-		if (pointer_inside_segment(segment, mm->size, ptr)) {
-			return segment;
-		}
-	}
-
-	return NULL;
-}
-
 static void *mspace_do_alloc(size_t boundary, size_t size, struct dlist_head *mspace) {
 	struct mm_segment *mm;
 	dlist_foreach_entry(mm, mspace, link) {
@@ -117,8 +59,11 @@ void *mspace_memalign(size_t boundary, size_t size, struct dlist_head *mspace) {
 
 	assert(mspace);
 
+	sched_lock();
+
 	block = mspace_do_alloc(boundary, size, mspace);
 	if (block) {
+		sched_unlock();
 		return block;
 	}
 
@@ -127,13 +72,11 @@ void *mspace_memalign(size_t boundary, size_t size, struct dlist_head *mspace) {
 	segment_pages_cnt = size / PAGE_SIZE() + boundary / PAGE_SIZE();
 	segment_pages_cnt += (size % PAGE_SIZE() + boundary % PAGE_SIZE() + 2 * PAGE_SIZE()) / PAGE_SIZE();
 
-	mm = mm_segment_alloc(segment_pages_cnt);
-	if (mm == NULL)
+	mm = mm_segment_add(mspace, segment_pages_cnt);
+	if (mm == NULL) {
+		sched_unlock();
 		return NULL;
-
-	mm->size = segment_pages_cnt * PAGE_SIZE();
-	dlist_head_init(&mm->link);
-	dlist_add_next(&mm->link, mspace);
+	}
 
 	bm_init(mm_to_segment(mm), mm->size - sizeof(struct mm_segment));
 
@@ -142,6 +85,8 @@ void *mspace_memalign(size_t boundary, size_t size, struct dlist_head *mspace) {
 		panic("new memory block is not sufficient to allocate requested size");
 	}
 
+	sched_unlock();
+
 	return block;
 }
 
@@ -151,16 +96,16 @@ void *mspace_malloc(size_t size, struct dlist_head *mspace) {
 }
 
 int mspace_free(void *ptr, struct dlist_head *mspace) {
-	void *segment;
+	struct mm_segment *mm;
 
 	assert(ptr);
 	assert(mspace);
 
-	segment = pointer_to_segment(ptr, mspace);
+	sched_lock();
 
-	if (segment != NULL) {
-		bm_free(segment, ptr);
-	} else {
+	mm = mm_segment_find(ptr, mspace);
+	if (mm == NULL) {
+		sched_unlock();
 		/* No segment containing pointer @c ptr was found. */
 #ifdef DEBUG
 		printk("***** free(): incorrect address space\n");
@@ -168,6 +113,16 @@ int mspace_free(void *ptr, struct dlist_head *mspace) {
 		return -1;
 	}
 
+	bm_free(mm_to_segment(mm), ptr);
+
+	/* The oldest segment is the last one and it's kept */
+	if ((mm->link.next != mspace) && mm_segment_can_del()
+			&& bm_is_empty(mm_to_segment(mm), mm->size - sizeof(struct mm_segment))) {
+		mm_segment_del(mm);
+	}
+
+	sched_unlock();
+
 	return 0;
 }
 
@@ -216,85 +171,31 @@ void *mspace_calloc(size_t nmemb, size_t size, struct dlist_head *mspace) {
 	return ret;
 }
 
-int mspace_init(struct dlist_head *mspace) {
-	dlist_init(mspace);
-	return 0;
-}
-
-int mspace_fini(struct dlist_head *mspace) {
-	struct mm_segment *mm;
+size_t mspace_usable_size(void *ptr, struct dlist_head *mspace) {
+	assert(ptr);
+	assert(mspace);
 
-	dlist_foreach_entry(mm, mspace, link) {
-		mm_segment_free(mm, mm->size / PAGE_SIZE());
+	if (NULL == mm_segment_find(ptr, mspace)) {
+		return 0;
 	}
 
-	return 0;
-}
-
-size_t mspace_deep_copy_size(struct dlist_head *mspace) {
-	struct mm_segment *mm;
-	size_t ret;
-
-	ret = 0;
-	dlist_foreach_entry(mm, mspace, link) {
-		ret += mm->size;
-	}
-	return ret;
+	return bm_block_size(ptr);
 }
 
-
-void mspace_deep_store(struct dlist_head *mspace, struct dlist_head *store_space, void *buf) {
+void mspace_get_stat(struct dlist_head *mspace, struct heap_stat *stat) {
 	struct mm_segment *mm;
-	void *p;
-
-	dlist_init(store_space);
-
-	/* if mspace is empty list manipulation is illegal */
-	if (dlist_empty(mspace)) {
-		return;
-	}
-
-	dlist_del(mspace);
-	dlist_add_prev(store_space, mspace->next);
-
-	p = buf;
-	dlist_foreach_entry(mm, store_space, link) {
-		memcpy(p, mm, mm->size);
-		p += mm->size;
-	}
-
-	dlist_del(store_space);
-	dlist_add_prev(mspace, mspace->next);
-}
-
-void mspace_deep_restore(struct dlist_head *mspace, struct dlist_head *store_space, void *buf) {
-	struct dlist_head *raw_mm;
-	void *p;
+	size_t free, largest;
 
 	assert(mspace);
-	assert(store_space);
-	assert(buf);
-
-	dlist_init(mspace);
-
-	p = buf;
-	raw_mm = store_space->next;
-
-	/* can't use foreach, since it stores next pointer in accumulator */
-	while (raw_mm != store_space) {
-		struct mm_segment *buf_mm, *mm;
+	assert(stat);
 
-		buf_mm = p;
-
-		mm = member_cast_out(raw_mm, struct mm_segment, link);
-		memcpy(mm, buf_mm, buf_mm->size);
-
-		p += buf_mm->size;
-		raw_mm = raw_mm->next;
-	}
+	memset(stat, 0, sizeof(*stat));
+	dlist_foreach_entry(mm, mspace, link) {
+		bm_get_stat(mm_to_segment(mm), &free, &largest);
 
-	if (!dlist_empty(store_space)) {
-		dlist_del(store_space);
-		dlist_add_prev(mspace, store_space->next);
+		stat->total += mm->size - sizeof(struct mm_segment);
+		stat->free += free;
+		stat->largest_free = max(stat->largest_free, largest);
+		stat->segments++;
 	}
 }
@@ -17,5 +17,10 @@ extern void *mspace_malloc(size_t size, struct dlist_head *mspace);
 extern int   mspace_free(void *ptr, struct dlist_head *mspace);
 extern void *mspace_calloc(size_t nmemb, size_t size, struct dlist_head *mspace);
 extern void *mspace_realloc(void *ptr, size_t size, struct dlist_head *mspace);
+/** @return Usable size of block or zero if it isn't allocated in @a mspace */
+extern size_t mspace_usable_size(void *ptr, struct dlist_head *mspace);
+
+struct heap_stat;
+extern void mspace_get_stat(struct dlist_head *mspace, struct heap_stat *stat);
 
 #endif /* MSPACE_MALLOC_H_ */
@@ -0,0 +1,284 @@
+/**
+ * @file
+ * @brief Segments of task heap allocated from page allocators
+ *
+ * @details Each page of heap allocators has an entry in the map of owners,
+ *   which points to the segment the page belongs to. Maps are allocated
+ *   from the allocators on first use.
+ *
+ * @date 04.03.2014
+ * @author Alexander Kalmuk
+ */
+
+#include <string.h>
+
+#include <kernel/sched/sched_lock.h>
+#include <mem/page.h>
+
+#include <util/array.h>
+#include <util/dlist.h>
+#include <util/member.h>
+
+#include "mspace_segment.h"
+
+extern struct page_allocator *__heap_pgallocator;
+extern struct page_allocator *__heap_pgallocator2 __attribute__((weak));
+static struct page_allocator ** const mm_page_allocs[] = {
+	&__heap_pgallocator,
+	&__heap_pgallocator2,
+};
+
+static struct mm_segment **mm_owners[ARRAY_SIZE(mm_page_allocs)];
+
+/* Number of fork images of heap. Segments are restored from them to the
+ * same pages, so the pages can't be returned until images are dropped */
+static int mm_images;
+
+static inline struct page_allocator *mm_allocator(int i) {
+	return mm_page_allocs[i] ? *mm_page_allocs[i] : NULL;
+}
+
+/* Index of allocator which contains @a ptr or -1 */
+static int mm_allocator_index(void *ptr) {
+	struct page_allocator *allocator;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mm_page_allocs); i++) {
+		allocator = mm_allocator(i);
+		if (allocator && ((char *) ptr >= (char *) allocator->pages_start)
+				&& ((char *) ptr < (char *) allocator->pages_start
+					+ allocator->pages_n * allocator->page_size)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static struct mm_segment **mm_owner_map(int i) {
+	struct page_allocator *allocator;
+	size_t map_pages;
+
+	allocator = mm_allocator(i);
+	if (mm_owners[i] == NULL) {
+		map_pages = (allocator->pages_n * sizeof(struct mm_segment *)
+				+ allocator->page_size - 1) / allocator->page_size;
+		mm_owners[i] = page_alloc_zero(allocator, map_pages);
+	}
+
+	return mm_owners[i];
+}
+
+static void mm_owner_set(struct mm_segment *mm, struct mm_segment *owner) {
+	struct page_allocator *allocator;
+	size_t first, j;
+	int i;
+
+	i = mm_allocator_index(mm);
+	assert(i >= 0);
+	assert(mm_owners[i]);
+
+	allocator = mm_allocator(i);
+	first = ((char *) mm - (char *) allocator->pages_start) / allocator->page_size;
+	for (j = 0; j < mm->size / allocator->page_size; j++) {
+		mm_owners[i][first + j] = owner;
+	}
+}
+
+static void *mm_segment_alloc(int page_cnt) {
+	void *ret;
+	int i;
+
+	ret = NULL;
+	for (i = 0; i < ARRAY_SIZE(mm_page_allocs); i++) {
+		if (mm_allocator(i) && mm_owner_map(i)) {
+			ret = page_alloc(mm_allocator(i), page_cnt);
+			if (ret) {
+				break;
+			}
+		}
+	}
+	return ret;
+}
+
+static void mm_segment_free(struct mm_segment *mm) {
+	int i;
+
+	mm_owner_set(mm, NULL);
+
+	i = mm_allocator_index(mm);
+	page_free(mm_allocator(i), mm, mm->size / PAGE_SIZE());
+}
+
+static inline int pointer_inside_segment(void *segment, size_t size, void *pointer) {
+	return (pointer > segment && pointer < (segment + size));
+}
+
+struct mm_segment *mm_segment_add(struct dlist_head *mspace, size_t page_cnt) {
+	struct mm_segment *mm;
+
+	assert(mspace);
+
+	sched_lock();
+	{
+		mm = mm_segment_alloc(page_cnt);
+		if (mm != NULL) {
+			mm->size = page_cnt * PAGE_SIZE();
+			mm->mspace = mspace;
+			dlist_head_init(&mm->link);
+			dlist_add_next(&mm->link, mspace);
+
+			mm_owner_set(mm, mm);
+		}
+	}
+	sched_unlock();
+
+	return mm;
+}
+
+void mm_segment_del(struct mm_segment *mm) {
+	assert(mm);
+
+	sched_lock();
+	{
+		dlist_del(&mm->link);
+		mm_segment_free(mm);
+	}
+	sched_unlock();
+}
+
+int mm_segment_can_del(void) {
+	return mm_images == 0;
+}
+
+struct mm_segment *mm_segment_find(void *ptr, struct dlist_head *mspace) {
+	struct page_allocator *allocator;
+	struct mm_segment *mm;
+	int i;
+
+	assert(ptr);
+	assert(mspace);
+
+	i = mm_allocator_index(ptr);
+	if ((i < 0) || (mm_owners[i] == NULL)) {
+		return NULL;
+	}
+
+	allocator = mm_allocator(i);
+	mm = mm_owners[i][((char *) ptr - (char *) allocator->pages_start)
+		/ allocator->page_size];
+	if ((mm == NULL) || (mm->mspace != mspace)
+			|| !pointer_inside_segment(mm_to_segment(mm), mm->size, ptr)) {
+		return NULL;
+	}
+
+	return mm;
+}
+
+int mspace_init(struct dlist_head *mspace) {
+	dlist_init(mspace);
+	return 0;
+}
+
+int mspace_fini(struct dlist_head *mspace) {
+	struct mm_segment *mm;
+
+	sched_lock();
+	{
+		dlist_foreach_entry(mm, mspace, link) {
+			mm_segment_free(mm);
+		}
+	}
+	sched_unlock();
+
+	return 0;
+}
+
+size_t mspace_deep_copy_size(struct dlist_head *mspace) {
+	struct mm_segment *mm;
+	size_t ret;
+
+	ret = 0;
+	dlist_foreach_entry(mm, mspace, link) {
+		ret += mm->size;
+	}
+	return ret;
+}
+
+
+void mspace_deep_hold(void) {
+	sched_lock();
+	{
+		mm_images++;
+	}
+	sched_unlock();
+}
+
+void mspace_deep_unhold(void) {
+	sched_lock();
+	{
+		assert(mm_images > 0);
+		mm_images--;
+	}
+	sched_unlock();
+}
+
+void mspace_deep_store(struct dlist_head *mspace, struct dlist_head *store_space, void *buf) {
+	struct mm_segment *mm;
+	void *p;
+
+	dlist_init(store_space);
+
+	/* if mspace is empty list manipulation is illegal */
+	if (dlist_empty(mspace)) {
+		return;
+	}
+
+	dlist_del(mspace);
+	dlist_add_prev(store_space, mspace->next);
+
+	p = buf;
+	dlist_foreach_entry(mm, store_space, link) {
+		memcpy(p, mm, mm->size);
+		p += mm->size;
+	}
+
+	dlist_del(store_space);
+	dlist_add_prev(mspace, mspace->next);
+}
+
+void mspace_deep_restore(struct dlist_head *mspace, struct dlist_head *store_space, void *buf) {
+	struct dlist_head *raw_mm;
+	void *p;
+
+	assert(mspace);
+	assert(store_space);
+	assert(buf);
+
+	dlist_init(mspace);
+
+	p = buf;
+	raw_mm = store_space->next;
+
+	/* can't use foreach, since it stores next pointer in accumulator */
+	while (raw_mm != store_space) {
+		struct mm_segment *buf_mm, *mm;
+
+		buf_mm = p;
+
+		mm = member_cast_out(raw_mm, struct mm_segment, link);
+		memcpy(mm, buf_mm, buf_mm->size);
+		/* Image can be stored from another task */
+		mm->mspace = mspace;
+		/* Pages could be given to another segment meanwhile */
+		mm_owner_set(mm, mm);
+
+		p += buf_mm->size;
+		raw_mm = raw_mm->next;
+	}
+
+	if (!dlist_empty(store_space)) {
+		dlist_del(store_space);
+		dlist_add_prev(mspace, store_space->next);
+	}
+}
@@ -0,0 +1,61 @@
+/**
+ * @file
+ * @brief Segments of task heap allocated from page allocators
+ *
+ * @date 17.10.26
+ */
+
+#ifndef MSPACE_SEGMENT_H_
+#define MSPACE_SEGMENT_H_
+
+#include <assert.h>
+#include <stddef.h>
+
+#include <util/dlist.h>
+
+/*    Segment structure:
+ *    |struct mm_segment| *** space for allocator ***|
+ */
+struct mm_segment {
+	struct dlist_head link;
+	struct dlist_head *mspace; /* Owner of the segment */
+	size_t size;
+};
+
+static inline void *mm_to_segment(struct mm_segment *mm) {
+	assert(mm);
+	return ((char *) mm + sizeof *mm);
+}
+
+/**
+ * Allocates segment of @a page_cnt pages and adds it to the head of
+ * @a mspace, so the oldest segment is the last one.
+ */
+extern struct mm_segment *mm_segment_add(struct dlist_head *mspace,
+		size_t page_cnt);
+
+/** Removes segment from its mspace and returns pages of it */
+extern void mm_segment_del(struct mm_segment *mm);
+
+/**
+ * @return Non-zero if empty segments can be deleted, it's not so while
+ *   fork images of heap are stored
+ */
+extern int mm_segment_can_del(void);
+
+/**
+ * Finds segment by map of owners of heap pages, so it takes constant time.
+ * @return Segment of @a mspace which contains @a ptr or NULL
+ */
+extern struct mm_segment *mm_segment_find(void *ptr, struct dlist_head *mspace);
+
+/** @return Space of segment of @a mspace which contains @a ptr or NULL */
+static inline void *pointer_to_segment(void *ptr, struct dlist_head *mspace) {
+	struct mm_segment *mm;
+
+	mm = mm_segment_find(ptr, mspace);
+
+	return mm ? mm_to_segment(mm) : NULL;
+}
+
+#endif /* MSPACE_SEGMENT_H_ */
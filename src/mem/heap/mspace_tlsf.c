@@ -0,0 +1,225 @@
+/**
+ * @file
+ * @brief Heap implementation based on TLSF allocator
+ *
+ * @details All segments of mspace are pools of one allocator, so allocation
+ *   doesn't depend on number of segments. Control structure of the
+ *   allocator is placed in the first segment:
+ *    |struct mm_segment| struct tlsf | *** pool *** |
+ *   Next ones are:
+ *    |struct mm_segment| *** pool *** |
+ *   and they are returned to page allocator as soon as they become free.
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <framework/mod/options.h>
+#include <kernel/printk.h>
+#include <kernel/sched/sched_lock.h>
+#include <mem/heap.h>
+#include <mem/heap_tlsf.h>
+#include <mem/page.h>
+#include <util/dlist.h>
+#include <util/err.h>
+#include <util/math.h>
+#include <util/member.h>
+
+#include "mspace_malloc.h"
+#include "mspace_segment.h"
+
+#define MIN_SEGMENT_PAGES OPTION_GET(NUMBER, min_segment_pages)
+
+/* Headers of the first block and of the sentinel of pool */
+#define POOL_OVERHEAD     (8 * sizeof(void *))
+
+static struct tlsf *mspace_tlsf(struct dlist_head *mspace) {
+	struct mm_segment *mm;
+
+	if (dlist_empty(mspace)) {
+		return NULL;
+	}
+
+	/* Segments are added to the head of list */
+	mm = member_cast_out(mspace->prev, struct mm_segment, link);
+
+	return mm_to_segment(mm);
+}
+
+static struct tlsf *mspace_grow(size_t boundary, size_t size,
+		struct dlist_head *mspace) {
+	struct mm_segment *mm;
+	struct tlsf *tlsf;
+	size_t need, page_cnt;
+
+	tlsf = mspace_tlsf(mspace);
+
+	/* Request is rounded up to the next size class of allocator */
+	need = sizeof(struct mm_segment) + size + size / 8 + boundary
+			+ POOL_OVERHEAD;
+	if (tlsf == NULL) {
+		need += tlsf_control_size();
+	}
+	if (need < size) {
+		return NULL; /* overflow */
+	}
+	page_cnt = max((need + PAGE_SIZE() - 1) / PAGE_SIZE(),
+			(size_t) MIN_SEGMENT_PAGES);
+
+	mm = mm_segment_add(mspace, page_cnt);
+	if (mm == NULL) {
+		return NULL;
+	}
+
+	if (tlsf == NULL) {
+		return tlsf_init(mm_to_segment(mm), mm->size - sizeof(*mm));
+	}
+
+	if (0 != tlsf_add_pool(tlsf, mm_to_segment(mm), mm->size - sizeof(*mm))) {
+		return NULL;
+	}
+
+	return tlsf;
+}
+
+void *mspace_memalign(size_t boundary, size_t size, struct dlist_head *mspace) {
+	struct tlsf *tlsf;
+	void *block;
+
+	if (size == 0) {
+		return NULL;
+	}
+
+	assert(mspace);
+
+	sched_lock();
+	{
+		block = NULL;
+		tlsf = mspace_tlsf(mspace);
+		if (tlsf != NULL) {
+			block = tlsf_memalign(tlsf, boundary, size);
+		}
+
+		if (block == NULL) {
+			tlsf = mspace_grow(boundary, size, mspace);
+			if (tlsf != NULL) {
+				block = tlsf_memalign(tlsf, boundary, size);
+			}
+		}
+	}
+	sched_unlock();
+
+	return block;
+}
+
+void *mspace_malloc(size_t size, struct dlist_head *mspace) {
+	assert(mspace);
+	return mspace_memalign(8, size, mspace);
+}
+
+int mspace_free(void *ptr, struct dlist_head *mspace) {
+	struct mm_segment *mm;
+	struct tlsf *tlsf;
+
+	assert(ptr);
+	assert(mspace);
+
+	sched_lock();
+	{
+		mm = mm_segment_find(ptr, mspace);
+		if (mm == NULL) {
+			sched_unlock();
+			return -1;
+		}
+
+		tlsf = mspace_tlsf(mspace);
+		tlsf_free(tlsf, ptr);
+
+		if ((mm_to_segment(mm) != tlsf) && mm_segment_can_del()
+				&& (0 == tlsf_remove_pool(tlsf, mm_to_segment(mm)))) {
+			mm_segment_del(mm);
+		}
+	}
+	sched_unlock();
+
+	return 0;
+}
+
+void *mspace_realloc(void *ptr, size_t size, struct dlist_head *mspace) {
+	void *ret;
+
+	assert(mspace);
+	assert(size != 0 || ptr == NULL);
+
+	if ((ptr != NULL) && (NULL == pointer_to_segment(ptr, mspace))) {
+		return err_ptr(EINVAL);
+	}
+
+	ret = mspace_memalign(8, size, mspace);
+	if (ret == NULL) {
+		return NULL; /* error: errno set in malloc */
+	}
+
+	if (ptr == NULL) {
+		return ret;
+	}
+
+	memcpy(ret, ptr, min(size, tlsf_block_size(ptr)));
+	mspace_free(ptr, mspace);
+
+	return ret;
+}
+
+void *mspace_calloc(size_t nmemb, size_t size, struct dlist_head *mspace) {
+	void *ret;
+	size_t total_size;
+
+	total_size = nmemb * size;
+
+	assert(mspace);
+	assert(total_size > 0);
+
+	ret = mspace_malloc(total_size, mspace);
+	if (ret == NULL) {
+		return NULL; /* error: errno set in malloc */
+	}
+
+	memset(ret, 0, total_size);
+	return ret;
+}
+
+size_t mspace_usable_size(void *ptr, struct dlist_head *mspace) {
+	assert(ptr);
+	assert(mspace);
+
+	if (NULL == mm_segment_find(ptr, mspace)) {
+		return 0;
+	}
+
+	return tlsf_block_size(ptr);
+}
+
+void mspace_get_stat(struct dlist_head *mspace, struct heap_stat *stat) {
+	struct mm_segment *mm;
+	struct tlsf *tlsf;
+
+	assert(mspace);
+	assert(stat);
+
+	memset(stat, 0, sizeof(*stat));
+
+	sched_lock();
+	{
+		dlist_foreach_entry(mm, mspace, link) {
+			stat->segments++;
+		}
+
+		tlsf = mspace_tlsf(mspace);
+		if (tlsf != NULL) {
+			tlsf_get_stat(tlsf, &stat->total, &stat->free, &stat->largest_free);
+		}
+	}
+	sched_unlock();
+}
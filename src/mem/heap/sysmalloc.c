@@ -13,6 +13,7 @@
 #include <kernel/printk.h>
 #include <kernel/task/kernel_task.h>
 #include <kernel/task/resource/task_heap.h>
+#include <mem/shrinker.h>
 #include <mem/sysmalloc.h>
 
 #include "mspace_malloc.h"
@@ -25,11 +26,25 @@ static struct dlist_head *kernel_task_mspace(void) {
 }
 
 void *sysmemalign(size_t boundary, size_t size) {
-	return mspace_memalign(boundary, size, kernel_task_mspace());
+	void *ptr;
+
+	ptr = mspace_memalign(boundary, size, kernel_task_mspace());
+	if ((ptr == NULL) && (0 != shrink_caches(SHRINK_HEAP, SHRINK_BATCH))) {
+		ptr = mspace_memalign(boundary, size, kernel_task_mspace());
+	}
+
+	return ptr;
 }
 
 void *sysmalloc(size_t size) {
-	return mspace_malloc(size, kernel_task_mspace());
+	void *ptr;
+
+	ptr = mspace_malloc(size, kernel_task_mspace());
+	if ((ptr == NULL) && (0 != shrink_caches(SHRINK_HEAP, SHRINK_BATCH))) {
+		ptr = mspace_malloc(size, kernel_task_mspace());
+	}
+
+	return ptr;
 }
 
 void sysfree(void *ptr) {
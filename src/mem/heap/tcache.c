@@ -0,0 +1,228 @@
+/**
+ * @file
+ * @brief Per-thread caches of small heap blocks
+ *
+ * @details Blocks up to @c max_size bytes are cached in classes of
+ *   TCACHE_STEP bytes. A block is put to the class by its usable size, so
+ *   a block freed by another thread of the task or allocated by memalign()
+ *   is cached as well. Empty class is refilled and full one is flushed by
+ *   a batch of half of @c bin_size blocks under a single scheduler lock.
+ *
+ *   Only the thread itself touches its cache, except it's read for
+ *   statistics.
+ *
+ *   Cached blocks stay allocated in the heap, so the heap can't detect
+ *   the second free() of such a block. Each cached block is marked with
+ *   its cache, and a marked block is looked up in the class before it's
+ *   cached again.
+ *
+ * @date 17.10.26
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include <framework/mod/options.h>
+#include <kernel/printk.h>
+#include <kernel/sched/sched_lock.h>
+#include <kernel/task.h>
+#include <kernel/task/resource/task_heap.h>
+#include <kernel/thread.h>
+#include <mem/tcache.h>
+
+#include "mspace_malloc.h"
+
+#define TCACHE_MAX_SIZE OPTION_GET(NUMBER, max_size)
+#define TCACHE_BIN_SIZE OPTION_GET(NUMBER, bin_size)
+#define TCACHE_BATCH    ((TCACHE_BIN_SIZE + 1) / 2)
+
+static inline void tcache_push(struct tcache *tc, struct tcache_bin *bin,
+		void *ptr) {
+	((void **) ptr)[0] = bin->head;
+	((void **) ptr)[1] = tc;
+	bin->head = ptr;
+	bin->count++;
+}
+
+static inline void *tcache_pop(struct tcache_bin *bin) {
+	void *ptr;
+
+	ptr = bin->head;
+	bin->head = ((void **) ptr)[0];
+	((void **) ptr)[1] = NULL;
+	bin->count--;
+
+	return ptr;
+}
+
+static int tcache_contains(struct tcache *tc, struct tcache_bin *bin,
+		void *ptr) {
+	unsigned int i;
+	void *it;
+
+	if (((void **) ptr)[1] != tc) {
+		return 0;
+	}
+
+	/* User data can match the mark by chance */
+	it = bin->head;
+	for (i = 0; i < bin->count; i++) {
+		if (it == ptr) {
+			return 1;
+		}
+		it = *(void **) it;
+	}
+
+	return 0;
+}
+
+/* Cache is used only by threads running in their own task */
+static struct tcache *tcache_self(void) {
+	struct thread *t;
+
+	t = thread_self();
+	if ((t == NULL) || (t->task != task_self())) {
+		return NULL;
+	}
+
+	return &t->tcache;
+}
+
+static void tcache_refill(struct tcache *tc, struct tcache_bin *bin,
+		size_t size, struct dlist_head *mspace) {
+	void *ptr;
+
+	sched_lock();
+	{
+		while (bin->count < TCACHE_BATCH) {
+			ptr = mspace_malloc(size, mspace);
+			if (ptr == NULL) {
+				break;
+			}
+			tcache_push(tc, bin, ptr);
+		}
+	}
+	sched_unlock();
+
+	tc->stats.refills++;
+}
+
+static void tcache_drain(struct tcache *tc, struct tcache_bin *bin,
+		unsigned int left, struct dlist_head *mspace) {
+	sched_lock();
+	{
+		while (bin->count > left) {
+			mspace_free(tcache_pop(bin), mspace);
+		}
+	}
+	sched_unlock();
+
+	tc->stats.flushes++;
+}
+
+void *tcache_alloc(size_t size, struct dlist_head *mspace) {
+	struct tcache_bin *bin;
+	struct tcache *tc;
+	int cls;
+
+	assert(mspace);
+
+	if ((size == 0) || (size > TCACHE_MAX_SIZE)) {
+		return NULL;
+	}
+
+	tc = tcache_self();
+	if (tc == NULL) {
+		return NULL;
+	}
+
+	/* The smallest class which blocks are not less than @a size */
+	cls = (size + TCACHE_STEP - 1) / TCACHE_STEP - 1;
+	bin = &tc->bins[cls];
+
+	tc->stats.allocs++;
+	if (bin->count != 0) {
+		tc->stats.alloc_hits++;
+	} else {
+		tcache_refill(tc, bin, (cls + 1) * TCACHE_STEP, mspace);
+		if (bin->count == 0) {
+			return NULL;
+		}
+	}
+
+	return tcache_pop(bin);
+}
+
+int tcache_free(void *ptr, struct dlist_head *mspace) {
+	struct tcache_bin *bin;
+	struct tcache *tc;
+	size_t size;
+	int cls;
+
+	assert(ptr);
+	assert(mspace);
+
+	tc = tcache_self();
+	if (tc == NULL) {
+		return -1;
+	}
+
+	/* Blocks of other tasks and blocks which are not busy are freed as
+	 * usual, the heap reports the latter */
+	size = mspace_usable_size(ptr, mspace);
+	if ((size < TCACHE_STEP) || (size >= TCACHE_MAX_SIZE + TCACHE_STEP)) {
+		return -1;
+	}
+
+	/* The largest class which blocks are not greater than @a size */
+	cls = size / TCACHE_STEP - 1;
+	bin = &tc->bins[cls];
+
+	if (tcache_contains(tc, bin, ptr)) {
+		printk("***** free(): the block not busy\n");
+		return 0; /* if we try to free block more than once */
+	}
+
+	tc->stats.frees++;
+	if (bin->count != TCACHE_BIN_SIZE) {
+		tc->stats.free_hits++;
+	} else {
+		tcache_drain(tc, bin, TCACHE_BIN_SIZE - TCACHE_BATCH, mspace);
+	}
+
+	tcache_push(tc, bin, ptr);
+
+	return 0;
+}
+
+void tcache_flush(struct thread *t) {
+	struct dlist_head *mspace;
+	int cls;
+
+	assert(t);
+
+	mspace = &task_heap_get(t->task)->mm;
+
+	for (cls = 0; cls < TCACHE_CLASSES; cls++) {
+		if (t->tcache.bins[cls].count != 0) {
+			tcache_drain(&t->tcache, &t->tcache.bins[cls], 0, mspace);
+		}
+	}
+}
+
+void tcache_get_stats(struct thread *t, struct tcache_stats *stats) {
+	int cls;
+
+	assert(t);
+	assert(stats);
+
+	sched_lock();
+	{
+		memcpy(stats, &t->tcache.stats, sizeof(*stats));
+		stats->cached = 0;
+		for (cls = 0; cls < TCACHE_CLASSES; cls++) {
+			stats->cached += t->tcache.bins[cls].count;
+		}
+	}
+	sched_unlock();
+}
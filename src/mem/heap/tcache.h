@@ -0,0 +1,29 @@
+/**
+ * @file
+ *
+ * @date 17.10.26
+ */
+
+#ifndef MEM_HEAP_TCACHE_H_
+#define MEM_HEAP_TCACHE_H_
+
+#include <framework/mod/options.h>
+
+#define TCACHE_STEP    16
+#define TCACHE_CLASSES \
+	(OPTION_MODULE_GET(embox__mem__tcache, NUMBER, max_size) / TCACHE_STEP)
+
+struct tcache_bin {
+	/* blocks are linked through their first word, the second one points
+	 * to the cache holding the block */
+	void *head;
+	unsigned int count;
+};
+
+struct tcache {
+	struct tcache_bin bins[TCACHE_CLASSES];
+	struct tcache_stats stats;
+};
+typedef struct tcache __tcache_t;
+
+#endif /* MEM_HEAP_TCACHE_H_ */
@@ -0,0 +1,37 @@
+/**
+ * @file
+ *
+ * @date 17.10.26
+ */
+
+#ifndef MEM_HEAP_TCACHE_NONE_H_
+#define MEM_HEAP_TCACHE_NONE_H_
+
+#include <stddef.h>
+#include <string.h>
+
+struct tcache {
+};
+typedef struct tcache __tcache_t;
+
+static inline void *tcache_alloc(size_t size, struct dlist_head *mspace) {
+	(void)size; (void)mspace;
+	return NULL;
+}
+
+static inline int tcache_free(void *ptr, struct dlist_head *mspace) {
+	(void)ptr; (void)mspace;
+	return -1;
+}
+
+static inline void tcache_flush(struct thread *t) {
+	(void)t;
+}
+
+static inline void tcache_get_stats(struct thread *t,
+		struct tcache_stats *stats) {
+	(void)t;
+	memset(stats, 0, sizeof(*stats));
+}
+
+#endif /* MEM_HEAP_TCACHE_NONE_H_ */
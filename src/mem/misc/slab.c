@@ -2,6 +2,18 @@
  * @file
  * @brief SLAB allocator
  *
+ * @details Each CPU keeps a magazine of free objects of every cache, so
+ *   allocation and freeing don't take the cache lock while the magazine is
+ *   neither empty nor full. Then half of the magazine is moved from or to
+ *   slabs at once.
+ *
+ *   Objects of successive slabs start at different offsets (colours) within
+ *   unused space of slab, so objects of the same index in different slabs
+ *   don't fall into the same cache lines.
+ *
+ *   When no slab can be allocated, memory of other caches is reclaimed by
+ *   shrinkers, and free slabs are given up to shrinkers in turn.
+ *
  * @date 14.12.10
  * @author Dmitry Zubarevich
  * @author Kirill Tyushev
@@ -18,9 +30,13 @@
 #include <util/slist.h>
 #include <util/binalign.h>
 
+#include <hal/cpu.h>
+#include <hal/ipl.h>
+#include <kernel/spinlock.h>
 #include <mem/misc/slab.h>
 #include <mem/page.h>
 #include <mem/heap.h>
+#include <mem/shrinker.h>
 #include <framework/mod/ops.h>
 #include <mem/phymem.h>
 
@@ -40,12 +56,6 @@ typedef struct slab {
 	unsigned int inuse;
 } slab_t;
 
-/* some information about page  */
-typedef struct page_info {
-	cache_t *cache;
-	slab_t *slab;
-} page_info_t;
-
 static struct page_allocator *slab_pa;
 
 #if 0
@@ -54,15 +64,14 @@ static struct page_allocator *slab_pa;
 
 #define HEAP_SIZE OPTION_MODULE_GET(embox__mem__slab,NUMBER,heap_size)
 
-static char *heap_start_ptr;
+/* objects moved between magazine and slabs at once */
+#define SLAB_BATCH ((SLAB_MAGAZINE_SIZE + 1) / 2)
 
-static page_info_t pages[HEAP_SIZE / PAGE_SIZE()];
+/* slab which each page belongs to */
+static slab_t *pages[HEAP_SIZE / PAGE_SIZE()];
 
-/* macros to finding the cache and slab which an obj belongs to */
-#define SET_PAGE_CACHE(pg, x)  ((pg)->cache = (x))
-#define GET_PAGE_CACHE(pg)    ((pg)->cache)
-#define SET_PAGE_SLAB(pg, x)   ((pg)->slab = (x))
-#define GET_PAGE_SLAB(pg)     ((pg)->slab)
+/* protects list of caches */
+static spinlock_t cache_chain_lock = SPIN_STATIC_UNLOCKED;
 
 #ifdef SLAB_ALLOCATOR_DEBUG
 void print_slab_info(cache_t *cachep, slab_t *slabp) {
@@ -78,26 +87,25 @@ void print_slab_info(cache_t *cachep, slab_t *slabp) {
 }
 #endif
 
-/* return information about page which an object belongs to */
-static page_info_t* ptr_to_page(void *objp) {
-	unsigned int index = ((unsigned int) objp - (unsigned int) heap_start_ptr)
-			/ PAGE_SIZE();
-	return &(pages[index]);
+/* return slab which an object belongs to */
+static slab_t **ptr_to_page(void *objp) {
+	return &pages[((char *) objp - (char *) slab_pa->pages_start)
+			/ PAGE_SIZE()];
 }
 
-/* main cache which will contain another descriptors of caches */
+/* main cache which will contain another descriptors of caches,
+ * number of objects and colours are estimated at init */
 cache_t cache_chain = {
 	.name = "__cache_chain",
-	.num  = (PAGE_SIZE() * CACHE_CHAIN_SIZE
-				- binalign_bound(sizeof(slab_t), 4))
-				/ binalign_bound(sizeof(cache_t), 4),
 	.obj_size = binalign_bound(sizeof(cache_t), sizeof(struct slist_link)),
 	.slabs_full = DLIST_INIT(cache_chain.slabs_full),
 	.slabs_free = DLIST_INIT(cache_chain.slabs_free),
 	.slabs_partial = DLIST_INIT(cache_chain.slabs_partial),
 	.next = DLIST_INIT(cache_chain.next),
 	.slab_order = CACHE_CHAIN_SIZE,
-	.growing = true
+	.growing = true,
+	.lock = SPIN_STATIC_UNLOCKED,
+	.colour = 1,
 };
 
 /** Initialize cache according to storage data in info structure */
@@ -117,12 +125,18 @@ static int cache_member_init(const struct mod_member *info) {
  * @param slab_ptr the pointer to slab which must be deleted
  */
 static void cache_slab_destroy(cache_t *cachep, slab_t *slabp) {
-	page_free(slab_pa, slabp, slabp->inuse);
+	page_free(slab_pa, slabp, 1 << cachep->slab_order);
+	cachep->slabs_nr--;
 }
 
 /* init slab descriptor and slab objects */
 static void cache_slab_init(cache_t *cachep, slab_t *slabp) {
-	char *elem = (char*) slabp + binalign_bound(sizeof(slab_t), 4);
+	char *elem = (char*) slabp + binalign_bound(sizeof(slab_t), 4)
+			+ cachep->colour_next * SLAB_COLOUR_ALIGN;
+
+	if (++cachep->colour_next == cachep->colour) {
+		cachep->colour_next = 0;
+	}
 
 	slabp->inuse = 0;
 	dlist_head_init(&slabp->cache_link);
@@ -138,7 +152,7 @@ static void cache_slab_init(cache_t *cachep, slab_t *slabp) {
 /* grow (by 1) the number of slabs within a cache */
 static int cache_grow(cache_t *cachep) {
 	int pages_count;
-	page_info_t *page;
+	slab_t **page;
 	slab_t * slabp;
 	size_t slab_size = 1 << cachep->slab_order;
 
@@ -149,14 +163,13 @@ static int cache_grow(cache_t *cachep) {
 	pages_count = slab_size;
 
 	do {
-		SET_PAGE_CACHE(page, cachep);
-		SET_PAGE_SLAB(page, slabp);
-		page++;
+		*page++ = slabp;
 	} while (--pages_count);
 
 	cache_slab_init(cachep, slabp);
 
 	dlist_add_prev(&slabp->cache_link, &cachep->slabs_free);
+	cachep->slabs_nr++;
 
 	return 1;
 }
@@ -193,6 +206,7 @@ static void cache_estimate(unsigned int gfporder, size_t size,
 
 int cache_init(cache_t *cachep, size_t obj_size, size_t obj_num) {
 	size_t left_over;
+	ipl_t ipl;
 
 	assert(cachep != NULL);
 
@@ -225,11 +239,15 @@ int cache_init(cache_t *cachep, size_t obj_size, size_t obj_num) {
 	}
 
 	cachep->growing = true;
+	spin_init(&cachep->lock, __SPIN_UNLOCKED);
+	cachep->colour = left_over / SLAB_COLOUR_ALIGN + 1;
+	cachep->colour_next = 0;
+	cachep->slabs_nr = 0;
+	cachep->inuse = 0;
+	memset(cachep->cpu, 0, sizeof(cachep->cpu));
 	dlist_init(&cachep->slabs_full);
 	dlist_init(&cachep->slabs_partial);
 	dlist_init(&cachep->slabs_free);
-	dlist_head_init(&cachep->next);
-	dlist_add_prev(&cachep->next, &(cache_chain.next));
 
 	/* Reserve memory for minimum count of objects (obj_num) */
 	while (obj_num >= cachep->num) {
@@ -241,6 +259,13 @@ int cache_init(cache_t *cachep, size_t obj_size, size_t obj_num) {
 		cache_grow(cachep);
 	}
 
+	dlist_head_init(&cachep->next);
+	ipl = spin_lock_ipl(&cache_chain_lock);
+	{
+		dlist_add_prev(&cachep->next, &(cache_chain.next));
+	}
+	spin_unlock_ipl(&cache_chain_lock, ipl);
+
 #ifdef SLAB_ALLOCATOR_DEBUG
 	printf("\n\nCreating cache with name \"%s\"\n", cachep->name);
 	printf("Object size: %d\n", cachep->obj_size);
@@ -285,25 +310,12 @@ static void destroy_slabs(cache_t *cachep, struct dlist_head *slabs) {
 	}
 }
 
-int cache_destroy(cache_t *cachep) {
-	assert(cachep);
-
-	destroy_slabs(cachep, &cachep->slabs_free);
-	destroy_slabs(cachep, &cachep->slabs_full);
-	destroy_slabs(cachep, &cachep->slabs_partial);
-
-	dlist_del(&cachep->next);
-	cache_free(&cache_chain, cachep);
-
-	return 0;
-}
+/* The following functions are called under cache lock */
 
-void *cache_alloc(cache_t *cachep) {
+static void *cache_obj_get(cache_t *cachep) {
 	slab_t * slabp;
 	void *objp;
 
-	assert(cachep);
-
 	/* getting slab */
 	if (dlist_empty(&cachep->slabs_partial)) {
 		if (dlist_empty(&cachep->slabs_free)) {
@@ -326,6 +338,7 @@ void *cache_alloc(cache_t *cachep) {
 		dlist_del(&slabp->cache_link);
 		dlist_add_prev(&slabp->cache_link, &cachep->slabs_partial);
 	}
+	cachep->inuse++;
 
 #ifdef SLAB_ALLOCATOR_DEBUG
 	printf("\n\nSlab info after allocating object:");
@@ -335,17 +348,10 @@ void *cache_alloc(cache_t *cachep) {
 	return objp;
 }
 
-void cache_free(cache_t *cachep, void* objp) {
+static void cache_obj_put(cache_t *cachep, void *objp) {
 	slab_t * slabp;
-	page_info_t* page;
-
-	assert(cachep);
-
-	if (objp == NULL)
-		return;
 
-	page = ptr_to_page(objp);
-	slabp = GET_PAGE_SLAB(page);
+	slabp = *ptr_to_page(objp);
 	slist_add_first_link(slist_link_init((struct slist_link *)objp),
 			&slabp->free_blocks);
 	slabp->inuse--;
@@ -357,6 +363,7 @@ void cache_free(cache_t *cachep, void* objp) {
 		dlist_del(&slabp->cache_link);
 		dlist_add_next(&slabp->cache_link, &cachep->slabs_partial);
 	}
+	cachep->inuse--;
 
 #ifdef SLAB_ALLOCATOR_DEBUG
 	printf("\n\nSlab info after freeing object:");
@@ -364,24 +371,306 @@ void cache_free(cache_t *cachep, void* objp) {
 #endif
 }
 
+static int cache_destroy_free_slabs(cache_t *cachep) {
+	int ret;
+
+	ret = cachep->slabs_nr;
+	destroy_slabs(cachep, &cachep->slabs_free);
+
+	return ret - cachep->slabs_nr;
+}
+
+/* Returns objects of the current CPU magazine to slabs, then removes free
+ * slabs. Called with local interrupts disabled */
+static int cache_reclaim(cache_t *cachep) {
+	struct cache_cpu *cpu;
+	int ret;
+
+	cpu = &cachep->cpu[cpu_get_id()];
+
+	spin_lock(&cachep->lock);
+	{
+		while (cpu->count != 0) {
+			cache_obj_put(cachep, cpu->objs[--cpu->count]);
+		}
+		ret = cache_destroy_free_slabs(cachep);
+	}
+	spin_unlock(&cachep->lock);
+
+	return ret;
+}
+
+/* Takes up to @a nr objects from slabs. Called with local interrupts
+ * disabled */
+static unsigned int cache_take(cache_t *cachep, void **objs, unsigned int nr) {
+	unsigned int n;
+
+	spin_lock(&cachep->lock);
+	{
+		for (n = 0; n < nr; n++) {
+			if (!(objs[n] = cache_obj_get(cachep))) {
+				break;
+			}
+		}
+	}
+	spin_unlock(&cachep->lock);
+
+	return n;
+}
+
+static void cache_put(cache_t *cachep, void **objs, unsigned int nr) {
+	spin_lock(&cachep->lock);
+	{
+		while (nr--) {
+			cache_obj_put(cachep, *objs++);
+		}
+	}
+	spin_unlock(&cachep->lock);
+}
+
+int cache_destroy(cache_t *cachep) {
+	int i;
+	ipl_t ipl;
+
+	assert(cachep);
+
+	ipl = spin_lock_ipl(&cache_chain_lock);
+	{
+		dlist_del(&cachep->next);
+	}
+	spin_unlock_ipl(&cache_chain_lock, ipl);
+
+	ipl = spin_lock_ipl(&cachep->lock);
+	{
+		/* Cache isn't used anymore, so magazines of other CPUs are safe */
+		for (i = 0; i < NCPU; i++) {
+			while (cachep->cpu[i].count != 0) {
+				cache_obj_put(cachep,
+						cachep->cpu[i].objs[--cachep->cpu[i].count]);
+			}
+		}
+
+		destroy_slabs(cachep, &cachep->slabs_free);
+		destroy_slabs(cachep, &cachep->slabs_full);
+		destroy_slabs(cachep, &cachep->slabs_partial);
+	}
+	spin_unlock_ipl(&cachep->lock, ipl);
+
+	cache_free(&cache_chain, cachep);
+
+	return 0;
+}
+
+static void *cache_alloc_cpu(cache_t *cachep) {
+	struct cache_cpu *cpu;
+	void *objp;
+	ipl_t ipl;
+
+	ipl = ipl_save();
+	{
+		cpu = &cachep->cpu[cpu_get_id()];
+
+		cpu->allocs++;
+		if (SLAB_MAGAZINE_SIZE == 0) {
+			if (0 == cache_take(cachep, &objp, 1)) {
+				objp = NULL;
+			}
+		} else {
+			if (cpu->count != 0) {
+				cpu->alloc_hits++;
+			} else {
+				cpu->count = cache_take(cachep, cpu->objs, SLAB_BATCH);
+			}
+			objp = (cpu->count != 0) ? cpu->objs[--cpu->count] : NULL;
+		}
+	}
+	ipl_restore(ipl);
+
+	return objp;
+}
+
+void *cache_alloc(cache_t *cachep) {
+	void *objp;
+
+	assert(cachep);
+
+	objp = cache_alloc_cpu(cachep);
+	/* There is no memory for a new slab. Other caches are shrunk with
+	 * interrupts enabled, as shrinkers can take long */
+	if ((objp == NULL) && cachep->growing
+			&& (0 != shrink_caches(SHRINK_SLAB, SHRINK_BATCH))) {
+		objp = cache_alloc_cpu(cachep);
+	}
+
+	return objp;
+}
+
+void cache_free(cache_t *cachep, void* objp) {
+	struct cache_cpu *cpu;
+	ipl_t ipl;
+
+	assert(cachep);
+
+	if (objp == NULL)
+		return;
+
+	ipl = ipl_save();
+	{
+		cpu = &cachep->cpu[cpu_get_id()];
+
+		cpu->frees++;
+		if (SLAB_MAGAZINE_SIZE == 0) {
+			cache_put(cachep, &objp, 1);
+		} else {
+			if (cpu->count != SLAB_MAGAZINE_SIZE) {
+				cpu->free_hits++;
+			} else {
+				cpu->count -= SLAB_BATCH;
+				cache_put(cachep, &cpu->objs[cpu->count], SLAB_BATCH);
+			}
+			cpu->objs[cpu->count++] = objp;
+		}
+	}
+	ipl_restore(ipl);
+}
+
 int cache_shrink(cache_t *cachep) {
-	slab_t * slabp;
-	int ret = 0;
+	int ret;
+	ipl_t ipl;
 
 	assert(cachep);
 
-	dlist_foreach_entry(slabp, &cachep->slabs_free, cache_link) {
-		dlist_del(&slabp->cache_link);
-		cache_slab_destroy(cachep, slabp);
-		ret++;
+	ipl = ipl_save();
+	{
+		ret = cache_reclaim(cachep);
 	}
+	ipl_restore(ipl);
 
 	return ret;
 }
 
+static void cache_get_stats_one(cache_t *cachep, struct cache_stats *stats) {
+	slab_t *slabp;
+	int i;
+
+	memset(stats, 0, sizeof(*stats));
+
+	spin_lock(&cachep->lock);
+	{
+		strncpy(stats->name, cachep->name, sizeof(stats->name) - 1);
+		stats->obj_size = cachep->obj_size;
+		stats->num = cachep->num;
+		stats->slab_order = cachep->slab_order;
+		stats->colour = cachep->colour;
+		stats->slabs = cachep->slabs_nr;
+		dlist_foreach_entry(slabp, &cachep->slabs_free, cache_link) {
+			stats->slabs_free++;
+		}
+		stats->inuse = cachep->inuse;
+	}
+	spin_unlock(&cachep->lock);
+
+	for (i = 0; i < NCPU; i++) {
+		stats->cached += cachep->cpu[i].count;
+		stats->allocs += cachep->cpu[i].allocs;
+		stats->alloc_hits += cachep->cpu[i].alloc_hits;
+		stats->frees += cachep->cpu[i].frees;
+		stats->free_hits += cachep->cpu[i].free_hits;
+	}
+}
+
+int cache_get_stats(struct cache_stats *stats, int nr) {
+	cache_t *cachep;
+	int n;
+	ipl_t ipl;
+
+	assert(stats || (nr == 0));
+
+	n = 0;
+	ipl = spin_lock_ipl(&cache_chain_lock);
+	{
+		if (n++ < nr) {
+			cache_get_stats_one(&cache_chain, &stats[0]);
+		}
+		dlist_foreach_entry(cachep, &cache_chain.next, next) {
+			if (n < nr) {
+				cache_get_stats_one(cachep, &stats[n]);
+			}
+			n++;
+		}
+	}
+	spin_unlock_ipl(&cache_chain_lock, ipl);
+
+	return n;
+}
+
+/* Objects in free slabs and in magazines of the current CPU */
+static size_t slab_shrink_count_one(cache_t *cachep) {
+	slab_t *slabp;
+	size_t cnt;
+
+	cnt = cachep->cpu[cpu_get_id()].count;
+
+	spin_lock(&cachep->lock);
+	{
+		dlist_foreach_entry(slabp, &cachep->slabs_free, cache_link) {
+			cnt += cachep->num;
+		}
+	}
+	spin_unlock(&cachep->lock);
+
+	return cnt;
+}
+
+static size_t slab_shrink_count(void) {
+	cache_t *cachep;
+	size_t cnt;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&cache_chain_lock);
+	{
+		cnt = slab_shrink_count_one(&cache_chain);
+		dlist_foreach_entry(cachep, &cache_chain.next, next) {
+			cnt += slab_shrink_count_one(cachep);
+		}
+	}
+	spin_unlock_ipl(&cache_chain_lock, ipl);
+
+	return cnt;
+}
+
+/* Freed objects are counted by removed slabs */
+static size_t slab_shrink_scan(size_t nr) {
+	cache_t *cachep;
+	size_t freed;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&cache_chain_lock);
+	{
+		freed = 0;
+		dlist_foreach_entry(cachep, &cache_chain.next, next) {
+			if (freed >= nr) {
+				break;
+			}
+			freed += cache_reclaim(cachep) * cachep->num;
+		}
+		/* Descriptors of caches are released the last */
+		if (freed < nr) {
+			freed += cache_reclaim(&cache_chain) * cache_chain.num;
+		}
+	}
+	spin_unlock_ipl(&cache_chain_lock, ipl);
+
+	return freed;
+}
+
+SHRINKER_DEF("slab", SHRINK_SLAB, slab_shrink_count, slab_shrink_scan);
+
 static int slab_init(void) {
 	extern struct page_allocator *__heap_pgallocator;
 	int page_cnt = (HEAP_SIZE / PAGE_SIZE() - 2);
+	char *heap_start_ptr;
+	size_t left_over;
 
 	heap_start_ptr = page_alloc(__heap_pgallocator, page_cnt);
 
@@ -390,8 +679,14 @@ static int slab_init(void) {
 	}
 
 	slab_pa = page_allocator_init(heap_start_ptr, page_cnt * PAGE_SIZE(), PAGE_SIZE());
+	if (NULL == slab_pa) {
+		page_free(__heap_pgallocator, heap_start_ptr, page_cnt);
+		return -1;
+	}
 
-	heap_start_ptr += PAGE_SIZE();
+	cache_estimate(cache_chain.slab_order, cache_chain.obj_size, &left_over,
+			&cache_chain.num);
+	cache_chain.colour = left_over / SLAB_COLOUR_ALIGN + 1;
 
 	return 0;
 }
@@ -10,7 +10,10 @@
 #define MEM_MISC_SLAB_IMPL_H_
 
 #include <util/dlist.h>
+#include <framework/mod/options.h>
 #include <framework/mod/self.h>
+#include <hal/cpu.h>
+#include <kernel/spinlock.h>
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -27,6 +30,21 @@
 #define CACHE_CHAIN_SIZE 1
 /** use to search a fit cache for object */
 #define MAX_OBJECT_ALIGN 0
+/** objects in slabs of a cache start at different offsets multiple of it */
+#define SLAB_COLOUR_ALIGN 32
+/** max number of free objects kept by each CPU */
+#define SLAB_MAGAZINE_SIZE \
+	OPTION_MODULE_GET(embox__mem__slab,NUMBER,magazine_size)
+
+/** free objects of cache kept by one CPU */
+struct cache_cpu {
+	unsigned int count;
+	unsigned long allocs;
+	unsigned long alloc_hits;
+	unsigned long frees;
+	unsigned long free_hits;
+	void *objs[SLAB_MAGAZINE_SIZE ? SLAB_MAGAZINE_SIZE : 1];
+};
 
 /** cache descriptor */
 struct cache {
@@ -48,12 +66,25 @@ struct cache {
 	unsigned int slab_order;
 	/** Indicates weather cache can growing or not. All caches are growing by default */
 	bool growing;
+	/** protects slabs and counters of cache */
+	spinlock_t lock;
+	/** number of different offsets of objects in slabs */
+	unsigned int colour;
+	/** offset of objects in the next slab in SLAB_COLOUR_ALIGN units */
+	unsigned int colour_next;
+	/** number of slabs */
+	unsigned int slabs_nr;
+	/** number of objects taken from slabs, including cached by CPUs */
+	unsigned int inuse;
+	/** per-CPU magazines */
+	struct cache_cpu cpu[NCPU];
 };
 
 #define __CACHE_DEF(cache_nm, object_t, objects_nr) \
 	static struct cache cache_nm =  {                      \
 		.num = (objects_nr),              \
 		.obj_size = sizeof(object_t),                  \
+		.lock = SPIN_STATIC_UNLOCKED,                  \
 	};                                                     \
 	extern const struct mod_member_ops __cache_member_ops; \
 	MOD_MEMBER_BIND(&__cache_member_ops, &cache_nm)
@@ -1,15 +0,0 @@
-/*
- * @file
- *
- * @date Apr 12, 2013
- * @author: Anton Bondarev
- */
-
-#ifndef BITMASK_H_
-#define BITMASK_H_
-
-
-#define PAGE_SIZE() OPTION_MODULE_GET(embox__mem__bitmask,NUMBER,page_size)
-
-
-#endif /* BITMASK_H_ */
@@ -0,0 +1,482 @@
+/**
+ * @file
+ * @brief Binary buddy page allocator
+ *
+ * @details Free memory is kept in blocks of 2^order pages aligned to their
+ *   size, each order has its own list of free blocks. Allocation splits
+ *   the smallest suitable block, freeing merges a block with its buddy
+ *   while the buddy is free too, so both take O(log n).
+ *
+ *   Lists are linked through the free pages themselves, a page has only
+ *   a byte of state: the order and a flag if it starts a free block.
+ *
+ *   Single pages are cached by each CPU: allocation and freeing of them
+ *   touch only CPU local list with local interrupts disabled. The
+ *   allocator is locked to move a batch of pages to or from the list.
+ *
+ * @date 14.11.2011
+ * @author Anton Bondarev
+ * @author Anton Kozlov
+ */
+
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <limits.h>
+#include <hal/cpu.h>
+#include <hal/ipl.h>
+#include <kernel/printk.h>
+#include <util/binalign.h>
+#include <util/bit.h>
+#include <util/dlist.h>
+#include <util/math.h>
+
+#include <mem/page.h>
+#include <embox/unit.h>
+
+#define PCP_HIGH   OPTION_GET(NUMBER, pcp_high)
+
+#define PAGE_FREE  0x80 /* page starts a free block */
+#define PAGE_PCP   0x40 /* page is in per-CPU list */
+#define PAGE_ORDER 0x3f
+
+struct page_area {
+	struct dlist_head blocks;
+	unsigned int nr_free;
+};
+
+struct page_pcp {
+	struct dlist_head pages;
+	unsigned int count;
+};
+
+static inline unsigned int page_ptr2i(struct page_allocator *allocator, void *page) {
+	return (page - allocator->pages_start) / allocator->page_size;
+}
+
+static inline void *page_i2ptr(struct page_allocator *allocator, unsigned int i) {
+	return allocator->pages_start + i * allocator->page_size;
+}
+
+static inline struct dlist_head *page_link(struct page_allocator *allocator,
+		unsigned int i) {
+	return page_i2ptr(allocator, i);
+}
+
+static void area_add(struct page_allocator *allocator, unsigned int i,
+		unsigned int order) {
+	struct page_area *area = &allocator->areas[order];
+	struct dlist_head *link = page_link(allocator, i);
+
+	allocator->page_state[i] = PAGE_FREE | order;
+	dlist_head_init(link);
+	dlist_add_prev(link, &area->blocks);
+	area->nr_free++;
+
+	allocator->free += allocator->page_size << order;
+}
+
+static void area_del(struct page_allocator *allocator, unsigned int i,
+		unsigned int order) {
+	struct page_area *area = &allocator->areas[order];
+
+	assert(allocator->page_state[i] == (PAGE_FREE | order));
+
+	allocator->page_state[i] = 0;
+	dlist_del(page_link(allocator, i));
+	area->nr_free--;
+
+	allocator->free -= allocator->page_size << order;
+}
+
+static void buddy_free_block(struct page_allocator *allocator, unsigned int i,
+		unsigned int order) {
+	unsigned int buddy;
+
+	while (order < allocator->max_order) {
+		buddy = i ^ (1U << order);
+		if ((buddy + (1U << order) > allocator->pages_n)
+				|| (allocator->page_state[buddy] != (PAGE_FREE | order))) {
+			break;
+		}
+
+		area_del(allocator, buddy, order);
+		i &= ~(1U << order);
+		order++;
+	}
+
+	area_add(allocator, i, order);
+}
+
+static int buddy_alloc_block(struct page_allocator *allocator,
+		unsigned int order) {
+	struct dlist_head *link;
+	unsigned int k, i;
+
+	for (k = order; k <= allocator->max_order; k++) {
+		if (!dlist_empty(&allocator->areas[k].blocks)) {
+			break;
+		}
+	}
+	if (k > allocator->max_order) {
+		return -1;
+	}
+
+	link = allocator->areas[k].blocks.next;
+	i = page_ptr2i(allocator, link);
+	area_del(allocator, i, k);
+
+	/* Upper halves of the block are left free */
+	while (k > order) {
+		k--;
+		area_add(allocator, i + (1U << k), k);
+	}
+
+	return i;
+}
+
+/* Splits pages into the largest aligned blocks and frees them */
+static void buddy_free_range(struct page_allocator *allocator, unsigned int i,
+		unsigned int page_q) {
+	unsigned int order;
+
+	assert(i + page_q <= allocator->pages_n);
+
+	while (page_q) {
+		if (allocator->page_state[i] != 0) {
+			printk("***** page_free(): the page not busy\n");
+			i++;
+			page_q--;
+			continue;
+		}
+
+		order = min((unsigned int) bit_fls(page_q) - 1, allocator->max_order);
+		if (i != 0) {
+			order = min(order, (unsigned int) bit_ctz(i));
+		}
+
+		buddy_free_block(allocator, i, order);
+		i += 1U << order;
+		page_q -= 1U << order;
+	}
+}
+
+/* Takes a run of adjacent free blocks, it's used when there is no block
+ * of suitable order */
+static int buddy_alloc_run(struct page_allocator *allocator,
+		unsigned int page_q) {
+	unsigned int i, j, start, run, order;
+
+	run = start = 0;
+	for (i = 0; i < allocator->pages_n; ) {
+		if (!(allocator->page_state[i] & PAGE_FREE)) {
+			run = 0;
+			i++;
+			continue;
+		}
+
+		if (run == 0) {
+			start = i;
+		}
+		order = allocator->page_state[i] & PAGE_ORDER;
+		run += 1U << order;
+		i += 1U << order;
+
+		if (run >= page_q) {
+			for (j = start; j < i; j += 1U << order) {
+				order = allocator->page_state[j] & PAGE_ORDER;
+				area_del(allocator, j, order);
+			}
+			buddy_free_range(allocator, start + page_q, run - page_q);
+			return start;
+		}
+	}
+
+	return -1;
+}
+
+static int buddy_alloc(struct page_allocator *allocator, unsigned int page_q) {
+	unsigned int order;
+	int i;
+
+	order = page_q > 1 ? bit_fls(page_q - 1) : 0;
+	if (order <= allocator->max_order) {
+		i = buddy_alloc_block(allocator, order);
+		if (i >= 0) {
+			/* The rest of the block isn't needed */
+			buddy_free_range(allocator, i + page_q, (1U << order) - page_q);
+			return i;
+		}
+	}
+
+	return buddy_alloc_run(allocator, page_q);
+}
+
+static void pcp_refill(struct page_allocator *allocator, struct page_pcp *pcp) {
+	int i;
+
+	spin_lock(&allocator->lock);
+	{
+		while (pcp->count < (allocator->pcp_high + 1) / 2) {
+			i = buddy_alloc_block(allocator, 0);
+			if (i < 0) {
+				break;
+			}
+			allocator->page_state[i] = PAGE_PCP;
+			dlist_head_init(page_link(allocator, i));
+			dlist_add_prev(page_link(allocator, i), &pcp->pages);
+			pcp->count++;
+		}
+	}
+	spin_unlock(&allocator->lock);
+}
+
+static void pcp_drain(struct page_allocator *allocator, struct page_pcp *pcp,
+		unsigned int left) {
+	struct dlist_head *link;
+	unsigned int i;
+
+	spin_lock(&allocator->lock);
+	{
+		while (pcp->count > left) {
+			/* The oldest pages are returned */
+			link = pcp->pages.next;
+			dlist_del(link);
+			pcp->count--;
+
+			i = page_ptr2i(allocator, link);
+			allocator->page_state[i] = 0;
+			buddy_free_block(allocator, i, 0);
+		}
+	}
+	spin_unlock(&allocator->lock);
+}
+
+static void *pcp_alloc(struct page_allocator *allocator) {
+	struct page_pcp *pcp;
+	struct dlist_head *link;
+	ipl_t ipl;
+
+	link = NULL;
+
+	ipl = ipl_save();
+	{
+		pcp = &allocator->pcp[cpu_get_id()];
+		if (pcp->count == 0) {
+			pcp_refill(allocator, pcp);
+		}
+		if (pcp->count != 0) {
+			/* The most recently freed page is likely in cache */
+			link = pcp->pages.prev;
+			dlist_del(link);
+			pcp->count--;
+			allocator->page_state[page_ptr2i(allocator, link)] = 0;
+		}
+	}
+	ipl_restore(ipl);
+
+	return link;
+}
+
+static void pcp_free(struct page_allocator *allocator, void *page) {
+	struct page_pcp *pcp;
+	struct dlist_head *link;
+	unsigned int i;
+	ipl_t ipl;
+
+	i = page_ptr2i(allocator, page);
+	link = page;
+
+	ipl = ipl_save();
+	{
+		if (allocator->page_state[i] != 0) {
+			ipl_restore(ipl);
+			printk("***** page_free(): the page not busy\n");
+			return;
+		}
+
+		pcp = &allocator->pcp[cpu_get_id()];
+		if (pcp->count == allocator->pcp_high) {
+			pcp_drain(allocator, pcp, allocator->pcp_high / 2);
+		}
+
+		allocator->page_state[i] = PAGE_PCP;
+		dlist_head_init(link);
+		dlist_add_prev(link, &pcp->pages);
+		pcp->count++;
+	}
+	ipl_restore(ipl);
+}
+
+void *page_alloc(struct page_allocator *allocator, size_t page_q) {
+	struct page_pcp *pcp;
+	void *page;
+	ipl_t ipl;
+	int i;
+
+	assert(allocator);
+
+	if ((page_q == 0) || (page_q > allocator->pages_n)) {
+		return NULL;
+	}
+
+	if ((page_q == 1) && allocator->pcp_high) {
+		return pcp_alloc(allocator);
+	}
+
+	ipl = spin_lock_ipl(&allocator->lock);
+	{
+		i = buddy_alloc(allocator, page_q);
+	}
+	spin_unlock_ipl(&allocator->lock, ipl);
+
+	if ((i < 0) && allocator->pcp_high) {
+		/* Pages cached by this CPU might be the missing part */
+		ipl = ipl_save();
+		{
+			pcp = &allocator->pcp[cpu_get_id()];
+			pcp_drain(allocator, pcp, 0);
+
+			spin_lock(&allocator->lock);
+			{
+				i = buddy_alloc(allocator, page_q);
+			}
+			spin_unlock(&allocator->lock);
+		}
+		ipl_restore(ipl);
+	}
+
+	page = (i >= 0) ? page_i2ptr(allocator, i) : NULL;
+
+	return page;
+}
+
+void *page_alloc_zero(struct page_allocator *allocator, size_t page_q) {
+	char *page_p;
+
+	if (NULL != (page_p = page_alloc(allocator, page_q))) {
+		memset(page_p, 0, page_q * allocator->page_size);
+	}
+
+	return page_p;
+}
+
+void page_free(struct page_allocator *allocator, void *page, size_t page_q) {
+	ipl_t ipl;
+
+	assert(allocator);
+	assert(page_belong(allocator, page));
+
+	if ((page_q == 1) && allocator->pcp_high) {
+		pcp_free(allocator, page);
+		return;
+	}
+
+	ipl = spin_lock_ipl(&allocator->lock);
+	{
+		buddy_free_range(allocator, page_ptr2i(allocator, page), page_q);
+	}
+	spin_unlock_ipl(&allocator->lock, ipl);
+}
+
+static size_t page_ctrl_size(unsigned int pages) {
+	size_t size;
+
+	size = binalign_bound(sizeof(struct page_allocator), sizeof(void *));
+	size += min(bit_fls(pages), PAGE_MAX_ORDER) * sizeof(struct page_area);
+	size += NCPU * sizeof(struct page_pcp);
+	size += pages;
+
+	return size;
+}
+
+struct page_allocator *page_allocator_init(char *start, size_t len, size_t page_size) {
+	char *pages_start, *end;
+	struct page_allocator *allocator;
+	unsigned int pages, i;
+	char *ctrl;
+
+	if ((len < page_size + sizeof(struct page_allocator))
+			|| (page_size < sizeof(struct dlist_head))) {
+		return NULL;
+	}
+
+	end = start + len;
+	start = (char *) binalign_bound((uintptr_t) start, 16);
+	pages_start = (char *) binalign_bound((uintptr_t) start, page_size);
+	if (pages_start >= end) {
+		return NULL;
+	}
+	pages = (end - pages_start) / page_size;
+
+	while (page_ctrl_size(pages) > pages_start - start) {
+		pages_start += page_size;
+		pages--;
+		if ((int) pages <= 0) {
+			return NULL;
+		}
+	}
+
+	allocator = (struct page_allocator *) start;
+	allocator->pages_start = pages_start;
+	allocator->pages_n = pages;
+	allocator->page_size = page_size;
+	allocator->free = 0;
+	spin_init(&allocator->lock, __SPIN_UNLOCKED);
+	allocator->max_order = min((unsigned int) bit_fls(pages), PAGE_MAX_ORDER) - 1;
+
+	ctrl = start + binalign_bound(sizeof(struct page_allocator), sizeof(void *));
+	allocator->areas = (struct page_area *) ctrl;
+	ctrl += (allocator->max_order + 1) * sizeof(struct page_area);
+	allocator->pcp = (struct page_pcp *) ctrl;
+	ctrl += NCPU * sizeof(struct page_pcp);
+	allocator->page_state = (unsigned char *) ctrl;
+
+	for (i = 0; i <= allocator->max_order; i++) {
+		dlist_init(&allocator->areas[i].blocks);
+		allocator->areas[i].nr_free = 0;
+	}
+
+	/* A small allocator shouldn't have most of its pages cached */
+	allocator->pcp_high = min((unsigned int) PCP_HIGH, pages / (4 * NCPU));
+	for (i = 0; i < NCPU; i++) {
+		dlist_init(&allocator->pcp[i].pages);
+		allocator->pcp[i].count = 0;
+	}
+
+	memset(allocator->page_state, 0, pages);
+	buddy_free_range(allocator, 0, pages);
+
+	return allocator;
+}
+
+int page_belong(struct page_allocator *allocator, void *page) {
+	void *pages_end = allocator->pages_start + allocator->pages_n * allocator->page_size;
+	return allocator->pages_start <= page && page < pages_end;
+}
+
+void page_get_stat(struct page_allocator *allocator, struct page_stat *stat) {
+	unsigned int i;
+	ipl_t ipl;
+
+	assert(allocator);
+	assert(stat);
+
+	memset(stat, 0, sizeof(*stat));
+
+	ipl = spin_lock_ipl(&allocator->lock);
+	{
+		for (i = 0; i <= allocator->max_order; i++) {
+			stat->blocks[i] = allocator->areas[i].nr_free;
+			stat->free_pages += (size_t) allocator->areas[i].nr_free << i;
+			if (allocator->areas[i].nr_free) {
+				stat->largest_free = (size_t) 1 << i;
+			}
+		}
+	}
+	spin_unlock_ipl(&allocator->lock, ipl);
+
+	for (i = 0; i < NCPU; i++) {
+		stat->cached_pages += allocator->pcp[i].count;
+	}
+}
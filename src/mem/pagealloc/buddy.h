@@ -0,0 +1,15 @@
+/*
+ * @file
+ *
+ * @date Apr 12, 2013
+ * @author: Anton Bondarev
+ */
+
+#ifndef BUDDY_H_
+#define BUDDY_H_
+
+
+#define PAGE_SIZE() OPTION_MODULE_GET(embox__mem__buddy,NUMBER,page_size)
+
+
+#endif /* BUDDY_H_ */
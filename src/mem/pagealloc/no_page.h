@@ -32,6 +32,11 @@ static inline void page_free(struct page_allocator *allocator, void *page, size_
 
 }
 
+static inline void page_get_stat(struct page_allocator *allocator,
+		struct page_stat *stat) {
+
+}
+
 #endif /* __LDS__ */
 
 #endif /* NO_PAGE_H_ */
@@ -0,0 +1,61 @@
+/**
+ * @file
+ * @brief Reclaim of memory held by caches
+ *
+ * @date 17.10.26
+ */
+
+#include <stddef.h>
+
+#include <kernel/spinlock.h>
+#include <mem/shrinker.h>
+#include <util/array.h>
+#include <util/math.h>
+
+ARRAY_SPREAD_DEF(const struct shrinker, __shrinker_registry);
+
+/* Held during reclaim, so memory freed by a shrinker can't start another
+ * reclaim */
+static spinlock_t shrink_lock = SPIN_STATIC_UNLOCKED;
+
+size_t shrink_caches(enum shrink_target target, size_t nr) {
+	const struct shrinker *s;
+	size_t freed, cnt;
+
+	if (!spin_trylock(&shrink_lock)) {
+		return 0;
+	}
+
+	freed = 0;
+	array_spread_foreach_ptr(s, __shrinker_registry) {
+		if (freed >= nr) {
+			break;
+		}
+		if (s->target != target) {
+			continue;
+		}
+
+		cnt = s->count();
+		if (cnt != 0) {
+			freed += s->scan(min(cnt, nr - freed));
+		}
+	}
+
+	spin_unlock(&shrink_lock);
+
+	return freed;
+}
+
+size_t shrink_count(enum shrink_target target) {
+	const struct shrinker *s;
+	size_t cnt;
+
+	cnt = 0;
+	array_spread_foreach_ptr(s, __shrinker_registry) {
+		if (s->target == target) {
+			cnt += s->count();
+		}
+	}
+
+	return cnt;
+}
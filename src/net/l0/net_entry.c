@@ -2,6 +2,19 @@
  * @file
  * @brief
  *
+ * @details
+ *   Devices having received packets are kept in the list and polled in
+ *   round-robin by the lthread. Each device handles at most its weight of
+ *   packets per turn and the lthread handles at most the budget of packets
+ *   per run, then relaunches itself, so one flooding device neither
+ *   starves other devices nor other schedees.
+ *
+ *   Drivers without poll callback push received packets with netif_rx() to
+ *   the device backlog, which is polled the same way. Packets taken by one
+ *   poll are passed to the stack as a batch. Drivers with poll
+ *   callback mask their receive interrupt, call netif_napi_schedule() and
+ *   unmask it after netif_napi_complete() when the ring is drained.
+ *
  * @date 27.10.11
  * @author Anton Kozlov
  * @author Anton Bondarev
@@ -16,6 +29,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <util/dlist.h>
+#include <util/math.h>
+#include <net/l0/net_entry.h>
 #include <net/l0/net_rx.h>
 #include <embox/unit.h>
 
@@ -23,6 +38,10 @@
 #include <kernel/lthread/lthread.h>
 
 #define NETIF_RX_HND_PRIORITY OPTION_GET(NUMBER, hnd_priority)
+#define NETIF_RX_BUDGET       OPTION_GET(NUMBER, budget)
+#define NETIF_RX_WEIGHT       OPTION_GET(NUMBER, weight)
+#define NETIF_RX_BACKLOG      OPTION_GET(NUMBER, backlog)
+#define NETIF_RX_BATCH        OPTION_GET(BOOLEAN, batch)
 
 EMBOX_UNIT_INIT(net_entry_init);
 
@@ -57,44 +76,165 @@ static void netif_rx_dequeued(struct net_device *dev) {
 	ipl_restore(sp);
 }
 
-static void netif_poll(struct net_device *dev) {
-	struct sk_buff *skb;
+/* Moves the device to the tail of the list to let others be polled */
+static void netif_rx_requeued(struct net_device *dev) {
+	ipl_t sp;
 
-	while ((skb = skb_queue_pop(&dev->dev_queue)) != NULL) {
-		net_rx(skb);
+	sp = ipl_save();
+	{
+		if (!dlist_empty(&dev->rx_lnk)) {
+			dlist_del_init(&dev->rx_lnk);
+			dlist_add_prev(&dev->rx_lnk, &netif_rx_list);
+		}
 	}
+	ipl_restore(sp);
+}
+
+static struct net_device *netif_rx_first(void) {
+	struct net_device *dev;
+	ipl_t sp;
+
+	sp = ipl_save();
+	{
+		dev = dlist_empty(&netif_rx_list) ? NULL
+				: dlist_first_entry(&netif_rx_list, struct net_device, rx_lnk);
+	}
+	ipl_restore(sp);
+
+	return dev;
+}
+
+/* Poll callback for devices pushing packets with netif_rx() */
+static int netif_backlog_poll(struct net_device *dev, int budget) {
+	struct sk_buff_head batch;
+	int work;
+	ipl_t sp;
+
+	skb_queue_init(&batch);
+
+	/* The whole batch is taken at once */
+	sp = ipl_save();
+	{
+		work = skb_queue_pop_list(&dev->dev_queue, &batch, budget);
+		dev->dev_queue_len -= work;
+		if (work < budget) {
+			/* Drained, complete it until a new packet comes */
+			dlist_del_init(&dev->rx_lnk);
+		}
+	}
+	ipl_restore(sp);
+
+	netif_receive_skb_list(&batch);
+
+	return work;
 }
 
 static int netif_rx_action(struct lthread *self) {
 	struct net_device *dev;
+	int budget, weight, quota, work;
+
+	budget = NETIF_RX_BUDGET;
+
+	while ((dev = netif_rx_first()) != NULL) {
+		if (budget <= 0) {
+			/* Let other schedees run, we'll continue later */
+			lthread_launch(self);
+			break;
+		}
+
+		weight = dev->poll_weight > 0 ? dev->poll_weight : NETIF_RX_WEIGHT;
+		quota = min(weight, budget);
+
+		dev->stats.rx_polls++;
+		if (dev->poll != NULL) {
+			work = dev->poll(dev, quota);
+		} else {
+			work = netif_backlog_poll(dev, quota);
+		}
+		assert(work <= quota);
+
+		budget -= work;
 
-	dlist_foreach_entry(dev, &netif_rx_list, rx_lnk) {
-		netif_poll(dev);
-		netif_rx_dequeued(dev);
+		if (work == quota) {
+			/* Device may have more packets, but it has used up its turn */
+			dev->stats.rx_poll_squeezed++;
+			netif_rx_requeued(dev);
+		}
 	}
 
 	return 0;
 }
 
-static void netif_rx_schedule(struct sk_buff *skb) {
+void netif_napi_add(struct net_device *dev,
+		int (*poll)(struct net_device *dev, int budget), int weight) {
+	assert(dev != NULL);
+	assert(poll != NULL);
+
+	dev->poll = poll;
+	dev->poll_weight = weight;
+}
+
+void netif_napi_schedule(struct net_device *dev) {
+	netif_rx_queued(dev);
+
+	lthread_launch(&netif_rx_irq_handler);
+}
+
+void netif_napi_complete(struct net_device *dev) {
+	netif_rx_dequeued(dev);
+}
+
+int netif_receive_skb(struct sk_buff *skb) {
+	assert(skb != NULL);
+	return net_rx(skb);
+}
+
+void netif_receive_skb_list(struct sk_buff_head *list) {
+	struct sk_buff *skb;
+
+	assert(list != NULL);
+
+	if (NETIF_RX_BATCH) {
+		net_rx_list(list);
+		return;
+	}
+
+	while ((skb = __skb_queue_pop(list)) != NULL) {
+		net_rx(skb);
+	}
+}
+
+static int netif_rx_schedule(struct sk_buff *skb) {
 	struct net_device *dev;
+	ipl_t sp;
 
 	assert(skb != NULL);
 
 	dev = skb->dev;
 	assert(dev != NULL);
 
-	skb_queue_push(&dev->dev_queue, skb);
+	sp = ipl_save();
+	{
+		if (dev->dev_queue_len >= NETIF_RX_BACKLOG) {
+			ipl_restore(sp);
+			dev->stats.rx_dropped++;
+			skb_free(skb);
+			return NET_RX_DROP;
+		}
+
+		skb_queue_push(&dev->dev_queue, skb);
+		dev->dev_queue_len++;
+	}
+	ipl_restore(sp);
 
-	netif_rx_queued(dev);
+	netif_napi_schedule(dev);
 
-	lthread_launch(&netif_rx_irq_handler);
+	return NET_RX_SUCCESS;
 }
 
 int netif_rx(void *data) {
 	assert(data != NULL);
-	netif_rx_schedule((struct sk_buff *) data);
-	return NET_RX_SUCCESS;
+	return netif_rx_schedule((struct sk_buff *) data);
 }
 
 static int net_entry_init(void) {
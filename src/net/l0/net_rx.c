@@ -20,9 +20,9 @@
 
 #define LOG_LEVEL OPTION_GET(NUMBER, log_level)
 
-int net_rx(struct sk_buff *skb) {
+/* Handles L2 layer of the packet, returns NULL if the packet was consumed */
+static struct sk_buff *net_rx_l2(struct sk_buff *skb, unsigned short *type) {
 	struct net_header_info hdr_info;
-	const struct net_pack *npack;
 
 	/* check L2 header size */
 	assert(skb != NULL);
@@ -30,7 +30,7 @@ int net_rx(struct sk_buff *skb) {
 	if (skb->len < skb->dev->hdr_len) {
 		log_error("%p invalid length %zu", skb, skb->len);
 		skb_free(skb);
-		return 0; /* error: invalid size */
+		return NULL; /* error: invalid size */
 	}
 
 	/* parse L2 header */
@@ -39,7 +39,7 @@ int net_rx(struct sk_buff *skb) {
 	if (0 != skb->dev->ops->parse_hdr(skb, &hdr_info)) {
 		log_error("%p can't parse header", skb);
 		skb_free(skb);
-		return 0; /* error: can't parse L2 header */
+		return NULL; /* error: can't parse L2 header */
 	}
 
 	/* check recipient on L2 layer */
@@ -47,7 +47,7 @@ int net_rx(struct sk_buff *skb) {
 	default:
 		log_debug("%p not for us", skb);
 		skb_free(skb);
-		return 0; /* ok, but: not for us */
+		return NULL; /* ok, but: not for us */
 	case PACKET_HOST:
 	case PACKET_LOOPBACK:
 	case PACKET_BROADCAST:
@@ -64,18 +64,32 @@ int net_rx(struct sk_buff *skb) {
 	/* decrypt packet */
 	skb = net_decrypt(skb);
 	if (skb == NULL) {
-		return 0; /* error: something wrong :( */
+		return NULL; /* error: something wrong :( */
 	}
 
-	sock_packet_add(skb, hdr_info.type);
-
-	/* lookup handler for L3 layer
-	 * We check if L3 handler exists only after sock_packet_add(), because of
+	/* We check if L3 handler exists only after sock_packet_add(), because of
 	 * we must pass skb to all packet sockets even though L3 header is not valid
 	 * from Embox kernel's point of view. */
-	npack = net_pack_lookup(hdr_info.type);
+	sock_packet_add(skb, hdr_info.type);
+
+	*type = hdr_info.type;
+
+	return skb;
+}
+
+int net_rx(struct sk_buff *skb) {
+	const struct net_pack *npack;
+	unsigned short type;
+
+	skb = net_rx_l2(skb, &type);
+	if (skb == NULL) {
+		return 0;
+	}
+
+	/* lookup handler for L3 layer */
+	npack = net_pack_lookup(type);
 	if (npack == NULL) {
-		log_debug("%p unknown type %#.6hx", skb, hdr_info.type);
+		log_debug("%p unknown type %#.6hx", skb, type);
 		skb_free(skb);
 		return 0; /* ok, but: not supported */
 	}
@@ -83,3 +97,60 @@ int net_rx(struct sk_buff *skb) {
 	/* handling on L3 layer */
 	return npack->rcv_pack(skb, skb->dev);
 }
+
+/* Passes the batch of packets of the same type and device to L3 layer */
+static void net_rx_flush(struct sk_buff_head *batch, unsigned short type,
+		struct net_device *dev) {
+	const struct net_pack *npack;
+	struct sk_buff *skb;
+
+	npack = net_pack_lookup(type);
+	if (npack == NULL) {
+		log_debug("unknown type %#.6hx", type);
+		while ((skb = __skb_queue_pop(batch)) != NULL) {
+			skb_free(skb);
+		}
+		return; /* ok, but: not supported */
+	}
+
+	if (npack->rcv_pack_list != NULL) {
+		npack->rcv_pack_list(batch, dev);
+		assert(skb_queue_front(batch) == NULL);
+		return;
+	}
+
+	while ((skb = __skb_queue_pop(batch)) != NULL) {
+		npack->rcv_pack(skb, dev);
+	}
+}
+
+void net_rx_list(struct sk_buff_head *list) {
+	struct sk_buff_head batch;
+	struct sk_buff *skb;
+	struct net_device *batch_dev;
+	unsigned short type, batch_type;
+
+	skb_queue_init(&batch);
+	batch_dev = NULL;
+	batch_type = 0;
+
+	while ((skb = __skb_queue_pop(list)) != NULL) {
+		skb = net_rx_l2(skb, &type);
+		if (skb == NULL) {
+			continue;
+		}
+
+		if ((batch_dev != NULL)
+				&& ((type != batch_type) || (skb->dev != batch_dev))) {
+			net_rx_flush(&batch, batch_type, batch_dev);
+		}
+
+		__skb_queue_push(&batch, skb);
+		batch_type = type;
+		batch_dev = skb->dev;
+	}
+
+	if (batch_dev != NULL) {
+		net_rx_flush(&batch, batch_type, batch_dev);
+	}
+}
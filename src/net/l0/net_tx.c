@@ -91,6 +91,17 @@ int net_tx(struct sk_buff *skb,
 		return ret;
 	}
 
+	/* Route could be changed after checksum was left to the device */
+	if ((skb->ip_summed == CHECKSUM_PARTIAL)
+			&& !(dev->features & NETIF_F_HW_CSUM)) {
+		ret = skb_csum_complete(skb);
+		if (ret != 0) {
+			skb_free(skb);
+			dev->stats.tx_err++;
+			return ret;
+		}
+	}
+
 	skb_len = skb->len;
 
 	log_debug("%p len %zu type %#.6hx", skb, skb->len, ntohs(skb->mac.ethh->h_proto));
@@ -30,11 +30,16 @@
 #include <embox/net/proto.h>
 #include <embox/net/pack.h>
 
-EMBOX_NET_PACK(ETH_P_IP, ip_rcv);
+EMBOX_NET_PACK_LIST(ETH_P_IP, ip_rcv, ip_rcv_list);
 
-static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
+/**
+ * Validates the packet and handles everything except delivery to the local
+ * transport layer. Returns NULL if the packet was consumed (dropped,
+ * forwarded or queued for reassembly).
+ */
+static struct sk_buff *ip_rcv_check(struct sk_buff *skb,
+		struct net_device *dev) {
 	net_device_stats_t *stats = &dev->stats;
-	const struct net_proto *nproto;
 	iphdr_t *iph = ip_hdr(skb);
 	__u16 old_check;
 	size_t ip_len;
@@ -55,7 +60,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 		log_debug("ip_rcv: invalid IPv4 header length");
 		stats->rx_length_errors++;
 		skb_free(skb);
-		return 0; /* error: invalid header length */
+		return NULL; /* error: invalid header length */
 	}
 
 
@@ -63,7 +68,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 		log_debug("ip_rcv: invalid IPv4 version");
 		stats->rx_err++;
 		skb_free(skb);
-		return 0; /* error: not ipv4 */
+		return NULL; /* error: not ipv4 */
 	}
 
 	old_check = iph->check;
@@ -73,7 +78,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 				ntohs(old_check), ntohs(iph->check));
 		stats->rx_crc_errors++;
 		skb_free(skb);
-		return 0; /* error: invalid crc */
+		return NULL; /* error: invalid crc */
 	}
 
 	ip_len = ntohs(iph->tot_len);
@@ -82,7 +87,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 		log_debug("ip_rcv: invalid IPv4 length");
 		stats->rx_length_errors++;
 		skb_free(skb);
-		return 0; /* error: invalid length */
+		return NULL; /* error: invalid length */
 	}
 
 	/* Setup transport layer (L4) header */
@@ -93,7 +98,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 		log_debug("ip_rcv: dropped by input netfilter");
 		stats->rx_dropped++;
 		skb_free(skb);
-		return 0; /* error: dropped */
+		return NULL; /* error: dropped */
 	}
 
 	/* Forwarding */
@@ -101,7 +106,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 	if (!inetdev_get_by_dev(skb->dev)) {
 		log_debug("ip_rcv: dropped by input  because inet_dev is not set");
 		skb_free(skb);
-		return 0; /* didn't set inet dev yet */
+		return NULL; /* didn't set inet dev yet */
 	}
 
 	if (inetdev_get_by_dev(skb->dev)->ifa_address != 0) {
@@ -119,9 +124,10 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 				log_debug("ip_rcv: dropped by forward netfilter");
 				stats->rx_dropped++;
 				skb_free(skb);
-				return 0; /* error: dropped */
+				return NULL; /* error: dropped */
 			}
-			return ip_forward(skb);
+			ip_forward(skb);
+			return NULL;
 		}
 	}
 
@@ -141,13 +147,13 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 			log_debug("ip_rcv: invalid options");
 			stats->rx_err++;
 			skb_free(skb);
-			return 0; /* error: bad ops */
+			return NULL; /* error: bad ops */
 		}
 		if (ip_options_handle_srr(skb)) {
 			log_debug("ip_rcv: can't handle options");
 			stats->tx_err++;
 			skb_free(skb);
-			return 0; /* error: can't handle ops */
+			return NULL; /* error: can't handle ops */
 		}
 	}
 
@@ -159,13 +165,25 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 	 */
 	if (ntohs(skb->nh.iph->frag_off) & (IP_MF | IP_OFFSET)) {
 		if ((complete_skb = ip_defrag(skb)) == NULL) {
-			return 0;
+			return NULL;
 		} else {
 			skb = complete_skb;
-			iph = ip_hdr(complete_skb);
 		}
 	}
 
+	return skb;
+}
+
+static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
+	const struct net_proto *nproto;
+	iphdr_t *iph;
+
+	skb = ip_rcv_check(skb, dev);
+	if (skb == NULL) {
+		return 0;
+	}
+	iph = ip_hdr(skb);
+
 	/* When a packet is received, it is passed to any raw sockets
 	 * which have been bound to its protocol or to socket with concrete protocol */
 	raw_rcv(skb);
@@ -179,3 +197,38 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 	skb_free(skb);
 	return 0; /* error: nobody wants this packet */
 }
+
+/* Consecutive packets usually belong to the same transport protocol, so its
+ * handler is looked up once per run of such packets */
+static void ip_rcv_list(struct sk_buff_head *list, struct net_device *dev) {
+	const struct net_proto *nproto;
+	struct sk_buff *skb;
+	iphdr_t *iph;
+	int proto;
+
+	nproto = NULL;
+	proto = -1;
+
+	while ((skb = __skb_queue_pop(list)) != NULL) {
+		skb = ip_rcv_check(skb, dev);
+		if (skb == NULL) {
+			continue;
+		}
+		iph = ip_hdr(skb);
+
+		raw_rcv(skb);
+
+		if (iph->proto != proto) {
+			proto = iph->proto;
+			nproto = net_proto_lookup(ETH_P_IP, proto);
+		}
+
+		if (nproto == NULL) {
+			log_debug("ip_rcv: unknown protocol %d", iph->proto);
+			skb_free(skb);
+			continue;
+		}
+
+		nproto->handle(skb);
+	}
+}
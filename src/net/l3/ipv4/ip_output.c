@@ -42,7 +42,7 @@ static const struct net_pack_out_ops ip_out_ops_struct;
 const struct net_pack_out_ops *const ip_out_ops
 		= &ip_out_ops_struct;
 
-static int ip_xmit(struct sk_buff *skb) {
+static int ip_xmit_route(struct sk_buff *skb, const struct rt_entry *rte) {
 	int ret;
 	in_addr_t daddr;
 	struct net_header_info hdr_info;
@@ -59,6 +59,15 @@ static int ip_xmit(struct sk_buff *skb) {
 	if (ip_is_local(daddr, IP_LOCAL_BROADCAST)) {
 		hdr_info.dst_p = NULL;
 	}
+	else if (rte != NULL) {
+		/* route is already known */
+		if (rte->rt_gateway != INADDR_ANY) {
+			daddr = rte->rt_gateway;
+		}
+
+		hdr_info.dst_p = &daddr;
+		hdr_info.p_len = sizeof daddr;
+	}
 	else {
 		/* get dest ip from route table */
 		ret = rt_fib_route_ip(daddr, &daddr);
@@ -76,6 +85,10 @@ static int ip_xmit(struct sk_buff *skb) {
 	return net_tx(skb, &hdr_info);
 }
 
+static int ip_xmit(struct sk_buff *skb) {
+	return ip_xmit_route(skb, NULL);
+}
+
 /* Fragments skb and sends it to the interface.
  * Returns -1 in case of error
  * As side effect frees incoming skb
@@ -185,7 +198,7 @@ int ip_forward(struct sk_buff *skb) {
 		}
 	}
 
-	return ip_xmit(skb);
+	return ip_xmit_route(skb, best_route);
 }
 
 static in_addr_t ip_get_dest_addr(const struct inet_sock *in_sk,
@@ -229,23 +242,17 @@ static int ip_make(const struct sock *sk,
 
 	dst_ip = ip_get_dest_addr(in_sk, to, out_skb);
 
-	ret = rt_fib_out_dev(dst_ip, in_sk != NULL ? &in_sk->sk : NULL,
-			&dev);
+	/* Socket keeps the route to its last destination */
+	ret = rt_fib_dst_get(dst_ip, in_sk != NULL ? &in_sk->sk : NULL,
+			in_sk != NULL ? &((struct inet_sock *)in_sk)->dst_cache : NULL,
+			&dev, &src_ip);
 	if (ret != 0) {
-		DBG(printk("ip_make: unknown device for %s\n",
+		DBG(printk("ip_make: unknown route for %s\n",
 					inet_ntoa(*(struct in_addr *)&dst_ip)));
 		return ret;
 	}
 	assert(dev != NULL);
-
 	assert(inetdev_get_by_dev(dev) != NULL);
-	//src_ip = inetdev_get_by_dev(dev)->ifa_address; /* TODO it's better! */
-	ret = rt_fib_source_ip(dst_ip, dev, &src_ip);
-	if (ret != 0) {
-		DBG(printk("ip_make: can't resolve source ip for %s\n",
-					inet_ntoa(*(struct in_addr *)&dst_ip)));
-		return ret;
-	}
 
 	proto = in_sk != NULL ? in_sk->sk.opt.so_protocol
 			: (*out_skb)->nh.iph->proto;
@@ -308,8 +315,15 @@ static int ip_snd(struct sk_buff *skb) {
 	ip_set_id_field(skb->nh.iph, global_id++);
 	ip_set_check_field(skb->nh.iph);
 
-	if (skb->len > skb->dev->mtu) {
+	if ((skb->len > skb->dev->mtu)
+			&& !(skb->gso_size && (skb->dev->features & NETIF_F_TSO))) {
 		if (!(skb->nh.iph->frag_off & htons(IP_DF))) {
+			/* Device can't sum the fragmented datagram */
+			if ((skb->ip_summed == CHECKSUM_PARTIAL)
+					&& (0 != skb_csum_complete(skb))) {
+				skb_free(skb);
+				return -ENOMEM;
+			}
 			return fragment_skb_and_send(skb, skb->dev);
 		}
 	}
@@ -16,6 +16,7 @@
 #include <net/inetdevice.h>
 #include <util/bit.h>
 #include <util/dlist.h>
+#include <util/math.h>
 #include <util/member.h>
 #include <net/skbuff.h>
 #include <net/sock.h>
@@ -29,46 +30,247 @@
  *    + neighbour table (ARP cache)
  */
 
+#define ROUTE_TABLE_SIZE OPTION_GET(NUMBER, route_table_size)
+
+/**
+ * Routes are kept in a path-compressed binary trie keyed by destination
+ * prefix, so the longest prefix match costs at most one node per prefix bit
+ * regardless of number of routes. A node holds all routes of its prefix,
+ * nodes without routes only join two subtries.
+ */
+struct rt_trie_node {
+	struct rt_trie_node *parent;
+	struct rt_trie_node *child[2];
+	uint32_t key; /* host byte order, bits after plen are zeroes */
+	int plen;
+	struct dlist_head routes;
+};
+
 struct rt_entry_info {
-	struct dlist_head lnk;
+	struct dlist_head lnk;      /* in list of all routes */
+	struct dlist_head node_lnk; /* in list of routes of the trie node */
+	struct rt_trie_node *node;
 	struct rt_entry entry;
 };
 
-POOL_DEF(rt_entry_info_pool, struct rt_entry_info, OPTION_GET(NUMBER,route_table_size));
+POOL_DEF(rt_entry_info_pool, struct rt_entry_info, ROUTE_TABLE_SIZE);
+/* Every route adds at most one node for itself and one branching node */
+POOL_DEF(rt_trie_node_pool, struct rt_trie_node, 2 * ROUTE_TABLE_SIZE);
 static DLIST_DEFINE(rt_entry_info_list);
+static struct rt_trie_node *rt_trie_root;
+
+/* Zero is never used, so zeroed dst cache is invalid */
+static unsigned int rt_fib_gen_cnt = 1;
+
+static inline uint32_t rt_prefix_mask(int plen) {
+	return plen ? ~(uint32_t)0 << (32 - plen) : 0;
+}
+
+static inline int rt_key_bit(uint32_t key, int pos) {
+	return (key >> (31 - pos)) & 1;
+}
+
+/* Noncontiguous masks are matched by their leading ones */
+static int rt_mask_len(in_addr_t mask) {
+	return 32 - bit_fls((uint32_t)~ntohl(mask));
+}
+
+static int rt_common_len(uint32_t key1, uint32_t key2, int max_len) {
+	return min(32 - bit_fls(key1 ^ key2), max_len);
+}
+
+static struct rt_trie_node * rt_trie_node_alloc(uint32_t key, int plen,
+		struct rt_trie_node *parent) {
+	struct rt_trie_node *node;
+
+	node = pool_alloc(&rt_trie_node_pool);
+	if (node == NULL) {
+		return NULL;
+	}
+
+	node->parent = parent;
+	node->child[0] = node->child[1] = NULL;
+	node->key = key & rt_prefix_mask(plen);
+	node->plen = plen;
+	dlist_init(&node->routes);
+
+	return node;
+}
+
+/* Finds the node of exactly this prefix */
+static struct rt_trie_node * rt_trie_find(uint32_t key, int plen) {
+	struct rt_trie_node *node;
+
+	node = rt_trie_root;
+	while ((node != NULL) && (node->plen <= plen)
+			&& (rt_common_len(key, node->key, node->plen) == node->plen)) {
+		if (node->plen == plen) {
+			return node;
+		}
+		node = node->child[rt_key_bit(key, node->plen)];
+	}
+
+	return NULL;
+}
+
+/* Finds the node of exactly this prefix or inserts a new one */
+static struct rt_trie_node * rt_trie_get(uint32_t key, int plen) {
+	struct rt_trie_node **link, *node, *parent, *new, *branch;
+	int len;
+
+	key &= rt_prefix_mask(plen);
+
+	parent = NULL;
+	link = &rt_trie_root;
+	while ((node = *link) != NULL) {
+		len = rt_common_len(key, node->key, min(plen, node->plen));
+		if (len == node->plen) {
+			if (len == plen) {
+				return node;
+			}
+			parent = node;
+			link = &node->child[rt_key_bit(key, len)];
+			continue;
+		}
+
+		/* Prefixes diverge before the end of the node prefix */
+		new = rt_trie_node_alloc(key, plen, parent);
+		if (new == NULL) {
+			return NULL;
+		}
+
+		if (len == plen) {
+			/* New prefix covers the node */
+			new->child[rt_key_bit(node->key, len)] = node;
+			node->parent = new;
+			*link = new;
+			return new;
+		}
+
+		branch = rt_trie_node_alloc(key, len, parent);
+		if (branch == NULL) {
+			pool_free(&rt_trie_node_pool, new);
+			return NULL;
+		}
+		branch->child[rt_key_bit(key, len)] = new;
+		branch->child[rt_key_bit(node->key, len)] = node;
+		new->parent = node->parent = branch;
+		*link = branch;
+		return new;
+	}
+
+	new = rt_trie_node_alloc(key, plen, parent);
+	if (new != NULL) {
+		*link = new;
+	}
+	return new;
+}
+
+/* Removes the node and the branching nodes which become useless */
+static void rt_trie_put(struct rt_trie_node *node) {
+	struct rt_trie_node *parent, *child;
+
+	while ((node != NULL) && dlist_empty(&node->routes)
+			&& ((node->child[0] == NULL) || (node->child[1] == NULL))) {
+		child = node->child[0] != NULL ? node->child[0] : node->child[1];
+		parent = node->parent;
+
+		if (parent == NULL) {
+			rt_trie_root = child;
+		} else {
+			parent->child[rt_key_bit(node->key, parent->plen)] = child;
+		}
+		if (child != NULL) {
+			child->parent = parent;
+		}
+
+		pool_free(&rt_trie_node_pool, node);
+		node = parent;
+	}
+}
+
+static inline int rt_entry_match(const struct rt_entry *rte,
+		struct net_device *dev, in_addr_t dst, in_addr_t mask,
+		in_addr_t gw) {
+	return (rte->rt_dst == dst)
+			&& ((rte->rt_mask == mask) || (INADDR_ANY == mask))
+			&& ((rte->rt_gateway == gw) || (INADDR_ANY == gw))
+			&& ((rte->dev == dev) || (NULL == dev));
+}
+
+static struct rt_entry_info * rt_entry_find(struct net_device *dev,
+		in_addr_t dst, in_addr_t mask, in_addr_t gw) {
+	struct rt_entry_info *rt_info;
+	struct rt_trie_node *node;
+
+	if (mask == INADDR_ANY) {
+		/* Any mask matches, so look through all routes */
+		dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
+			if (rt_entry_match(&rt_info->entry, dev, dst, mask, gw)) {
+				return rt_info;
+			}
+		}
+		return NULL;
+	}
+
+	node = rt_trie_find(ntohl(dst), rt_mask_len(mask));
+	if (node == NULL) {
+		return NULL;
+	}
+
+	dlist_foreach_entry(rt_info, &node->routes, node_lnk) {
+		if (rt_entry_match(&rt_info->entry, dev, dst, mask, gw)) {
+			return rt_info;
+		}
+	}
+
+	return NULL;
+}
+
+static void rt_entry_release(struct rt_entry_info *rt_info) {
+	dlist_del_init_entry(rt_info, lnk);
+	dlist_del_init_entry(rt_info, node_lnk);
+	rt_trie_put(rt_info->node);
+	pool_free(&rt_entry_info_pool, rt_info);
+	rt_fib_gen_cnt++;
+}
 
 int rt_add_route(struct net_device *dev, in_addr_t dst,
 		in_addr_t mask, in_addr_t gw, int flags) {
 	struct rt_entry_info *rt_info;
-	bool flag = true;
+	struct rt_trie_node *node;
 
 	if (dev == NULL) {
 		return -EINVAL;
 	}
 
-	dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
-		if ((rt_info->entry.rt_dst == dst) &&
-                ((rt_info->entry.rt_mask == mask) || (INADDR_ANY == mask)) &&
-    			((rt_info->entry.rt_gateway == gw) || (INADDR_ANY == gw)) &&
-    			((rt_info->entry.dev == dev) || (NULL == dev))) {
-			flag = false;
-			return 0;
-		}
+	if (rt_entry_find(dev, dst, mask, gw) != NULL) {
+		return 0;
 	}
 
-	if (flag) {
-		rt_info = (struct rt_entry_info *)pool_alloc(&rt_entry_info_pool);
-		if (rt_info == NULL) {
-			return -ENOMEM;
-		}
-		rt_info->entry.dev = dev;
-		rt_info->entry.rt_dst = dst; /* We assume that host bits are zeroes here */
-		rt_info->entry.rt_mask = mask;
-		rt_info->entry.rt_gateway = gw;
-		rt_info->entry.rt_flags = RTF_UP | flags;
-		dlist_add_prev_entry(rt_info, &rt_entry_info_list, lnk);
+	rt_info = (struct rt_entry_info *)pool_alloc(&rt_entry_info_pool);
+	if (rt_info == NULL) {
+		return -ENOMEM;
 	}
 
+	node = rt_trie_get(ntohl(dst), rt_mask_len(mask));
+	if (node == NULL) {
+		pool_free(&rt_entry_info_pool, rt_info);
+		return -ENOMEM;
+	}
+
+	rt_info->entry.dev = dev;
+	rt_info->entry.rt_dst = dst; /* We assume that host bits are zeroes here */
+	rt_info->entry.rt_mask = mask;
+	rt_info->entry.rt_gateway = gw;
+	rt_info->entry.rt_flags = RTF_UP | flags;
+	rt_info->node = node;
+	dlist_head_init(&rt_info->node_lnk);
+	/* Earlier route wins among routes of the same prefix */
+	dlist_add_prev_entry(rt_info, &node->routes, node_lnk);
+	dlist_add_prev_entry(rt_info, &rt_entry_info_list, lnk);
+	rt_fib_gen_cnt++;
+
 	return 0;
 }
 
@@ -76,18 +278,14 @@ int rt_del_route(struct net_device *dev, in_addr_t dst,
 		in_addr_t mask, in_addr_t gw) {
 	struct rt_entry_info *rt_info;
 
-	dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
-		if ((rt_info->entry.rt_dst == dst) &&
-                ((rt_info->entry.rt_mask == mask) || (INADDR_ANY == mask)) &&
-    			((rt_info->entry.rt_gateway == gw) || (INADDR_ANY == gw)) &&
-    			((rt_info->entry.dev == dev) || (NULL == dev))) {
-			dlist_del_init_entry(rt_info, lnk);
-			pool_free(&rt_entry_info_pool, rt_info);
-			return 0;
-		}
+	rt_info = rt_entry_find(dev, dst, mask, gw);
+	if (rt_info == NULL) {
+		return -ENOENT;
 	}
 
-	return -ENOENT;
+	rt_entry_release(rt_info);
+
+	return 0;
 }
 
 int rt_del_route_if(struct net_device *dev) {
@@ -96,8 +294,7 @@ int rt_del_route_if(struct net_device *dev) {
 
 	dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
 		if (rt_info->entry.dev == dev) {
-			dlist_del_init_entry(rt_info, lnk);
-			pool_free(&rt_entry_info_pool, rt_info);
+			rt_entry_release(rt_info);
 			ret ++;
 		}
 	}
@@ -105,6 +302,10 @@ int rt_del_route_if(struct net_device *dev) {
 	return ret ? 0 : -ENOENT;
 }
 
+unsigned int rt_fib_gen(void) {
+	return rt_fib_gen_cnt;
+}
+
 /* svv: ToDo:
  *      1) this function returns -ENOENT/0, but arp_resolve -1/0
  *         style must be the same
@@ -233,6 +434,46 @@ int rt_fib_out_dev(in_addr_t dst, const struct sock *sk,
 	return 0;
 }
 
+int rt_fib_dst_get(in_addr_t dst, const struct sock *sk,
+		struct rt_dst_cache *dc, struct net_device **out_dev,
+		in_addr_t *out_src) {
+	struct net_device *wanna_dev;
+	struct in_device *in_dev;
+	int ret;
+
+	wanna_dev = sk != NULL ? sk->opt.so_bindtodevice : NULL;
+
+	/* Interface address may change without routing table change */
+	if ((dc != NULL) && (dc->gen == rt_fib_gen_cnt) && (dc->dst == dst)
+			&& (dc->wanna_dev == wanna_dev)
+			&& (NULL != (in_dev = inetdev_get_by_dev(dc->dev)))
+			&& (in_dev->ifa_address == dc->src)) {
+		*out_dev = dc->dev;
+		*out_src = dc->src;
+		return 0;
+	}
+
+	ret = rt_fib_out_dev(dst, sk, out_dev);
+	if (ret != 0) {
+		return ret;
+	}
+
+	ret = rt_fib_source_ip(dst, *out_dev, out_src);
+	if (ret != 0) {
+		return ret;
+	}
+
+	if (dc != NULL) {
+		dc->gen = rt_fib_gen_cnt;
+		dc->dst = dst;
+		dc->wanna_dev = wanna_dev;
+		dc->dev = *out_dev;
+		dc->src = *out_src;
+	}
+
+	return 0;
+}
+
 struct rt_entry * rt_fib_get_first(void) {
 	if (dlist_empty(&rt_entry_info_list)) {
 		return NULL;
@@ -257,26 +498,31 @@ struct rt_entry * rt_fib_get_next(struct rt_entry *entry) {
 			struct rt_entry_info, lnk)->entry;
 }
 
-/* ToDo: It's too ugly to perform sorting for every packet.
- * Routes must be added into list with mask_len decrease.
- * In this case we'll simply take the first match
- */
 struct rt_entry * rt_fib_get_best(in_addr_t dst, struct net_device *out_dev) {
+	struct rt_trie_node *node;
 	struct rt_entry_info *rt_info;
-	int mask_len, best_mask_len;
 	struct rt_entry *best_rte;
+	uint32_t key;
 
+	key = ntohl(dst);
 	best_rte = NULL;
-	best_mask_len = -1;
-	dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
-		mask_len = ~rt_info->entry.rt_mask
-			? bit_clz(ntohl(~rt_info->entry.rt_mask)) + 1 : 32;
-		if (((dst & rt_info->entry.rt_mask) == rt_info->entry.rt_dst)
-				&& (out_dev == NULL || out_dev == rt_info->entry.dev)
-				&& (mask_len > best_mask_len)) {
-			best_rte = &rt_info->entry;
-			best_mask_len = mask_len;
+
+	/* Nodes on the path are visited in order of prefix length increase */
+	node = rt_trie_root;
+	while ((node != NULL)
+			&& (((key ^ node->key) & rt_prefix_mask(node->plen)) == 0)) {
+		dlist_foreach_entry(rt_info, &node->routes, node_lnk) {
+			if (((dst & rt_info->entry.rt_mask) == rt_info->entry.rt_dst)
+					&& (out_dev == NULL || out_dev == rt_info->entry.dev)) {
+				best_rte = &rt_info->entry;
+				break;
+			}
+		}
+
+		if (node->plen == 32) {
+			break;
 		}
+		node = node->child[rt_key_bit(key, node->plen)];
 	}
 
 	return best_rte;
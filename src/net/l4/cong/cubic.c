@@ -0,0 +1,171 @@
+/**
+ * @file
+ * @brief CUBIC congestion control (RFC 8312).
+ *
+ * @details Window is grown along cubic function of time since the last
+ *   reduction, so it doesn't depend on RTT and quickly returns to the
+ *   window where loss has happened. Below the Reno-friendly estimation
+ *   the window grows like in NewReno.
+ *
+ * @date 17.10.26
+ */
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <util/math.h>
+
+#include <hal/clock.h>
+#include <kernel/time/time.h>
+
+#include <net/l4/tcp.h>
+#include <net/l4/tcp_cong.h>
+
+#define CUBIC_SCALE   1024
+#define CUBIC_BETA     717 /* Multiplicative decrease factor 0.7 */
+#define CUBIC_ALPHA    542 /* Reno-friendly increase 3 * (1 - beta) / (1 + beta) */
+#define CUBIC_C_NUM      4 /* Scaling constant C = 0.4 */
+#define CUBIC_C_DEN     10
+
+#define CUBIC_T_MAX  (1 << 20) /* Limit of time in calculations (ms) */
+
+struct cubic {
+	uint32_t w_max;       /* Window before the last reduction (bytes) */
+	uint32_t w_last_max;  /* Previous w_max, for fast convergence */
+	uint32_t k;           /* Time to reach w_max since epoch start (ms) */
+	uint32_t origin;      /* Window at the plateau of the curve (bytes) */
+	uint32_t epoch_start; /* Start of current epoch (ms), 0 if not started */
+	uint64_t acc;         /* Remainder of window growth (bytes * cwnd) */
+};
+
+/* Integer cube root, digit by digit */
+static uint32_t cubic_cbrt(uint64_t a) {
+	uint64_t x, b;
+	int s;
+
+	x = 0;
+	for (s = 63; s >= 0; s -= 3) {
+		x <<= 1;
+		b = 3 * x * (x + 1) + 1;
+		if ((a >> s) >= b) {
+			a -= b << s;
+			x++;
+		}
+	}
+
+	return x;
+}
+
+static uint32_t cubic_now(void) {
+	uint32_t now;
+
+	now = jiffies2ms(clock_sys_ticks());
+	return now != 0 ? now : 1;
+}
+
+static void cubic_reset(struct cubic *c) {
+	c->w_max = c->w_last_max = 0;
+	c->k = c->origin = 0;
+	c->epoch_start = 0;
+	c->acc = 0;
+}
+
+static void cubic_init(struct tcp_sock *tcp_sk) {
+	struct cubic *c = tcp_cong_priv(tcp_sk);
+
+	assert(sizeof *c <= sizeof tcp_sk->cong_priv);
+	cubic_reset(c);
+}
+
+static uint32_t cubic_ssthresh(struct tcp_sock *tcp_sk) {
+	struct cubic *c = tcp_cong_priv(tcp_sk);
+
+	c->epoch_start = 0;
+
+	/* Fast convergence (RFC 8312, 4.6): release bandwidth for new flows
+	 * if the window keeps being reduced */
+	if (tcp_sk->cwnd < c->w_last_max) {
+		c->w_max = (uint64_t)tcp_sk->cwnd * (CUBIC_SCALE + CUBIC_BETA)
+				/ (2 * CUBIC_SCALE);
+	}
+	else {
+		c->w_max = tcp_sk->cwnd;
+	}
+	c->w_last_max = tcp_sk->cwnd;
+
+	return max((uint32_t)((uint64_t)tcp_sk->cwnd * CUBIC_BETA / CUBIC_SCALE),
+			2 * tcp_sk->smss);
+}
+
+static void cubic_rto(struct tcp_sock *tcp_sk) {
+	cubic_reset(tcp_cong_priv(tcp_sk));
+}
+
+/* Window which should be reached in one RTT (RFC 8312, 4.1 and 4.2) */
+static uint64_t cubic_target(struct tcp_sock *tcp_sk, struct cubic *c) {
+	uint32_t t;
+	int64_t d, offs, target;
+	uint64_t w_est;
+
+	t = min(cubic_now() - c->epoch_start, (uint32_t)CUBIC_T_MAX);
+
+	/* W_cubic(t + RTT) = C * (t + RTT - K)^3 + W_max */
+	d = (int64_t)min(t + tcp_sk->srtt, (uint32_t)CUBIC_T_MAX) - c->k;
+	offs = d * d * d * CUBIC_C_NUM / CUBIC_C_DEN / 100000;
+	offs = offs * tcp_sk->smss / 10000;
+	target = max((int64_t)c->origin + offs, (int64_t)0);
+
+	/* Reno-friendly region, W_est(t) */
+	if (tcp_sk->srtt != 0) {
+		w_est = (uint64_t)c->w_max * CUBIC_BETA / CUBIC_SCALE
+				+ (uint64_t)t * CUBIC_ALPHA * tcp_sk->smss
+					/ CUBIC_SCALE / tcp_sk->srtt;
+		target = max((uint64_t)target, w_est);
+	}
+
+	return min((uint64_t)target, (uint64_t)UINT32_MAX);
+}
+
+static void cubic_cong_avoid(struct tcp_sock *tcp_sk, uint32_t acked) {
+	struct cubic *c = tcp_cong_priv(tcp_sk);
+	uint64_t target, inc;
+
+	acked = tcp_cong_slow_start(tcp_sk, acked);
+	if (acked == 0) {
+		return;
+	}
+
+	if (c->epoch_start == 0) {
+		c->epoch_start = cubic_now();
+		c->acc = 0;
+		if (tcp_sk->cwnd < c->w_max) {
+			/* K = cubic_root((W_max - cwnd) / C) in segments and seconds */
+			c->k = cubic_cbrt((uint64_t)((c->w_max - tcp_sk->cwnd)
+						/ tcp_sk->smss)
+					* CUBIC_C_DEN * 1000000000ULL / CUBIC_C_NUM);
+			c->origin = c->w_max;
+		}
+		else {
+			c->k = 0;
+			c->origin = tcp_sk->cwnd;
+		}
+	}
+
+	target = cubic_target(tcp_sk, c);
+	if (target > tcp_sk->cwnd) {
+		/* (target - cwnd) / cwnd segments per acknowledged segment */
+		c->acc += (target - tcp_sk->cwnd) * acked;
+	}
+	else {
+		/* Very slow growth near the plateau */
+		c->acc += (uint64_t)tcp_sk->smss * acked / 100;
+	}
+
+	inc = c->acc / tcp_sk->cwnd;
+	c->acc -= inc * tcp_sk->cwnd;
+	/* Don't grow faster than 1.5 times per RTT */
+	tcp_sk->cwnd += min(inc, (uint64_t)acked / 2);
+}
+
+TCP_CONG_DEF("cubic", cubic_init, cubic_ssthresh,
+		cubic_cong_avoid, cubic_rto);
@@ -0,0 +1,49 @@
+/**
+ * @file
+ * @brief NewReno congestion control (RFC 5681, RFC 6582).
+ *
+ * @date 17.10.26
+ */
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <util/math.h>
+
+#include <net/l4/tcp.h>
+#include <net/l4/tcp_cong.h>
+
+struct newreno {
+	uint32_t acked_cnt; /* Bytes acknowledged in congestion avoidance */
+};
+
+static void newreno_init(struct tcp_sock *tcp_sk) {
+	struct newreno *nr = tcp_cong_priv(tcp_sk);
+
+	assert(sizeof *nr <= sizeof tcp_sk->cong_priv);
+	nr->acked_cnt = 0;
+}
+
+static uint32_t newreno_ssthresh(struct tcp_sock *tcp_sk) {
+	/* RFC 5681, equation (4) */
+	return max(tcp_cong_flight(tcp_sk) / 2, 2 * tcp_sk->smss);
+}
+
+static void newreno_cong_avoid(struct tcp_sock *tcp_sk, uint32_t acked) {
+	struct newreno *nr = tcp_cong_priv(tcp_sk);
+
+	acked = tcp_cong_slow_start(tcp_sk, acked);
+	if (acked == 0) {
+		return;
+	}
+
+	/* One segment per window of acknowledged data (RFC 5681, 3.1) */
+	nr->acked_cnt += acked;
+	if (nr->acked_cnt >= tcp_sk->cwnd) {
+		nr->acked_cnt -= tcp_sk->cwnd;
+		tcp_sk->cwnd += tcp_sk->smss;
+	}
+}
+
+TCP_CONG_DEF("newreno", newreno_init, newreno_ssthresh,
+		newreno_cong_avoid, NULL);
@@ -9,17 +9,21 @@
  * @author Ilia Vaprol
  */
 #include <util/log.h>
+#include <util/math.h>
 
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
 #include <errno.h>
 #include <assert.h>
+#include <limits.h>
 #include <sys/time.h>
 #include <string.h>
 #include <poll.h>
 #include <arpa/inet.h>
 
 #include <net/l4/tcp.h>
+#include <net/l4/tcp_cong.h>
 #include <net/skbuff.h>
 #include <net/sock.h>
 
@@ -28,13 +32,17 @@
 #include <net/socket/inet6_sock.h>
 #include <net/l3/ipv4/ip.h>
 #include <net/l3/ipv6.h>
+#include <net/l3/route.h>
 #include <net/l2/ethernet.h>
+#include <net/netdevice.h>
 
 #include <net/lib/ipv4.h>
 #include <net/lib/ipv6.h>
 #include <net/lib/tcp.h>
 
+#include <hal/clock.h>
 #include <kernel/time/timer.h>
+#include <kernel/time/time.h>
 #include <kernel/sched/sched_lock.h>
 #include <kernel/time/ktime.h>
 
@@ -43,16 +51,15 @@
 
 #include <embox/net/pack.h>
 #include <embox/net/proto.h>
-#include <embox/unit.h>
 
 
-EMBOX_UNIT_INIT(tcp_init);
 EMBOX_NET_PROTO(ETH_P_IP, IPPROTO_TCP, tcp_rcv,
 		net_proto_handle_error_none);
 EMBOX_NET_PROTO(ETH_P_IPV6, IPPROTO_TCP, tcp_rcv,
 		net_proto_handle_error_none);
 
 #define MODOPS_VERIFY_CHKSUM OPTION_GET(BOOLEAN, verify_chksum)
+#define MODOPS_OOO_QUEUE_LEN OPTION_GET(NUMBER, ooo_queue_len)
 
 #if OPTION_GET(NUMBER, log_level) >= LOG_DEBUG
 #define TCP_DEBUG 1
@@ -93,8 +100,6 @@ typedef enum tcp_ret_code (*tcp_handler_t)(struct tcp_sock *tcp_sk,
 		const struct tcphdr *tcph, struct sk_buff *skb,
 		struct tcphdr *out_tcph);
 
-static struct sys_timer tcp_tmr_default; /* Timer structure for rexmitting or TIME-WAIT satate */
-
 /* Prototypes */
 static int tcp_handle(struct tcp_sock *tcp_sk, struct sk_buff *skb, tcp_handler_t hnd);
 static const tcp_handler_t tcp_st_handler[];
@@ -183,20 +188,95 @@ void tcp_sock_unlock(struct tcp_sock *tcp_sk, unsigned int obj) {
 
 void tcp_seq_state_set_wind_value(struct tcp_seq_state *tcp_seq_st,
 		uint16_t value) {
-	if (tcp_seq_st->wind.value != value) {
-		tcp_seq_st->wind.value = value;
-		tcp_seq_st->wind.size = value << tcp_seq_st->wind.factor;
-	}
+	/* Size is recalculated always since window of SYN is not scaled */
+	tcp_seq_st->wind.value = value;
+	tcp_seq_st->wind.size = (uint32_t)value << tcp_seq_st->wind.factor;
 }
 
 void tcp_seq_state_set_wind_factor(struct tcp_seq_state *tcp_seq_st,
 		uint8_t factor) {
 	if (tcp_seq_st->wind.factor != factor) {
 		tcp_seq_st->wind.factor = factor;
-		tcp_seq_st->wind.size = tcp_seq_st->wind.value << factor;
+		tcp_seq_st->wind.size = (uint32_t)tcp_seq_st->wind.value << factor;
+	}
+}
+
+/************************ Socket timers ********************************/
+static void tcp_sock_timer_update(struct tcp_sock *tcp_sk) {
+	enum tcp_tmr tmr;
+	clock_t now;
+	long delta, nearest;
+
+	if (tcp_sk->tmr_pending == 0) {
+		timer_stop(&tcp_sk->timer);
+		return;
+	}
+
+	now = clock_sys_ticks();
+	nearest = LONG_MAX;
+	for (tmr = 0; tmr < TCP_TMR_MAX; ++tmr) {
+		if (tcp_sk->tmr_pending & (1 << tmr)) {
+			delta = (long)(tcp_sk->tmr_deadline[tmr] - now);
+			nearest = min(nearest, max(delta, 0L));
+		}
+	}
+
+	timer_start(&tcp_sk->timer, nearest);
+}
+
+static void tcp_sock_timer_arm(struct tcp_sock *tcp_sk,
+		enum tcp_tmr tmr, uint32_t delay_msec) {
+	tcp_sk->tmr_deadline[tmr] = clock_sys_ticks() + ms2jiffies(delay_msec);
+	tcp_sk->tmr_pending |= 1 << tmr;
+	tcp_sock_timer_update(tcp_sk);
+}
+
+static void tcp_sock_timer_cancel(struct tcp_sock *tcp_sk,
+		enum tcp_tmr tmr) {
+	if (tcp_sk->tmr_pending & (1 << tmr)) {
+		tcp_sk->tmr_pending &= ~(1 << tmr);
+		tcp_sock_timer_update(tcp_sk);
 	}
 }
 
+static int tcp_sock_timer_pending(const struct tcp_sock *tcp_sk,
+		enum tcp_tmr tmr) {
+	return tcp_sk->tmr_pending & (1 << tmr);
+}
+
+static void tcp_sock_timer_stop(struct tcp_sock *tcp_sk) {
+	tcp_sk->tmr_pending = 0;
+	timer_stop(&tcp_sk->timer);
+}
+
+/**
+ * Update RTO with a new round-trip time sample (RFC 6298, section 2)
+ */
+static void tcp_rtt_update(struct tcp_sock *tcp_sk, uint32_t rtt) {
+	uint32_t delta;
+
+	rtt = max(rtt, 1U); /* zero srtt means 'no samples yet' */
+
+	if (tcp_sk->srtt == 0) {
+		tcp_sk->srtt = rtt;
+		tcp_sk->rttvar = rtt / 2;
+	}
+	else {
+		delta = tcp_sk->srtt > rtt ? tcp_sk->srtt - rtt
+				: rtt - tcp_sk->srtt;
+		tcp_sk->rttvar = (3 * tcp_sk->rttvar + delta) / 4;
+		tcp_sk->srtt = (7 * tcp_sk->srtt + rtt) / 8;
+	}
+
+	tcp_sk->rto = tcp_sk->srtt
+			+ max((uint32_t)jiffies2ms(1), 4 * tcp_sk->rttvar);
+	tcp_sk->rto = min(max(tcp_sk->rto, (uint32_t)TCP_RTO_MIN),
+			(uint32_t)TCP_RTO_MAX);
+
+	log_debug("sk %p rtt %u srtt %u rttvar %u rto %u", to_sock(tcp_sk),
+			rtt, tcp_sk->srtt, tcp_sk->rttvar, tcp_sk->rto);
+}
+
 static void tcp_sock_rcv(struct tcp_sock *tcp_sk,
 		struct sk_buff *skb) {
 	size_t seq_off;
@@ -235,6 +315,7 @@ void tcp_sock_set_state(struct tcp_sock *tcp_sk,
 	case TCP_SYN_SENT:
 	case TCP_SYN_RECV:
 		tcp_get_now(&tcp_sk->syn_time); /* set when SYN sent */
+		tcp_sock_timer_arm(tcp_sk, TCP_TMR_SYNC, TCP_SYNC_TIMEOUT);
 		/* fallthrough */
 	case TCP_FINWAIT_1:
 	case TCP_LASTACK:
@@ -242,6 +323,9 @@ void tcp_sock_set_state(struct tcp_sock *tcp_sk,
 		log_debug("sk %p set ack_flag %u for state %d-%s",
 				sk, tcp_sk->ack_flag, new_state, str_state[new_state]);
 		break;
+	case TCP_TIMEWAIT:
+		tcp_sock_timer_arm(tcp_sk, TCP_TMR_TIMEWAIT, TCP_TIMEWAIT_DELAY);
+		break;
 	}
 
 	tcp_sk->state = new_state;
@@ -310,15 +394,16 @@ static void tcp_get_now(struct timeval *out_now) {
 	ktime_get_timeval(out_now);
 }
 
-static int tcp_is_expired(struct timeval *since, useconds_t limit_msec) {
-	struct timeval now, delta, limit;
-
-	ktime_get_timeval(&now);
-	timersub(&now, since, &delta);
-	limit.tv_sec = limit_msec / MSEC_PER_SEC;
-	limit.tv_usec = (limit_msec % MSEC_PER_SEC) * USEC_PER_MSEC;
-
-	return timercmp(&delta, &limit, >=);
+/* Checksum is left to device which is able to compute it */
+static void tcp_set_check(struct sk_buff *skb) {
+	if ((skb->dev != NULL) && (skb->dev->features & NETIF_F_HW_CSUM)) {
+		tcp_set_check_pseudo(skb->h.th, skb->nh.raw);
+		skb_csum_partial(skb, offsetof(struct tcphdr, check));
+	}
+	else {
+		tcp_set_check_field(skb->h.th, skb->nh.raw);
+		skb->ip_summed = CHECKSUM_NONE;
+	}
 }
 
 static void tcp_xmit(struct sk_buff *skb,
@@ -343,8 +428,14 @@ static void tcp_xmit(struct sk_buff *skb,
 	}
 }
 
+/* Sequence number @a a is before @a b */
+static inline int tcp_seq_before(uint32_t a, uint32_t b) {
+	return (int32_t)(a - b) < 0;
+}
+
 static void tcp_rexmit(struct tcp_sock *tcp_sk) {
 	struct sk_buff *skb, *skb_send;
+	uint32_t seq;
 
 	tcp_sock_lock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
 	{
@@ -366,10 +457,393 @@ static void tcp_rexmit(struct tcp_sock *tcp_sk) {
 			return;
 		}
 		log_debug("send skb %p, postponed %p", skb_send, skb);
+		/* Karn's algorithm: don't sample retransmitted segments */
+		tcp_sk->rtt_active = 0;
+		seq = ntohl(skb->h.th->seq) + tcp_seq_length(skb->h.th, skb->nh.raw);
+		if (tcp_seq_before(tcp_sk->rexmit_high, seq)) {
+			tcp_sk->rexmit_high = seq;
+		}
+	}
+	tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+
+	tcp_xmit(skb_send, tcp_sk, NULL);
+}
+
+/********************** Selective acknowledgments **********************/
+/**
+ * Adds the block reported by the receiver to the scoreboard, which is kept
+ * sorted and without overlapping blocks. When the scoreboard is full the
+ * highest block is forgotten.
+ */
+static void tcp_sack_mark(struct tcp_sock *tcp_sk, uint32_t start,
+		uint32_t end) {
+	struct tcp_sack_block *sb;
+	unsigned int i, j;
+
+	/* Ignore blocks which are not within the data in flight */
+	if (!tcp_seq_before(tcp_sk->last_ack, start)
+			|| !tcp_seq_before(start, end)
+			|| tcp_seq_before(tcp_sk->self.seq, end)) {
+		return;
+	}
+
+	sb = &tcp_sk->sacked[0];
+	for (i = 0; (i < tcp_sk->sacked_cnt) && tcp_seq_before(sb[i].end, start);
+			++i) { }
+
+	if ((i < tcp_sk->sacked_cnt) && !tcp_seq_before(end, sb[i].start)) {
+		/* Merge with the block and the following ones it overlaps */
+		if (tcp_seq_before(start, sb[i].start)) {
+			sb[i].start = start;
+		}
+		if (tcp_seq_before(sb[i].end, end)) {
+			sb[i].end = end;
+		}
+		for (j = i + 1; (j < tcp_sk->sacked_cnt)
+				&& !tcp_seq_before(sb[i].end, sb[j].start); ++j) {
+			if (tcp_seq_before(sb[i].end, sb[j].end)) {
+				sb[i].end = sb[j].end;
+			}
+		}
+		memmove(&sb[i + 1], &sb[j], (tcp_sk->sacked_cnt - j) * sizeof *sb);
+		tcp_sk->sacked_cnt -= j - i - 1;
+		return;
+	}
+
+	if (tcp_sk->sacked_cnt == TCP_SACK_SCORE_MAX) {
+		if (i == TCP_SACK_SCORE_MAX) {
+			return;
+		}
+		--tcp_sk->sacked_cnt;
+	}
+	memmove(&sb[i + 1], &sb[i], (tcp_sk->sacked_cnt - i) * sizeof *sb);
+	sb[i].start = start;
+	sb[i].end = end;
+	++tcp_sk->sacked_cnt;
+}
+
+/* Forgets blocks which are below the cumulative acknowledgment */
+static void tcp_sack_clean(struct tcp_sock *tcp_sk) {
+	struct tcp_sack_block *sb;
+	unsigned int i;
+
+	sb = &tcp_sk->sacked[0];
+	for (i = 0; (i < tcp_sk->sacked_cnt)
+			&& !tcp_seq_before(tcp_sk->last_ack, sb[i].end); ++i) { }
+
+	memmove(&sb[0], &sb[i], (tcp_sk->sacked_cnt - i) * sizeof *sb);
+	tcp_sk->sacked_cnt -= i;
+
+	if ((tcp_sk->sacked_cnt != 0)
+			&& tcp_seq_before(sb[0].start, tcp_sk->last_ack)) {
+		sb[0].start = tcp_sk->last_ack;
+	}
+}
+
+/**
+ * Retransmits the first segment that isn't SACKed and wasn't retransmitted
+ * in this recovery yet, if there is SACKed data above it, so it is
+ * considered lost (simplified RFC 6675). Returns zero if nothing is sent.
+ */
+static int tcp_sack_rexmit(struct tcp_sock *tcp_sk) {
+	struct sk_buff_head *queue;
+	struct sk_buff *skb, *skb_send;
+	const struct tcp_sack_block *sb;
+	uint32_t seq, end, high;
+	unsigned int i;
+
+	if (tcp_sk->sacked_cnt == 0) {
+		return 0;
+	}
+
+	sb = &tcp_sk->sacked[0];
+	high = sb[tcp_sk->sacked_cnt - 1].end;
+	queue = &to_sock(tcp_sk)->tx_queue;
+	skb_send = NULL;
+	i = 0;
+
+	tcp_sock_lock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+	{
+		for (skb = queue->next; !skb_queue_end(skb, queue);
+				skb = skb_queue_next(skb)) {
+			seq = ntohl(skb->h.th->seq);
+			end = seq + tcp_seq_length(skb->h.th, skb->nh.raw);
+			if (!tcp_seq_before(seq, high)) {
+				break;
+			}
+			if (tcp_seq_before(seq, tcp_sk->rexmit_high)) {
+				continue;
+			}
+			while ((i < tcp_sk->sacked_cnt)
+					&& !tcp_seq_before(seq, sb[i].end)) {
+				++i;
+			}
+			if ((i < tcp_sk->sacked_cnt)
+					&& !tcp_seq_before(seq, sb[i].start)
+					&& !tcp_seq_before(sb[i].end, end)) {
+				continue; /* the receiver has it */
+			}
+
+			skb_send = skb_clone(skb);
+			if (skb_send != NULL) {
+				tcp_sk->rexmit_high = end;
+				tcp_sk->rtt_active = 0;
+			}
+			break;
+		}
 	}
 	tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
 
+	if (skb_send == NULL) {
+		return 0;
+	}
+
+	log_debug("sk %p sack rexmit skb %p", to_sock(tcp_sk), skb_send);
 	tcp_xmit(skb_send, tcp_sk, NULL);
+	return 1;
+}
+
+/**
+ * Keeps in-window segment beyond a hole until the hole is filled. The queue
+ * is sorted by sequence number. Returns zero if @a skb is queued.
+ */
+static int tcp_ooo_queue(struct tcp_sock *tcp_sk, struct sk_buff *skb) {
+	struct sk_buff_head *queue;
+	struct sk_buff *pos;
+	uint32_t seq, end, pos_seq;
+
+	switch (tcp_sk->state) {
+	default:
+		return -1;
+	case TCP_ESTABIL:
+	case TCP_FINWAIT_1:
+	case TCP_FINWAIT_2:
+		break;
+	}
+
+	seq = ntohl(skb->h.th->seq);
+	end = seq + tcp_data_length(skb->h.th, skb->nh.raw);
+	if ((seq == end) || skb->h.th->syn || skb->h.th->fin
+			|| (tcp_sk->ooo_len >= MODOPS_OOO_QUEUE_LEN)) {
+		return -1; /* FIN is accepted only in sequence */
+	}
+
+	queue = &tcp_sk->ooo_queue;
+	for (pos = queue->next; !skb_queue_end(pos, queue);
+			pos = skb_queue_next(pos)) {
+		pos_seq = ntohl(pos->h.th->seq);
+		if (pos_seq == seq) {
+			if (!tcp_seq_before(pos_seq + tcp_data_length(pos->h.th,
+						pos->nh.raw), end)) {
+				return -1; /* duplicate */
+			}
+			break;
+		}
+		if (tcp_seq_before(seq, pos_seq)) {
+			break;
+		}
+	}
+
+	__skb_queue_insert(queue, skb_queue_end(pos, queue) ? NULL : pos, skb);
+	++tcp_sk->ooo_len;
+	tcp_sk->ooo_last = seq;
+
+	return 0;
+}
+
+/* Delivers segments of the out-of-order queue which are in sequence now */
+static void tcp_ooo_drain(struct tcp_sock *tcp_sk) {
+	struct sk_buff *skb;
+	uint32_t seq, end;
+
+	while (NULL != (skb = skb_queue_front(&tcp_sk->ooo_queue))) {
+		seq = ntohl(skb->h.th->seq);
+		if (tcp_seq_before(tcp_sk->rem.seq, seq)) {
+			break; /* there is a hole yet */
+		}
+
+		__skb_queue_pop(&tcp_sk->ooo_queue);
+		--tcp_sk->ooo_len;
+
+		end = seq + tcp_data_length(skb->h.th, skb->nh.raw);
+		if (tcp_seq_before(tcp_sk->rem.seq, end)) {
+			tcp_sock_rcv(tcp_sk, skb);
+			tcp_sk->rem.seq = end;
+		}
+		else {
+			skb_free(skb); /* already received */
+		}
+	}
+}
+
+/**
+ * Delivers in-sequence data of @a skb and out-of-order segments following
+ * it. Returns non-zero if a hole was filled, since such segment must be
+ * acknowledged at once (RFC 5681, 4.2).
+ */
+static int tcp_data_rcv(struct tcp_sock *tcp_sk, struct sk_buff *skb,
+		size_t data_len) {
+	uint32_t seq;
+
+	seq = ntohl(skb->h.th->seq);
+	tcp_sock_rcv(tcp_sk, skb);
+	tcp_sk->rem.seq = seq + data_len;
+
+	if (tcp_sk->ooo_len == 0) {
+		return 0;
+	}
+
+	tcp_ooo_drain(tcp_sk);
+	return 1;
+}
+
+/**
+ * Builds SACK option (RFC 2018, 4) describing the out-of-order queue, the
+ * block with the most recently received segment goes first.
+ */
+static size_t tcp_sack_build(const struct tcp_sock *tcp_sk, uint8_t *opts) {
+	struct tcp_sack_block blk[TCP_SACK_BLOCKS_MAX], last;
+	const struct sk_buff_head *queue;
+	struct sk_buff *skb;
+	uint32_t seq, end, val;
+	int i, n;
+
+	queue = &tcp_sk->ooo_queue;
+	n = 0;
+	for (skb = queue->next; !skb_queue_end(skb, (struct sk_buff_head *)queue);
+			skb = skb_queue_next(skb)) {
+		seq = ntohl(skb->h.th->seq);
+		end = seq + tcp_data_length(skb->h.th, skb->nh.raw);
+		if ((n != 0) && !tcp_seq_before(blk[n - 1].end, seq)) {
+			if (tcp_seq_before(blk[n - 1].end, end)) {
+				blk[n - 1].end = end;
+			}
+		}
+		else if (n < TCP_SACK_BLOCKS_MAX) {
+			blk[n].start = seq;
+			blk[n].end = end;
+			++n;
+		}
+		else {
+			break;
+		}
+	}
+
+	if (n == 0) {
+		return 0;
+	}
+
+	for (i = 0; i < n; ++i) {
+		if (!tcp_seq_before(tcp_sk->ooo_last, blk[i].start)
+				&& tcp_seq_before(tcp_sk->ooo_last, blk[i].end)) {
+			last = blk[i];
+			memmove(&blk[1], &blk[0], i * sizeof blk[0]);
+			blk[0] = last;
+			break;
+		}
+	}
+
+	opts[0] = opts[1] = TCP_OPT_KIND_NOP;
+	opts[2] = TCP_OPT_KIND_SACK_BLK;
+	opts[3] = 2 + n * 2 * sizeof(uint32_t);
+	for (i = 0; i < n; ++i) {
+		val = htonl(blk[i].start);
+		memcpy(&opts[4 + i * 2 * sizeof val], &val, sizeof val);
+		val = htonl(blk[i].end);
+		memcpy(&opts[4 + (i * 2 + 1) * sizeof val], &val, sizeof val);
+	}
+
+	return 4 + n * 2 * sizeof(uint32_t);
+}
+
+/* Output device of the connection, NULL if it is unknown */
+static struct net_device * tcp_sock_dev(const struct tcp_sock *tcp_sk) {
+	const struct sock *sk;
+	struct net_device *dev;
+
+	sk = to_sock(tcp_sk);
+	if ((sk->opt.so_domain != AF_INET)
+			|| (0 != rt_fib_out_dev(to_const_inet_sock(sk)->dst_in.sin_addr.s_addr,
+					sk, &dev))) {
+		return NULL;
+	}
+
+	return dev;
+}
+
+/* Largest segment which fits MTU of the output device */
+static uint16_t tcp_dev_mss(const struct net_device *dev) {
+	if (dev == NULL) {
+		return TCP_MSS_DEFAULT;
+	}
+
+	return min(dev->mtu, (unsigned int)IP_MAX_PACKET_LEN - 1)
+			- IP_MIN_HEADER_SIZE - TCP_MIN_HEADER_SIZE;
+}
+
+/**
+ * Sets segment sizes of the connection when MSS of the remote side is known.
+ * Device with TSO gets segments of many MSS at once.
+ */
+static void tcp_path_update(struct tcp_sock *tcp_sk) {
+	struct net_device *dev;
+
+	dev = tcp_sock_dev(tcp_sk);
+	tcp_sk->mss = min(tcp_sk->rem_mss, tcp_dev_mss(dev));
+	tcp_sk->seg_max = tcp_sk->mss;
+	if ((dev != NULL) && (dev->features & NETIF_F_TSO)) {
+		tcp_sk->seg_max = TCP_TSO_MAX_SIZE / tcp_sk->mss * tcp_sk->mss;
+	}
+
+	/* Initial window for the actual MSS (RFC 6928, 2) */
+	tcp_sk->smss = tcp_sk->mss;
+	tcp_sk->cwnd = min(10 * tcp_sk->smss,
+			max(2 * tcp_sk->smss, (uint32_t)TCP_CONG_INIT_WND));
+}
+
+/**
+ * Builds options of SYN segment. Window scale and SACK are offered on
+ * active open, and on passive open only if the peer has offered them.
+ */
+size_t tcp_syn_opts_build(const struct tcp_sock *tcp_sk, uint8_t *opts) {
+	size_t len;
+
+	uint16_t mss;
+
+	mss = tcp_dev_mss(tcp_sock_dev(tcp_sk));
+
+	len = 0;
+	opts[len++] = TCP_OPT_KIND_MSS;
+	opts[len++] = 4;
+	opts[len++] = mss >> 8;
+	opts[len++] = mss & 0xFF;
+	if (tcp_sk->ws_ok) {
+		opts[len++] = TCP_OPT_KIND_NOP;
+		opts[len++] = TCP_OPT_KIND_WS;
+		opts[len++] = 3;
+		opts[len++] = tcp_sk->self.wind.factor;
+	}
+	if (tcp_sk->sack_ok) {
+		opts[len++] = TCP_OPT_KIND_NOP;
+		opts[len++] = TCP_OPT_KIND_NOP;
+		opts[len++] = TCP_OPT_KIND_SACK;
+		opts[len++] = 2;
+	}
+	assert(len <= TCP_SYN_OPT_MAX_LEN);
+
+	return len;
+}
+
+/* Builds options of segment without data which is sent in reply */
+static size_t tcp_opts_build(const struct tcp_sock *tcp_sk,
+		const struct tcphdr *tcph, uint8_t *opts) {
+	if (tcph->syn) {
+		return tcp_syn_opts_build(tcp_sk, opts);
+	}
+	if (tcp_sk->sack_ok && (tcp_sk->ooo_len != 0)) {
+		return tcp_sack_build(tcp_sk, opts);
+	}
+	return 0;
 }
 
 static void send_rst_reply(struct sk_buff *skb) {
@@ -408,7 +882,7 @@ static void send_rst_reply(struct sk_buff *skb) {
 		tcp_set_seq_field(tcph, 0);
 		tcp_set_ack_field(tcph, ntohl(old_tcph.seq) + old_seq_len);
 	}
-	tcp_set_check_field(tcph, skb->nh.raw);
+	tcp_set_check(skb);
 
 	/* send over L3 */
 	tcp_xmit(skb, NULL, out_ops);
@@ -421,7 +895,10 @@ static void send_nonseq_from_sock(struct tcp_sock *tcp_sk,
 		struct sk_buff *skb) {
 	log_debug("send %p", skb);
 	tcp_set_seq_field(skb->h.th, tcp_sk->self.seq);
-	tcp_set_check_field(skb->h.th, skb->nh.raw);
+	tcp_set_check(skb);
+	if (skb->h.th->ack) {
+		tcp_sock_timer_cancel(tcp_sk, TCP_TMR_DELACK);
+	}
 	tcp_xmit(skb, tcp_sk, NULL);
 }
 
@@ -441,14 +918,29 @@ void send_seq_from_sock(struct tcp_sock *tcp_sk, struct sk_buff *skb) {
 	tcp_sock_lock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
 	{
 		tcp_set_seq_field(skb->h.th, tcp_sk->self.seq);
-		tcp_set_check_field(skb->h.th, skb->nh.raw);
+		tcp_set_check(skb);
 		if (skb_send != NULL) {
 			/* set to cloned pkg */
 			memcpy(skb_send->h.th, skb->h.th, sizeof *skb->h.th);
+			skb_send->ip_summed = skb->ip_summed;
+			skb_send->csum_start = skb->csum_start;
+			skb_send->csum_offset = skb->csum_offset;
 		}
 		assert(to_sock(tcp_sk) != NULL);
 		skb_queue_push(&to_sock(tcp_sk)->tx_queue, skb);
 		tcp_sk->self.seq += tcp_seq_length(skb->h.th, skb->nh.raw);
+
+		if (!tcp_sk->rtt_active && !tcp_sk->rexmit_mode) {
+			tcp_sk->rtt_active = 1;
+			tcp_sk->rtt_seq = tcp_sk->self.seq;
+			tcp_sk->rtt_start = clock_sys_ticks();
+		}
+		if (!tcp_sock_timer_pending(tcp_sk, TCP_TMR_REXMIT)) {
+			tcp_sock_timer_arm(tcp_sk, TCP_TMR_REXMIT, tcp_sk->rto);
+		}
+		if (skb->h.th->ack) {
+			tcp_sock_timer_cancel(tcp_sk, TCP_TMR_DELACK);
+		}
 	}
 	tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
 
@@ -457,6 +949,79 @@ void send_seq_from_sock(struct tcp_sock *tcp_sk, struct sk_buff *skb) {
 	}
 }
 
+/* Releases socket which isn't linked to the listening one */
+static void tcp_sock_free(struct tcp_sock *tcp_sk) {
+	tcp_sock_timer_stop(tcp_sk);
+	if (tcp_sk->tx_pend != NULL) {
+		skb_free(tcp_sk->tx_pend);
+		tcp_sk->tx_pend = NULL;
+	}
+	skb_queue_purge(&tcp_sk->ooo_queue);
+	tcp_sk->ooo_len = 0;
+	sock_release(to_sock(tcp_sk));
+}
+
+/**
+ * Sends the partial segment which coalesces small writes. It is held back
+ * while it isn't full if the socket is corked or more data is expected, and
+ * by Nagle algorithm (RFC 896) while there is unacknowledged data.
+ */
+void tcp_pend_push(struct tcp_sock *tcp_sk, int mode) {
+	struct sk_buff *skb;
+	unsigned char *data;
+	size_t len;
+
+	tcp_sock_lock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+	{
+		skb = tcp_sk->tx_pend;
+		len = tcp_sk->tx_pend_len;
+		if ((skb == NULL) || (tcp_sock_get_status(tcp_sk) != TCP_ST_SYNC)) {
+			tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+			return;
+		}
+
+		if ((mode != TCP_PUSH_FORCE) && (len < tcp_sk->mss)) {
+			if ((mode == TCP_PUSH_MORE) || tcp_sk->cork) {
+				if (!tcp_sock_timer_pending(tcp_sk, TCP_TMR_PUSH)) {
+					tcp_sock_timer_arm(tcp_sk, TCP_TMR_PUSH, TCP_CORK_DELAY);
+				}
+				tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+				return;
+			}
+			if (!tcp_sk->nodelay && (tcp_sk->last_ack != tcp_sk->self.seq)) {
+				tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+				return;
+			}
+		}
+
+		tcp_sk->tx_pend = NULL;
+		tcp_sk->tx_pend_len = 0;
+		tcp_sock_timer_cancel(tcp_sk, TCP_TMR_PUSH);
+
+		/* Headers are rebuilt for the actual length, the data stays in
+		 * place unless the headers have changed */
+		data = skb->h.raw + TCP_MIN_HEADER_SIZE;
+		if (0 != alloc_prep_skb(tcp_sk, 0, &len, &skb)) {
+			log_error("sk %p lost %zu bytes", to_sock(tcp_sk), len);
+			skb_free(skb);
+			tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+			return;
+		}
+		if (data != skb->h.raw + TCP_MIN_HEADER_SIZE) {
+			memmove(skb->h.raw + TCP_MIN_HEADER_SIZE, data, len);
+		}
+
+		tcp_build(skb->h.th,
+				sock_inet_get_dst_port(to_sock(tcp_sk)),
+				sock_inet_get_src_port(to_sock(tcp_sk)),
+				TCP_MIN_HEADER_SIZE, tcp_sk->self.wind.value);
+		skb->h.th->psh = 1;
+		tcp_set_ack_field(skb->h.th, tcp_sk->rem.seq);
+		send_seq_from_sock(tcp_sk, skb);
+	}
+	tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+}
+
 void tcp_sock_release(struct tcp_sock *tcp_sk) {
 	struct tcp_sock *anticipant;
 
@@ -465,13 +1030,13 @@ void tcp_sock_release(struct tcp_sock *tcp_sk) {
 		{
 			list_for_each_entry(anticipant,
 					&tcp_sk->conn_wait, conn_lnk) {
-				sock_release(to_sock(anticipant));
+				tcp_sock_free(anticipant);
 			}
 			list_for_each_entry(anticipant, &tcp_sk->conn_ready, conn_lnk) {
-				sock_release(to_sock(anticipant));
+				tcp_sock_free(anticipant);
 			}
 			list_for_each_entry(anticipant, &tcp_sk->conn_free, conn_lnk) {
-				sock_release(to_sock(anticipant));
+				tcp_sock_free(anticipant);
 			}
 		}
 		tcp_sock_unlock(tcp_sk, TCP_SYNC_CONN_QUEUE);
@@ -488,7 +1053,143 @@ void tcp_sock_release(struct tcp_sock *tcp_sk) {
 		tcp_sock_unlock(tcp_sk->parent, TCP_SYNC_CONN_QUEUE);
 	}
 
-	sock_release(to_sock(tcp_sk));
+	tcp_sock_free(tcp_sk);
+}
+
+static void tcp_send_ack(struct tcp_sock *tcp_sk) {
+	struct sk_buff *skb;
+	uint8_t opts[TCP_OPT_MAX_LEN];
+	size_t opt_len;
+
+	opt_len = tcp_sk->sack_ok && (tcp_sk->ooo_len != 0)
+			? tcp_sack_build(tcp_sk, opts) : 0;
+
+	skb = NULL; /* alloc new pkg */
+	if (0 != alloc_prep_skb(tcp_sk, opt_len, NULL, &skb)) {
+		return; /* error: see ret */
+	}
+
+	tcp_build(skb->h.th,
+			sock_inet_get_dst_port(to_sock(tcp_sk)),
+			sock_inet_get_src_port(to_sock(tcp_sk)),
+			TCP_MIN_HEADER_SIZE + opt_len, tcp_sk->self.wind.value);
+	memcpy(&skb->h.th->options, opts, opt_len);
+	tcp_set_ack_field(skb->h.th, tcp_sk->rem.seq);
+	send_nonseq_from_sock(tcp_sk, skb);
+}
+
+static void tcp_sock_timer_handler(struct sys_timer *timer, void *param) {
+	struct tcp_sock *tcp_sk;
+	enum tcp_tmr tmr;
+	unsigned int expired;
+	clock_t now;
+
+	tcp_sk = param;
+	assert(tcp_sk != NULL);
+
+	now = clock_sys_ticks();
+	expired = 0;
+	for (tmr = 0; tmr < TCP_TMR_MAX; ++tmr) {
+		if ((tcp_sk->tmr_pending & (1 << tmr))
+				&& ((long)(now - tcp_sk->tmr_deadline[tmr]) >= 0)) {
+			tcp_sk->tmr_pending &= ~(1 << tmr);
+			expired |= 1 << tmr;
+		}
+	}
+
+	if ((expired & (1 << TCP_TMR_TIMEWAIT))
+			&& (tcp_sk->state == TCP_TIMEWAIT)) {
+		log_debug("release timewait sk %p", to_sock(tcp_sk));
+		tcp_sock_release(tcp_sk);
+		return;
+	}
+
+	if ((expired & (1 << TCP_TMR_SYNC))
+			&& (tcp_sock_get_status(tcp_sk) == TCP_ST_NONSYNC)
+			&& !list_empty(&tcp_sk->conn_lnk)) {
+		assert(tcp_sk->parent != NULL);
+		log_debug("release nonsync sk %p", to_sock(tcp_sk));
+		tcp_sock_release(tcp_sk);
+		return;
+	}
+
+	if ((expired & (1 << TCP_TMR_DELACK))
+			&& (tcp_sock_get_status(tcp_sk) == TCP_ST_SYNC)) {
+		tcp_send_ack(tcp_sk);
+	}
+
+	if (expired & (1 << TCP_TMR_PUSH)) {
+		tcp_pend_push(tcp_sk, TCP_PUSH_FORCE);
+	}
+
+	if ((expired & (1 << TCP_TMR_REXMIT))
+			&& (tcp_sock_get_status(tcp_sk) != TCP_ST_NOTEXIST)
+			&& (tcp_sk->last_ack != tcp_sk->self.seq)) {
+		log_debug("rexmit sk %p rto %u", to_sock(tcp_sk), tcp_sk->rto);
+		if (!tcp_sk->rexmit_mode) {
+			/* Loss window is one segment (RFC 5681, 3.1), threshold is
+			 * not reduced again by repeated timeouts */
+			tcp_sk->ssthresh = tcp_sk->cong->ssthresh(tcp_sk);
+			if (tcp_sk->cong->rto != NULL) {
+				tcp_sk->cong->rto(tcp_sk);
+			}
+		}
+		tcp_sk->cwnd = tcp_sk->smss;
+		tcp_sk->in_recovery = 0;
+		tcp_sk->dup_ack = 0;
+		tcp_sk->rexmit_mode = 1;
+		/* The receiver may discard SACKed data (RFC 2018, 8) */
+		tcp_sk->sacked_cnt = 0;
+		tcp_sk->rexmit_high = tcp_sk->last_ack;
+		/* back off the timer (RFC 6298, 5.5) */
+		tcp_sk->rto = min(2 * tcp_sk->rto, (uint32_t)TCP_RTO_MAX);
+		tcp_rexmit(tcp_sk);
+		tcp_sk->tmr_deadline[TCP_TMR_REXMIT] = now + ms2jiffies(tcp_sk->rto);
+		tcp_sk->tmr_pending |= 1 << TCP_TMR_REXMIT;
+	}
+
+	tcp_sock_timer_update(tcp_sk);
+}
+
+void tcp_sock_timer_init(struct tcp_sock *tcp_sk) {
+	timer_init(&tcp_sk->timer, TIMER_ONESHOT, tcp_sock_timer_handler,
+			tcp_sk);
+	tcp_sk->tmr_pending = 0;
+	tcp_sk->srtt = tcp_sk->rttvar = 0;
+	tcp_sk->rto = TCP_RTO_INITIAL;
+	tcp_sk->rtt_active = 0;
+}
+
+
+static enum tcp_ret_code process_opt(struct tcp_sock *tcp_sk,
+		const struct tcphdr *tcph);
+
+/**
+ * Window scale and SACK are used only if both sides offer them in SYN
+ * segments (RFC 7323, 2.2 and RFC 2018, 2). Window of SYN segment itself
+ * is never scaled. Segment size is chosen from MSS option and MTU.
+ */
+static void tcp_syn_negotiate(struct tcp_sock *tcp_sk,
+		const struct tcphdr *tcph) {
+	uint32_t size;
+
+	tcp_sk->ws_ok = tcp_sk->sack_ok = 0;
+	tcp_seq_state_set_wind_factor(&tcp_sk->rem, 0);
+	tcp_sk->rem_mss = TCP_MSS_DEFAULT;
+	if (TCP_HEADER_SIZE(tcph) != TCP_MIN_HEADER_SIZE) {
+		process_opt(tcp_sk, tcph);
+	}
+	tcp_path_update(tcp_sk);
+
+	if (!tcp_sk->ws_ok) {
+		size = tcp_sk->self.wind.size;
+		tcp_seq_state_set_wind_factor(&tcp_sk->self, 0);
+		tcp_seq_state_set_wind_value(&tcp_sk->self,
+				min(size, (uint32_t)TCP_WINDOW_VALUE_MAX));
+	}
+
+	tcp_seq_state_set_wind_value(&tcp_sk->rem, ntohs(tcph->window));
+	tcp_sk->rem.wind.size = ntohs(tcph->window);
 }
 
 
@@ -567,6 +1268,9 @@ static enum tcp_ret_code tcp_st_listen(struct tcp_sock *tcp_sk,
 					&ip6_hdr(skb)->saddr,
 					sizeof newsk.in6->dst_in6.sin6_addr);
 		}
+		sock_rehash(to_sock(tcp_newsk));
+		/* Accepted socket inherits congestion control of listening one */
+		tcp_cong_init(tcp_newsk, tcp_sk->cong, 0);
 		/* Save new socket to accept queue */
 		tcp_sock_lock(tcp_sk, TCP_SYNC_CONN_QUEUE);
 		{
@@ -596,8 +1300,7 @@ static enum tcp_ret_code tcp_st_syn_sent(struct tcp_sock *tcp_sk,
 
 	if (tcph->syn) {
 		tcp_sk->rem.seq = ntohl(tcph->seq) + 1;
-		tcp_seq_state_set_wind_value(&tcp_sk->rem,
-				ntohs(tcph->window));
+		tcp_syn_negotiate(tcp_sk, tcph);
 		if (tcph->ack) {
 			tcp_sock_set_state(tcp_sk, TCP_ESTABIL);
 		} else {
@@ -618,8 +1321,7 @@ static enum tcp_ret_code tcp_st_syn_recv_pre(
 
 	if (tcph->syn) {
 		tcp_sk->rem.seq = ntohl(tcph->seq) + 1;
-		tcp_seq_state_set_wind_value(&tcp_sk->rem,
-				ntohs(tcph->window));
+		tcp_syn_negotiate(tcp_sk, tcph);
 		tcp_sock_set_state(tcp_sk, TCP_SYN_RECV);
 		out_tcph->syn = 1;
 		tcp_set_ack_field(out_tcph, tcp_sk->rem.seq);
@@ -645,6 +1347,7 @@ static enum tcp_ret_code tcp_st_estabil(struct tcp_sock *tcp_sk,
 		const struct tcphdr *tcph, struct sk_buff *skb,
 		struct tcphdr *out_tcph) {
 	size_t data_len;
+	int filled;
 
 	log_debug("call tcp_st_estabil");
 	assert(tcp_sk->state == TCP_ESTABIL);
@@ -653,12 +1356,18 @@ static enum tcp_ret_code tcp_st_estabil(struct tcp_sock *tcp_sk,
 	if (data_len > 0) {
 		/* Save current sk_buff_t with data */
 		log_debug("\t received %d", data_len);
-		tcp_sock_rcv(tcp_sk, skb);
-		tcp_sk->rem.seq += data_len;
+		filled = tcp_data_rcv(tcp_sk, skb, data_len);
 		if (tcph->fin) {
 			tcp_sk->rem.seq += 1;
 			tcp_sock_set_state(tcp_sk, TCP_CLOSEWAIT);
 		}
+		else if (!tcph->psh && !filled
+				&& !tcp_sock_timer_pending(tcp_sk, TCP_TMR_DELACK)) {
+			/* Acknowledge every second segment or after delay
+			 * (RFC 1122, 4.2.3.2) */
+			tcp_sock_timer_arm(tcp_sk, TCP_TMR_DELACK, TCP_DELACK_DELAY);
+			return TCP_RET_OK;
+		}
 		tcp_set_ack_field(out_tcph, tcp_sk->rem.seq);
 		return TCP_RET_SEND_ALLOC;
 	} else if (tcph->fin) {
@@ -683,8 +1392,7 @@ static enum tcp_ret_code tcp_st_finwait_1(struct tcp_sock *tcp_sk,
 	if (data_len > 0) {
 		/* Save current sk_buff_t with data */
 		log_debug("\t received %d", data_len);
-		tcp_sock_rcv(tcp_sk, skb);
-		tcp_sk->rem.seq += data_len;
+		tcp_data_rcv(tcp_sk, skb, data_len);
 		if (tcph->fin) {
 			tcp_sk->rem.seq += 1;
 			if (tcph->ack) {
@@ -725,8 +1433,7 @@ static enum tcp_ret_code tcp_st_finwait_2(struct tcp_sock *tcp_sk,
 	if (data_len > 0) {
 		/* Save current sk_buff_t with data */
 		log_debug("\t received %d\n", data_len);
-		tcp_sock_rcv(tcp_sk, skb);
-		tcp_sk->rem.seq += data_len;
+		tcp_data_rcv(tcp_sk, skb, data_len);
 		if (tcph->fin) {
 			tcp_sk->rem.seq += 1;
 			tcp_sock_set_state(tcp_sk, TCP_TIMEWAIT);
@@ -785,7 +1492,8 @@ static enum tcp_ret_code tcp_st_timewait(struct tcp_sock *tcp_sk,
 	log_debug("call tcp_st_timewait");
 	assert(tcp_sk->state == TCP_TIMEWAIT);
 
-	/* timeout 2msl and set TCP_CLOSED state */
+	/* restart 2msl timeout, the socket will be released on expiry */
+	tcp_sock_timer_arm(tcp_sk, TCP_TMR_TIMEWAIT, TCP_TIMEWAIT_DELAY);
 
 	return TCP_RET_DROP;
 }
@@ -850,8 +1558,45 @@ static void confirm_ack(struct tcp_sock *tcp_sk, uint32_t ack) {
 	tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
 }
 
+/* Fast retransmit and start of fast recovery (RFC 6582, 3.2) */
+static void tcp_fast_retransmit(struct tcp_sock *tcp_sk) {
+	tcp_sk->ssthresh = tcp_sk->cong->ssthresh(tcp_sk);
+	tcp_sk->cwnd = tcp_sk->ssthresh + TCP_REXMIT_DUP_ACK * tcp_sk->smss;
+	tcp_sk->recover = tcp_sk->self.seq;
+	tcp_sk->in_recovery = 1;
+	log_debug("sk %p recovery cwnd %u ssthresh %u", to_sock(tcp_sk),
+			tcp_sk->cwnd, tcp_sk->ssthresh);
+	tcp_sk->rexmit_high = tcp_sk->last_ack;
+	tcp_rexmit(tcp_sk);
+}
+
+/* Updates congestion window when @a acked new bytes are acknowledged */
+static void tcp_cong_update(struct tcp_sock *tcp_sk, uint32_t ack,
+		uint32_t acked) {
+	if (tcp_sk->rexmit_mode || !tcp_sk->in_recovery) {
+		/* It is slow start from the loss window after RTO as well */
+		tcp_sk->cong->cong_avoid(tcp_sk, acked);
+	}
+	else if (ack - tcp_sk->recover <= tcp_sk->self.seq - tcp_sk->recover) {
+		/* Full acknowledgment, deflate the window */
+		tcp_sk->cwnd = min(tcp_sk->ssthresh,
+				max(tcp_cong_flight(tcp_sk), tcp_sk->smss) + tcp_sk->smss);
+		tcp_sk->in_recovery = 0;
+		tcp_sk->dup_ack = 0;
+	}
+	else {
+		/* Partial acknowledgment, the next segment is lost too. With
+		 * SACK the next hole is retransmitted instead */
+		if (!tcp_sk->sack_ok || !tcp_sack_rexmit(tcp_sk)) {
+			tcp_rexmit(tcp_sk);
+		}
+		tcp_sk->cwnd -= min(acked, tcp_sk->cwnd);
+		tcp_sk->cwnd += tcp_sk->smss;
+	}
+}
+
 static enum tcp_ret_code process_ack(struct tcp_sock *tcp_sk,
-		const struct tcphdr *tcph) {
+		const struct tcphdr *tcph, const struct sk_buff *skb) {
 	uint32_t ack, ack2last_ack, seq;
 
 	/* Resetting if recv ack in this state */
@@ -868,21 +1613,51 @@ static enum tcp_ret_code process_ack(struct tcp_sock *tcp_sk,
 	seq = tcp_sk->self.seq;
 
 	if (ack2last_ack == 0) {
-		/* no new acknowledgments */
-		if ((seq != ack) && !tcp_sk->rexmit_mode) {
+		/* no new acknowledgments, segments with data don't count as
+		 * duplicates (RFC 5681, 2) */
+		if ((seq != ack) && !tcp_sk->rexmit_mode
+				&& (tcp_seq_length(tcph, skb->nh.raw) == 0)) {
 			++tcp_sk->dup_ack;
-			if (tcp_sk->dup_ack == TCP_REXMIT_DUP_ACK) {
-				tcp_sk->rexmit_mode = 1;
-				tcp_rexmit(tcp_sk);
+			if (tcp_sk->in_recovery) {
+				/* One more segment has left the network, so inflate the
+				 * window to send a new one */
+				tcp_sk->cwnd += tcp_sk->smss;
+				if (tcp_sk->sack_ok) {
+					tcp_sack_rexmit(tcp_sk);
+				}
+				sock_notify(to_sock(tcp_sk), POLLOUT);
+			}
+			else if (tcp_sk->dup_ack == TCP_REXMIT_DUP_ACK) {
+				tcp_fast_retransmit(tcp_sk);
 			}
 		}
 	}
 	else if (ack2last_ack <= seq - tcp_sk->last_ack) {
 		confirm_ack(tcp_sk, ack);
 		tcp_sk->last_ack = ack;
+		tcp_sack_clean(tcp_sk);
 		tcp_get_now(&tcp_sk->ack_time);
+		if (tcp_sk->rtt_active
+				&& (ack - tcp_sk->rtt_seq <= seq - tcp_sk->rtt_seq)) {
+			tcp_sk->rtt_active = 0;
+			tcp_rtt_update(tcp_sk, jiffies2ms(clock_sys_ticks()
+						- tcp_sk->rtt_start));
+		}
+		if (ack != seq) {
+			tcp_sock_timer_arm(tcp_sk, TCP_TMR_REXMIT, tcp_sk->rto);
+		}
+		else {
+			tcp_sock_timer_cancel(tcp_sk, TCP_TMR_REXMIT);
+		}
+		tcp_cong_update(tcp_sk, ack, ack2last_ack);
+		if (ack == seq) {
+			/* Nagle algorithm holds partial segment until now */
+			tcp_pend_push(tcp_sk, TCP_PUSH_NAGLE);
+		}
 		if (!tcp_sk->rexmit_mode) {
-			tcp_sk->dup_ack = 0;
+			if (!tcp_sk->in_recovery) {
+				tcp_sk->dup_ack = 0;
+			}
 			sock_notify(to_sock(tcp_sk), POLLOUT);
 		}
 		else {
@@ -958,6 +1733,20 @@ static inline int tcp_opt_process(struct tcphdr *tcph, struct tcphdr *otcph, str
 }
 #endif
 
+/* Marks blocks of received SACK option in the scoreboard */
+static void process_sack(struct tcp_sock *tcp_sk, const uint8_t *blk,
+		int len) {
+	uint32_t start, end;
+
+	for (; len >= 2 * (int)sizeof start; len -= 2 * sizeof start) {
+		memcpy(&start, blk, sizeof start);
+		blk += sizeof start;
+		memcpy(&end, blk, sizeof end);
+		blk += sizeof end;
+		tcp_sack_mark(tcp_sk, ntohl(start), ntohl(end));
+	}
+}
+
 static enum tcp_ret_code process_opt(struct tcp_sock *tcp_sk,
 		const struct tcphdr *tcph) {
 	char *ptr = (char *)&tcph->options[0];
@@ -974,9 +1763,31 @@ static enum tcp_ret_code process_opt(struct tcp_sock *tcp_sk,
 			++ptr;
 			break;
 		case TCP_OPT_KIND_WS:
-			if (*(ptr + 1) == 3) {
+			if (tcph->syn && (*(ptr + 1) == 3)) {
+				tcp_sk->ws_ok = 1;
 				tcp_seq_state_set_wind_factor(&tcp_sk->rem,
-						*(ptr + 2));
+						min((uint8_t)*(ptr + 2),
+							(uint8_t)TCP_WINDOW_FACTOR_MAX));
+			}
+			ptr += *(ptr + 1);
+			break;
+		case TCP_OPT_KIND_MSS:
+			if (tcph->syn && (*(ptr + 1) == 4)) {
+				tcp_sk->rem_mss = max(((uint8_t)*(ptr + 2) << 8)
+						| (uint8_t)*(ptr + 3), 64);
+			}
+			ptr += *(ptr + 1);
+			break;
+		case TCP_OPT_KIND_SACK:
+			if (tcph->syn && (*(ptr + 1) == 2)) {
+				tcp_sk->sack_ok = 1;
+			}
+			ptr += *(ptr + 1);
+			break;
+		case TCP_OPT_KIND_SACK_BLK:
+			if (!tcph->syn && tcp_sk->sack_ok) {
+				process_sack(tcp_sk, (uint8_t *)ptr + 2,
+						min((uint8_t)*(ptr + 1) - 2, (int)(end - ptr - 2)));
 			}
 			ptr += *(ptr + 1);
 			break;
@@ -999,8 +1810,8 @@ static enum tcp_ret_code pre_process(struct tcp_sock *tcp_sk,
 	int ret;
 	uint32_t seq2rem_seq, seq_len, seq_last2rem_seq, rem_len;
 
-	/* Check CRC */
-	if (MODOPS_VERIFY_CHKSUM) {
+	/* Check CRC, unless it's verified by device or packet is local */
+	if (MODOPS_VERIFY_CHKSUM && (skb->ip_summed == CHECKSUM_NONE)) {
 		uint16_t old_check;
 		old_check = tcph->check;
 		/* XXX remove const qualifier */
@@ -1039,12 +1850,17 @@ static enum tcp_ret_code pre_process(struct tcp_sock *tcp_sk,
 		rem_len = tcp_sk->self.wind.size;
 		if (seq2rem_seq < rem_len) {
 			if (seq2rem_seq != 0) {
-				/* TODO There is correct packet (with
-				 * correct sequence number), but some packages
-				 * was lost. We should save this skb, and wait
-				 * previous packages.
+				/* There is correct packet (with correct sequence
+				 * number), but some packages was lost. Save this
+				 * skb until the previous packages are received.
+				 * Duplicate acknowledgment is sent at once, so
+				 * the sender can do fast retransmit (RFC 5681, 4.2)
 				 */
-				return TCP_RET_DROP;
+				tcp_set_ack_field(out_tcph, tcp_sk->rem.seq);
+				if (0 == tcp_ooo_queue(tcp_sk, skb)) {
+					return TCP_RET_SEND_ALLOC;
+				}
+				return TCP_RET_SEND;
 			}
 		}
 		else if ((seq_last2rem_seq != 0)
@@ -1066,9 +1882,18 @@ static enum tcp_ret_code pre_process(struct tcp_sock *tcp_sk,
 		break;
 	}
 
+	/* Process options, SACK blocks are needed to process ACK. Options of
+	 * SYN are processed by the state handlers */
+	if (!tcph->syn && (TCP_HEADER_SIZE(tcph) != TCP_MIN_HEADER_SIZE)) {
+		ret = process_opt(tcp_sk, tcph);
+		if (ret != TCP_RET_OK) {
+			return ret;
+		}
+	}
+
 	/* Porcess ACK */
 	if (tcph->ack) {
-		ret = process_ack(tcp_sk, tcph);
+		ret = process_ack(tcp_sk, tcph, skb);
 		if (ret != TCP_RET_OK) {
 			return ret;
 		}
@@ -1084,14 +1909,6 @@ static enum tcp_ret_code pre_process(struct tcp_sock *tcp_sk,
 		break;
 	}
 
-	/* Process options */
-	if (TCP_HEADER_SIZE(tcph) != TCP_MIN_HEADER_SIZE) {
-		ret = process_opt(tcp_sk, tcph);
-		if (ret != TCP_RET_OK) {
-			return ret;
-		}
-	}
-
 	return TCP_RET_OK;
 }
 
@@ -1118,6 +1935,8 @@ static int tcp_handle(struct tcp_sock *tcp_sk, struct sk_buff *skb,
 	enum tcp_ret_code ret;
 	struct tcphdr out_tcph;
 	struct sk_buff *out_skb;
+	uint8_t out_opts[TCP_OPT_MAX_LEN];
+	size_t opt_len;
 
 	tcp_build(&out_tcph, skb->h.th->source, skb->h.th->dest,
 			TCP_MIN_HEADER_SIZE, tcp_sk->self.wind.value);
@@ -1164,10 +1983,13 @@ static int tcp_handle(struct tcp_sock *tcp_sk, struct sk_buff *skb,
 		/* fallthrough */
 	case TCP_RET_SEND_ALLOC:
 		out_skb = ret != TCP_RET_SEND_ALLOC ? skb : NULL;
-		if (0 != alloc_prep_skb(tcp_sk, 0, NULL, &out_skb)) {
+		opt_len = tcp_opts_build(tcp_sk, &out_tcph, out_opts);
+		if (0 != alloc_prep_skb(tcp_sk, opt_len, NULL, &out_skb)) {
 			return TCP_RET_DROP; /* error: see ret */
 		}
+		out_tcph.doff = (TCP_MIN_HEADER_SIZE + opt_len) / 4;
 		memcpy(out_skb->h.th, &out_tcph, sizeof out_tcph);
+		memcpy(&out_skb->h.th->options, out_opts, opt_len);
 		if (ret == TCP_RET_SEND_SEQ) {
 			send_seq_from_sock(tcp_sk, out_skb);
 		}
@@ -1281,17 +2103,22 @@ static int tcp_rcv(struct sk_buff *skb) {
 	assert(ip_check_version(ip_hdr(skb))
 			|| ip6_check_version(ip6_hdr(skb)));
 
-	sk = sock_lookup(NULL, tcp_sock_ops,
-			ip_check_version(ip_hdr(skb))
-				? tcp4_rcv_tester_strict
-				: tcp6_rcv_tester_strict,
-			skb);
+	if (ip_check_version(ip_hdr(skb))) {
+		sk = sock_lookup_conn(tcp_sock_ops, tcp4_rcv_tester_strict, skb,
+				tcp_hdr(skb)->dest, tcp_hdr(skb)->source,
+				&ip_hdr(skb)->saddr, sizeof ip_hdr(skb)->saddr);
+	}
+	else {
+		sk = sock_lookup_conn(tcp_sock_ops, tcp6_rcv_tester_strict, skb,
+				tcp_hdr(skb)->dest, tcp_hdr(skb)->source,
+				&ip6_hdr(skb)->saddr, sizeof ip6_hdr(skb)->saddr);
+	}
 	if (sk == NULL) {
-		sk = sock_lookup(NULL, tcp_sock_ops,
+		sk = sock_lookup_listen(tcp_sock_ops,
 				ip_check_version(ip_hdr(skb))
 					? tcp4_rcv_tester_soft
 					: tcp6_rcv_tester_soft,
-				skb);
+				skb, tcp_hdr(skb)->dest);
 	}
 
 	tcp_sk = sk != NULL ? to_tcp_sock(sk) : NULL;
@@ -1317,50 +2144,3 @@ static int tcp_rcv(struct sk_buff *skb) {
 
 	return 0;
 }
-
-static void tcp_timer_handler(struct sys_timer *timer, void *param) {
-	struct sock *sk;
-	struct tcp_sock *tcp_sk;
-
-	(void)timer;
-	(void)param;
-
-	sock_foreach(sk, tcp_sock_ops) {
-		tcp_sk = to_tcp_sock(sk);
-		if ((tcp_sk->state == TCP_TIMEWAIT)
-				&& tcp_is_expired(&tcp_sk->rcv_time, TCP_TIMEWAIT_DELAY)) {
-
-			log_debug("release timewait sk %p", to_sock(tcp_sk));
-			tcp_sock_release(tcp_sk);
-		}
-		else if ((tcp_sock_get_status(tcp_sk) == TCP_ST_NONSYNC)
-				&& !list_empty(&tcp_sk->conn_lnk)
-				&& tcp_is_expired(&tcp_sk->syn_time, TCP_SYNC_TIMEOUT)) {
-
-			assert(tcp_sk->parent != NULL);
-			log_debug("release nonsync sk %p", to_sock(tcp_sk));
-			tcp_sock_release(tcp_sk);
-		}
-		else if ((tcp_sock_get_status(tcp_sk) != TCP_ST_NOTEXIST)
-				&& tcp_is_expired(&tcp_sk->ack_time, TCP_REXMIT_DELAY)
-				&& (tcp_sk->last_ack != tcp_sk->self.seq)) {
-
-			log_debug("rexmit sk %p", to_sock(tcp_sk));
-			tcp_sk->rexmit_mode = 1;
-			tcp_rexmit(tcp_sk);
-		}
-	}
-}
-
-static int tcp_init(void) {
-	int ret;
-
-	/* Create default timer */
-	ret = timer_init_start_msec(&tcp_tmr_default, TIMER_PERIODIC,
-			TCP_TIMER_FREQUENCY, tcp_timer_handler, NULL);
-	if (ret != 0) {
-		return ret;
-	}
-
-	return 0;
-}
@@ -0,0 +1,77 @@
+/**
+ * @file
+ * @brief Registry of TCP congestion control algorithms.
+ *
+ * @date 17.10.26
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <util/array.h>
+#include <util/math.h>
+
+#include <framework/mod/options.h>
+
+#include <net/l4/tcp.h>
+#include <net/l4/tcp_cong.h>
+
+#define MODOPS_CONG_DEFAULT OPTION_STRING_GET(cong_default)
+
+ARRAY_SPREAD_DEF(const struct tcp_cong_ops, __tcp_cong_registry);
+
+const struct tcp_cong_ops * tcp_cong_lookup(const char *name) {
+	const struct tcp_cong_ops *ops;
+
+	assert(name != NULL);
+
+	tcp_cong_foreach(ops) {
+		if (0 == strcmp(ops->name, name)) {
+			return ops;
+		}
+	}
+
+	return NULL;
+}
+
+void tcp_cong_init(struct tcp_sock *tcp_sk,
+		const struct tcp_cong_ops *ops, int reset) {
+	assert(tcp_sk != NULL);
+
+	if (ops == NULL) {
+		ops = tcp_cong_lookup(MODOPS_CONG_DEFAULT);
+		assert(ops != NULL);
+	}
+
+	if (reset) {
+		tcp_sk->smss = TCP_MSS_DEFAULT;
+		tcp_sk->cwnd = TCP_CONG_INIT_WND;
+		tcp_sk->ssthresh = UINT32_MAX;
+		tcp_sk->in_recovery = 0;
+	}
+
+	tcp_sk->cong = ops;
+	memset(&tcp_sk->cong_priv[0], 0, sizeof tcp_sk->cong_priv);
+	if (ops->init != NULL) {
+		ops->init(tcp_sk);
+	}
+}
+
+uint32_t tcp_cong_slow_start(struct tcp_sock *tcp_sk, uint32_t acked) {
+	uint32_t cwnd;
+
+	if (tcp_sk->cwnd >= tcp_sk->ssthresh) {
+		return acked;
+	}
+
+	/* Appropriate byte counting with limit of 2 * SMSS (RFC 3465), so
+	 * delayed acknowledgments don't slow it down */
+	cwnd = min(tcp_sk->cwnd + min(acked, 2 * tcp_sk->smss),
+			tcp_sk->ssthresh);
+	acked -= min(acked, cwnd - tcp_sk->cwnd);
+	tcp_sk->cwnd = cwnd;
+
+	return acked;
+}
@@ -23,6 +23,8 @@
 #include <net/socket/inet_sock.h>
 
 #include <net/netdevice.h>
+#include <net/skbuff.h>
+#include <net/util/checksum.h>
 #include <framework/mod/options.h>
 
 #include <net/lib/ipv4.h>
@@ -74,6 +76,17 @@ static int udp6_accept_dst(const struct sock *sk,
 				|| (sk->opt.so_bindtodevice == NULL));
 }
 
+/* Verifies checksum which is left to be verified while data is copied to
+ * user, when there is no user */
+static int udp_csum_valid(struct sk_buff *skb) {
+	if (skb->ip_summed != CHECKSUM_COPY) {
+		return 1;
+	}
+
+	return fold_short(skb->csum + partial_sum(skb->h.raw + UDP_HEADER_SIZE,
+				udp_data_length(udp_hdr(skb)))) == 0xffff;
+}
+
 static int udp_rcv(struct sk_buff *skb) {
 	struct sock *sk;
 
@@ -81,20 +94,32 @@ static int udp_rcv(struct sk_buff *skb) {
 	assert(ip_check_version(ip_hdr(skb))
 			|| ip6_check_version(ip6_hdr(skb)));
 
-	/* Check CRC */
-	if (MODOPS_VERIFY_CHKSUM) {
-		uint16_t old_check;
-		old_check = skb->h.uh->check;
-		udp_set_check_field(skb->h.uh, skb->nh.raw);
-		if (old_check != skb->h.uh->check) {
-			return 0; /* error: bad checksum */
-		}
+	/* Data is verified while it's copied to user, since it's read anyway.
+	 * Zero checksum of IPv4 datagram means it isn't computed by sender */
+	if (MODOPS_VERIFY_CHKSUM && (skb->ip_summed == CHECKSUM_NONE)
+			&& !(ip_check_version(ip_hdr(skb)) && (udp_hdr(skb)->check == 0))) {
+		skb->ip_summed = CHECKSUM_COPY;
+		skb->csum = udp_pseudo_sum(skb->nh.raw)
+				+ partial_sum(skb->h.uh, UDP_HEADER_SIZE);
 	}
 
-	sk = sock_lookup(NULL, udp_sock_ops,
-			ip_check_version(ip_hdr(skb))
-				? udp4_rcv_tester : udp6_rcv_tester,
-			skb);
+	/* Connected sockets are more specific, so check them first */
+	if (ip_check_version(ip_hdr(skb))) {
+		sk = sock_lookup_conn(udp_sock_ops, udp4_rcv_tester, skb,
+				udp_hdr(skb)->dest, udp_hdr(skb)->source,
+				&ip_hdr(skb)->saddr, sizeof ip_hdr(skb)->saddr);
+	}
+	else {
+		sk = sock_lookup_conn(udp_sock_ops, udp6_rcv_tester, skb,
+				udp_hdr(skb)->dest, udp_hdr(skb)->source,
+				&ip6_hdr(skb)->saddr, sizeof ip6_hdr(skb)->saddr);
+	}
+	if (sk == NULL) {
+		sk = sock_lookup_listen(udp_sock_ops,
+				ip_check_version(ip_hdr(skb))
+					? udp4_rcv_tester : udp6_rcv_tester,
+				skb, udp_hdr(skb)->dest);
+	}
 	if (sk != NULL) {
 		if (ip_check_version(ip_hdr(skb))
 				? udp4_accept_dst(sk, skb)
@@ -106,9 +131,13 @@ static int udp_rcv(struct sk_buff *skb) {
 			skb_free(skb);
 		}
 	}
-	else {
+	else if (udp_csum_valid(skb)) {
 		icmp_discard(skb, ICMP_DEST_UNREACH, ICMP_PORT_UNREACH);
 	}
+	else {
+		/* Corrupted datagram is dropped silently */
+		skb_free(skb);
+	}
 
 	return 0;
 }
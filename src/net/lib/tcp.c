@@ -80,6 +80,26 @@ void tcp_set_check_field(struct tcphdr *tcph,
 	}
 }
 
+static unsigned long tcp_pseudo_sum(const void *nhhdr) {
+	struct ip_pseudohdr ipph;
+	struct ip6_pseudohdr ip6ph;
+
+	if (ip_check_version((const struct iphdr *)nhhdr)) {
+		ip_pseudo_build((const struct iphdr *)nhhdr, &ipph);
+		return partial_sum(&ipph, sizeof ipph);
+	}
+	else {
+		assert(ip6_check_version((const struct ip6hdr *)nhhdr));
+		ip6_pseudo_build((const struct ip6hdr *)nhhdr, &ip6ph);
+		return partial_sum(&ip6ph, sizeof ip6ph);
+	}
+}
+
+void tcp_set_check_pseudo(struct tcphdr *tcph, const void *nhhdr) {
+	assert(tcph != NULL);
+	tcph->check = fold_short(tcp_pseudo_sum(nhhdr));
+}
+
 size_t tcp4_data_length(const struct tcphdr *tcph,
 		const struct iphdr *iph) {
 	assert(tcph != NULL);
@@ -60,6 +60,26 @@ void udp_set_check_field(struct udphdr *udph, const void *nhhdr) {
 	}
 }
 
+unsigned long udp_pseudo_sum(const void *nhhdr) {
+	struct ip_pseudohdr ipph;
+	struct ip6_pseudohdr ip6ph;
+
+	if (ip_check_version((const struct iphdr *)nhhdr)) {
+		ip_pseudo_build((const struct iphdr *)nhhdr, &ipph);
+		return partial_sum(&ipph, sizeof ipph);
+	}
+	else {
+		assert(ip6_check_version((const struct ip6hdr *)nhhdr));
+		ip6_pseudo_build((const struct ip6hdr *)nhhdr, &ip6ph);
+		return partial_sum(&ip6ph, sizeof ip6ph);
+	}
+}
+
+void udp_set_check_pseudo(struct udphdr *udph, const void *nhhdr) {
+	assert(udph != NULL);
+	udph->check = fold_short(udp_pseudo_sum(nhhdr));
+}
+
 size_t udp_data_length(const struct udphdr *udph) {
 	assert(udph != NULL);
 	assert(ntohs(udph->len) >= UDP_HEADER_SIZE);
@@ -10,12 +10,14 @@
 #include <errno.h>
 #include <kernel/sched/sched_lock.h>
 #include <mem/misc/pool.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
 #include <util/dlist.h>
 #include <util/array.h>
 #include <sys/time.h>
 #include <kernel/time/ktime.h>
+#include <kernel/time/time.h>
 #include <kernel/time/timer.h>
 #include <net/l0/net_tx.h>
 #include <util/binalign.h>
@@ -29,41 +31,142 @@
 #include <net/l2/ethernet.h>
 #include <net/netdevice.h>
 #include <net/inetdevice.h>
+#include <netinet/in.h>
 
-#define MODOPS_NEIGHBOUR_AMOUNT   OPTION_GET(NUMBER, neighbour_amount)
-#define MODOPS_NEIGHBOUR_EXPIRE   OPTION_GET(NUMBER, neighbour_expire)
-#define MODOPS_NEIGHBOUR_TMR_FREQ OPTION_GET(NUMBER, neighbour_tmr_freq)
-#define MODOPS_NEIGHBOUR_RESEND   OPTION_GET(NUMBER, neighbour_resend)
-#define MODOPS_NEIGHBOUR_ATTEMPT  OPTION_GET(NUMBER, neighbour_attempt)
+#define MODOPS_NEIGHBOUR_AMOUNT    OPTION_GET(NUMBER, neighbour_amount)
+#define MODOPS_NEIGHBOUR_HASH_SIZE OPTION_GET(NUMBER, neighbour_hash_size)
+#define MODOPS_NEIGHBOUR_EXPIRE    OPTION_GET(NUMBER, neighbour_expire)
+#define MODOPS_NEIGHBOUR_REACHABLE OPTION_GET(NUMBER, neighbour_reachable)
+#define MODOPS_NEIGHBOUR_DELAY     OPTION_GET(NUMBER, neighbour_delay)
+#define MODOPS_NEIGHBOUR_RESEND    OPTION_GET(NUMBER, neighbour_resend)
+#define MODOPS_NEIGHBOUR_ATTEMPT   OPTION_GET(NUMBER, neighbour_attempt)
+#define MODOPS_NEIGHBOUR_QUEUE_LEN OPTION_GET(NUMBER, neighbour_queue_len)
 
 EMBOX_UNIT_INIT(neighbour_init);
 
 POOL_DEF(neighbour_pool, struct neighbour, MODOPS_NEIGHBOUR_AMOUNT);
+/* All entities, the least recently used one is the first */
 static DLIST_DEFINE(neighbour_list);
-static struct sys_timer neighbour_tmr;
+static struct dlist_head neighbour_hash[MODOPS_NEIGHBOUR_HASH_SIZE];
+
+static void nbr_timer_handler(struct sys_timer *tmr, void *param);
+
+static unsigned int nbr_hash(unsigned short ptype, const void *paddr,
+		struct net_device *dev) {
+	const unsigned char *b;
+	unsigned char plen;
+	unsigned int hash;
+
+	plen = ptype == ETH_P_IP ? sizeof(struct in_addr)
+			: sizeof(struct in6_addr);
+	hash = ptype ^ ((uintptr_t)dev >> 4);
+	for (b = paddr; plen != 0; --plen, ++b) {
+		hash = hash * 31 + *b;
+	}
+
+	return hash % MODOPS_NEIGHBOUR_HASH_SIZE;
+}
+
+/* Moves entity to the end of LRU list */
+static inline void nbr_touch(struct neighbour *nbr) {
+	dlist_del(&nbr->lnk);
+	dlist_add_prev(&nbr->lnk, &neighbour_list);
+}
+
+static void nbr_set_state(struct neighbour *nbr, enum neighbour_state state) {
+	uint32_t msec;
+
+	nbr->state = state;
+
+	switch (state) {
+	case NEIGHBOUR_INCOMPLETE:
+	case NEIGHBOUR_PROBE:
+		msec = MODOPS_NEIGHBOUR_RESEND;
+		break;
+	case NEIGHBOUR_REACHABLE:
+		if (nbr->flags & NEIGHBOUR_FLAG_PERMANENT) {
+			timer_stop(&nbr->tmr);
+			return;
+		}
+		msec = MODOPS_NEIGHBOUR_REACHABLE;
+		break;
+	case NEIGHBOUR_STALE:
+		msec = MODOPS_NEIGHBOUR_EXPIRE;
+		break;
+	case NEIGHBOUR_DELAY:
+		msec = MODOPS_NEIGHBOUR_DELAY;
+		break;
+	default:
+		assert(0);
+		return;
+	}
+
+	timer_start(&nbr->tmr, ms2jiffies(msec));
+}
 
 static void nbr_set_haddr(struct neighbour *nbr, const void *haddr) {
 	assert(nbr != NULL);
 
+	nbr->sent_times = 0;
 	if (haddr != NULL) {
-		nbr->incomplete = 0;
 		memcpy(&nbr->haddr[0], haddr, nbr->hlen);
+		nbr_set_state(nbr, NEIGHBOUR_REACHABLE);
 	}
 	else {
-		nbr->incomplete = 1;
-		nbr->resend = MODOPS_NEIGHBOUR_RESEND;
-		nbr->sent_times = 0;
+		nbr_set_state(nbr, NEIGHBOUR_INCOMPLETE);
 	}
 }
 
 static void nbr_free(struct neighbour *nbr) {
 	assert(nbr != NULL);
 
+	timer_stop(&nbr->tmr);
 	dlist_del_init_entry(nbr, lnk);
+	dlist_del_init_entry(nbr, hash_lnk);
 	skb_queue_purge(&nbr->w_queue);
 	pool_free(&neighbour_pool, nbr);
 }
 
+/* Allocates entity, when the table is full the least recently used one
+ * is evicted */
+static struct neighbour * nbr_alloc(unsigned short ptype, const void *paddr,
+		unsigned char plen, struct net_device *dev) {
+	struct neighbour *nbr;
+
+	nbr = pool_alloc(&neighbour_pool);
+	if (nbr == NULL) {
+		dlist_foreach_entry(nbr, &neighbour_list, lnk) {
+			if (!(nbr->flags & NEIGHBOUR_FLAG_PERMANENT)) {
+				log_debug("evict %p", nbr);
+				nbr_free(nbr);
+				break;
+			}
+		}
+		nbr = pool_alloc(&neighbour_pool);
+		if (nbr == NULL) {
+			return NULL;
+		}
+	}
+
+	dlist_head_init(&nbr->lnk);
+	dlist_head_init(&nbr->hash_lnk);
+	nbr->ptype = ptype;
+	memcpy(nbr->paddr, paddr, plen);
+	nbr->plen = plen;
+	nbr->dev = dev;
+	nbr->flags = 0;
+	nbr->sent_times = 0;
+	skb_queue_init(&nbr->w_queue);
+	nbr->w_queue_len = 0;
+	timer_init(&nbr->tmr, TIMER_ONESHOT, nbr_timer_handler, nbr);
+
+	dlist_add_prev_entry(nbr, &neighbour_list, lnk);
+	dlist_add_prev_entry(nbr,
+			&neighbour_hash[nbr_hash(ptype, paddr, dev)], hash_lnk);
+
+	return nbr;
+}
+
 static struct neighbour * nbr_lookup_by_paddr(unsigned short ptype,
 		const void *paddr, struct net_device *dev) {
 	struct neighbour *nbr;
@@ -71,7 +174,8 @@ static struct neighbour * nbr_lookup_by_paddr(unsigned short ptype,
 	assert(paddr != NULL);
 	assert(dev != NULL);
 
-	dlist_foreach_entry(nbr, &neighbour_list, lnk) {
+	dlist_foreach_entry(nbr,
+			&neighbour_hash[nbr_hash(ptype, paddr, dev)], hash_lnk) {
 		if ((nbr->ptype == ptype)
 				&& (0 == memcmp(&nbr->paddr[0], paddr, nbr->plen))
 				&& (nbr->dev == dev)) {
@@ -100,6 +204,14 @@ static struct neighbour * nbr_lookup_by_haddr(unsigned short htype,
 	return NULL; /* error: no such entity */
 }
 
+/* Entity is used to send a packet */
+static void nbr_use(struct neighbour *nbr) {
+	nbr_touch(nbr);
+	if (nbr->state == NEIGHBOUR_STALE) {
+		nbr_set_state(nbr, NEIGHBOUR_DELAY);
+	}
+}
+
 static int nbr_send_request(struct neighbour *nbr) {
 	struct in_device *in_dev;
 	struct {
@@ -140,6 +252,7 @@ static void nbr_drop_w_queue(struct neighbour *nbr) {
 		icmp_discard(skb, ICMP_DEST_UNREACH, ICMP_HOST_UNREACH);
 	}
 
+	nbr->w_queue_len = 0;
 	nbr->sent_times = 0;
 }
 
@@ -172,15 +285,28 @@ static int nbr_build_and_send_pkt(struct sk_buff *skb,
 	return 0;
 }
 
-static void nbr_flush_w_queue(struct neighbour *nbr) {
+/* Moves waiting packets to @a out to send them without the lock */
+static void nbr_take_w_queue(struct neighbour *nbr,
+		struct sk_buff_head *out) {
+	struct sk_buff *skb;
+
+	while ((skb = skb_queue_pop(&nbr->w_queue)) != NULL) {
+		skb_queue_push(out, skb);
+	}
+
+	nbr->w_queue_len = 0;
+}
+
+static void nbr_flush_w_queue(struct sk_buff_head *queue,
+		unsigned short ptype, struct net_device *dev, const void *haddr) {
 	struct sk_buff *skb;
 	struct net_header_info hdr_info;
 
-	hdr_info.type = nbr->ptype;
-	hdr_info.src_hw = &nbr->dev->dev_addr[0];
-	hdr_info.dst_hw = &nbr->haddr[0];
+	hdr_info.type = ptype;
+	hdr_info.src_hw = &dev->dev_addr[0];
+	hdr_info.dst_hw = haddr;
 
-	while ((skb = skb_queue_pop(&nbr->w_queue)) != NULL) {
+	while ((skb = skb_queue_pop(queue)) != NULL) {
 		(void)nbr_build_and_send_pkt(skb, &hdr_info);
 	}
 }
@@ -189,8 +315,9 @@ int neighbour_add(unsigned short ptype, const void *paddr,
 		unsigned char plen, struct net_device *dev,
 		unsigned short htype, const void *haddr, unsigned char hlen,
 		unsigned int flags) {
-	int exist;
 	struct neighbour *nbr;
+	struct sk_buff_head w_queue;
+	unsigned char haddr_copy[MAX_ADDR_LEN];
 
 	if ((paddr == NULL) || (plen == 0)
 			|| (plen > ARRAY_SIZE(nbr->paddr)) || (dev == NULL)
@@ -199,42 +326,38 @@ int neighbour_add(unsigned short ptype, const void *paddr,
 		return -EINVAL;
 	}
 
+	skb_queue_init(&w_queue);
+
 	sched_lock();
 	{
 		nbr = nbr_lookup_by_paddr(ptype, paddr, dev);
-		exist = nbr != NULL;
 		if (nbr == NULL) {
-			nbr = pool_alloc(&neighbour_pool);
+			nbr = nbr_alloc(ptype, paddr, plen, dev);
+			if (nbr == NULL) {
+				sched_unlock();
+				return -ENOMEM;
+			}
+		}
+		else if ((nbr->flags & NEIGHBOUR_FLAG_PERMANENT)
+				&& !(flags & NEIGHBOUR_FLAG_PERMANENT)) {
+			/* dynamic update can't override static entity */
+			nbr_touch(nbr);
+			sched_unlock();
+			return 0;
 		}
-	}
-	sched_unlock();
-	if (nbr == NULL) {
-		return -ENOMEM;
-	}
 
-	nbr->htype = htype;
-	nbr->hlen = hlen;
-	nbr_set_haddr(nbr, haddr);
-	nbr->flags = flags;
-	nbr->expire = MODOPS_NEIGHBOUR_EXPIRE;
+		nbr->htype = htype;
+		nbr->hlen = hlen;
+		nbr->flags = flags;
+		nbr_set_haddr(nbr, haddr);
+		nbr_touch(nbr);
 
-	if (exist) {
-		nbr_flush_w_queue(nbr);
-	}
-	else {
-		dlist_head_init(&nbr->lnk);
-		nbr->ptype = ptype;
-		memcpy(nbr->paddr, paddr, plen);
-		nbr->plen = plen;
-		nbr->dev = dev;
-		skb_queue_init(&nbr->w_queue);
-
-		sched_lock();
-		{
-			dlist_add_prev_entry(nbr, &neighbour_list, lnk);
-		}
-		sched_unlock();
+		nbr_take_w_queue(nbr, &w_queue);
+		memcpy(haddr_copy, haddr, hlen);
 	}
+	sched_unlock();
+
+	nbr_flush_w_queue(&w_queue, ptype, dev, haddr_copy);
 
 	return 0;
 }
@@ -259,7 +382,7 @@ int neighbour_get_haddr(unsigned short ptype,  const void *paddr,
 			sched_unlock();
 			return -ENOENT;
 		}
-		else if (nbr->incomplete) {
+		else if (nbr->state == NEIGHBOUR_INCOMPLETE) {
 			sched_unlock();
 			return -EINPROGRESS;
 		}
@@ -268,6 +391,7 @@ int neighbour_get_haddr(unsigned short ptype,  const void *paddr,
 			return -ENOMEM;
 		}
 
+		nbr_use(nbr);
 		memcpy(out_haddr, &nbr->haddr[0], nbr->hlen);
 	}
 	sched_unlock();
@@ -377,8 +501,9 @@ int neighbour_send_after_resolve(unsigned short ptype,
 	int allocated, resolved;
 	struct neighbour *nbr;
 	struct net_header_info hdr_info;
+	unsigned char haddr[MAX_ADDR_LEN];
 
-	if ((paddr == NULL) || (dev == NULL) || (dev == NULL)) {
+	if ((paddr == NULL) || (dev == NULL) || (skb == NULL)) {
 		skb_free(skb);
 		return -EINVAL;
 	}
@@ -387,97 +512,102 @@ int neighbour_send_after_resolve(unsigned short ptype,
 	{
 		nbr = nbr_lookup_by_paddr(ptype, paddr, dev);
 		if (nbr == NULL) {
-			nbr = pool_alloc(&neighbour_pool);
+			nbr = nbr_alloc(ptype, paddr, plen, dev);
 			if (nbr == NULL) {
 				sched_unlock();
 				skb_free(skb);
 				return -ENOMEM;
 			}
-			dlist_head_init(&nbr->lnk);
-			nbr->ptype = ptype;
-			memcpy(nbr->paddr, paddr, plen);
-			nbr->plen = plen;
-			nbr->dev = dev;
 			nbr->htype = dev->type;
 			nbr->hlen = dev->addr_len;
 			nbr_set_haddr(nbr, NULL);
-			nbr->flags = 0;
-			skb_queue_init(&nbr->w_queue);
-			nbr->expire = MODOPS_NEIGHBOUR_EXPIRE;
-
-			dlist_add_prev_entry(nbr, &neighbour_list, lnk);
 
 			allocated = 1;
 		}
 		else {
+			nbr_use(nbr);
 			allocated = 0;
 		}
 
-		resolved = !nbr->incomplete;
+		resolved = nbr->state != NEIGHBOUR_INCOMPLETE;
 
-		if (!resolved) {
+		if (resolved) {
+			memcpy(haddr, &nbr->haddr[0], nbr->hlen);
+		}
+		else {
+			if (nbr->w_queue_len == MODOPS_NEIGHBOUR_QUEUE_LEN) {
+				/* the oldest packet is dropped */
+				skb_free(skb_queue_pop(&nbr->w_queue));
+				--nbr->w_queue_len;
+			}
 			skb_queue_push(&nbr->w_queue, skb);
+			++nbr->w_queue_len;
+
+			if (allocated) {
+				(void)nbr_send_request(nbr);
+			}
 		}
 	}
 	sched_unlock();
 
 	if (resolved) {
-		hdr_info.type = nbr->ptype;
-		hdr_info.src_hw = &nbr->dev->dev_addr[0];
-		hdr_info.dst_hw = &nbr->haddr[0];
+		hdr_info.type = ptype;
+		hdr_info.src_hw = &dev->dev_addr[0];
+		hdr_info.dst_hw = &haddr[0];
 		return nbr_build_and_send_pkt(skb, &hdr_info);
 	}
 
-	if (allocated) {
-		(void)nbr_send_request(nbr);
-	}
-
 	return 0;
 }
 
 static void nbr_timer_handler(struct sys_timer *tmr, void *param) {
 	struct neighbour *nbr;
 
+	nbr = param;
+
 	sched_lock();
 	{
-		dlist_foreach_entry(nbr, &neighbour_list, lnk) {
-			if (nbr->flags & NEIGHBOUR_FLAG_PERMANENT) {
-				continue;
-			}
-			else if (nbr->expire <= MODOPS_NEIGHBOUR_TMR_FREQ) {
+		switch (nbr->state) {
+		case NEIGHBOUR_INCOMPLETE:
+			if (nbr->sent_times >= MODOPS_NEIGHBOUR_ATTEMPT) {
+				nbr_drop_w_queue(nbr);
 				nbr_free(nbr);
-				continue;
+				break;
 			}
-
-			nbr->expire -= MODOPS_NEIGHBOUR_TMR_FREQ;
-
-			if (nbr->incomplete) {
-				if (nbr->resend <= MODOPS_NEIGHBOUR_TMR_FREQ) {
-					if (nbr->sent_times == MODOPS_NEIGHBOUR_ATTEMPT) {
-						(void)nbr_drop_w_queue(nbr);
-						nbr_free(nbr);
-					}
-					else {
-						(void)nbr_send_request(nbr);
-						nbr->resend = MODOPS_NEIGHBOUR_RESEND;
-					}
-				}
-				else {
-					nbr->resend -= MODOPS_NEIGHBOUR_TMR_FREQ;
-				}
+			(void)nbr_send_request(nbr);
+			nbr_set_state(nbr, NEIGHBOUR_INCOMPLETE);
+			break;
+		case NEIGHBOUR_REACHABLE:
+			nbr_set_state(nbr, NEIGHBOUR_STALE);
+			break;
+		case NEIGHBOUR_STALE:
+			/* wasn't used for a long time */
+			nbr_free(nbr);
+			break;
+		case NEIGHBOUR_DELAY:
+			/* wasn't confirmed by upper layer, so ask it directly */
+			nbr->sent_times = 0;
+			(void)nbr_send_request(nbr);
+			nbr_set_state(nbr, NEIGHBOUR_PROBE);
+			break;
+		case NEIGHBOUR_PROBE:
+			if (nbr->sent_times >= MODOPS_NEIGHBOUR_ATTEMPT) {
+				nbr_free(nbr);
+				break;
 			}
+			(void)nbr_send_request(nbr);
+			nbr_set_state(nbr, NEIGHBOUR_PROBE);
+			break;
 		}
 	}
 	sched_unlock();
 }
 
 static int neighbour_init(void) {
-	int ret;
+	struct dlist_head *bucket;
 
-	ret = timer_init_start_msec(&neighbour_tmr, TIMER_PERIODIC,
-			MODOPS_NEIGHBOUR_TMR_FREQ, nbr_timer_handler, NULL);
-	if (ret != 0) {
-		return ret;
+	array_foreach_ptr(bucket, neighbour_hash, ARRAY_SIZE(neighbour_hash)) {
+		dlist_init(bucket);
 	}
 
 	return 0;
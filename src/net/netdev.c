@@ -62,6 +62,10 @@ static int netdev_init(struct net_device *dev, const char *name,
 	strcpy(&dev->name[0], name);
 	memset(&dev->stats, 0, sizeof dev->stats);
 	skb_queue_init(&dev->dev_queue);
+	dev->dev_queue_len = 0;
+	dev->poll = NULL;
+	dev->poll_weight = 0;
+	dev->features = 0;
 
 	if (priv_size != 0) {
 		dev->priv = sysmalloc(priv_size);
@@ -9,6 +9,7 @@
 */
 
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
 #include <stdint.h>
 #include <sys/uio.h>
@@ -25,11 +26,16 @@
 #include <linux/list.h>
 
 #include <net/skbuff.h>
+#include <net/util/checksum.h>
+
+#include "skb_cache.h"
 
 #include <framework/mod/options.h>
 
 #define MODOPS_AMOUNT_SKB       OPTION_GET(NUMBER, amount_skb)
+#define MODOPS_CACHE_SIZE       OPTION_GET(NUMBER, cache_size)
 POOL_DEF(skb_pool, struct sk_buff, MODOPS_AMOUNT_SKB);
+SKB_CACHE_DEF(skb_cache, &skb_pool, MODOPS_AMOUNT_SKB, MODOPS_CACHE_SIZE);
 
 struct sk_buff * skb_wrap(size_t size, struct sk_buff_data *skb_data) {
 	return skb_wrap_local(size, skb_data, &skb_pool);
@@ -50,11 +56,15 @@ struct sk_buff * skb_wrap_local(size_t size, struct sk_buff_data *skb_data,
 //		return NULL; /* error: invalid argument */
 //	}
 
-	sp = ipl_save();
-	{
-		skb = pool_alloc(pl);
+	if (pl == &skb_pool) {
+		skb = skb_cache_alloc(&skb_cache);
+	} else {
+		sp = ipl_save();
+		{
+			skb = pool_alloc(pl);
+		}
+		ipl_restore(sp);
 	}
-	ipl_restore(sp);
 
 	if (skb == NULL) {
 		log_error("skb_wrap: error: no memory\n");
@@ -66,6 +76,8 @@ struct sk_buff * skb_wrap_local(size_t size, struct sk_buff_data *skb_data,
 	INIT_LIST_HEAD((struct list_head * )skb);
 	skb->dev = NULL;
 	skb->len = size;
+	skb->gso_size = 0;
+	skb->ip_summed = CHECKSUM_NONE;
 	skb->nh.raw = skb->h.raw = NULL;
 	skb->data = skb_data;
 	skb->mac.raw = skb_get_data_pointner(skb_data);
@@ -105,6 +117,8 @@ struct sk_buff * skb_realloc(size_t size, struct sk_buff *skb) {
 	list_del_init((struct list_head *) skb);
 	skb->dev = NULL;
 	skb->len = size;
+	skb->gso_size = 0;
+	skb->ip_summed = CHECKSUM_NONE;
 	skb->mac.raw = skb_get_data_pointner(skb->data);
 	skb->nh.raw = skb->h.raw = NULL;
 
@@ -124,11 +138,19 @@ void skb_free(struct sk_buff *skb) {
 	{
 		assert((skb->lnk.prev != NULL) && (skb->lnk.next != NULL));
 		list_del((struct list_head *) skb);
-		pool_free(skb->pl, skb);
+		if (skb->pl == &skb_pool) {
+			skb_cache_free(&skb_cache, skb);
+		} else {
+			pool_free(skb->pl, skb);
+		}
 	}
 	ipl_restore(sp);
 }
 
+void skb_get_cache_stats(unsigned int cpu, struct skb_cache_stats *stats) {
+	skb_cache_get_stats(&skb_cache, cpu, stats);
+}
+
 static void skb_copy_ref(struct sk_buff *to, const struct sk_buff *from) {
 	ptrdiff_t offset;
 
@@ -136,6 +158,11 @@ static void skb_copy_ref(struct sk_buff *to, const struct sk_buff *from) {
 			&& (from->data != NULL));
 
 	to->dev = from->dev;
+	to->gso_size = from->gso_size;
+	to->ip_summed = from->ip_summed;
+	to->csum_start = from->csum_start;
+	to->csum_offset = from->csum_offset;
+	to->csum = from->csum;
 	offset = skb_get_data_pointner(to->data)
 			- skb_get_data_pointner(from->data);
 	if (from->mac.raw != NULL) {
@@ -235,6 +262,25 @@ struct sk_buff * skb_declone(struct sk_buff *skb) {
 	return skb;
 }
 
+int skb_csum_complete(struct sk_buff *skb) {
+	unsigned char *start;
+
+	assert(skb != NULL);
+	assert(skb->ip_summed == CHECKSUM_PARTIAL);
+
+	/* Data could be shared with the packet kept for retransmission */
+	if (skb_declone(skb) == NULL) {
+		return -ENOMEM;
+	}
+
+	start = skb->mac.raw + skb->csum_start;
+	*(uint16_t *)(start + skb->csum_offset) =
+			~fold_short(partial_sum(start, skb->len - skb->csum_start));
+	skb->ip_summed = CHECKSUM_NONE;
+
+	return 0;
+}
+
 void skb_rshift(struct sk_buff *skb, size_t count) {
 	assert(skb != NULL);
 	assert(skb->data != NULL);
@@ -276,6 +322,31 @@ int skb_iovec_buf(const struct iovec *iov, int iovlen, const void *buf, int bufl
 	return buf_p - buf;
 }
 
+int skb_iovec_buf_csum(const struct iovec *iov, int iovlen,
+		const void *buf, int buflen, unsigned long *sum) {
+	const void *const buf_e = buf + buflen;
+	const void *buf_p = buf;
+	int i_io = 0;
+
+	while (buf_p < buf_e && i_io < iovlen) {
+		const int to_copy = min(iov[i_io].iov_len, buf_e - buf_p);
+
+		*sum = csum_block_add(*sum,
+				csum_and_copy(iov[i_io].iov_base, buf_p, to_copy),
+				buf_p - buf);
+		buf_p += to_copy;
+		++i_io;
+	}
+
+	/* The rest which doesn't fit into iovec is summed as well */
+	if (buf_p < buf_e) {
+		*sum = csum_block_add(*sum, partial_sum(buf_p, buf_e - buf_p),
+				buf_p - buf);
+	}
+
+	return buf_p - buf;
+}
+
 int skb_buf_iovec(void *buf, int buflen, struct iovec *iov, int iovlen) {
 	void *const buf_e = buf + buflen;
 	void *buf_p = buf;
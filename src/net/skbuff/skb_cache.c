@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @brief Per-CPU magazine caches in front of skb pools
+ *
+ * @details Each CPU keeps a small stack (magazine) of free objects, so
+ *   allocation and freeing touch only CPU local data with local interrupts
+ *   disabled. The shared pool is locked only to refill an empty magazine
+ *   or to flush a full one, and then @c batch objects are moved at once.
+ *
+ * @date 17.10.26
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include <hal/cpu.h>
+#include <hal/ipl.h>
+#include <mem/misc/pool.h>
+
+#include "skb_cache.h"
+
+static void skb_cache_refill(struct skb_cache *cache,
+		struct skb_cache_mag *mag, void **objs) {
+	void *obj;
+
+	spin_lock(&cache->lock);
+	{
+		while (mag->count < cache->batch) {
+			obj = pool_alloc(cache->pool);
+			if (obj == NULL) {
+				mag->stats.depleted++;
+				break;
+			}
+			objs[mag->count++] = obj;
+		}
+	}
+	spin_unlock(&cache->lock);
+
+	mag->stats.refills++;
+}
+
+static void skb_cache_flush(struct skb_cache *cache,
+		struct skb_cache_mag *mag, void **objs) {
+	unsigned int left;
+
+	left = cache->size - cache->batch;
+
+	spin_lock(&cache->lock);
+	{
+		while (mag->count > left) {
+			pool_free(cache->pool, objs[--mag->count]);
+		}
+	}
+	spin_unlock(&cache->lock);
+
+	mag->stats.flushes++;
+}
+
+void *skb_cache_alloc(struct skb_cache *cache) {
+	struct skb_cache_mag *mag;
+	void **objs;
+	void *obj;
+	ipl_t ipl;
+
+	assert(cache != NULL);
+
+	ipl = ipl_save();
+	{
+		mag = cpudata_cpu_ptr(cpu_get_id(), cache->mag);
+		objs = cpudata_cpu_ptr(cpu_get_id(), cache->objs);
+
+		mag->stats.allocs++;
+		if (cache->size == 0) {
+			spin_lock(&cache->lock);
+			{
+				obj = pool_alloc(cache->pool);
+			}
+			spin_unlock(&cache->lock);
+			if (obj == NULL) {
+				mag->stats.depleted++;
+			}
+		} else {
+			if (mag->count != 0) {
+				mag->stats.alloc_hits++;
+			} else {
+				skb_cache_refill(cache, mag, objs);
+			}
+			obj = (mag->count != 0) ? objs[--mag->count] : NULL;
+		}
+	}
+	ipl_restore(ipl);
+
+	return obj;
+}
+
+void skb_cache_free(struct skb_cache *cache, void *obj) {
+	struct skb_cache_mag *mag;
+	void **objs;
+	ipl_t ipl;
+
+	assert(cache != NULL);
+	assert(obj != NULL);
+
+	ipl = ipl_save();
+	{
+		mag = cpudata_cpu_ptr(cpu_get_id(), cache->mag);
+		objs = cpudata_cpu_ptr(cpu_get_id(), cache->objs);
+
+		mag->stats.frees++;
+		if (cache->size == 0) {
+			spin_lock(&cache->lock);
+			{
+				pool_free(cache->pool, obj);
+			}
+			spin_unlock(&cache->lock);
+		} else {
+			if (mag->count != cache->size) {
+				mag->stats.free_hits++;
+			} else {
+				skb_cache_flush(cache, mag, objs);
+			}
+			objs[mag->count++] = obj;
+		}
+	}
+	ipl_restore(ipl);
+}
+
+void skb_cache_get_stats(struct skb_cache *cache, unsigned int cpu,
+		struct skb_cache_stats *stats) {
+	struct skb_cache_mag *mag;
+	ipl_t ipl;
+
+	assert(cache != NULL);
+	assert(cpu < NCPU);
+	assert(stats != NULL);
+
+	mag = cpudata_cpu_ptr(cpu, cache->mag);
+
+	ipl = ipl_save();
+	{
+		memcpy(stats, &mag->stats, sizeof(*stats));
+		stats->cached = mag->count;
+	}
+	ipl_restore(ipl);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file
+ * @brief Per-CPU magazine caches in front of skb pools
+ *
+ * @date 17.10.26
+ */
+
+#ifndef NET_SKBUFF_SKB_CACHE_H_
+#define NET_SKBUFF_SKB_CACHE_H_
+
+#include <kernel/cpu/cpudata.h>
+#include <kernel/spinlock.h>
+#include <net/skbuff.h>
+
+struct pool;
+
+struct skb_cache_mag {
+	unsigned int count;
+	struct skb_cache_stats stats;
+};
+
+struct skb_cache {
+	struct pool *pool;
+	spinlock_t lock; /* protects the shared pool */
+	unsigned int size;  /* capacity of magazine */
+	unsigned int batch; /* objects moved between magazine and pool at once */
+	struct skb_cache_mag *mag; /* per-CPU */
+	void **objs;               /* per-CPU */
+};
+
+/**
+ * Magazine capacity limited so that magazines of all CPUs together hold
+ * at most half of the pool of @a pool_size objects. Otherwise one CPU
+ * could keep every free object while allocations on others fail.
+ */
+#define SKB_CACHE_SIZE(size, pool_size) \
+	(((size) < (pool_size) / (2 * NCPU)) ? (size) : (pool_size) / (2 * NCPU))
+
+/**
+ * Defines cache of up to @a size objects per CPU for the @a pool_ptr
+ * of @a pool_size objects. Zero @a size turns the cache off.
+ */
+#define SKB_CACHE_DEF(name, pool_ptr, pool_size, size_) \
+	static struct skb_cache_mag name ## _mag __cpudata__; \
+	static void *name ## _objs[SKB_CACHE_SIZE(size_, pool_size) ? \
+			SKB_CACHE_SIZE(size_, pool_size) : 1] __cpudata__; \
+	static struct skb_cache name = { \
+		.pool = pool_ptr, \
+		.lock = SPIN_STATIC_UNLOCKED, \
+		.size = SKB_CACHE_SIZE(size_, pool_size), \
+		.batch = (SKB_CACHE_SIZE(size_, pool_size) + 1) / 2, \
+		.mag = &name ## _mag, \
+		.objs = name ## _objs, \
+	}
+
+extern void *skb_cache_alloc(struct skb_cache *cache);
+extern void skb_cache_free(struct skb_cache *cache, void *obj);
+extern void skb_cache_get_stats(struct skb_cache *cache, unsigned int cpu,
+		struct skb_cache_stats *stats);
+
+#endif /* NET_SKBUFF_SKB_CACHE_H_ */
@@ -24,12 +24,15 @@
 
 #include <net/skbuff.h>
 
+#include "skb_cache.h"
+
 #include <framework/mod/options.h>
 
 #define MODOPS_AMOUNT_SKB_DATA  OPTION_GET(NUMBER, amount_skb_data)
 #define MODOPS_DATA_SIZE        OPTION_GET(NUMBER, data_size)
 #define MODOPS_DATA_ALIGN       OPTION_GET(NUMBER, data_align)
 #define MODOPS_DATA_PADTO       OPTION_GET(NUMBER, data_padto)
+#define MODOPS_CACHE_SIZE       OPTION_GET(NUMBER, cache_size)
 
 #define IP_ALIGN_SIZE \
 	(OPTION_GET(BOOLEAN, ip_align) ? 2 : 0)
@@ -62,6 +65,8 @@ struct sk_buff_data {
 } DATA_ATTR;
 
 POOL_DEF(skb_data_pool, struct sk_buff_data_fixed, MODOPS_AMOUNT_SKB_DATA);
+SKB_CACHE_DEF(skb_data_cache, &skb_data_pool,
+		MODOPS_AMOUNT_SKB_DATA, MODOPS_CACHE_SIZE);
 
 void *skb_get_data_pointner(struct sk_buff_data *skb_data) {
 	return skb_data->__data + IP_ALIGN_SIZE;
@@ -90,17 +95,17 @@ struct sk_buff_data * skb_data_alloc(size_t size) {
 	struct sk_buff_data *skb_data;
 	int alloc_type = -1;
 
-	sp = ipl_save();
-	{
-		if (!skb_data_is_huge(size)) {
-			skb_data = pool_alloc(&skb_data_pool);
-			alloc_type = ALLOCATED_POOL;
-		} else {
+	if (!skb_data_is_huge(size)) {
+		skb_data = skb_cache_alloc(&skb_data_cache);
+		alloc_type = ALLOCATED_POOL;
+	} else {
+		sp = ipl_save();
+		{
 			skb_data = (struct sk_buff_data *) sysmalloc(SKB_DATA_SIZE(size));
-			alloc_type = ALLOCATED_MALLOC;
 		}
+		ipl_restore(sp);
+		alloc_type = ALLOCATED_MALLOC;
 	}
-	ipl_restore(sp);
 
 	if (skb_data == NULL) {
 		log_error("no memory skb_size = %d", size);
@@ -141,7 +146,7 @@ void skb_data_free(struct sk_buff_data *skb_data) {
 		if (--skb_data->links == 0) {
 			switch (skb_data->alloc_type) {
 			case ALLOCATED_POOL:
-				pool_free(&skb_data_pool, skb_data);
+				skb_cache_free(&skb_data_cache, skb_data);
 				break;
 			case ALLOCATED_MALLOC:
 				sysfree(skb_data);
@@ -154,3 +159,8 @@ void skb_data_free(struct sk_buff_data *skb_data) {
 	}
 	ipl_restore(sp);
 }
+
+void skb_data_get_cache_stats(unsigned int cpu,
+		struct skb_cache_stats *stats) {
+	skb_cache_get_stats(&skb_data_cache, cpu, stats);
+}
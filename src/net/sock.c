@@ -24,6 +24,7 @@
 #include <net/socket/inet_sock.h>
 #include <net/socket/inet6_sock.h>
 #include <net/sock_wait.h>
+#include <net/util/checksum.h>
 
 extern size_t skb_read(struct sk_buff *skb, char *buff, size_t buff_sz);
 
@@ -103,21 +104,38 @@ static struct sk_buff *sock_get_skb(struct sock *sk, unsigned long timeout, int
 int sock_dgram_recvmsg(struct sock *sk, struct msghdr *msg, int flags) {
 	const unsigned long timeout = sock_calc_timeout(sk);
 	struct sk_buff *skb;
+	unsigned long sum;
 	int err, nrecv;
 
 	assert(sk != NULL);
 
-	skb = sock_get_skb(sk, timeout, &err);
+	while (1) {
+		skb = sock_get_skb(sk, timeout, &err);
 
-	if (!skb) {
-		assert(err);
-		return err;
-	}
+		if (!skb) {
+			assert(err);
+			return err;
+		}
 
-	nrecv = skb_iovec_buf(msg->msg_iov, msg->msg_iovlen,
-			skb->p_data, skb->p_data_end - skb->p_data);
+		sk->rx_data_len -= skb->p_data_end - skb->p_data;
 
-	sk->rx_data_len -= skb->p_data_end - skb->p_data;
+		if (skb->ip_summed != CHECKSUM_COPY) {
+			nrecv = skb_iovec_buf(msg->msg_iov, msg->msg_iovlen,
+					skb->p_data, skb->p_data_end - skb->p_data);
+			break;
+		}
+
+		/* Checksum is verified in the same pass with copying */
+		sum = skb->csum;
+		nrecv = skb_iovec_buf_csum(msg->msg_iov, msg->msg_iovlen,
+				skb->p_data, skb->p_data_end - skb->p_data, &sum);
+		if (fold_short(sum) == 0xffff) {
+			break;
+		}
+
+		/* Drop datagram with invalid checksum and wait for the next one */
+		skb_free(skb);
+	}
 
 	assert(sk->p_ops != NULL);
 	if (sk->p_ops->fillmsg && msg->msg_name) {
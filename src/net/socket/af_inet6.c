@@ -76,6 +76,7 @@ static void __inet6_bind(struct inet6_sock *in6_sk,
 	assert(addr_in6 != NULL);
 	assert(addr_in6->sin6_family == AF_INET6);
 	memcpy(&in6_sk->src_in6, addr_in6, sizeof *addr_in6);
+	sock_rehash(&in6_sk->sk);
 }
 
 static int inet6_addr_tester(const struct sockaddr *lhs_sa,
@@ -176,6 +177,7 @@ static int __inet6_connect(struct inet6_sock *in6_sk,
 #endif
 
 	memcpy(&in6_sk->dst_in6, addr_in6, sizeof *addr_in6);
+	sock_rehash(&in6_sk->sk);
 
 	return 0;
 }
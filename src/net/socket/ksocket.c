@@ -275,6 +275,25 @@ int ksendmsg(struct sock *sk, struct msghdr *msg, int flags) {
 	return sk->f_ops->sendmsg(sk, msg, flags);
 }
 
+int ksendfile(struct sock *sk, struct idesc *in, size_t count) {
+	assert(sk);
+	assert(in);
+
+	if (sk->opt.so_type != SOCK_STREAM) {
+		return -EOPNOTSUPP;
+	}
+	else if (!sock_state_connected(sk)) {
+		return -ENOTCONN;
+	}
+
+	assert(sk->p_ops != NULL);
+	if (sk->p_ops->sendfile == NULL) {
+		return -EOPNOTSUPP;
+	}
+
+	return sk->p_ops->sendfile(sk, in, count);
+}
+
 int krecvmsg(struct sock *sk, struct msghdr *msg, int flags) {
 	assert(sk);
 	assert(msg);
@@ -4,20 +4,200 @@
  * @date Nov 7, 2013
  * @author: Anton Bondarev
  */
+#include <stdint.h>
+#include <string.h>
+
+#include <embox/unit.h>
+#include <framework/mod/options.h>
+#include <hal/ipl.h>
 #include <net/sock.h>
+#include <net/socket/inet_sock.h>
+#include <net/socket/inet6_sock.h>
+#include <util/array.h>
 #include <util/dlist.h>
 
+#define MODOPS_CONN_HTABLE_SIZE   OPTION_GET(NUMBER, conn_htable_size)
+#define MODOPS_LISTEN_HTABLE_SIZE OPTION_GET(NUMBER, listen_htable_size)
+
+EMBOX_UNIT_INIT(sock_hash_init);
+
+/* Sockets with non-zero remote port, hashed by 4-tuple */
+static struct dlist_head sock_conn_htable[MODOPS_CONN_HTABLE_SIZE];
+/* Bound sockets without remote port, hashed by local port only */
+static struct dlist_head sock_listen_htable[MODOPS_LISTEN_HTABLE_SIZE];
+
+static uint32_t sock_addr_fold(const void *addr, size_t addr_len) {
+	const uint32_t *words;
+	uint32_t val;
+
+	assert(addr != NULL);
+	assert(addr_len % sizeof *words == 0);
+
+	val = 0;
+	for (words = addr; addr_len != 0; addr_len -= sizeof *words) {
+		val ^= *words++;
+	}
+
+	return val;
+}
+
+static uint32_t sock_hash_mix(const struct sock_proto_ops *p_ops,
+		in_port_t local_port, in_port_t remote_port, uint32_t addr) {
+	uint32_t val;
+
+	val = (uint32_t)(uintptr_t)p_ops ^ addr
+			^ (((uint32_t)local_port << 16) | remote_port);
+	val ^= val >> 16;
+	val *= 0x45d9f3b;
+	val ^= val >> 16;
+
+	return val;
+}
+
+static struct dlist_head * sock_conn_bucket(
+		const struct sock_proto_ops *p_ops, in_port_t local_port,
+		in_port_t remote_port, const void *remote_addr, size_t addr_len) {
+	return &sock_conn_htable[sock_hash_mix(p_ops, local_port, remote_port,
+				sock_addr_fold(remote_addr, addr_len))
+			% MODOPS_CONN_HTABLE_SIZE];
+}
+
+static struct dlist_head * sock_listen_bucket(
+		const struct sock_proto_ops *p_ops, in_port_t local_port) {
+	return &sock_listen_htable[sock_hash_mix(p_ops, local_port, 0, 0)
+			% MODOPS_LISTEN_HTABLE_SIZE];
+}
+
+static struct dlist_head * sock_bucket(const struct sock *sk) {
+	in_port_t local_port, remote_port;
+
+	if ((sk->src_addr == NULL) || ((sk->opt.so_domain != AF_INET)
+				&& (sk->opt.so_domain != AF_INET6))) {
+		return NULL; /* not an inet socket */
+	}
+
+	local_port = sock_inet_get_src_port(sk);
+	if (local_port == 0) {
+		return NULL; /* not bound yet */
+	}
+
+	remote_port = sock_inet_get_dst_port(sk);
+	if (remote_port == 0) {
+		return sock_listen_bucket(sk->p_ops, local_port);
+	}
+
+	if (sk->opt.so_domain == AF_INET) {
+		return sock_conn_bucket(sk->p_ops, local_port, remote_port,
+				&to_const_inet_sock(sk)->dst_in.sin_addr,
+				sizeof to_const_inet_sock(sk)->dst_in.sin_addr);
+	}
+
+	return sock_conn_bucket(sk->p_ops, local_port, remote_port,
+			&to_const_inet6_sock(sk)->dst_in6.sin6_addr,
+			sizeof to_const_inet6_sock(sk)->dst_in6.sin6_addr);
+}
+
 void sock_hash(struct sock *sk) {
 	assert(sk != NULL);
 	assert(sk->p_ops != NULL);
 	assert(dlist_empty_entry(sk, lnk));
 
 	dlist_add_prev_entry(sk, sk->p_ops->sock_list, lnk);
+	sock_rehash(sk);
 }
 
 void sock_unhash(struct sock *sk) {
+	ipl_t ipl;
+
 	assert(sk != NULL);
 	assert(!dlist_empty_entry(sk, lnk));
 
+	ipl = ipl_save();
+	{
+		dlist_del_init_entry(sk, hash_lnk);
+	}
+	ipl_restore(ipl);
+
 	dlist_del_init_entry(sk, lnk);
 }
+
+void sock_rehash(struct sock *sk) {
+	ipl_t ipl;
+	struct dlist_head *bucket;
+
+	assert(sk != NULL);
+
+	if (dlist_empty_entry(sk, lnk)) {
+		return; /* not hashed yet, sock_hash() will place it */
+	}
+
+	bucket = sock_bucket(sk);
+
+	ipl = ipl_save();
+	{
+		dlist_del_init_entry(sk, hash_lnk);
+		if (bucket != NULL) {
+			dlist_add_prev_entry(sk, bucket, hash_lnk);
+		}
+	}
+	ipl_restore(ipl);
+}
+
+static struct sock * sock_bucket_lookup(struct dlist_head *bucket,
+		const struct sock_proto_ops *p_ops,
+		sock_lookup_tester_ft tester, const struct sk_buff *skb) {
+	ipl_t ipl;
+	struct sock *sk;
+
+	ipl = ipl_save();
+	{
+		dlist_foreach_entry(sk, bucket, hash_lnk) {
+			if ((sk->p_ops == p_ops) && tester(sk, skb)) {
+				ipl_restore(ipl);
+				return sk;
+			}
+		}
+	}
+	ipl_restore(ipl);
+
+	return NULL; /* error: no such entity */
+}
+
+struct sock * sock_lookup_conn(const struct sock_proto_ops *p_ops,
+		sock_lookup_tester_ft tester, const struct sk_buff *skb,
+		in_port_t local_port, in_port_t remote_port,
+		const void *remote_addr, size_t addr_len) {
+	if ((p_ops == NULL) || (tester == NULL)) {
+		return NULL; /* error: invalid arguments */
+	}
+
+	return sock_bucket_lookup(sock_conn_bucket(p_ops, local_port,
+				remote_port, remote_addr, addr_len), p_ops, tester, skb);
+}
+
+struct sock * sock_lookup_listen(const struct sock_proto_ops *p_ops,
+		sock_lookup_tester_ft tester, const struct sk_buff *skb,
+		in_port_t local_port) {
+	if ((p_ops == NULL) || (tester == NULL)) {
+		return NULL; /* error: invalid arguments */
+	}
+
+	return sock_bucket_lookup(sock_listen_bucket(p_ops, local_port),
+			p_ops, tester, skb);
+}
+
+static int sock_hash_init(void) {
+	struct dlist_head *bucket;
+
+	array_foreach_ptr(bucket, sock_conn_htable,
+			ARRAY_SIZE(sock_conn_htable)) {
+		dlist_init(bucket);
+	}
+
+	array_foreach_ptr(bucket, sock_listen_htable,
+			ARRAY_SIZE(sock_listen_htable)) {
+		dlist_init(bucket);
+	}
+
+	return 0;
+}
@@ -15,6 +15,7 @@
 #include <util/math.h>
 
 #include <net/l4/tcp.h>
+#include <net/l4/tcp_cong.h>
 #include <net/lib/tcp.h>
 #include <net/l3/ipv4/ip.h>
 #include <net/l2/ethernet.h>
@@ -29,6 +30,7 @@
 #include "net_sock.h"
 
 #include <kernel/sched/sched_lock.h>
+#include <fs/idesc.h>
 #include <fs/idesc_event.h>
 #include <net/sock_wait.h>
 
@@ -51,9 +53,6 @@ EMBOX_NET_SOCK(AF_INET, SOCK_STREAM, IPPROTO_TCP, 1,
 EMBOX_NET_SOCK(AF_INET6, SOCK_STREAM, IPPROTO_TCP, 1,
 		tcp_sock_ops_struct);
 
-#define MAX_HEADER_SIZE    (IP_MIN_HEADER_SIZE + IP_MAX_OPTLEN + \
-		TCP_MIN_HEADER_SIZE + ETH_HEADER_SIZE + 128 /* 128 is max size of tcp options length */)
-
 
 /************************ Socket's functions ***************************/
 static int tcp_init(struct sock *sk) {
@@ -87,6 +86,19 @@ static int tcp_init(struct sock *sk) {
 	timerclear(&tcp_sk->rcv_time);
 	tcp_sk->dup_ack = 0;
 	tcp_sk->rexmit_mode = 0;
+	/* Offered in SYN, negotiated with the peer */
+	tcp_sk->ws_ok = tcp_sk->sack_ok = 1;
+	skb_queue_init(&tcp_sk->ooo_queue);
+	tcp_sk->ooo_len = 0;
+	tcp_sk->sacked_cnt = 0;
+	tcp_sk->rexmit_high = tcp_sk->last_ack;
+	tcp_sk->rem_mss = tcp_sk->mss = TCP_MSS_DEFAULT;
+	tcp_sk->seg_max = TCP_MSS_DEFAULT;
+	tcp_sk->nodelay = tcp_sk->cork = 0;
+	tcp_sk->tx_pend = NULL;
+	tcp_sk->tx_pend_len = 0;
+	tcp_sock_timer_init(tcp_sk);
+	tcp_cong_init(tcp_sk, NULL, 1);
 
 	return 0;
 }
@@ -121,6 +133,7 @@ static int tcp_close(struct sock *sk) {
 		case TCP_SYN_RECV:
 		case TCP_ESTABIL:
 		case TCP_CLOSEWAIT:
+			tcp_pend_push(tcp_sk, TCP_PUSH_FORCE);
 			skb = NULL; /* alloc new pkg */
 			if (0 != alloc_prep_skb(tcp_sk, 0, NULL, &skb)) {
 				break; /* error: see ret */
@@ -151,13 +164,8 @@ static int tcp_connect(struct sock *sk,
 	struct tcphdr *tcph;
 	struct tcp_sock *tcp_sk;
 	int ret;
-	static const __u8 magic_opts[] = {
-		TCP_OPT_KIND_MSS, 0x04,     /* Maximum segment size:             */
-				0x40, 0x0C,               /* 16396 bytes         */
-		TCP_OPT_KIND_NOP,           /* No-Operation                      */
-		TCP_OPT_KIND_WS, 0x03,      /* Window scale:                     */
-				TCP_WINDOW_FACTOR_DEFAULT /* 7 (multiply by 128) */
-	};
+	__u8 syn_opts[TCP_SYN_OPT_MAX_LEN];
+	size_t opt_len;
 
 	(void)addr;
 	(void)addr_len;
@@ -177,8 +185,9 @@ static int tcp_connect(struct sock *sk,
 			break;
 		case TCP_CLOSED:
 			/* make skb with options */
+			opt_len = tcp_syn_opts_build(tcp_sk, &syn_opts[0]);
 			skb = NULL; /* alloc new pkg */
-			ret = alloc_prep_skb(tcp_sk, sizeof magic_opts, NULL, &skb);
+			ret = alloc_prep_skb(tcp_sk, opt_len, NULL, &skb);
 			if (ret != 0) {
 				break;
 			}
@@ -187,10 +196,10 @@ static int tcp_connect(struct sock *sk,
 			tcp_build(tcph,
 					sock_inet_get_dst_port(to_sock(tcp_sk)),
 					sock_inet_get_src_port(to_sock(tcp_sk)),
-					TCP_MIN_HEADER_SIZE + sizeof magic_opts,
+					TCP_MIN_HEADER_SIZE + opt_len,
 					tcp_sk->self.wind.value);
 			tcph->syn = 1;
-			memcpy(&tcph->options, &magic_opts[0], sizeof magic_opts);
+			memcpy(&tcph->options, &syn_opts[0], opt_len);
 			send_seq_from_sock(tcp_sk, skb);
 			//FIXME hack use common lock/unlock systems for socket
 			sched_lock();
@@ -374,23 +383,74 @@ static int tcp_accept(struct sock *sk, struct sockaddr *addr,
 	return 0;
 }
 
-static int tcp_write(struct tcp_sock *tcp_sk, void *buff, size_t len) {
-	void *pb;
+/* Copies @a len bytes gathered from iovec array starting at @a iov_off
+ * bytes of @a *iov to @a dst, and advances the iovec position */
+static void tcp_iov_gather(void *dst, const struct iovec **iov,
+		size_t *iov_off, size_t len) {
+	size_t bytes;
+
+	while (len != 0) {
+		bytes = min(len, (*iov)->iov_len - *iov_off);
+		memcpy(dst, (*iov)->iov_base + *iov_off, bytes);
+		dst += bytes;
+		len -= bytes;
+		*iov_off += bytes;
+		if (*iov_off == (*iov)->iov_len) {
+			++*iov;
+			*iov_off = 0;
+		}
+	}
+}
+
+/* Sends @a len bytes starting at @a iov_off bytes of @a *iov, and advances
+ * the iovec position. Data is cut into segments of MSS, or of many MSS for
+ * device with TSO. The tail shorter than MSS is kept in the partial segment,
+ * which next writes are appended to, see tcp_pend_push() */
+static int tcp_write(struct tcp_sock *tcp_sk, const struct iovec **iov,
+		size_t *iov_off, size_t len, int more) {
 	struct sk_buff *skb;
+	size_t sent, bytes, cap;
 	int ret;
 
-	pb = buff;
+	sent = 0;
+	tcp_sock_lock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
 	while (len != 0) {
-		/* Previous comment: try to send wholly msg
-		 * We must pass no more than 64k bytes to underlaying IP level */
-		size_t bytes = min(len, IP_MAX_PACKET_LEN - MAX_HEADER_SIZE);
+		if (tcp_sk->tx_pend != NULL) {
+			/* Coalesce with the previous small write */
+			bytes = min(len, tcp_sk->mss - tcp_sk->tx_pend_len);
+			tcp_iov_gather((char *)(tcp_sk->tx_pend->h.th + 1)
+					+ tcp_sk->tx_pend_len, iov, iov_off, bytes);
+			tcp_sk->tx_pend_len += bytes;
+			sent += bytes;
+			len -= bytes;
+			if (tcp_sk->tx_pend_len == tcp_sk->mss) {
+				tcp_pend_push(tcp_sk, TCP_PUSH_FORCE);
+			}
+			continue;
+		}
+
+		bytes = min(len, (size_t)tcp_sk->seg_max);
+		cap = bytes - bytes % tcp_sk->mss;
+		if (cap == 0) {
+			cap = tcp_sk->mss; /* partial segment is filled later */
+		}
 		skb = NULL; /* alloc new pkg */
 
-		ret = alloc_prep_skb(tcp_sk, 0, &bytes, &skb);
+		ret = alloc_prep_skb(tcp_sk, 0, &cap, &skb);
 		if (ret != 0) {
 			break;
 		}
 
+		if (bytes < tcp_sk->mss) {
+			tcp_iov_gather(skb->h.th + 1, iov, iov_off, bytes);
+			tcp_sk->tx_pend = skb;
+			tcp_sk->tx_pend_len = bytes;
+			sent += bytes;
+			len -= bytes;
+			continue;
+		}
+		bytes = cap;
+
 		log_debug("sending len %d", bytes);
 
 		tcp_build(skb->h.th,
@@ -398,15 +458,90 @@ static int tcp_write(struct tcp_sock *tcp_sk, void *buff, size_t len) {
 				sock_inet_get_src_port(to_sock(tcp_sk)),
 				TCP_MIN_HEADER_SIZE, tcp_sk->self.wind.value);
 
-		memcpy(skb->h.th + 1, pb, bytes);
-		pb += bytes;
+		/* Segment payload is gathered from all user buffers at once */
+		tcp_iov_gather(skb->h.th + 1, iov, iov_off, bytes);
+		sent += bytes;
 		len -= bytes;
 		/* Fill TCP header */
 		skb->h.th->psh = (len == 0);
+		if (bytes > tcp_sk->mss) {
+			skb->gso_size = tcp_sk->mss;
+		}
 		tcp_set_ack_field(skb->h.th, tcp_sk->rem.seq);
 		send_seq_from_sock(tcp_sk, skb);
 	}
-	return pb - buff;
+	tcp_pend_push(tcp_sk, more ? TCP_PUSH_MORE : TCP_PUSH_NAGLE);
+	tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+
+	return sent;
+}
+
+/* Reads at most @a len bytes from @a in straight to the segment payload,
+ * so file data is copied only once on its way to the network. It isn't
+ * zero-copy, skbs are linear and own their data */
+static int tcp_write_file(struct tcp_sock *tcp_sk, struct idesc *in,
+		size_t len) {
+	struct sk_buff *skb, *short_skb;
+	struct iovec iov;
+	size_t sent, bytes, read_bytes;
+	ssize_t ret;
+
+	sent = 0;
+	while (len != 0) {
+		bytes = min(len, (size_t)tcp_sk->seg_max);
+		skb = NULL;
+
+		ret = alloc_prep_skb(tcp_sk, 0, &bytes, &skb);
+		if (ret != 0) {
+			break;
+		}
+
+		iov.iov_base = skb->h.th + 1;
+		iov.iov_len = bytes;
+		ret = in->idesc_ops->id_readv(in, &iov, 1);
+		if (ret <= 0) {
+			skb_free(skb);
+			if ((ret < 0) && (sent == 0)) {
+				return ret;
+			}
+			break;
+		}
+		read_bytes = ret;
+
+		if (read_bytes < bytes) {
+			/* Rare case of a file shrunk underneath, the data was already
+			 * consumed so move it to the segment of suitable size */
+			short_skb = NULL;
+			bytes = read_bytes;
+			ret = alloc_prep_skb(tcp_sk, 0, &bytes, &short_skb);
+			if ((ret != 0) || (bytes != read_bytes)) {
+				if (ret == 0) {
+					skb_free(short_skb);
+				}
+				skb_free(skb);
+				break;
+			}
+			memcpy(short_skb->h.th + 1, skb->h.th + 1, read_bytes);
+			skb_free(skb);
+			skb = short_skb;
+			len = read_bytes;
+		}
+
+		tcp_build(skb->h.th,
+				sock_inet_get_dst_port(to_sock(tcp_sk)),
+				sock_inet_get_src_port(to_sock(tcp_sk)),
+				TCP_MIN_HEADER_SIZE, tcp_sk->self.wind.value);
+
+		sent += bytes;
+		len -= bytes;
+		skb->h.th->psh = (len == 0);
+		if (bytes > tcp_sk->mss) {
+			skb->gso_size = tcp_sk->mss;
+		}
+		tcp_set_ack_field(skb->h.th, tcp_sk->rem.seq);
+		send_seq_from_sock(tcp_sk, skb);
+	}
+	return sent;
 }
 
 #if MAX_SIMULTANEOUS_TX_PACK > 0
@@ -432,24 +567,18 @@ static inline int tcp_wait_tx_ready(struct sock *sk, int timeout) {
 }
 #endif
 
-#define REM_WIND_MAX_SIZE (1460 * 100) /* FIXME use txqueuelen for netdev */
-static int tcp_sendmsg(struct sock *sk, struct msghdr *msg, int flags) {
-	struct tcp_sock *tcp_sk;
-	size_t len;
-	int ret, timeout;
-
-	(void)flags;
-
-	assert(sk);
-	assert(msg);
+/* Sending is limited by both remote and congestion windows */
+static inline uint32_t tcp_send_wind(const struct tcp_sock *tcp_sk) {
+	return min(tcp_sk->rem.wind.size, tcp_sk->cwnd);
+}
 
-	timeout = timeval_to_ms(&sk->opt.so_sndtimeo);
-	if (timeout == 0) {
-		timeout = SCHED_TIMEOUT_INFINITE;
-	}
+/* Waits until the connection is established and the remote window is open,
+ * returns free space of the window */
+static int tcp_wait_send(struct tcp_sock *tcp_sk, int timeout) {
+	struct sock *sk;
+	int ret;
 
-	tcp_sk = to_tcp_sock(sk);
-	log_debug("sk %p", to_sock(tcp_sk));
+	sk = to_sock(tcp_sk);
 
 sendmsg_again:
 	assert(tcp_sk->state < TCP_MAX_STATE);
@@ -471,8 +600,7 @@ sendmsg_again:
 	case TCP_CLOSEWAIT:
 		sched_lock();
 		{
-			while ((min(tcp_sk->rem.wind.size, REM_WIND_MAX_SIZE)
-						<= tcp_sk->self.seq - tcp_sk->last_ack)
+			while ((tcp_send_wind(tcp_sk) <= tcp_cong_flight(tcp_sk))
 					|| tcp_sk->rexmit_mode) {
 				ret = sock_wait(sk, POLLOUT | POLLERR, timeout);
 				if (ret != 0) {
@@ -480,15 +608,10 @@ sendmsg_again:
 					return ret;
 				}
 			}
+			ret = tcp_send_wind(tcp_sk) - tcp_cong_flight(tcp_sk);
 		}
 		sched_unlock();
-
-		len = tcp_write(tcp_sk, msg->msg_iov->iov_base, msg->msg_iov->iov_len);
-		ret = tcp_wait_tx_ready(sk, timeout);
-		if (0 > ret) {
-			return ret;
-		}
-		return len;
+		return ret;
 	case TCP_FINWAIT_1:
 	case TCP_FINWAIT_2:
 	case TCP_CLOSING:
@@ -498,6 +621,100 @@ sendmsg_again:
 	}
 }
 
+static int tcp_send_timeout(struct sock *sk) {
+	int timeout;
+
+	timeout = timeval_to_ms(&sk->opt.so_sndtimeo);
+	if (timeout == 0) {
+		timeout = SCHED_TIMEOUT_INFINITE;
+	}
+
+	return timeout;
+}
+
+static int tcp_sendmsg(struct sock *sk, struct msghdr *msg, int flags) {
+	struct tcp_sock *tcp_sk;
+	const struct iovec *iov;
+	size_t len, sent, iov_off;
+	int i, ret, timeout;
+
+	assert(sk);
+	assert(msg);
+
+	timeout = tcp_send_timeout(sk);
+
+	tcp_sk = to_tcp_sock(sk);
+	log_debug("sk %p", to_sock(tcp_sk));
+
+	len = 0;
+	for (i = 0; i < msg->msg_iovlen; i++) {
+		len += msg->msg_iov[i].iov_len;
+	}
+
+	iov = msg->msg_iov;
+	iov_off = 0;
+	sent = 0;
+	do {
+		/* Whole message is taken, but no more than the window is in
+		 * flight at once */
+		ret = tcp_wait_send(tcp_sk, timeout);
+		if (ret < 0) {
+			return sent != 0 ? sent : ret;
+		}
+
+		ret = min(len - sent, (size_t)ret);
+		/* Partial segment is held while the rest of message is waited */
+		ret = tcp_write(tcp_sk, &iov, &iov_off, ret,
+				(flags & MSG_MORE) || (sent + ret != len));
+		if (ret == 0) {
+			break;
+		}
+		sent += ret;
+	} while (sent != len);
+
+	ret = tcp_wait_tx_ready(sk, timeout);
+	if (0 > ret) {
+		return ret;
+	}
+	return sent;
+}
+
+static int tcp_sendfile(struct sock *sk, struct idesc *in, size_t count) {
+	struct tcp_sock *tcp_sk;
+	int ret, timeout, len;
+
+	assert(sk);
+	assert(in);
+	assert(in->idesc_ops);
+	assert(in->idesc_ops->id_readv);
+
+	timeout = tcp_send_timeout(sk);
+
+	tcp_sk = to_tcp_sock(sk);
+	log_debug("sk %p count %zu", sk, count);
+
+	ret = tcp_wait_send(tcp_sk, timeout);
+	if (ret < 0) {
+		return ret;
+	}
+
+	/* Data of previous writes goes first */
+	tcp_pend_push(tcp_sk, TCP_PUSH_FORCE);
+
+	/* Unlike sendmsg, file is not a user buffer which must be taken wholly,
+	 * so send no more than the remote window allows and let caller repeat */
+	len = tcp_write_file(tcp_sk, in, min(count, (size_t)ret));
+	if (len < 0) {
+		return len;
+	}
+
+	ret = tcp_wait_tx_ready(sk, timeout);
+	if (0 > ret) {
+		return ret;
+	}
+	return len;
+}
+
 static int tcp_recvmsg(struct sock *sk, struct msghdr *msg,
 		int flags) {
 	struct tcp_sock *tcp_sk;
@@ -542,12 +759,74 @@ static int tcp_shutdown(struct sock *sk, int how) {
 	return 0;
 }
 
+static int tcp_getsockopt(struct sock *sk, int level, int optname,
+			void *optval, socklen_t *optlen) {
+	const char *name;
+	int val;
+
+	switch (optname) {
+	case TCP_NODELAY:
+	case TCP_CORK:
+	case TCP_MAXSEG:
+		val = optname == TCP_NODELAY ? to_tcp_sock(sk)->nodelay
+				: optname == TCP_CORK ? to_tcp_sock(sk)->cork
+				: to_tcp_sock(sk)->mss;
+		*optlen = min(*optlen, (socklen_t)sizeof val);
+		memcpy(optval, &val, *optlen);
+		break;
+	case TCP_CONGESTION:
+		name = to_tcp_sock(sk)->cong->name;
+		*optlen = min(*optlen, (socklen_t)strlen(name) + 1);
+		memcpy(optval, name, *optlen);
+		break;
+	default:
+		return -ENOPROTOOPT;
+	}
+
+	return 0;
+}
+
 static int tcp_setsockopt(struct sock *sk, int level, int optname,
 			const void *optval, socklen_t optlen) {
+	const struct tcp_cong_ops *cong;
+	char name[TCP_CONG_NAME_MAX];
 
 	switch (optname) {
 	case TCP_NODELAY:
-		/* TODO just ignoring for now... */
+	case TCP_CORK:
+		if (optlen != sizeof(int)) {
+			return -EINVAL;
+		}
+		if (optname == TCP_NODELAY) {
+			to_tcp_sock(sk)->nodelay = *(const int *)optval != 0;
+		}
+		else {
+			to_tcp_sock(sk)->cork = *(const int *)optval != 0;
+		}
+		/* Partial segment held by cork is sent when it is removed */
+		if (!to_tcp_sock(sk)->cork) {
+			tcp_pend_push(to_tcp_sock(sk), optname == TCP_CORK
+					? TCP_PUSH_FORCE : TCP_PUSH_NAGLE);
+		}
+		break;
+	case TCP_CONGESTION:
+		/* Name may be not null-terminated */
+		if (optlen >= sizeof name) {
+			return -EINVAL;
+		}
+		memcpy(name, optval, optlen);
+		name[optlen] = '\0';
+
+		cong = tcp_cong_lookup(name);
+		if (cong == NULL) {
+			return -ENOENT;
+		}
+
+		tcp_sock_lock(to_tcp_sock(sk), TCP_SYNC_STATE);
+		{
+			tcp_cong_init(to_tcp_sock(sk), cong, 0);
+		}
+		tcp_sock_unlock(to_tcp_sock(sk), TCP_SYNC_STATE);
 		break;
 	default:
 		return -ENOPROTOOPT;
@@ -566,7 +845,9 @@ static const struct sock_proto_ops tcp_sock_ops_struct = {
 	.listen     = tcp_listen,
 	.accept     = tcp_accept,
 	.sendmsg    = tcp_sendmsg,
+	.sendfile   = tcp_sendfile,
 	.recvmsg    = tcp_recvmsg,
+	.getsockopt = tcp_getsockopt,
 	.setsockopt = tcp_setsockopt,
 	.shutdown   = tcp_shutdown,
 	.sock_pool  = &tcp_sock_pool,
@@ -21,6 +21,8 @@
 #include <net/l3/ipv4/ip.h>
 #include <net/l4/udp.h>
 #include <net/lib/udp.h>
+#include <net/netdevice.h>
+#include <net/skbuff.h>
 #include <net/sock.h>
 #include <net/socket/inet_sock.h>
 
@@ -141,7 +143,13 @@ static int udp_sendmsg(struct sock *sk, struct msghdr *msg, int flags) {
 	err = 0;
 	for (struct sk_buff *skb = skb_queue_pop(&queue); skb; skb = skb_queue_pop(&queue)) {
 		udp_build(skb->h.uh, sk_src, addr_to->sin_port, skb->len - skb_udp_offset);
-		udp4_set_check_field(skb->h.uh, skb->nh.iph);
+		if (skb->dev->features & NETIF_F_HW_CSUM) {
+			udp_set_check_pseudo(skb->h.uh, skb->nh.raw);
+			skb_csum_partial(skb, offsetof(struct udphdr, check));
+		}
+		else {
+			udp4_set_check_field(skb->h.uh, skb->nh.iph);
+		}
 		err = sk->o_ops->snd_pack(skb);
 		if (err < 0) {
 			break;
@@ -11,6 +11,10 @@
 #include <mem/objalloc.h>
 #include <linux/list.h>
 #include <stdio.h>
+#include <hal/ipl.h>
+#include <net/netdevice.h>
+#include <net/l0/net_entry.h>
+#include <util/dlist.h>
 
 #include <pnet/core/prior_path.h>
 #include <pnet/core/core.h>
@@ -27,6 +31,7 @@ EMBOX_UNIT_INIT(unit_init);
 
 static LIST_HEAD(skb_queue);
 static LIST_HEAD(pnet_queue);
+static DLIST_DEFINE(napi_dev_list);
 
 static struct lthread pnet_rx_handler_lt;
 
@@ -54,12 +59,60 @@ int netif_rx(void *data) {
 	return NET_RX_SUCCESS;
 }
 
+void netif_napi_add(struct net_device *dev,
+		int (*poll)(struct net_device *dev, int budget), int weight) {
+	dev->poll = poll;
+	dev->poll_weight = weight > 0 ? weight : 64;
+}
+
+void netif_napi_schedule(struct net_device *dev) {
+	ipl_t ipl;
+
+	ipl = ipl_save();
+	{
+		if (dlist_empty(&dev->rx_lnk)) {
+			dlist_add_prev(&dev->rx_lnk, &napi_dev_list);
+		}
+	}
+	ipl_restore(ipl);
+
+	lthread_launch(&pnet_rx_handler_lt);
+}
+
+void netif_napi_complete(struct net_device *dev) {
+	ipl_t ipl;
+
+	ipl = ipl_save();
+	{
+		dlist_del_init(&dev->rx_lnk);
+	}
+	ipl_restore(ipl);
+}
+
+int netif_receive_skb(struct sk_buff *skb) {
+	return netif_rx(skb);
+}
+
+void netif_receive_skb_list(struct sk_buff_head *list) {
+	struct sk_buff *skb;
+
+	while ((skb = __skb_queue_pop(list)) != NULL) {
+		netif_rx(skb);
+	}
+}
+
 static net_node_t entry;
 
 static int pnet_rx_action(struct lthread *data) {
 	struct pnet_pack *pack, *safe;
 	struct list_head *curr, *n;
 	struct pnet_pack *skb_pack;
+	struct net_device *dev;
+
+	/* Polled packets are queued by netif_receive_skb() and handled below */
+	dlist_foreach_entry(dev, &napi_dev_list, rx_lnk) {
+		dev->poll(dev, dev->poll_weight);
+	}
 
 	list_for_each_entry_safe(pack, safe, &pnet_queue, link) {
 		list_del(&pack->link);
@@ -73,6 +126,10 @@ static int pnet_rx_action(struct lthread *data) {
 		pnet_entry(skb_pack);
 	}
 
+	if (!dlist_empty(&napi_dev_list)) {
+		lthread_launch(data);
+	}
+
 	return 0;
 }
 
@@ -0,0 +1,159 @@
+/**
+ * @file
+ * @brief Tests hits, write back, read-ahead and replacement of buffer cache
+ *   on ramdisk.
+ *
+ * @date 17.10.26
+ */
+
+#include <string.h>
+
+#include <drivers/block_dev.h>
+#include <drivers/block_request.h>
+#include <drivers/block_dev/ramdisk/ramdisk.h>
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <fs/bcache.h>
+#include <mem/page.h>
+#include <util/err.h>
+
+EMBOX_TEST_SUITE("buffer cache test");
+
+TEST_SETUP_SUITE(suite_setup);
+TEST_TEARDOWN_SUITE(suite_teardown);
+
+#define RAMDISK_NAME "/dev/rambc"
+#define BLKSIZE      512
+#define TEST_BLOCKS  4
+
+/* Blocks of the replacement test are after blocks of other tests */
+#define SCAN_START   256
+
+#define WRITE_BACK \
+	OPTION_MODULE_GET(embox__driver__block_common, BOOLEAN, write_back)
+
+static struct block_dev *bdev;
+static int capacity;
+
+static char wr_buf[TEST_BLOCKS * BLKSIZE];
+static char rd_buf[TEST_BLOCKS * BLKSIZE];
+
+static int read_block(int blkno) {
+	return block_dev_read_buffered(bdev, rd_buf, BLKSIZE, blkno * BLKSIZE);
+}
+
+TEST_CASE("Repeated read of block is a hit") {
+	struct bcache_stats before, after;
+
+	test_assert_equal(BLKSIZE, read_block(200));
+
+	bcache_get_stats(&before);
+	test_assert_equal(BLKSIZE, read_block(200));
+	bcache_get_stats(&after);
+
+	test_assert_equal(1, after.hits - before.hits);
+	test_assert_equal(0, after.misses - before.misses);
+}
+
+TEST_CASE("Written blocks are dirty until device is synced") {
+	struct bcache_stats before, after;
+
+	bcache_get_stats(&before);
+	test_assert_equal(sizeof wr_buf,
+			block_dev_write_buffered(bdev, wr_buf, sizeof wr_buf, 0));
+	bcache_get_stats(&after);
+	if (WRITE_BACK) {
+		test_assert(after.dirty >= TEST_BLOCKS);
+	}
+
+	test_assert_zero(block_dev_sync(bdev));
+	bcache_get_stats(&after);
+	test_assert_zero(after.dirty);
+	if (WRITE_BACK) {
+		test_assert(after.writebacks - before.writebacks >= TEST_BLOCKS);
+	}
+
+	/* Device has the data without the cache */
+	memset(rd_buf, 0, sizeof rd_buf);
+	test_assert_zero(block_dev_rw_blocks(bdev, BLOCK_REQ_READ, rd_buf,
+			TEST_BLOCKS, 0));
+	test_assert_zero(memcmp(rd_buf, wr_buf, sizeof wr_buf));
+}
+
+TEST_CASE("Sequential reading reads blocks ahead") {
+	struct bcache_stats before, after;
+	int i;
+
+	bcache_get_stats(&before);
+	for (i = 100; i < 100 + 2 * TEST_BLOCKS; i++) {
+		test_assert_equal(BLKSIZE, read_block(i));
+	}
+	bcache_get_stats(&after);
+
+	test_assert(after.readahead > before.readahead);
+	test_assert(after.readahead_hits > before.readahead_hits);
+	test_assert(after.misses - before.misses < 2 * TEST_BLOCKS);
+}
+
+TEST_CASE("Block accessed again after eviction survives a scan") {
+	struct bcache_stats before, after;
+	int blkno, i;
+
+	/* First access puts the block to the fifo and scan evicts it */
+	test_assert_equal(BLKSIZE, read_block(10));
+	blkno = SCAN_START;
+	for (i = 0; i < capacity + 16; i++) {
+		test_assert_equal(BLKSIZE, read_block(blkno++));
+	}
+
+	/* It's remembered, so the second access makes it frequently used */
+	bcache_get_stats(&before);
+	test_assert_equal(BLKSIZE, read_block(10));
+	bcache_get_stats(&after);
+	test_assert_equal(1, after.misses - before.misses);
+	test_assert(after.lru > 0);
+
+	/* Blocks of another scan are accessed once, they evict each other */
+	blkno += 32;
+	for (i = 0; i < capacity + 32; i++) {
+		test_assert_equal(BLKSIZE, read_block(blkno++));
+	}
+
+	bcache_get_stats(&before);
+	test_assert_equal(BLKSIZE, read_block(10));
+	bcache_get_stats(&after);
+	test_assert_equal(1, after.hits - before.hits);
+}
+
+static int suite_setup(void) {
+	struct bcache_stats stats;
+	struct ramdisk *ramdisk;
+	size_t size;
+	int i;
+
+	for (i = 0; i < sizeof wr_buf; i++) {
+		wr_buf[i] = i * 7 + 1;
+	}
+
+	bcache_get_stats(&stats);
+	capacity = stats.capacity;
+
+	/* Two scans with the read-ahead after them */
+	size = (SCAN_START + 2 * capacity + 128) * BLKSIZE;
+	ramdisk = ramdisk_create(RAMDISK_NAME,
+			(size + PAGE_SIZE() - 1) / PAGE_SIZE() * PAGE_SIZE());
+	if ((ramdisk == NULL) || err(ramdisk)) {
+		return -1;
+	}
+
+	bdev = block_dev_find(RAMDISK_NAME + sizeof("/dev/") - 1);
+	if ((bdev == NULL) || (bdev->block_size != BLKSIZE)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static int suite_teardown(void) {
+	return ramdisk_delete(RAMDISK_NAME);
+}
@@ -0,0 +1,176 @@
+/**
+ * @file
+ * @brief Tests merging, splitting and scheduling of block requests on ramdisk.
+ *
+ * @date 17.10.26
+ */
+
+#include <string.h>
+
+#include <drivers/block_dev.h>
+#include <drivers/block_request.h>
+#include <drivers/block_dev/ramdisk/ramdisk.h>
+#include <embox/test.h>
+#include <mem/page.h>
+#include <util/array.h>
+#include <util/err.h>
+
+EMBOX_TEST_SUITE("block request queue test");
+
+TEST_SETUP_SUITE(suite_setup);
+TEST_TEARDOWN_SUITE(suite_teardown);
+
+#define RAMDISK_NAME  "/dev/ramreq"
+#define RAMDISK_PAGES 16
+#define BLKSIZE       512
+#define TEST_BLOCKS   8
+
+static struct block_dev *bdev;
+
+static char wr_buf[TEST_BLOCKS * BLKSIZE];
+static char rd_buf[TEST_BLOCKS * BLKSIZE];
+
+static blkno_t done_order[TEST_BLOCKS];
+static int done_cnt;
+
+static void test_end_io(struct block_bio *bio, int err) {
+	test_assert_zero(err);
+	done_order[done_cnt++] = bio->blkno;
+}
+
+static void test_bio_init(struct block_bio *bio, int op, blkno_t blkno,
+		char *buf) {
+	bio->op = op;
+	bio->blkno = blkno;
+	bio->nblocks = 1;
+	bio->buf = buf;
+	bio->end_io = test_end_io;
+	bio->priv = NULL;
+}
+
+TEST_CASE("Adjacent bios are merged into one request") {
+	struct block_bio bio[TEST_BLOCKS];
+	unsigned long merges, dispatched;
+	int i;
+
+	merges = bdev->queue->nr_merges;
+	dispatched = bdev->queue->nr_dispatched;
+	done_cnt = 0;
+
+	/* Buffers are in reverse order, so requests have a few bios */
+	block_queue_plug(bdev);
+	for (i = 0; i < TEST_BLOCKS; i++) {
+		test_bio_init(&bio[i], BLOCK_REQ_WRITE, i,
+				wr_buf + (TEST_BLOCKS - 1 - i) * BLKSIZE);
+		block_bio_submit(bdev, &bio[i]);
+	}
+	test_assert_zero(done_cnt);
+	block_queue_unplug(bdev);
+
+	test_assert_equal(TEST_BLOCKS, done_cnt);
+	test_assert_equal(TEST_BLOCKS - 1, bdev->queue->nr_merges - merges);
+	test_assert_equal(1, bdev->queue->nr_dispatched - dispatched);
+
+	memset(rd_buf, 0, sizeof rd_buf);
+	test_assert_zero(block_dev_rw_blocks(bdev, BLOCK_REQ_READ, rd_buf,
+			TEST_BLOCKS, 0));
+	for (i = 0; i < TEST_BLOCKS; i++) {
+		test_assert_zero(memcmp(rd_buf + i * BLKSIZE,
+				wr_buf + (TEST_BLOCKS - 1 - i) * BLKSIZE, BLKSIZE));
+	}
+}
+
+static void test_dispatch_order(const char *sched, const blkno_t *expected) {
+	static const blkno_t blocks[] = { 10, 2, 6 };
+	struct block_bio bio[ARRAY_SIZE(blocks)];
+	int i;
+
+	test_assert_zero(block_queue_set_sched(bdev->queue, sched));
+	bdev->queue->last_pos = 0;
+	done_cnt = 0;
+
+	block_queue_plug(bdev);
+	for (i = 0; i < ARRAY_SIZE(blocks); i++) {
+		test_bio_init(&bio[i], BLOCK_REQ_READ, blocks[i], rd_buf + i * BLKSIZE);
+		block_bio_submit(bdev, &bio[i]);
+	}
+	block_queue_unplug(bdev);
+
+	test_assert_equal(ARRAY_SIZE(blocks), done_cnt);
+	for (i = 0; i < ARRAY_SIZE(blocks); i++) {
+		test_assert_equal(expected[i], done_order[i]);
+	}
+}
+
+TEST_CASE("noop dispatches requests in order of arrival") {
+	static const blkno_t expected[] = { 10, 2, 6 };
+
+	test_dispatch_order("noop", expected);
+}
+
+TEST_CASE("deadline dispatches requests in order of blocks") {
+	static const blkno_t expected[] = { 2, 6, 10 };
+
+	test_dispatch_order("deadline", expected);
+}
+
+TEST_CASE("Unaligned buffered I/O") {
+	size_t len, offset;
+
+	len = sizeof wr_buf - 100;
+	offset = 3 * BLKSIZE + 17;
+
+	test_assert_equal(len, block_dev_write_buffered(bdev, wr_buf, len, offset));
+	memset(rd_buf, 0, sizeof rd_buf);
+	test_assert_equal(len, block_dev_read_buffered(bdev, rd_buf, len, offset));
+	test_assert_zero(memcmp(rd_buf, wr_buf, len));
+}
+
+TEST_CASE("Blocks are split to requests of the maximum size") {
+	size_t max_blocks;
+	unsigned long dispatched;
+
+	max_blocks = bdev->queue->max_blocks;
+	block_queue_set_limits(bdev->queue, bdev->queue->depth, TEST_BLOCKS / 4);
+	dispatched = bdev->queue->nr_dispatched;
+
+	memset(rd_buf, 0, sizeof rd_buf);
+	test_assert_zero(block_dev_rw_blocks(bdev, BLOCK_REQ_WRITE, wr_buf,
+			TEST_BLOCKS, 0));
+	test_assert_zero(block_dev_rw_blocks(bdev, BLOCK_REQ_READ, rd_buf,
+			TEST_BLOCKS, 0));
+	block_queue_set_limits(bdev->queue, bdev->queue->depth, max_blocks);
+
+	test_assert_equal(8, bdev->queue->nr_dispatched - dispatched);
+	test_assert_zero(memcmp(rd_buf, wr_buf, sizeof rd_buf));
+}
+
+TEST_CASE("Flush and discard are completed by ramdisk") {
+	test_assert_zero(block_dev_flush(bdev));
+	test_assert_zero(block_dev_discard(bdev, 0, TEST_BLOCKS));
+}
+
+static int suite_setup(void) {
+	struct ramdisk *ramdisk;
+	int i;
+
+	for (i = 0; i < sizeof wr_buf; i++) {
+		wr_buf[i] = i * 7;
+	}
+
+	ramdisk = ramdisk_create(RAMDISK_NAME, RAMDISK_PAGES * PAGE_SIZE());
+	if ((ramdisk == NULL) || err(ramdisk)) {
+		return -1;
+	}
+
+	bdev = block_dev_find(RAMDISK_NAME + sizeof("/dev/") - 1);
+	if ((bdev == NULL) || (bdev->block_size != BLKSIZE)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static int suite_teardown(void) {
+	return ramdisk_delete(RAMDISK_NAME);
+}
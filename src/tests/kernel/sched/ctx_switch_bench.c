@@ -0,0 +1,78 @@
+/**
+ * @file
+ * @brief Measures context switch cost depending on number of runnable threads
+ *
+ * @details Results are for the run queue strategy selected in the
+ *   configuration, rebuild with another embox.kernel.sched.strategy.runq
+ *   implementation to compare them. Thread pool should be large enough to
+ *   hold thread_max threads.
+ *
+ * @date 17.10.26
+ */
+
+#include <stdio.h>
+
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <kernel/thread.h>
+#include <kernel/thread/thread_flags.h>
+#include <kernel/time/ktime.h>
+#include <util/err.h>
+
+EMBOX_TEST_SUITE("context switch benchmark");
+
+#define THREAD_MAX    OPTION_GET(NUMBER, thread_max)
+#define SWITCH_COUNT  OPTION_GET(NUMBER, switch_count)
+
+static struct thread *bench_threads[THREAD_MAX];
+
+static void *bench_run(void *arg) {
+	int i;
+
+	for (i = 0; i < SWITCH_COUNT; i++) {
+		thread_yield();
+	}
+
+	return NULL;
+}
+
+static void bench_switch(int count) {
+	time64_t start, total_ns;
+	int i;
+
+	test_assert(count <= THREAD_MAX);
+
+	for (i = 0; i < count; i++) {
+		bench_threads[i] = thread_create(THREAD_FLAG_SUSPENDED,
+				bench_run, NULL);
+		test_assert_zero(err(bench_threads[i]));
+	}
+
+	start = ktime_get_ns();
+	for (i = 0; i < count; i++) {
+		test_assert_zero(thread_launch(bench_threads[i]));
+	}
+	for (i = 0; i < count; i++) {
+		test_assert_zero(thread_join(bench_threads[i], NULL));
+	}
+	total_ns = ktime_get_ns() - start;
+
+	printf("\n%d threads: %lld ns per switch\n", count,
+			(long long)(total_ns / ((time64_t)count * SWITCH_COUNT)));
+}
+
+TEST_CASE("switch cost with 1 runnable thread") {
+	bench_switch(1);
+}
+
+TEST_CASE("switch cost with 16 runnable threads") {
+	bench_switch(16);
+}
+
+TEST_CASE("switch cost with 64 runnable threads") {
+	bench_switch(64);
+}
+
+TEST_CASE("switch cost with 256 runnable threads") {
+	bench_switch(THREAD_MAX);
+}
@@ -0,0 +1,161 @@
+/**
+ * @file
+ * @brief Measures timer strategy cost with many armed timers
+ *
+ * @details Results are for the strategy selected in the configuration,
+ *   rebuild with another embox.kernel.timer.strategy implementation to
+ *   compare them. Timers are started on a private instance of the strategy,
+ *   so system timers aren't affected by ticks of the benchmark.
+ *
+ * @date 17.10.26
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <kernel/sched/sched_lock.h>
+#include <kernel/time/ktime.h>
+#include <kernel/time/timer.h>
+
+EMBOX_TEST_SUITE("timer strategy benchmark");
+
+#define TIMER_MAX     OPTION_GET(NUMBER, timer_max)
+#define TICK_COUNT    OPTION_GET(NUMBER, tick_count)
+#define PROBE_COUNT   OPTION_GET(NUMBER, probe_count)
+
+/* Timeouts are spread over this range to hit all levels of the wheels */
+#define TIMEOUT_RANGE (1 << 20)
+
+#define ORDER_TIMERS  300
+
+static struct timer_queue bench_queue;
+static struct sys_timer bench_timers[TIMER_MAX];
+static uint32_t bench_seed;
+
+static void bench_stop(struct sys_timer *tmr) {
+	if (timer_is_started(tmr)) {
+		timer_queue_stop(&bench_queue, tmr);
+	}
+}
+
+/* Same as timer_start() for one-shot timers, but on the private queue */
+static void bench_start(struct sys_timer *tmr, clock_t jiffies) {
+	bench_stop(tmr);
+	tmr->cnt = tmr->load = jiffies + 1;
+	timer_queue_start(&bench_queue, tmr);
+}
+
+static uint32_t bench_rand(void) {
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return bench_seed >> 8;
+}
+
+static int bench_expired;
+
+static void bench_handler(struct sys_timer *tmr, void *param) {
+	bench_expired++;
+}
+
+static void bench_run(int count) {
+	time64_t start, start_ns, probe_ns, tick_ns, stop_ns;
+	struct sys_timer probe;
+	int i;
+
+	if (count > TIMER_MAX) {
+		printf("\n%d timers: skipped, timer_max is %d\n", count, TIMER_MAX);
+		return;
+	}
+
+	bench_seed = count;
+	bench_expired = 0;
+	timer_queue_init(&bench_queue);
+	timer_init(&probe, TIMER_ONESHOT, bench_handler, NULL);
+
+	sched_lock();
+	{
+		start = ktime_get_ns();
+		for (i = 0; i < count; i++) {
+			timer_init(&bench_timers[i], TIMER_ONESHOT,
+					bench_handler, NULL);
+			bench_start(&bench_timers[i],
+					TICK_COUNT + 1 + bench_rand() % TIMEOUT_RANGE);
+		}
+		start_ns = ktime_get_ns() - start;
+
+		start = ktime_get_ns();
+		for (i = 0; i < PROBE_COUNT; i++) {
+			bench_start(&probe, TICK_COUNT + 1 + bench_rand() % TIMEOUT_RANGE);
+			bench_stop(&probe);
+		}
+		probe_ns = ktime_get_ns() - start;
+
+		start = ktime_get_ns();
+		for (i = 0; i < TICK_COUNT; i++) {
+			timer_queue_sched(&bench_queue);
+		}
+		tick_ns = ktime_get_ns() - start;
+
+		start = ktime_get_ns();
+		for (i = 0; i < count; i++) {
+			bench_stop(&bench_timers[i]);
+		}
+		stop_ns = ktime_get_ns() - start;
+	}
+	sched_unlock();
+
+	test_assert_zero(bench_expired);
+
+	printf("\n%d timers: start %lld ns, start+stop %lld ns, "
+			"tick %lld ns, stop %lld ns\n", count,
+			(long long)(start_ns / count),
+			(long long)(probe_ns / PROBE_COUNT),
+			(long long)(tick_ns / TICK_COUNT),
+			(long long)(stop_ns / count));
+}
+
+TEST_CASE("cost with 10 armed timers") {
+	bench_run(10);
+}
+
+TEST_CASE("cost with 1k armed timers") {
+	bench_run(1000);
+}
+
+TEST_CASE("cost with timer_max armed timers") {
+	bench_run(TIMER_MAX);
+}
+
+static int order_tick;
+static int order_fired[ORDER_TIMERS];
+
+static void order_handler(struct sys_timer *tmr, void *param) {
+	order_fired[(uintptr_t)param] = order_tick;
+}
+
+TEST_CASE("timers expire in order of their timeouts across wheel levels") {
+	int i;
+
+	test_assert(ORDER_TIMERS <= TIMER_MAX);
+
+	timer_queue_init(&bench_queue);
+
+	/* Start the latest timer first to not depend on insertion order */
+	for (i = ORDER_TIMERS - 1; i >= 0; i--) {
+		order_fired[i] = 0;
+		timer_init(&bench_timers[i], TIMER_ONESHOT, order_handler,
+				(void *)(uintptr_t)i);
+		bench_start(&bench_timers[i], i + 1);
+	}
+
+	for (order_tick = 1; order_tick <= ORDER_TIMERS + 2; order_tick++) {
+		timer_queue_sched(&bench_queue);
+	}
+
+	for (i = 0; i < ORDER_TIMERS; i++) {
+		test_assert_not_zero(order_fired[i]);
+		/* Every strategy has its own constant rounding of timeout */
+		test_assert_equal(order_fired[i] - i, order_fired[0]);
+	}
+}
@@ -27,3 +27,67 @@ TEST_CASE("Init page_allocator with len < page_size") {
 	allocator =  page_allocator_init(buff, 0x10, 0x100);
 	test_assert_null(allocator);
 }
+
+#define TEST_PAGE_SIZE 0x100
+#define TEST_PAGES     64
+
+static char test_space[(TEST_PAGES + 4) * TEST_PAGE_SIZE];
+
+TEST_CASE("Freed pages are merged back into the largest block") {
+	struct page_allocator *allocator;
+	struct page_stat stat;
+	void *page[TEST_PAGES];
+	size_t largest;
+	int i;
+
+	allocator = page_allocator_init(test_space, sizeof(test_space), TEST_PAGE_SIZE);
+	test_assert_not_null(allocator);
+	test_assert(allocator->pages_n >= TEST_PAGES);
+
+	page_get_stat(allocator, &stat);
+	largest = stat.largest_free;
+	test_assert(largest >= TEST_PAGES);
+
+	for (i = 0; i < TEST_PAGES; i++) {
+		page[i] = page_alloc(allocator, 1 + i % 3);
+		if (page[i] == NULL) {
+			break;
+		}
+		test_assert(page_belong(allocator, page[i]));
+	}
+	while (i--) {
+		page_free(allocator, page[i], 1 + i % 3);
+	}
+
+	/* Pages cached by CPU are returned when they are needed */
+	page[0] = page_alloc(allocator, allocator->pages_n);
+	test_assert_not_null(page[0]);
+	page_free(allocator, page[0], allocator->pages_n);
+
+	page_get_stat(allocator, &stat);
+	test_assert_equal(stat.largest_free, largest);
+	test_assert_equal(stat.free_pages, allocator->pages_n);
+	test_assert_zero(stat.cached_pages);
+}
+
+TEST_CASE("Allocation of not a power of two pages doesn't waste the rest") {
+	struct page_allocator *allocator;
+	void *pages, *rest;
+	size_t free;
+
+	allocator = page_allocator_init(test_space, sizeof(test_space), TEST_PAGE_SIZE);
+	test_assert_not_null(allocator);
+	free = allocator->free;
+
+	pages = page_alloc(allocator, 3);
+	test_assert_not_null(pages);
+	test_assert_equal(allocator->free, free - 3 * TEST_PAGE_SIZE);
+
+	rest = page_alloc(allocator, allocator->pages_n - 3);
+	test_assert_not_null(rest);
+	test_assert_null(page_alloc(allocator, 2));
+
+	page_free(allocator, rest, allocator->pages_n - 3);
+	page_free(allocator, pages, 3);
+	test_assert_equal(allocator->free, free);
+}
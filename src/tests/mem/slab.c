@@ -7,14 +7,19 @@
  * @author Alexander Kalmuk
  */
 
+#include <stdint.h>
+#include <string.h>
+
 #include <embox/test.h>
 #include <mem/misc/slab.h>
+#include <mem/shrinker.h>
 #include <util/dlist.h>
 #include <mem/page.h>
 
 #if 0
 static size_t list_length(struct dlist_head *head);
 #endif
+static int cache_stats_get(const char *name, struct cache_stats *st);
 /* Used to fill slab with one object */
 #define MAX_SIZE (PAGE_SIZE() - 64)
 
@@ -148,6 +153,107 @@ TEST_CASE("Cache's growing.") {
 	cache_destroy(cache);
 #endif
 }
+TEST_CASE("Freed object is kept by CPU and reused") {
+	struct cache_stats before, after;
+	cache_t *cache;
+	void *obj;
+
+	cache = cache_create("test_mag", 64, 0);
+	test_assert_not_null(cache);
+
+	obj = cache_alloc(cache);
+	test_assert_not_null(obj);
+	cache_free(cache, obj);
+
+	test_assert_zero(cache_stats_get("test_mag", &before));
+	test_assert_equal(cache_alloc(cache), obj);
+	test_assert_zero(cache_stats_get("test_mag", &after));
+	test_assert_equal(after.alloc_hits, before.alloc_hits + 1);
+
+	cache_free(cache, obj);
+	cache_destroy(cache);
+}
+
+TEST_CASE("Objects of successive slabs have different colours") {
+	struct cache_stats st;
+	cache_t *cache;
+	void **obj, **prev;
+	size_t offset;
+	int i, coloured;
+
+	cache = cache_create("test_colour", 100, 0);
+	test_assert_not_null(cache);
+	test_assert_zero(cache_stats_get("test_colour", &st));
+	test_assert_zero(st.slab_order);
+	test_assert(st.colour > 1);
+
+	/* Objects of two slabs at least, each one keeps the previous one */
+	prev = NULL;
+	coloured = 0;
+	offset = 0;
+	for (i = 0; i < (int) st.num * 2; i++) {
+		obj = cache_alloc(cache);
+		test_assert_not_null(obj);
+		*obj = prev;
+		prev = obj;
+
+		if (i == 0) {
+			offset = ((uintptr_t) obj % PAGE_SIZE()) % st.obj_size;
+		} else if (((uintptr_t) obj % PAGE_SIZE()) % st.obj_size != offset) {
+			coloured = 1;
+		}
+	}
+	test_assert(coloured);
+
+	while (prev != NULL) {
+		obj = *prev;
+		cache_free(cache, prev);
+		prev = obj;
+	}
+	cache_destroy(cache);
+}
+
+TEST_CASE("Free slabs are reclaimed by shrinker") {
+	struct cache_stats st;
+	cache_t *cache;
+	void *obj;
+
+	cache = cache_create("test_shrink", 64, 0);
+	test_assert_not_null(cache);
+
+	obj = cache_alloc(cache);
+	test_assert_not_null(obj);
+	cache_free(cache, obj);
+
+	test_assert_zero(cache_stats_get("test_shrink", &st));
+	test_assert_equal(st.slabs, 1);
+	test_assert(shrink_count(SHRINK_SLAB) >= st.num);
+
+	test_assert(shrink_caches(SHRINK_SLAB, SHRINK_BATCH) != 0);
+	while (shrink_caches(SHRINK_SLAB, SHRINK_BATCH) != 0) {
+	}
+	test_assert_zero(cache_stats_get("test_shrink", &st));
+	test_assert_zero(st.slabs);
+	test_assert_zero(st.cached);
+
+	cache_destroy(cache);
+}
+
+static int cache_stats_get(const char *name, struct cache_stats *st) {
+	static struct cache_stats all[32];
+	int i, n;
+
+	n = cache_get_stats(all, 32);
+	for (i = 0; (i < n) && (i < 32); i++) {
+		if (0 == strcmp(all[i].name, name)) {
+			memcpy(st, &all[i], sizeof(*st));
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
 #if 0
 static size_t list_length(struct dlist_head *head) {
 	struct dlist_head *pos;
@@ -0,0 +1,123 @@
+/**
+ * @file
+ * @brief Tests of per-thread caches of small heap blocks
+ *
+ * @date 17.10.26
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <embox/test.h>
+#include <kernel/thread.h>
+#include <mem/tcache.h>
+
+#define TEST_BLOCKS 64
+
+EMBOX_TEST_SUITE("Per-thread heap cache test");
+
+TEST_CASE("Freed small block is reused by the next allocation") {
+	struct tcache_stats before, after;
+	void *p, *q;
+
+	p = malloc(40);
+	test_assert_not_null(p);
+	free(p);
+
+	tcache_get_stats(thread_self(), &before);
+	q = malloc(33);
+	tcache_get_stats(thread_self(), &after);
+
+	test_assert_equal(q, p);
+	test_assert_equal(after.alloc_hits, before.alloc_hits + 1);
+
+	free(q);
+}
+
+TEST_CASE("calloc() takes a cached block and clears it") {
+	struct tcache_stats before, after;
+	char *p, *q;
+	int i;
+
+	p = malloc(48);
+	test_assert_not_null(p);
+	memset(p, 0xa5, 48);
+	free(p);
+
+	tcache_get_stats(thread_self(), &before);
+	q = calloc(6, 8);
+	tcache_get_stats(thread_self(), &after);
+
+	test_assert_equal(q, p);
+	test_assert_equal(after.alloc_hits, before.alloc_hits + 1);
+	for (i = 0; i < 48; i++) {
+		test_assert_zero(q[i]);
+	}
+
+	free(q);
+}
+
+TEST_CASE("Small block freed twice is cached once") {
+	void *p, *q, *r;
+
+	p = malloc(40);
+	test_assert_not_null(p);
+	free(p);
+	free(p);
+
+	q = malloc(40);
+	r = malloc(40);
+	test_assert_not_null(q);
+	test_assert_not_null(r);
+	test_assert_not_equal(q, r);
+
+	free(r);
+	free(q);
+}
+
+TEST_CASE("Large blocks bypass the cache") {
+	struct tcache_stats before, after;
+	void *p;
+
+	tcache_get_stats(thread_self(), &before);
+	p = malloc(4096);
+	test_assert_not_null(p);
+	free(p);
+	tcache_get_stats(thread_self(), &after);
+
+	test_assert_equal(after.allocs, before.allocs);
+	test_assert_equal(after.frees, before.frees);
+}
+
+static void *blocks[TEST_BLOCKS];
+
+static void *free_blocks(void *arg) {
+	int i;
+
+	for (i = 0; i < TEST_BLOCKS; i++) {
+		free(blocks[i]);
+	}
+
+	tcache_get_stats(thread_self(), arg);
+
+	return NULL;
+}
+
+TEST_CASE("Blocks can be freed by another thread") {
+	struct tcache_stats st;
+	pthread_t thread;
+	int i;
+
+	for (i = 0; i < TEST_BLOCKS; i++) {
+		blocks[i] = malloc(64);
+		test_assert_not_null(blocks[i]);
+	}
+
+	test_assert_zero(pthread_create(&thread, NULL, free_blocks, &st));
+	test_assert_zero(pthread_join(thread, NULL));
+
+	/* The thread had to flush its cache when it was full and on exit */
+	test_assert_equal(st.frees, TEST_BLOCKS);
+	test_assert(st.flushes > 0);
+}
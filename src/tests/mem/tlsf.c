@@ -0,0 +1,112 @@
+/**
+ * @file
+ * @brief Tests of two-level segregated fit allocator
+ *
+ * @date 17.10.26
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <embox/test.h>
+#include <mem/heap_tlsf.h>
+
+#define TEST_MEM_SIZE 0x10000
+#define TEST_OBJS     64
+
+EMBOX_TEST_SUITE("TLSF allocator test");
+
+TEST_SETUP(case_setup);
+
+static char test_mem[TEST_MEM_SIZE] __attribute__((aligned(16)));
+static char test_mem2[TEST_MEM_SIZE] __attribute__((aligned(16)));
+static struct tlsf *tlsf;
+
+static size_t largest_free(void) {
+	size_t total, free, largest;
+
+	tlsf_get_stat(tlsf, &total, &free, &largest);
+	return largest;
+}
+
+TEST_CASE("Allocated blocks are aligned and don't overlap") {
+	char *obj[TEST_OBJS];
+	int i;
+
+	for (i = 0; i < TEST_OBJS; i++) {
+		obj[i] = tlsf_memalign(tlsf, 0, i + 1);
+		test_assert_not_null(obj[i]);
+		test_assert_zero((uintptr_t) obj[i] % 8);
+		test_assert(tlsf_block_size(obj[i]) >= i + 1);
+		memset(obj[i], i, i + 1);
+	}
+
+	for (i = 0; i < TEST_OBJS; i++) {
+		test_assert_equal(obj[i][0], i);
+		test_assert_equal(obj[i][i], i);
+		tlsf_free(tlsf, obj[i]);
+	}
+}
+
+TEST_CASE("Freed blocks are merged with neighbours") {
+	void *obj[TEST_OBJS];
+	size_t largest;
+	int i;
+
+	largest = largest_free();
+
+	for (i = 0; i < TEST_OBJS; i++) {
+		obj[i] = tlsf_memalign(tlsf, 0, 100 + 10 * i);
+		test_assert_not_null(obj[i]);
+	}
+	/* Holes between used blocks are smaller than the initial block */
+	for (i = 0; i < TEST_OBJS; i += 2) {
+		tlsf_free(tlsf, obj[i]);
+	}
+	test_assert(largest_free() < largest);
+	for (i = 1; i < TEST_OBJS; i += 2) {
+		tlsf_free(tlsf, obj[i]);
+	}
+
+	test_assert_equal(largest_free(), largest);
+	test_assert_null(tlsf_memalign(tlsf, 0, largest + 1));
+	test_assert_not_null(obj[0] = tlsf_memalign(tlsf, 0, largest));
+	tlsf_free(tlsf, obj[0]);
+}
+
+TEST_CASE("Aligned allocation") {
+	void *obj[4];
+	size_t boundary;
+	int i;
+
+	for (i = 0, boundary = 64; i < 4; i++, boundary *= 4) {
+		obj[i] = tlsf_memalign(tlsf, boundary, 24);
+		test_assert_not_null(obj[i]);
+		test_assert_zero((uintptr_t) obj[i] % boundary);
+	}
+	for (i = 0; i < 4; i++) {
+		tlsf_free(tlsf, obj[i]);
+	}
+}
+
+TEST_CASE("Memory of added pool is used when the first one is exhausted") {
+	void *obj, *obj2;
+
+	obj = tlsf_memalign(tlsf, 0, largest_free());
+	test_assert_not_null(obj);
+	test_assert_null(tlsf_memalign(tlsf, 0, 1024));
+
+	test_assert_zero(tlsf_add_pool(tlsf, test_mem2, sizeof(test_mem2)));
+	obj2 = tlsf_memalign(tlsf, 0, 1024);
+	test_assert_not_null(obj2);
+	test_assert((char *) obj2 >= test_mem2);
+	test_assert((char *) obj2 < test_mem2 + sizeof(test_mem2));
+
+	tlsf_free(tlsf, obj2);
+	tlsf_free(tlsf, obj);
+}
+
+static int case_setup(void) {
+	tlsf = tlsf_init(test_mem, sizeof(test_mem));
+	return tlsf ? 0 : -1;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file
+ * @brief Tests of removal of TLSF pools
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <stddef.h>
+
+#include <embox/test.h>
+#include <mem/heap_tlsf.h>
+
+#define TEST_MEM_SIZE 0x10000
+#define TEST_OBJS     64
+
+EMBOX_TEST_SUITE("TLSF pool removal test");
+
+TEST_SETUP(case_setup);
+
+static char test_mem[TEST_MEM_SIZE] __attribute__((aligned(16)));
+static char test_mem2[TEST_MEM_SIZE] __attribute__((aligned(16)));
+static struct tlsf *tlsf;
+
+/* Allocates blocks of 1K until the first pool is exhausted */
+static int exhaust(void **obj) {
+	int i;
+
+	for (i = 0; i < TEST_OBJS; i++) {
+		obj[i] = tlsf_memalign(tlsf, 0, 1024);
+		if (obj[i] == NULL) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+static void release(void **obj, int n) {
+	while (n--) {
+		tlsf_free(tlsf, obj[n]);
+	}
+}
+
+TEST_CASE("Pool is removed only when all its blocks are free") {
+	size_t total, total2, free, largest;
+	void *obj[TEST_OBJS], *obj2;
+	int n;
+
+	n = exhaust(obj);
+	test_assert(n < TEST_OBJS);
+	tlsf_get_stat(tlsf, &total, &free, &largest);
+
+	test_assert_zero(tlsf_add_pool(tlsf, test_mem2, sizeof(test_mem2)));
+	obj2 = tlsf_memalign(tlsf, 0, 1024);
+	test_assert_not_null(obj2);
+	test_assert((char *) obj2 >= test_mem2);
+	test_assert_equal(tlsf_remove_pool(tlsf, test_mem2), -EBUSY);
+
+	tlsf_free(tlsf, obj2);
+	test_assert_zero(tlsf_remove_pool(tlsf, test_mem2));
+
+	tlsf_get_stat(tlsf, &total2, &free, &largest);
+	test_assert_equal(total2, total);
+	test_assert_null(tlsf_memalign(tlsf, 0, 1024));
+
+	release(obj, n);
+}
+
+static int case_setup(void) {
+	tlsf = tlsf_init(test_mem, sizeof(test_mem));
+	return tlsf ? 0 : -1;
+}
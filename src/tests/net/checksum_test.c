@@ -0,0 +1,161 @@
+/**
+ * @file
+ * @brief Tests Internet checksum routines against plain 16-bit loop and
+ *   measures their speed
+ *
+ * @date 17.10.26
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <kernel/time/ktime.h>
+#include <net/skbuff.h>
+#include <net/util/checksum.h>
+
+EMBOX_TEST_SUITE("Internet checksum test");
+
+TEST_SETUP_SUITE(suite_setup);
+
+#define BENCH_COUNT OPTION_GET(NUMBER, bench_count)
+
+#define BUF_SIZE    2048
+
+static unsigned char src_buf[BUF_SIZE + 8];
+static unsigned char dst_buf[BUF_SIZE + 8];
+
+/* The straightforward implementation which is used as the reference */
+static unsigned short ref_sum(const void *addr, int len) {
+	const unsigned char *ptr;
+	unsigned short word;
+	unsigned long sum;
+
+	sum = 0;
+	for (ptr = addr; len > 1; ptr += 2, len -= 2) {
+		memcpy(&word, ptr, sizeof word);
+		sum += word;
+	}
+	if (len == 1) {
+		word = 0;
+		*(unsigned char *)&word = *ptr;
+		sum += word;
+	}
+
+	return fold_short(sum);
+}
+
+TEST_CASE("partial_sum matches reference for all alignments") {
+	int offset, len;
+
+	for (offset = 0; offset < 8; offset++) {
+		for (len = 0; len < 128; len++) {
+			test_assert_equal(ref_sum(src_buf + offset, len),
+					fold_short(partial_sum(src_buf + offset, len)));
+		}
+		test_assert_equal(ref_sum(src_buf + offset, BUF_SIZE),
+				fold_short(partial_sum(src_buf + offset, BUF_SIZE)));
+	}
+}
+
+TEST_CASE("partial_sum doesn't lose carries") {
+	unsigned char ones[BUF_SIZE];
+
+	memset(ones, 0xff, sizeof ones);
+	test_assert_equal(0xffff, fold_short(partial_sum(ones, sizeof ones)));
+	test_assert_equal(ref_sum(ones, sizeof ones - 1),
+			fold_short(partial_sum(ones, sizeof ones - 1)));
+}
+
+TEST_CASE("csum_and_copy copies data and sums it") {
+	int src_off, dst_off, len;
+
+	for (src_off = 0; src_off < 4; src_off++) {
+		for (dst_off = 0; dst_off < 4; dst_off++) {
+			len = BUF_SIZE - 5;
+			memset(dst_buf, 0, sizeof dst_buf);
+			test_assert_equal(ref_sum(src_buf + src_off, len),
+					fold_short(csum_and_copy(dst_buf + dst_off,
+							src_buf + src_off, len)));
+			test_assert_zero(memcmp(dst_buf + dst_off, src_buf + src_off,
+					len));
+		}
+	}
+}
+
+TEST_CASE("csum_block_add combines sums of blocks at odd offset") {
+	int split;
+	unsigned long sum;
+
+	for (split = 0; split < 16; split++) {
+		sum = csum_block_add(partial_sum(src_buf, split),
+				partial_sum(src_buf + split, 100 - split), split);
+		test_assert_equal(ref_sum(src_buf, 100), fold_short(sum));
+	}
+}
+
+TEST_CASE("skb_iovec_buf_csum sums data scattered over iovec") {
+	struct iovec iov[3];
+	unsigned long sum;
+
+	iov[0].iov_base = dst_buf;
+	iov[0].iov_len = 3;
+	iov[1].iov_base = dst_buf + 8;
+	iov[1].iov_len = 101;
+	iov[2].iov_base = dst_buf + 112;
+	iov[2].iov_len = 20;
+
+	/* The last 76 bytes don't fit and are only summed */
+	sum = 0;
+	test_assert_equal(124,
+			skb_iovec_buf_csum(iov, 3, src_buf, 200, &sum));
+	test_assert_equal(ref_sum(src_buf, 200), fold_short(sum));
+	test_assert_zero(memcmp(dst_buf + 8, src_buf + 3, 101));
+}
+
+TEST_CASE("checksum speed") {
+	time64_t start, ref_ns, sum_ns, copy_ns;
+	volatile unsigned short res;
+	int i;
+
+	start = ktime_get_ns();
+	for (i = 0; i < BENCH_COUNT; i++) {
+		res = ref_sum(src_buf, BUF_SIZE);
+	}
+	ref_ns = ktime_get_ns() - start;
+
+	start = ktime_get_ns();
+	for (i = 0; i < BENCH_COUNT; i++) {
+		res = fold_short(partial_sum(src_buf, BUF_SIZE));
+	}
+	sum_ns = ktime_get_ns() - start;
+
+	start = ktime_get_ns();
+	for (i = 0; i < BENCH_COUNT; i++) {
+		res = fold_short(csum_and_copy(dst_buf, src_buf, BUF_SIZE));
+	}
+	copy_ns = ktime_get_ns() - start;
+	(void) res;
+
+	printf("\n%d bytes: 16-bit loop %lld ns, partial_sum %lld ns, "
+			"csum_and_copy %lld ns\n", BUF_SIZE,
+			(long long)(ref_ns / BENCH_COUNT),
+			(long long)(sum_ns / BENCH_COUNT),
+			(long long)(copy_ns / BENCH_COUNT));
+}
+
+static int suite_setup(void) {
+	uint32_t seed;
+	int i;
+
+	seed = 1;
+	for (i = 0; i < sizeof src_buf; i++) {
+		seed = seed * 1103515245 + 12345;
+		src_buf[i] = seed >> 16;
+	}
+
+	return 0;
+}
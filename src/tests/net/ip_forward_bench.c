@@ -0,0 +1,237 @@
+/**
+ * @file
+ * @brief Tests longest prefix match and measures ip_forward() cost with
+ *   many routes
+ *
+ * @details Routes above route_table_size option of embox.net.route are not
+ *   added, set it to 50000 to measure the largest table.
+ *
+ * @date 17.10.26
+ */
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <kernel/sched/sched_lock.h>
+#include <kernel/time/ktime.h>
+#include <net/if.h>
+#include <net/l2/ethernet.h>
+#include <net/l3/arp.h>
+#include <net/l3/ipv4/ip.h>
+#include <net/l3/route.h>
+#include <net/lib/ipv4.h>
+#include <net/netdevice.h>
+#include <net/skbuff.h>
+
+EMBOX_TEST_SUITE("IPv4 FIB and forwarding benchmark");
+
+TEST_SETUP_SUITE(suite_setup);
+TEST_TEARDOWN_SUITE(suite_teardown);
+
+#define PACKET_COUNT OPTION_GET(NUMBER, packet_count)
+
+#define TEST_NET(a, b, c, d) htonl(((a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+#define TEST_MASK(len) htonl((len) ? ~(uint32_t)0 << (32 - (len)) : 0)
+
+static struct net_device *in_dev, *out_dev;
+static int xmit_count;
+
+static int test_xmit(struct net_device *dev, struct sk_buff *skb) {
+	xmit_count++;
+	skb_free(skb);
+	return 0;
+}
+
+static const struct net_driver test_drv_ops = {
+	.xmit = test_xmit,
+};
+
+TEST_CASE("the longest matching prefix wins") {
+	struct rt_entry *rte;
+
+	test_assert_zero(rt_add_route(out_dev, TEST_NET(198, 18, 0, 0),
+			TEST_MASK(15), TEST_NET(192, 168, 0, 8), RTF_GATEWAY));
+	test_assert_zero(rt_add_route(out_dev, TEST_NET(198, 18, 2, 0),
+			TEST_MASK(24), TEST_NET(192, 168, 0, 24), RTF_GATEWAY));
+	test_assert_zero(rt_add_route(out_dev, TEST_NET(198, 18, 0, 0),
+			TEST_MASK(16), TEST_NET(192, 168, 0, 16), RTF_GATEWAY));
+
+	rte = rt_fib_get_best(TEST_NET(198, 18, 2, 3), NULL);
+	test_assert_not_null(rte);
+	test_assert_equal(TEST_NET(192, 168, 0, 24), rte->rt_gateway);
+
+	rte = rt_fib_get_best(TEST_NET(198, 18, 3, 3), NULL);
+	test_assert_not_null(rte);
+	test_assert_equal(TEST_NET(192, 168, 0, 16), rte->rt_gateway);
+
+	rte = rt_fib_get_best(TEST_NET(198, 19, 2, 3), NULL);
+	test_assert_not_null(rte);
+	test_assert_equal(TEST_NET(192, 168, 0, 8), rte->rt_gateway);
+
+	/* System routes may match anything, so look only at test device */
+	test_assert_null(rt_fib_get_best(TEST_NET(198, 20, 2, 3), out_dev));
+	test_assert_null(rt_fib_get_best(TEST_NET(198, 18, 2, 3), in_dev));
+
+	test_assert_zero(rt_del_route(out_dev, TEST_NET(198, 18, 2, 0),
+			TEST_MASK(24), INADDR_ANY));
+	rte = rt_fib_get_best(TEST_NET(198, 18, 2, 3), NULL);
+	test_assert_not_null(rte);
+	test_assert_equal(TEST_NET(192, 168, 0, 16), rte->rt_gateway);
+
+	test_assert_zero(rt_del_route_if(out_dev));
+	test_assert_null(rt_fib_get_best(TEST_NET(198, 18, 2, 3), out_dev));
+}
+
+TEST_CASE("routing table change moves FIB generation") {
+	unsigned int gen;
+
+	gen = rt_fib_gen();
+	test_assert_zero(rt_add_route(out_dev, TEST_NET(198, 18, 0, 0),
+			TEST_MASK(15), INADDR_ANY, 0));
+	test_assert_not_equal(gen, rt_fib_gen());
+
+	gen = rt_fib_gen();
+	test_assert_zero(rt_del_route(out_dev, TEST_NET(198, 18, 0, 0),
+			TEST_MASK(15), INADDR_ANY));
+	test_assert_not_equal(gen, rt_fib_gen());
+}
+
+static uint32_t bench_seed;
+
+static uint32_t bench_rand(void) {
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return bench_seed;
+}
+
+/* Random prefix of length 15..32 in benchmarking network 198.18.0.0/15 */
+static void bench_route(int i, in_addr_t *dst, in_addr_t *mask) {
+	int len;
+
+	bench_seed = i + 1;
+	len = 15 + bench_rand() % 18;
+	*mask = TEST_MASK(len);
+	*dst = (TEST_NET(198, 18, 0, 0) | (htonl(bench_rand() >> 8)
+			& ~TEST_MASK(15))) & *mask;
+}
+
+static struct sk_buff * bench_packet(in_addr_t daddr) {
+	struct sk_buff *skb;
+	size_t len;
+
+	len = ETH_HEADER_SIZE + IP_MIN_HEADER_SIZE + 64;
+	skb = skb_alloc(len);
+	if (skb == NULL) {
+		return NULL;
+	}
+
+	skb->dev = in_dev;
+	skb->nh.raw = skb->mac.raw + ETH_HEADER_SIZE;
+	skb->h.raw = skb->nh.raw + IP_MIN_HEADER_SIZE;
+	ethhdr_build(skb->mac.ethh, in_dev->dev_addr, out_dev->dev_addr, ETH_P_IP);
+	ip_build(skb->nh.iph, len - ETH_HEADER_SIZE, 64, IPPROTO_UDP,
+			TEST_NET(172, 16, 0, 1), daddr);
+	ip_set_check_field(skb->nh.iph);
+
+	return skb;
+}
+
+static void bench_run(int count) {
+	in_addr_t dst, mask;
+	time64_t start, ns;
+	struct sk_buff *skb;
+	int i, added, sent;
+
+	added = 0;
+	for (i = 0; i < count; i++) {
+		bench_route(i, &dst, &mask);
+		if (0 == rt_add_route(out_dev, dst, mask, INADDR_ANY, 0)) {
+			added++;
+		}
+	}
+
+	test_assert_not_zero(added);
+
+	xmit_count = sent = 0;
+	ns = 0;
+	sched_lock();
+	{
+		for (i = 0; i < PACKET_COUNT; i++) {
+			/* Once the table is full, the rest of routes are not added */
+			bench_route(i % added, &dst, &mask);
+			skb = bench_packet(dst | (htonl(bench_rand()) & ~mask));
+			if (skb == NULL) {
+				break;
+			}
+
+			start = ktime_get_ns();
+			ip_forward(skb);
+			ns += ktime_get_ns() - start;
+			sent++;
+		}
+	}
+	sched_unlock();
+
+	rt_del_route_if(out_dev);
+
+	test_assert_equal(PACKET_COUNT, sent);
+	test_assert_equal(sent, xmit_count);
+
+	printf("\n%d routes (%d added): ip_forward %lld ns, forwarded %d/%d\n",
+			count, added, (long long)(ns / PACKET_COUNT), xmit_count, sent);
+}
+
+TEST_CASE("ip_forward cost with 10 routes") {
+	bench_run(10);
+}
+
+TEST_CASE("ip_forward cost with 1k routes") {
+	bench_run(1000);
+}
+
+TEST_CASE("ip_forward cost with 50k routes") {
+	bench_run(50000);
+}
+
+static int test_setup(struct net_device *dev) {
+	return 0;
+}
+
+static struct net_device * test_dev_alloc(const char *name, uint8_t id) {
+	struct net_device *dev;
+
+	dev = netdev_alloc(name, test_setup, 0);
+	if (dev == NULL) {
+		return NULL;
+	}
+
+	dev->type = ARP_HRD_ETHERNET;
+	dev->hdr_len = ETH_HEADER_SIZE;
+	dev->addr_len = ETH_ALEN;
+	dev->mtu = ETH_FRAME_LEN;
+	dev->flags = IFF_UP | IFF_NOARP;
+	dev->ops = &ethernet_ops;
+	dev->drv_ops = &test_drv_ops;
+	memset(dev->dev_addr, 0, ETH_ALEN);
+	dev->dev_addr[ETH_ALEN - 1] = id;
+	memset(dev->broadcast, 0xff, ETH_ALEN);
+
+	return dev;
+}
+
+static int suite_setup(void) {
+	in_dev = test_dev_alloc("fwdin", 1);
+	out_dev = test_dev_alloc("fwdout", 2);
+
+	return (in_dev != NULL) && (out_dev != NULL) ? 0 : -1;
+}
+
+static int suite_teardown(void) {
+	netdev_free(in_dev);
+	netdev_free(out_dev);
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file
+ * @brief Tests budgeted round-robin polling of network devices
+ *
+ * @date 17.10.26
+ */
+
+#include <embox/test.h>
+#include <kernel/sched/sched_lock.h>
+#include <net/l0/net_entry.h>
+#include <net/netdevice.h>
+
+EMBOX_TEST_SUITE("NAPI-like polling test");
+
+TEST_SETUP(case_setup);
+TEST_TEARDOWN(case_teardown);
+
+#define TEST_WEIGHT 4
+#define FLOOD_PACKETS (TEST_WEIGHT * 16)
+#define QUIET_PACKETS (TEST_WEIGHT + 1)
+
+static struct net_device *flood_dev, *quiet_dev;
+
+static int flood_left, quiet_left;
+static int poll_step, quiet_done_step, flood_done_step;
+
+static int test_poll(struct net_device *dev, int budget) {
+	int *left = dev == flood_dev ? &flood_left : &quiet_left;
+	int work;
+
+	poll_step++;
+
+	work = *left < budget ? *left : budget;
+	*left -= work;
+
+	if (work < budget) {
+		if (dev == flood_dev) {
+			flood_done_step = poll_step;
+		} else {
+			quiet_done_step = poll_step;
+		}
+		netif_napi_complete(dev);
+	}
+
+	return work;
+}
+
+TEST_CASE("flooding device doesn't starve another one") {
+	sched_lock();
+	{
+		netif_napi_schedule(flood_dev);
+		netif_napi_schedule(quiet_dev);
+	}
+	sched_unlock();
+
+	test_assert_zero(flood_left);
+	test_assert_zero(quiet_left);
+	test_assert_not_zero(quiet_done_step);
+	test_assert(quiet_done_step < flood_done_step);
+
+	/* Devices are polled in turn, each one gets its weight per turn */
+	test_assert_equal(4, quiet_done_step);
+
+	test_assert_not_zero(flood_dev->stats.rx_polls);
+	test_assert_not_zero(flood_dev->stats.rx_poll_squeezed);
+	test_assert_equal(2, quiet_dev->stats.rx_polls);
+}
+
+static int test_setup(struct net_device *dev) {
+	return 0;
+}
+
+static int case_setup(void) {
+	flood_dev = netdev_alloc("napi0", test_setup, 0);
+	quiet_dev = netdev_alloc("napi1", test_setup, 0);
+	test_assert_not_null(flood_dev);
+	test_assert_not_null(quiet_dev);
+
+	netif_napi_add(flood_dev, test_poll, TEST_WEIGHT);
+	netif_napi_add(quiet_dev, test_poll, TEST_WEIGHT);
+
+	flood_left = FLOOD_PACKETS;
+	quiet_left = QUIET_PACKETS;
+	poll_step = quiet_done_step = flood_done_step = 0;
+
+	return 0;
+}
+
+static int case_teardown(void) {
+	netdev_free(flood_dev);
+	netdev_free(quiet_dev);
+
+	return 0;
+}
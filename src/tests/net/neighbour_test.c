@@ -0,0 +1,184 @@
+/**
+ * @file
+ * @brief Tests neighbour table eviction and states, measures lookup cost
+ *
+ * @details Table size is neighbour_amount option of embox.net.neighbour,
+ *   set it to several thousands to measure lookup in the large table.
+ *
+ * @date 17.10.26
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <kernel/time/ktime.h>
+#include <net/if.h>
+#include <net/l2/ethernet.h>
+#include <net/l3/arp.h>
+#include <net/neighbour.h>
+#include <net/netdevice.h>
+
+EMBOX_TEST_SUITE("neighbour table test");
+
+TEST_SETUP_SUITE(suite_setup);
+TEST_TEARDOWN_SUITE(suite_teardown);
+TEST_TEARDOWN(case_teardown);
+
+#define NEIGHBOUR_AMOUNT \
+	OPTION_MODULE_GET(embox__net__neighbour, NUMBER, neighbour_amount)
+#define LOOKUP_COUNT OPTION_GET(NUMBER, lookup_count)
+
+static struct net_device *test_dev;
+
+static in_addr_t test_paddr(int i) {
+	return htonl(0xc6120000 + i); /* 198.18.0.0/15 */
+}
+
+static void test_haddr(int i, unsigned char *haddr) {
+	memset(haddr, 0, ETH_ALEN);
+	haddr[0] = 0x02;
+	haddr[ETH_ALEN - 2] = i >> 8;
+	haddr[ETH_ALEN - 1] = i;
+}
+
+static int test_add(int i, unsigned int flags) {
+	in_addr_t paddr = test_paddr(i);
+	unsigned char haddr[ETH_ALEN];
+
+	test_haddr(i, haddr);
+	return neighbour_add(ETH_P_IP, &paddr, sizeof paddr, test_dev,
+			ARP_HRD_ETHERNET, haddr, ETH_ALEN, flags);
+}
+
+static int test_get(int i, unsigned char *haddr) {
+	in_addr_t paddr = test_paddr(i);
+
+	return neighbour_get_haddr(ETH_P_IP, &paddr, test_dev,
+			ARP_HRD_ETHERNET, ETH_ALEN, haddr);
+}
+
+static int test_state_of;
+
+static int test_state_get(const struct neighbour *nbr, void *args) {
+	in_addr_t paddr = test_paddr(test_state_of);
+
+	if ((nbr->dev == test_dev)
+			&& (0 == memcmp(nbr->paddr, &paddr, sizeof paddr))) {
+		*(enum neighbour_state *)args = nbr->state;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int test_state(int i, enum neighbour_state *state) {
+	test_state_of = i;
+	return neighbour_foreach(test_state_get, state) == 1 ? 0 : -ENOENT;
+}
+
+TEST_CASE("added entity is resolved and reachable") {
+	unsigned char haddr[ETH_ALEN], expected[ETH_ALEN];
+	enum neighbour_state state;
+
+	test_assert_zero(test_add(1, 0));
+	test_assert_zero(test_get(1, haddr));
+	test_haddr(1, expected);
+	test_assert_mem_equal(expected, haddr, ETH_ALEN);
+
+	test_assert_zero(test_state(1, &state));
+	test_assert_equal(NEIGHBOUR_REACHABLE, state);
+}
+
+TEST_CASE("dynamic update doesn't override permanent entity") {
+	in_addr_t paddr = test_paddr(1);
+	unsigned char haddr[ETH_ALEN], expected[ETH_ALEN];
+
+	test_assert_zero(test_add(1, NEIGHBOUR_FLAG_PERMANENT));
+
+	test_haddr(2, haddr);
+	test_assert_zero(neighbour_add(ETH_P_IP, &paddr, sizeof paddr, test_dev,
+			ARP_HRD_ETHERNET, haddr, ETH_ALEN, 0));
+
+	test_assert_zero(test_get(1, haddr));
+	test_haddr(1, expected);
+	test_assert_mem_equal(expected, haddr, ETH_ALEN);
+}
+
+TEST_CASE("least recently used entity is evicted when table is full") {
+	unsigned char haddr[ETH_ALEN];
+	int i, oldest;
+
+	for (i = 0; i < NEIGHBOUR_AMOUNT; i++) {
+		test_assert_zero(test_add(i, 0));
+	}
+
+	/* Permanent entities of the system may occupy some room */
+	for (oldest = 0; oldest < NEIGHBOUR_AMOUNT - 1; oldest++) {
+		if (0 == test_get(oldest, haddr)) {
+			break;
+		}
+	}
+	test_assert(oldest < NEIGHBOUR_AMOUNT - 2);
+
+	/* Now the oldest one was used recently, so the next one is evicted */
+	test_assert_zero(test_add(NEIGHBOUR_AMOUNT, 0));
+	test_assert_zero(test_get(oldest, haddr));
+	test_assert_equal(-ENOENT, test_get(oldest + 1, haddr));
+	test_assert_zero(test_get(NEIGHBOUR_AMOUNT, haddr));
+}
+
+TEST_CASE("lookup cost with full table") {
+	unsigned char haddr[ETH_ALEN];
+	time64_t start, lookup_ns;
+	int i, added;
+
+	for (i = 0; i < NEIGHBOUR_AMOUNT; i++) {
+		test_assert_zero(test_add(i, 0));
+	}
+	for (added = NEIGHBOUR_AMOUNT; added > 0; added--) {
+		if (0 == test_get(NEIGHBOUR_AMOUNT - added, haddr)) {
+			break;
+		}
+	}
+	test_assert(added > 0);
+
+	start = ktime_get_ns();
+	for (i = 0; i < LOOKUP_COUNT; i++) {
+		test_assert_zero(test_get(NEIGHBOUR_AMOUNT - 1 - i % added, haddr));
+	}
+	lookup_ns = (ktime_get_ns() - start) / LOOKUP_COUNT;
+
+	printf("\n%d entities: lookup %lld ns\n", added, (long long)lookup_ns);
+}
+
+static int test_setup(struct net_device *dev) {
+	return 0;
+}
+
+static int case_teardown(void) {
+	return neighbour_clean(test_dev);
+}
+
+static int suite_setup(void) {
+	test_dev = netdev_alloc("nbrtest", test_setup, 0);
+	if (test_dev == NULL) {
+		return -ENOMEM;
+	}
+
+	test_dev->type = ARP_HRD_ETHERNET;
+	test_dev->addr_len = ETH_ALEN;
+	test_dev->flags = IFF_UP | IFF_NOARP;
+
+	return 0;
+}
+
+static int suite_teardown(void) {
+	netdev_free(test_dev);
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @brief Measures receive path throughput over the loopback
+ *
+ * @details Datagrams are sent in bursts by the thread of priority higher
+ *   than the one of the rx lthread, so the whole burst is received by a
+ *   single poll. Toggle embox.net.net_entry.batch option to compare batched
+ *   and per-packet receive paths.
+ *
+ * @date 17.10.26
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <kernel/sched/schedee_priority.h>
+#include <kernel/thread.h>
+#include <kernel/time/ktime.h>
+#include <net/l2/ethernet.h>
+#include <net/l3/ipv4/ip.h>
+#include <net/l4/udp.h>
+
+EMBOX_TEST_SUITE("receive path benchmark");
+
+TEST_SETUP_SUITE(suite_setup);
+TEST_TEARDOWN_SUITE(suite_teardown);
+
+#define PACKET_COUNT OPTION_GET(NUMBER, packet_count)
+#define BURST        OPTION_GET(NUMBER, burst)
+
+#define PORT 5001
+
+#define HDRS_SIZE (ETH_HEADER_SIZE + IP_MIN_HEADER_SIZE + UDP_HEADER_SIZE)
+
+static int snd_sock, rcv_sock;
+static struct sockaddr_in addr;
+static char buf[ETH_FRAME_LEN];
+static int saved_prio;
+
+static void bench_frames(size_t frame_len) {
+	size_t len = frame_len - HDRS_SIZE;
+	time64_t start, elapsed_ns;
+	int sent, i, burst;
+
+	start = ktime_get_ns();
+	for (sent = 0; sent < PACKET_COUNT; sent += burst) {
+		burst = PACKET_COUNT - sent < BURST ? PACKET_COUNT - sent : BURST;
+
+		for (i = 0; i < burst; i++) {
+			test_assert_equal(len, sendto(snd_sock, buf, len, 0,
+					(struct sockaddr *)&addr, sizeof addr));
+		}
+		/* Blocking here lets the rx lthread receive the whole burst */
+		for (i = 0; i < burst; i++) {
+			test_assert_equal(len, recv(rcv_sock, buf, sizeof buf, 0));
+		}
+	}
+	elapsed_ns = ktime_get_ns() - start;
+
+	test_assert(elapsed_ns > 0);
+	printf("\n%zu-byte frames: %lld packets/s\n", frame_len,
+			(long long)(PACKET_COUNT * 1000000000LL / elapsed_ns));
+}
+
+TEST_CASE("throughput of 64-byte frames") {
+	bench_frames(64);
+}
+
+TEST_CASE("throughput of full-sized frames") {
+	bench_frames(ETH_FRAME_LEN);
+}
+
+static int suite_setup(void) {
+	struct schedee *self = &thread_self()->schedee;
+
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	rcv_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (rcv_sock == -1) {
+		return -1;
+	}
+	if (-1 == bind(rcv_sock, (struct sockaddr *)&addr, sizeof addr)) {
+		close(rcv_sock);
+		return -1;
+	}
+
+	snd_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (snd_sock == -1) {
+		close(rcv_sock);
+		return -1;
+	}
+
+	saved_prio = schedee_priority_get(self);
+	schedee_priority_set(self, SCHED_PRIORITY_MAX);
+
+	return 0;
+}
+
+static int suite_teardown(void) {
+	schedee_priority_set(&thread_self()->schedee, saved_prio);
+
+	close(snd_sock);
+	close(rcv_sock);
+
+	return 0;
+}
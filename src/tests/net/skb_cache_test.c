@@ -0,0 +1,97 @@
+/**
+ * @file
+ * @brief Tests per-CPU skb caches and measures skb allocation cost
+ *
+ * @date 17.10.26
+ */
+
+#include <stdio.h>
+
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <hal/cpu.h>
+#include <kernel/sched/sched_lock.h>
+#include <kernel/time/ktime.h>
+#include <net/skbuff.h>
+
+EMBOX_TEST_SUITE("skb per-CPU cache test");
+
+#define ALLOC_COUNT OPTION_GET(NUMBER, alloc_count)
+#define BURST       OPTION_GET(NUMBER, burst)
+
+static struct sk_buff *test_skbs[BURST];
+
+static unsigned long test_hits(void) {
+	struct skb_cache_stats skb_st, data_st;
+
+	skb_get_cache_stats(cpu_get_id(), &skb_st);
+	skb_data_get_cache_stats(cpu_get_id(), &data_st);
+
+	return skb_st.alloc_hits + data_st.alloc_hits;
+}
+
+TEST_CASE("freed skb is reused from CPU cache") {
+	struct skb_cache_stats before, after;
+	struct sk_buff *skb;
+
+	/* Stay on the same CPU */
+	sched_lock();
+	{
+		skb = skb_alloc(skb_max_size());
+		if (skb != NULL) {
+			skb_free(skb);
+		}
+
+		skb_get_cache_stats(cpu_get_id(), &before);
+		skb = skb_alloc(skb_max_size());
+		skb_get_cache_stats(cpu_get_id(), &after);
+		if (skb != NULL) {
+			skb_free(skb);
+		}
+	}
+	sched_unlock();
+
+	test_assert_not_null(skb);
+	if (before.cached == 0) {
+		/* Cache is turned off or limited to nothing by a small pool */
+		return;
+	}
+	test_assert_equal(before.allocs + 1, after.allocs);
+	test_assert_equal(before.alloc_hits + 1, after.alloc_hits);
+	test_assert_equal(before.depleted, after.depleted);
+}
+
+TEST_CASE("allocation cost for bursts of skbs") {
+	time64_t start, ns;
+	unsigned long hits;
+	int i, j, failed;
+
+	failed = 0;
+	sched_lock();
+	{
+		hits = test_hits();
+		start = ktime_get_ns();
+		for (i = 0; i < ALLOC_COUNT / BURST; i++) {
+			for (j = 0; j < BURST; j++) {
+				test_skbs[j] = skb_alloc(skb_max_size());
+			}
+			for (j = 0; j < BURST; j++) {
+				if (test_skbs[j] == NULL) {
+					failed++;
+					continue;
+				}
+				skb_free(test_skbs[j]);
+			}
+		}
+		ns = ktime_get_ns() - start;
+		hits = test_hits() - hits;
+	}
+	sched_unlock();
+
+	test_assert_zero(failed);
+
+	/* Both skb and its data are counted in hits */
+	printf("\nbursts of %d: alloc+free %lld ns per skb, cache hits %lu%%\n",
+			BURST, (long long)(ns / (ALLOC_COUNT / BURST * BURST)),
+			hits * 50 / (ALLOC_COUNT / BURST * BURST));
+}
@@ -0,0 +1,149 @@
+/**
+ * @file
+ * @brief Measures per-packet socket demultiplexing cost with many sockets
+ *
+ * @date 17.10.26
+ */
+
+#include <arpa/inet.h>
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <kernel/time/ktime.h>
+#include <net/sock.h>
+#include <net/socket/inet_sock.h>
+#include <util/dlist.h>
+
+EMBOX_TEST_SUITE("socket hash lookup test");
+
+TEST_SETUP_SUITE(suite_setup);
+TEST_TEARDOWN_SUITE(suite_teardown);
+
+#define SOCK_QUANTITY OPTION_GET(NUMBER, sock_quantity)
+#define LOOKUP_COUNT  OPTION_GET(NUMBER, lookup_count)
+
+#define LOCAL_PORT 80
+#define PEER_PORT_BASE 1024
+
+static struct inet_sock test_socks[SOCK_QUANTITY];
+static DLIST_DEFINE(test_sock_list);
+static const struct sock_proto_ops test_sock_ops = {
+	.sock_list = &test_sock_list
+};
+
+static struct inet_sock *test_peer;
+
+static int test_tester(const struct sock *sk, const struct sk_buff *skb) {
+	const struct inet_sock *in_sk = to_const_inet_sock(sk);
+
+	return (in_sk->src_in.sin_port == test_peer->src_in.sin_port)
+			&& (in_sk->dst_in.sin_port == test_peer->dst_in.sin_port)
+			&& (in_sk->dst_in.sin_addr.s_addr
+				== test_peer->dst_in.sin_addr.s_addr);
+}
+
+static struct sock * test_lookup_list(struct inet_sock *peer) {
+	test_peer = peer;
+	return sock_lookup(NULL, &test_sock_ops, test_tester, NULL);
+}
+
+static struct sock * test_lookup_hash(struct inet_sock *peer) {
+	test_peer = peer;
+	return sock_lookup_conn(&test_sock_ops, test_tester, NULL,
+			peer->src_in.sin_port, peer->dst_in.sin_port,
+			&peer->dst_in.sin_addr, sizeof peer->dst_in.sin_addr);
+}
+
+static time64_t test_measure(struct sock *(*lookup)(struct inet_sock *)) {
+	time64_t start;
+	int i;
+	struct inet_sock *peer;
+
+	start = ktime_get_ns();
+	for (i = 0; i < LOOKUP_COUNT; i++) {
+		peer = &test_socks[(i * 7919) % SOCK_QUANTITY];
+		if (lookup(peer) != &peer->sk) {
+			return -1;
+		}
+	}
+
+	return (ktime_get_ns() - start) / LOOKUP_COUNT;
+}
+
+TEST_CASE("every connected socket is found by its 4-tuple") {
+	int i;
+
+	for (i = 0; i < SOCK_QUANTITY; i++) {
+		test_assert_equal(&test_socks[i].sk, test_lookup_hash(&test_socks[i]));
+	}
+}
+
+TEST_CASE("rehashed socket is found only by its new 4-tuple") {
+	struct inet_sock *in_sk = &test_socks[0];
+	struct inet_sock old = *in_sk;
+
+	in_sk->dst_in.sin_port = htons(PEER_PORT_BASE - 1);
+	sock_rehash(&in_sk->sk);
+
+	test_assert_equal(&in_sk->sk, test_lookup_hash(in_sk));
+	test_assert_null(test_lookup_hash(&old));
+
+	in_sk->dst_in.sin_port = old.dst_in.sin_port;
+	sock_rehash(&in_sk->sk);
+	test_assert_equal(&in_sk->sk, test_lookup_hash(in_sk));
+}
+
+TEST_CASE("per-packet lookup cost for many sockets") {
+	time64_t list_ns, hash_ns;
+
+	list_ns = test_measure(test_lookup_list);
+	hash_ns = test_measure(test_lookup_hash);
+	test_assert(list_ns >= 0);
+	test_assert(hash_ns >= 0);
+
+	printf("\n%d sockets: list lookup %lld ns, hash lookup %lld ns\n",
+			SOCK_QUANTITY, (long long)list_ns, (long long)hash_ns);
+}
+
+static int suite_setup(void) {
+	int i;
+	struct inet_sock *in_sk;
+
+	for (i = 0; i < SOCK_QUANTITY; i++) {
+		in_sk = &test_socks[i];
+		memset(in_sk, 0, sizeof *in_sk);
+
+		dlist_head_init(&in_sk->sk.lnk);
+		dlist_head_init(&in_sk->sk.hash_lnk);
+		in_sk->sk.opt.so_domain = AF_INET;
+		in_sk->sk.p_ops = &test_sock_ops;
+		in_sk->sk.src_addr = (const struct sockaddr *)&in_sk->src_in;
+		in_sk->sk.dst_addr = (const struct sockaddr *)&in_sk->dst_in;
+		in_sk->sk.addr_len = sizeof(struct sockaddr_in);
+
+		in_sk->src_in.sin_family = AF_INET;
+		in_sk->src_in.sin_port = htons(LOCAL_PORT);
+		in_sk->src_in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		in_sk->dst_in.sin_family = AF_INET;
+		in_sk->dst_in.sin_port = htons(PEER_PORT_BASE + i % 4096);
+		in_sk->dst_in.sin_addr.s_addr = htonl(0x0a000000 + i / 4096);
+
+		sock_hash(&in_sk->sk);
+	}
+
+	return 0;
+}
+
+static int suite_teardown(void) {
+	int i;
+
+	for (i = 0; i < SOCK_QUANTITY; i++) {
+		sock_unhash(&test_socks[i].sk);
+	}
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file
+ * @brief Tests TCP congestion control selection and measures goodput over
+ *   loopback with injected loss
+ *
+ * @details Every loss_period-th segment sent to the server is dropped by
+ *   netfilter rule on the input chain.
+ *
+ * @date 17.10.26
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <kernel/thread.h>
+#include <kernel/time/ktime.h>
+#include <net/netfilter.h>
+#include <util/err.h>
+
+EMBOX_TEST_SUITE("TCP congestion control test");
+
+TEST_SETUP_SUITE(suite_setup);
+TEST_TEARDOWN_SUITE(suite_teardown);
+
+#define DATA_SIZE   OPTION_GET(NUMBER, data_size)
+#define LOSS_PERIOD OPTION_GET(NUMBER, loss_period)
+
+#define PORT       5201
+#define CHUNK_SIZE 8192
+
+static int l;
+static struct sockaddr_in addr;
+
+static char send_buf[CHUNK_SIZE];
+static char recv_buf[CHUNK_SIZE];
+
+static int loss_enabled;
+static unsigned int loss_seen, loss_dropped;
+
+static int loss_test_hnd(const struct nf_rule *r, void *data) {
+	if (!loss_enabled) {
+		return 0;
+	}
+
+	if (++loss_seen % LOSS_PERIOD == 0) {
+		loss_dropped++;
+		return 1;
+	}
+
+	return 0;
+}
+
+static void *receiver_run(void *arg) {
+	int fd = (intptr_t)arg;
+	size_t received;
+	ssize_t ret;
+
+	received = 0;
+	while (received < DATA_SIZE) {
+		ret = recv(fd, recv_buf, sizeof recv_buf, 0);
+		if (ret <= 0) {
+			break;
+		}
+		received += ret;
+	}
+
+	return (void *)(uintptr_t)received;
+}
+
+static int test_connect(const char *cong, int *out_c, int *out_a) {
+	int c, a;
+
+	c = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (c < 0) {
+		return -1;
+	}
+
+	if ((0 != setsockopt(c, IPPROTO_TCP, TCP_CONGESTION, cong, strlen(cong)))
+			|| (0 != connect(c, (struct sockaddr *)&addr, sizeof addr))) {
+		close(c);
+		return -1;
+	}
+
+	a = accept(l, NULL, NULL);
+	if (a < 0) {
+		close(c);
+		return -1;
+	}
+
+	*out_c = c;
+	*out_a = a;
+	return 0;
+}
+
+static void test_goodput(const char *cong) {
+	struct thread *receiver;
+	void *received;
+	time64_t start, total_ns;
+	size_t sent;
+	int c, a;
+
+	test_assert_zero(test_connect(cong, &c, &a));
+
+	receiver = thread_create(0, receiver_run, (void *)(intptr_t)a);
+	test_assert_zero(err(receiver));
+
+	loss_seen = loss_dropped = 0;
+	loss_enabled = 1;
+
+	start = ktime_get_ns();
+	for (sent = 0; sent < DATA_SIZE; sent += CHUNK_SIZE) {
+		test_assert_equal(CHUNK_SIZE, send(c, send_buf, CHUNK_SIZE, 0));
+	}
+	test_assert_zero(thread_join(receiver, &received));
+	total_ns = ktime_get_ns() - start;
+
+	loss_enabled = 0;
+
+	test_assert_equal(DATA_SIZE, (uintptr_t)received);
+	test_assert_not_zero(loss_dropped);
+
+	printf("\n%s: %lld KB/s, %u of %u segments dropped\n", cong,
+			(long long)((time64_t)DATA_SIZE * 1000000 / 1024
+				/ (total_ns / 1000 + 1)),
+			loss_dropped, loss_seen);
+
+	close(a);
+	close(c);
+}
+
+TEST_CASE("TCP_CONGESTION selects and reports algorithm") {
+	char name[16];
+	socklen_t len;
+	int s;
+
+	s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	test_assert(s >= 0);
+
+	len = sizeof name;
+	test_assert_zero(getsockopt(s, IPPROTO_TCP, TCP_CONGESTION, name, &len));
+	test_assert_zero(strcmp("newreno", name));
+
+	test_assert_zero(setsockopt(s, IPPROTO_TCP, TCP_CONGESTION, "cubic",
+			strlen("cubic")));
+	len = sizeof name;
+	test_assert_zero(getsockopt(s, IPPROTO_TCP, TCP_CONGESTION, name, &len));
+	test_assert_zero(strcmp("cubic", name));
+
+	test_assert_equal(-1, setsockopt(s, IPPROTO_TCP, TCP_CONGESTION, "none",
+			strlen("none")));
+	test_assert_equal(ENOENT, errno);
+
+	close(s);
+}
+
+TEST_CASE("NewReno goodput with loss") {
+	test_goodput("newreno");
+}
+
+TEST_CASE("CUBIC goodput with loss") {
+	test_goodput("cubic");
+}
+
+static int suite_setup(void) {
+	struct nf_rule rule;
+	int i;
+
+	for (i = 0; i < CHUNK_SIZE; i++) {
+		send_buf[i] = i;
+	}
+
+	nf_rule_init(&rule);
+	rule.target = NF_TARGET_DROP;
+	NF_SET_NOT_FIELD(&rule, proto, 0, NF_PROTO_TCP);
+	NF_SET_NOT_FIELD(&rule, dport, 0, htons(PORT));
+	rule.test_hnd = loss_test_hnd;
+	if (0 != nf_insert_rule(NF_CHAIN_INPUT, &rule, 0)) {
+		return -1;
+	}
+
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	l = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (l < 0) {
+		return -1;
+	}
+
+	if ((0 != bind(l, (struct sockaddr *)&addr, sizeof addr))
+			|| (0 != listen(l, 1))) {
+		close(l);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int suite_teardown(void) {
+	close(l);
+
+	return nf_del_rule(NF_CHAIN_INPUT, 0);
+}
@@ -0,0 +1,165 @@
+/**
+ * @file
+ * @brief Tests TCP receive of out-of-order segments and recovery with
+ *   selective acknowledgments over loopback with injected loss
+ *
+ * @details Every loss_period-th segment sent to the server is dropped by
+ *   netfilter rule on the input chain, so the segments after it are
+ *   received out of order.
+ *
+ * @date 17.10.26
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <kernel/thread.h>
+#include <kernel/time/ktime.h>
+#include <net/netfilter.h>
+#include <util/err.h>
+
+EMBOX_TEST_SUITE("TCP SACK and out-of-order queue test");
+
+TEST_SETUP_SUITE(suite_setup);
+TEST_TEARDOWN_SUITE(suite_teardown);
+
+#define DATA_SIZE   OPTION_GET(NUMBER, data_size)
+#define LOSS_PERIOD OPTION_GET(NUMBER, loss_period)
+
+#define PORT       5202
+#define CHUNK_SIZE 4096
+
+static int l;
+static struct sockaddr_in addr;
+
+static unsigned char send_buf[CHUNK_SIZE];
+static unsigned char recv_buf[CHUNK_SIZE];
+
+static int loss_enabled;
+static unsigned int loss_seen, loss_dropped;
+
+static int loss_test_hnd(const struct nf_rule *r, void *data) {
+	if (!loss_enabled) {
+		return 0;
+	}
+
+	if (++loss_seen % LOSS_PERIOD == 0) {
+		loss_dropped++;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Byte at @a off of the stream */
+static unsigned char stream_byte(size_t off) {
+	return (off * 7 + off / CHUNK_SIZE) & 0xFF;
+}
+
+/* Returns amount of received bytes which are equal to the sent ones */
+static void *receiver_run(void *arg) {
+	int fd = (intptr_t)arg;
+	size_t received;
+	ssize_t ret, i;
+
+	received = 0;
+	while (received < DATA_SIZE) {
+		ret = recv(fd, recv_buf, sizeof recv_buf, 0);
+		if (ret <= 0) {
+			break;
+		}
+		for (i = 0; i < ret; i++) {
+			if (recv_buf[i] != stream_byte(received + i)) {
+				return (void *)(uintptr_t)(received + i);
+			}
+		}
+		received += ret;
+	}
+
+	return (void *)(uintptr_t)received;
+}
+
+TEST_CASE("stream is received intact with loss") {
+	struct thread *receiver;
+	void *received;
+	time64_t start, total_ns;
+	size_t sent, i;
+	int c, a;
+
+	c = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	test_assert(c >= 0);
+	test_assert_zero(connect(c, (struct sockaddr *)&addr, sizeof addr));
+	a = accept(l, NULL, NULL);
+	test_assert(a >= 0);
+
+	receiver = thread_create(0, receiver_run, (void *)(intptr_t)a);
+	test_assert_zero(err(receiver));
+
+	loss_seen = loss_dropped = 0;
+	loss_enabled = 1;
+
+	start = ktime_get_ns();
+	for (sent = 0; sent < DATA_SIZE; sent += CHUNK_SIZE) {
+		for (i = 0; i < CHUNK_SIZE; i++) {
+			send_buf[i] = stream_byte(sent + i);
+		}
+		test_assert_equal(CHUNK_SIZE, send(c, send_buf, CHUNK_SIZE, 0));
+	}
+	test_assert_zero(thread_join(receiver, &received));
+	total_ns = ktime_get_ns() - start;
+
+	loss_enabled = 0;
+
+	test_assert_equal(DATA_SIZE, (uintptr_t)received);
+	test_assert_not_zero(loss_dropped);
+
+	printf("\n%lld KB/s, %u of %u segments dropped\n",
+			(long long)((time64_t)DATA_SIZE * 1000000 / 1024
+				/ (total_ns / 1000 + 1)),
+			loss_dropped, loss_seen);
+
+	close(a);
+	close(c);
+}
+
+static int suite_setup(void) {
+	struct nf_rule rule;
+
+	nf_rule_init(&rule);
+	rule.target = NF_TARGET_DROP;
+	NF_SET_NOT_FIELD(&rule, proto, 0, NF_PROTO_TCP);
+	NF_SET_NOT_FIELD(&rule, dport, 0, htons(PORT));
+	rule.test_hnd = loss_test_hnd;
+	if (0 != nf_insert_rule(NF_CHAIN_INPUT, &rule, 0)) {
+		return -1;
+	}
+
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	l = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (l < 0) {
+		return -1;
+	}
+
+	if ((0 != bind(l, (struct sockaddr *)&addr, sizeof addr))
+			|| (0 != listen(l, 1))) {
+		close(l);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int suite_teardown(void) {
+	close(l);
+
+	return nf_del_rule(NF_CHAIN_INPUT, 0);
+}
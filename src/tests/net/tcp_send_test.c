@@ -0,0 +1,117 @@
+/**
+ * @file
+ * @brief Tests TCP send path: segment size, TCP_CORK and vectored send
+ *
+ * @date 17.10.26
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <embox/test.h>
+
+EMBOX_TEST_SUITE("TCP send path test");
+
+TEST_SETUP(case_setup);
+TEST_TEARDOWN(case_teardown);
+
+#define PORT 5203
+
+#define IOV_PART 7000
+
+static int l, c, a;
+static struct sockaddr_in addr;
+
+static char send_buf[3 * IOV_PART];
+static char recv_buf[3 * IOV_PART];
+
+TEST_CASE("TCP_MAXSEG reports MSS of loopback") {
+	int mss;
+	socklen_t len;
+
+	len = sizeof mss;
+	test_assert_zero(getsockopt(c, IPPROTO_TCP, TCP_MAXSEG, &mss, &len));
+	/* Loopback MTU without IP and TCP headers */
+	test_assert_equal(16 * 1024 + 12, mss);
+}
+
+TEST_CASE("corked partial segment is sent on uncork") {
+	int on, off;
+
+	on = 1;
+	off = 0;
+	test_assert_zero(setsockopt(c, IPPROTO_TCP, TCP_CORK, &on, sizeof on));
+	test_assert_equal(10, send(c, send_buf, 10, 0));
+
+	test_assert_zero(fcntl(a, F_SETFD, O_NONBLOCK));
+	test_assert_equal(-1, recv(a, recv_buf, sizeof recv_buf, 0));
+	test_assert_equal(EAGAIN, errno);
+
+	test_assert_zero(setsockopt(c, IPPROTO_TCP, TCP_CORK, &off, sizeof off));
+	test_assert_equal(10, recv(a, recv_buf, sizeof recv_buf, 0));
+	test_assert_mem_equal(send_buf, recv_buf, 10);
+}
+
+TEST_CASE("all buffers of writev() are sent") {
+	struct iovec iov[3];
+	size_t received;
+	ssize_t ret;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		iov[i].iov_base = send_buf + i * IOV_PART;
+		iov[i].iov_len = IOV_PART - i; /* not multiples of MSS */
+	}
+	test_assert_equal(3 * IOV_PART - 3, writev(c, iov, 3));
+
+	received = 0;
+	while (received < 3 * IOV_PART - 3) {
+		ret = recv(a, recv_buf + received, sizeof recv_buf - received, 0);
+		test_assert(ret > 0);
+		received += ret;
+	}
+
+	test_assert_mem_equal(send_buf, recv_buf, IOV_PART);
+	test_assert_mem_equal(send_buf + IOV_PART, recv_buf + IOV_PART,
+			IOV_PART - 1);
+	test_assert_mem_equal(send_buf + 2 * IOV_PART, recv_buf + 2 * IOV_PART - 1,
+			IOV_PART - 2);
+}
+
+static int case_setup(void) {
+	int i;
+
+	for (i = 0; i < sizeof send_buf; i++) {
+		send_buf[i] = i * 13;
+	}
+
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	l = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	c = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if ((l < 0) || (c < 0)
+			|| (0 != bind(l, (struct sockaddr *)&addr, sizeof addr))
+			|| (0 != listen(l, 1))
+			|| (0 != connect(c, (struct sockaddr *)&addr, sizeof addr))) {
+		return -1;
+	}
+
+	a = accept(l, NULL, NULL);
+	return a < 0 ? -1 : 0;
+}
+
+static int case_teardown(void) {
+	close(a);
+	close(c);
+	close(l);
+	return 0;
+}
@@ -0,0 +1,264 @@
+/**
+ * @file
+ * @brief Tests for epoll and comparison of it with poll().
+ *
+ * @details Benchmark waits for one ready eventfd among n descriptors.
+ *   Numbers of descriptors which don't fit to descriptor table are skipped.
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <embox/test.h>
+#include <framework/mod/options.h>
+#include <kernel/task/resource/idesc_table.h>
+#include <kernel/time/ktime.h>
+#include <util/array.h>
+
+EMBOX_TEST_SUITE("epoll suite");
+
+#define BENCH_ITERATIONS OPTION_GET(NUMBER, bench_iterations)
+
+/* Descriptors which can be already opened by the test environment */
+#define BENCH_RESERVED_FDS 8
+
+static const int bench_sizes[] = { 10, 100, 1000, 10000 };
+
+static int bench_fds[MODOPS_IDESC_TABLE_SIZE];
+static struct pollfd bench_pfds[MODOPS_IDESC_TABLE_SIZE];
+
+static int epoll_add(int epfd, int fd, uint32_t events) {
+	struct epoll_event ev;
+
+	ev.events = events;
+	ev.data.fd = fd;
+	return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+TEST_CASE("epoll_ctl reports errors") {
+	struct epoll_event ev;
+	int epfd, fd;
+
+	epfd = epoll_create1(0);
+	test_assert(epfd >= 0);
+	fd = eventfd(0, EFD_NONBLOCK);
+	test_assert(fd >= 0);
+
+	test_assert_equal(-1, epoll_ctl(fd, EPOLL_CTL_ADD, epfd, &ev));
+	test_assert_equal(EINVAL, errno);
+	test_assert_equal(-1, epoll_add(epfd, epfd, EPOLLIN));
+	test_assert_equal(EINVAL, errno);
+	test_assert_equal(-1, epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL));
+	test_assert_equal(ENOENT, errno);
+
+	test_assert_zero(epoll_add(epfd, fd, EPOLLIN));
+	test_assert_equal(-1, epoll_add(epfd, fd, EPOLLIN));
+	test_assert_equal(EEXIST, errno);
+
+	test_assert_equal(-1, epoll_create1(~EPOLL_CLOEXEC));
+	test_assert_equal(EINVAL, errno);
+
+	close(fd);
+	close(epfd);
+}
+
+TEST_CASE("Level-triggered descriptor is reported until it's drained") {
+	struct epoll_event ev;
+	eventfd_t value;
+	int epfd, fd;
+
+	epfd = epoll_create1(0);
+	test_assert(epfd >= 0);
+	fd = eventfd(0, EFD_NONBLOCK);
+	test_assert(fd >= 0);
+
+	test_assert_zero(epoll_add(epfd, fd, EPOLLIN));
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 0));
+
+	test_assert_zero(eventfd_write(fd, 1));
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+	test_assert_equal(EPOLLIN, ev.events);
+	test_assert_equal(fd, ev.data.fd);
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+
+	test_assert_zero(eventfd_read(fd, &value));
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 0));
+
+	close(fd);
+	close(epfd);
+}
+
+TEST_CASE("Edge-triggered descriptor is reported once per event") {
+	struct epoll_event ev;
+	int epfd, fd;
+
+	epfd = epoll_create1(0);
+	test_assert(epfd >= 0);
+	fd = eventfd(0, EFD_NONBLOCK);
+	test_assert(fd >= 0);
+
+	test_assert_zero(epoll_add(epfd, fd, EPOLLIN | EPOLLET));
+
+	test_assert_zero(eventfd_write(fd, 1));
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 0));
+
+	test_assert_zero(eventfd_write(fd, 1));
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 0));
+
+	close(fd);
+	close(epfd);
+}
+
+TEST_CASE("Nested epoll descriptors can't make a loop") {
+	int epfd1, epfd2, epfd3;
+
+	epfd1 = epoll_create1(0);
+	test_assert(epfd1 >= 0);
+	epfd2 = epoll_create1(0);
+	test_assert(epfd2 >= 0);
+	epfd3 = epoll_create1(0);
+	test_assert(epfd3 >= 0);
+
+	test_assert_zero(epoll_add(epfd1, epfd2, EPOLLIN));
+	test_assert_zero(epoll_add(epfd2, epfd3, EPOLLIN));
+	test_assert_equal(-1, epoll_add(epfd2, epfd1, EPOLLIN));
+	test_assert_equal(ELOOP, errno);
+	test_assert_equal(-1, epoll_add(epfd3, epfd1, EPOLLIN));
+	test_assert_equal(ELOOP, errno);
+
+	close(epfd3);
+	close(epfd2);
+	close(epfd1);
+}
+
+TEST_CASE("EPOLLONESHOT descriptor is disabled until EPOLL_CTL_MOD") {
+	struct epoll_event ev;
+	int epfd, fd;
+
+	epfd = epoll_create1(0);
+	test_assert(epfd >= 0);
+	fd = eventfd(1, EFD_NONBLOCK);
+	test_assert(fd >= 0);
+
+	test_assert_zero(epoll_add(epfd, fd, EPOLLIN | EPOLLONESHOT));
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+	test_assert_zero(eventfd_write(fd, 1));
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 0));
+
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.fd = fd;
+	test_assert_zero(epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev));
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+
+	close(fd);
+	close(epfd);
+}
+
+TEST_CASE("Deleted and closed descriptors aren't reported") {
+	struct epoll_event ev[2];
+	int epfd, fd1, fd2;
+
+	epfd = epoll_create1(0);
+	test_assert(epfd >= 0);
+	fd1 = eventfd(1, EFD_NONBLOCK);
+	test_assert(fd1 >= 0);
+	fd2 = eventfd(1, EFD_NONBLOCK);
+	test_assert(fd2 >= 0);
+
+	test_assert_zero(epoll_add(epfd, fd1, EPOLLIN));
+	test_assert_zero(epoll_add(epfd, fd2, EPOLLIN));
+	test_assert_equal(2, epoll_wait(epfd, ev, 2, 0));
+
+	test_assert_zero(epoll_ctl(epfd, EPOLL_CTL_DEL, fd1, NULL));
+	test_assert_equal(1, epoll_wait(epfd, ev, 2, 0));
+	test_assert_equal(fd2, ev[0].data.fd);
+
+	close(fd2);
+	test_assert_zero(epoll_wait(epfd, ev, 2, 0));
+
+	close(fd1);
+	close(epfd);
+}
+
+TEST_CASE("epoll_wait times out without events") {
+	struct epoll_event ev;
+	time64_t start;
+	int epfd, fd;
+
+	epfd = epoll_create1(0);
+	test_assert(epfd >= 0);
+	fd = eventfd(0, EFD_NONBLOCK);
+	test_assert(fd >= 0);
+
+	test_assert_zero(epoll_add(epfd, fd, EPOLLIN));
+
+	start = ktime_get_ns();
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 20));
+	test_assert(ktime_get_ns() - start >= 10 * 1000000LL);
+
+	close(fd);
+	close(epfd);
+}
+
+static void bench_run(int n) {
+	struct epoll_event ev;
+	time64_t start, poll_ns, epoll_ns;
+	int epfd, i;
+
+	epfd = epoll_create1(0);
+	test_assert(epfd >= 0);
+
+	for (i = 0; i < n; i++) {
+		bench_fds[i] = eventfd(0, EFD_NONBLOCK);
+		test_assert(bench_fds[i] >= 0);
+		bench_pfds[i].fd = bench_fds[i];
+		bench_pfds[i].events = POLLIN;
+		test_assert_zero(epoll_add(epfd, bench_fds[i], EPOLLIN));
+	}
+	test_assert_zero(eventfd_write(bench_fds[n - 1], 1));
+
+	start = ktime_get_ns();
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		test_assert_equal(1, poll(bench_pfds, n, -1));
+	}
+	poll_ns = ktime_get_ns() - start;
+
+	start = ktime_get_ns();
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		test_assert_equal(1, epoll_wait(epfd, &ev, 1, -1));
+	}
+	epoll_ns = ktime_get_ns() - start;
+
+	printf("%5d fds: poll %lld ns, epoll %lld ns per call\n", n,
+			(long long) (poll_ns / BENCH_ITERATIONS),
+			(long long) (epoll_ns / BENCH_ITERATIONS));
+
+	for (i = 0; i < n; i++) {
+		close(bench_fds[i]);
+	}
+	close(epfd);
+}
+
+TEST_CASE("Compare poll() and epoll_wait() with one ready descriptor") {
+	int i;
+
+	printf("\n");
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		if (bench_sizes[i] + BENCH_RESERVED_FDS > MODOPS_IDESC_TABLE_SIZE) {
+			printf("%5d fds: skipped, descriptor table size is %d\n",
+					bench_sizes[i], MODOPS_IDESC_TABLE_SIZE);
+			continue;
+		}
+		bench_run(bench_sizes[i]);
+	}
+}
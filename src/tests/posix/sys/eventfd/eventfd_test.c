@@ -0,0 +1,82 @@
+/**
+ * @file
+ * @brief Tests for eventfd.
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <sys/eventfd.h>
+
+#include <embox/test.h>
+
+EMBOX_TEST_SUITE("eventfd suite");
+
+TEST_CASE("eventfd read returns counter and resets it") {
+	eventfd_t value;
+	int fd;
+
+	fd = eventfd(3, 0);
+	test_assert(fd >= 0);
+
+	test_assert_zero(eventfd_write(fd, 2));
+	test_assert_zero(eventfd_read(fd, &value));
+	test_assert_equal(5, value);
+
+	close(fd);
+}
+
+TEST_CASE("eventfd in semaphore mode decrements counter by one") {
+	eventfd_t value;
+	int fd;
+
+	fd = eventfd(2, EFD_SEMAPHORE | EFD_NONBLOCK);
+	test_assert(fd >= 0);
+
+	test_assert_zero(eventfd_read(fd, &value));
+	test_assert_equal(1, value);
+	test_assert_zero(eventfd_read(fd, &value));
+	test_assert_equal(1, value);
+	test_assert_equal(-1, eventfd_read(fd, &value));
+	test_assert_equal(EAGAIN, errno);
+
+	close(fd);
+}
+
+TEST_CASE("nonblocking eventfd returns EAGAIN on zero counter") {
+	eventfd_t value;
+	int fd;
+
+	fd = eventfd(0, EFD_NONBLOCK);
+	test_assert(fd >= 0);
+
+	test_assert_equal(-1, read(fd, &value, sizeof value));
+	test_assert_equal(EAGAIN, errno);
+
+	test_assert_equal(-1, read(fd, &value, sizeof value - 1));
+	test_assert_equal(EINVAL, errno);
+
+	close(fd);
+}
+
+TEST_CASE("eventfd is reported by poll() when counter isn't zero") {
+	struct pollfd pfd;
+	int fd;
+
+	fd = eventfd(0, EFD_NONBLOCK);
+	test_assert(fd >= 0);
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	test_assert_zero(poll(&pfd, 1, 0));
+
+	test_assert_zero(eventfd_write(fd, 1));
+	test_assert_equal(1, poll(&pfd, 1, 0));
+	test_assert(pfd.revents & POLLIN);
+
+	close(fd);
+}
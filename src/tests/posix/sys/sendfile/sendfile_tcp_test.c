@@ -0,0 +1,107 @@
+/**
+ * @file
+ * @brief Tests for sendfile() on TCP socket
+ *
+ * @date 17.10.26
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <embox/test.h>
+
+EMBOX_TEST_SUITE("sendfile() on TCP socket tests");
+
+TEST_SETUP(case_setup);
+TEST_TEARDOWN(case_teardown);
+
+#define PORT      5204
+#define FILE_PATH "/tmp/sendfile_tcp_test"
+
+/* Several segments of loopback, not multiple of MSS */
+#define DATA_LEN  21000
+#define PART_LEN  7000
+
+static int l, c, a, fd;
+
+static char test_data[DATA_LEN];
+static char test_buf[DATA_LEN];
+
+static void recv_all(size_t len) {
+	size_t received;
+	ssize_t ret;
+
+	received = 0;
+	while (received < len) {
+		ret = recv(a, test_buf + received, sizeof(test_buf) - received, 0);
+		test_assert(ret > 0);
+		received += ret;
+	}
+}
+
+TEST_CASE("sendfile sends the whole file on socket") {
+	test_assert_equal(DATA_LEN, sendfile(c, fd, NULL, 2 * DATA_LEN));
+	test_assert_equal(DATA_LEN, lseek(fd, 0, SEEK_CUR));
+
+	recv_all(DATA_LEN);
+	test_assert_zero(memcmp(test_buf, test_data, DATA_LEN));
+}
+
+TEST_CASE("sendfile sends part of file from offset on socket") {
+	off_t off = PART_LEN + 1;
+
+	test_assert_equal(PART_LEN, sendfile(c, fd, &off, PART_LEN));
+	test_assert_equal(2 * PART_LEN + 1, off);
+	test_assert_zero(lseek(fd, 0, SEEK_CUR));
+
+	recv_all(PART_LEN);
+	test_assert_zero(memcmp(test_buf, test_data + PART_LEN + 1, PART_LEN));
+}
+
+static int case_setup(void) {
+	struct sockaddr_in addr;
+	int i;
+
+	for (i = 0; i < DATA_LEN; i++) {
+		test_data[i] = i * 13 + i / 256;
+	}
+
+	fd = open(FILE_PATH, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if ((fd < 0) || (DATA_LEN != write(fd, test_data, DATA_LEN))
+			|| (0 != lseek(fd, 0, SEEK_SET))) {
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	l = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	c = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if ((l < 0) || (c < 0)
+			|| (0 != bind(l, (struct sockaddr *)&addr, sizeof(addr)))
+			|| (0 != listen(l, 1))
+			|| (0 != connect(c, (struct sockaddr *)&addr, sizeof(addr)))) {
+		return -1;
+	}
+
+	a = accept(l, NULL, NULL);
+	return a < 0 ? -1 : 0;
+}
+
+static int case_teardown(void) {
+	close(a);
+	close(c);
+	close(l);
+	close(fd);
+	unlink(FILE_PATH);
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @brief Tests for sendfile()
+ *
+ * @date 17.10.26
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+#include <embox/test.h>
+
+EMBOX_TEST_SUITE("sendfile() tests");
+
+TEST_SETUP(case_setup);
+TEST_TEARDOWN(case_teardown);
+
+#define SRC_PATH "/tmp/sendfile_test_src"
+#define DST_PATH "/tmp/sendfile_test_dst"
+
+/* Longer than copy buffer to check the data is sent in several rounds */
+#define DATA_LEN 3000
+
+static char test_data[DATA_LEN];
+static char test_buf[DATA_LEN];
+static int src_fd, dst_fd;
+
+static void check_dst(off_t off, size_t len) {
+	test_assert_equal(0, lseek(dst_fd, 0, SEEK_SET));
+	test_assert_equal(len, read(dst_fd, test_buf, sizeof(test_buf)));
+	test_assert_zero(memcmp(test_buf, test_data + off, len));
+}
+
+TEST_CASE("sendfile copies the whole file and moves file position") {
+	test_assert_equal(DATA_LEN, sendfile(dst_fd, src_fd, NULL, DATA_LEN));
+	test_assert_equal(DATA_LEN, lseek(src_fd, 0, SEEK_CUR));
+	check_dst(0, DATA_LEN);
+}
+
+TEST_CASE("sendfile doesn't send beyond end of file") {
+	test_assert_equal(100, lseek(src_fd, 100, SEEK_SET));
+	test_assert_equal(DATA_LEN - 100,
+			sendfile(dst_fd, src_fd, NULL, 2 * DATA_LEN));
+	test_assert_zero(sendfile(dst_fd, src_fd, NULL, DATA_LEN));
+	check_dst(100, DATA_LEN - 100);
+}
+
+TEST_CASE("sendfile with offset updates it and keeps file position") {
+	off_t off = 1000;
+
+	test_assert_equal(10, lseek(src_fd, 10, SEEK_SET));
+	test_assert_equal(500, sendfile(dst_fd, src_fd, &off, 500));
+	test_assert_equal(1500, off);
+	test_assert_equal(10, lseek(src_fd, 0, SEEK_CUR));
+	check_dst(1000, 500);
+}
+
+TEST_CASE("sendfile fails on bad descriptors") {
+	test_assert_equal(-1, sendfile(dst_fd, -1, NULL, DATA_LEN));
+	test_assert_equal(EBADF, errno);
+	test_assert_equal(-1, sendfile(-1, src_fd, NULL, DATA_LEN));
+	test_assert_equal(EBADF, errno);
+}
+
+static int case_setup(void) {
+	int i;
+
+	for (i = 0; i < DATA_LEN; i++) {
+		test_data[i] = i * 7 + i / 256;
+	}
+
+	src_fd = open(SRC_PATH, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	dst_fd = open(DST_PATH, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if ((src_fd < 0) || (dst_fd < 0)) {
+		return -1;
+	}
+
+	if (DATA_LEN != write(src_fd, test_data, DATA_LEN)) {
+		return -1;
+	}
+
+	return (0 == lseek(src_fd, 0, SEEK_SET)) ? 0 : -1;
+}
+
+static int case_teardown(void) {
+	close(src_fd);
+	close(dst_fd);
+	unlink(SRC_PATH);
+	unlink(DST_PATH);
+
+	return 0;
+}
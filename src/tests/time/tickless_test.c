@@ -0,0 +1,53 @@
+/**
+ * @file
+ * @brief Checks jiffies and timers are accurate while idle tick is stopped
+ *
+ * @date 17.10.26
+ */
+
+#include <unistd.h>
+
+#include <embox/test.h>
+#include <hal/clock.h>
+#include <kernel/time/time.h>
+#include <kernel/time/timer.h>
+
+EMBOX_TEST_SUITE("tickless idle test");
+
+#define TEST_TIMEOUT_MS 30
+#define TEST_SLEEP_MS   50
+
+static volatile clock_t test_fired_at;
+
+static void test_timer_handler(struct sys_timer *timer, void *param) {
+	test_fired_at = clock_sys_ticks();
+}
+
+TEST_CASE("timer expires on time when CPU is idle") {
+	struct sys_timer tmr;
+	clock_t start;
+
+	test_fired_at = 0;
+	start = clock_sys_ticks();
+	test_assert_zero(timer_init_start_msec(&tmr, TIMER_ONESHOT,
+				TEST_TIMEOUT_MS, test_timer_handler, NULL));
+
+	/* Let the CPU go idle until the timer expires */
+	usleep(2 * TEST_TIMEOUT_MS * 1000);
+	timer_close(&tmr);
+
+	test_assert_not_zero(test_fired_at);
+	test_assert(test_fired_at - start >= ms2jiffies(TEST_TIMEOUT_MS));
+	test_assert(test_fired_at - start <= ms2jiffies(TEST_TIMEOUT_MS) + 2);
+}
+
+TEST_CASE("jiffies advance while tick is stopped") {
+	clock_t start, passed;
+
+	start = clock_sys_ticks();
+	usleep(TEST_SLEEP_MS * 1000);
+	passed = clock_sys_ticks() - start;
+
+	test_assert(passed >= ms2jiffies(TEST_SLEEP_MS));
+	test_assert(passed <= ms2jiffies(TEST_SLEEP_MS) + 2);
+}